@@ -0,0 +1,58 @@
+lessThan(QT_MAJOR_VERSION, 5): error("The benchmarks require Qt 5.2+")
+
+QT += widgets testlib
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+TARGET = qhexeditbench
+
+# gzip files are read if zlib is found, seekable zstd files if libzstd is found
+packagesExist(zlib) {
+    DEFINES += QHEXEDIT_ZLIB
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+}
+packagesExist(libzstd) {
+    DEFINES += QHEXEDIT_ZSTD
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libzstd
+}
+
+HEADERS = \
+    benchcommon.h \
+    ../src/qhexedit.h \
+    ../src/qhexedit_p.h \
+    ../src/xbytearray.h \
+    ../src/commands.h \
+    ../src/qhexeditdata.h \
+    ../src/qhexeditdocument.h \
+    ../src/undostore.h \
+    ../src/piecetable.h \
+    ../src/editjournal.h \
+    ../src/hexlayout.h \
+    ../src/checksums.h \
+    ../src/hashengine.h \
+    ../src/qhexedithighlighter.h \
+    ../src/valuedecoder.h \
+    ../src/highlightrules.h \
+    ../src/bitscan.h
+
+SOURCES = \
+    qhexeditbench.cpp \
+    ../src/qhexedit.cpp \
+    ../src/qhexedit_p.cpp \
+    ../src/xbytearray.cpp \
+    ../src/commands.cpp \
+    ../src/qhexeditdata.cpp \
+    ../src/qhexeditcompresseddata.cpp \
+    ../src/qhexeditprocessdata.cpp \
+    ../src/qhexeditdocument.cpp \
+    ../src/undostore.cpp \
+    ../src/piecetable.cpp \
+    ../src/editjournal.cpp \
+    ../src/hexlayout.cpp \
+    ../src/checksums.cpp \
+    ../src/hashengine.cpp \
+    ../src/valuedecoder.cpp \
+    ../src/highlightrules.cpp
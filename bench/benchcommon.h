@@ -0,0 +1,75 @@
+#ifndef BENCHCOMMON_H
+#define BENCHCOMMON_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonObject>
+
+#include <algorithm>
+
+// The sample data and the JSON metadata of the benchmark and the latency
+// harness, so their results describe the same data and can be compared.
+
+const quint32 SAMPLE_SEED = 12345;
+const int SAMPLE_CHUNK = 1024 * 1024;           // written at once to a sample file
+
+// deterministic bytes with the mix of a typical binary: runs of zeros,
+// text and noise in blocks of 64 bytes, seed continues over the calls
+inline QByteArray sampleBytes(qint64 offset, int size, quint32 & seed)
+{
+    QByteArray bytes(size, 0);
+    for (int idx = 0; idx < size; idx++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        const uchar noise = uchar(seed >> 16);
+        switch (((offset + idx) / 64) % 4)
+        {
+            case 0:     bytes[idx] = 0; break;
+            case 1:     bytes[idx] = char('a' + noise % 26); break;
+            default:    bytes[idx] = char(noise); break;
+        }
+    }
+    return bytes;
+}
+
+inline QByteArray sampleBytes(int size)
+{
+    quint32 seed = SAMPLE_SEED;
+    return sampleBytes(0, size, seed);
+}
+
+// writes the sample in chunks, so it doesn't have to fit into memory
+inline bool writeSampleFile(const QString & fileName, qint64 size, QString & error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        error = file.errorString();
+        return false;
+    }
+    quint32 seed = SAMPLE_SEED;
+    for (qint64 offset = 0; offset < size; offset += SAMPLE_CHUNK)
+    {
+        const int len = int(std::min<qint64>(SAMPLE_CHUNK, size - offset));
+        if (file.write(sampleBytes(offset, len, seed)) != len)
+        {
+            error = file.errorString();
+            return false;
+        }
+    }
+    return true;
+}
+
+// the Qt version, the platform and the date of a JSON report
+inline QJsonObject reportHeader()
+{
+    QJsonObject object;
+    object.insert("qtVersion", QString(qVersion()));
+    object.insert("platform", QGuiApplication::platformName());
+    object.insert("date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    return object;
+}
+
+#endif // BENCHCOMMON_H
@@ -0,0 +1,779 @@
+#include <QApplication>
+#include <QClipboard>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFontDatabase>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QWindow>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "../../src/qhexedit.h"
+#include "../benchcommon.h"
+
+const qint64 DEFAULT_SIZE = 64 * 1024 * 1024;
+const int DRAG_STEPS = 16;                      // mouse moves of a drag without steps
+const int QUIET_ROUNDS = 2;                     // event loop passes without a paint, which end an event
+const int MAX_ROUNDS = 64;
+const int EXPOSE_TIMEOUT = 5000;                // ms
+const int VIEW_WIDTH = 1280;
+const int VIEW_HEIGHT = 960;
+
+// typing in insert mode in the middle of the data, paging, a drag selection,
+// which a paste replaces, and undoing it all
+static const char * const DEFAULT_SESSION =
+    "mode insert\n"
+    "goto 50%\n"
+    "64 type 0123456789abcdef\n"
+    "16 key PgDown\n"
+    "16 key PgUp\n"
+    "drag 240 120 720 360\n"
+    "paste 000102030405060708090a0b0c0d0e0f\n"
+    "64 key Ctrl+Z\n";
+
+// sizes like 4096, 512K, 64M or 2G
+static bool parseSize(const QString & text, qint64 & size)
+{
+    qint64 unit = 1;
+    QString digits = text.toUpper();
+    if (digits.endsWith('K')) {
+        unit = 1024;
+    } else if (digits.endsWith('M')) {
+        unit = 1024 * 1024;
+    } else if (digits.endsWith('G')) {
+        unit = 1024 * 1024 * 1024;
+    }
+    if (unit != 1) {
+        digits.chop(1);
+    }
+    bool ok = false;
+    size = digits.toLongLong(&ok) * unit;
+    return ok && size > 0;
+}
+
+static std::unique_ptr<QHexEditData> makeData(const QString & backend, qint64 size, const QTemporaryDir & dir,
+                                              QString & error)
+{
+    if (backend == "bytearray")
+    {
+        if (size > INT_MAX)
+        {
+            error = QObject::tr("The bytearray backend holds at most %1 bytes").arg(INT_MAX);
+            return std::unique_ptr<QHexEditData>();
+        }
+        return QHexEditData::fromByteArray(sampleBytes(int(size)));
+    }
+    if (backend != "file")
+    {
+        error = QObject::tr("Unknown backend %1, expected bytearray or file").arg(backend);
+        return std::unique_ptr<QHexEditData>();
+    }
+
+    const QString fileName = dir.filePath("sample.bin");
+    if (!writeSampleFile(fileName, size, error)) {
+        return std::unique_ptr<QHexEditData>();
+    }
+
+    std::unique_ptr<QHexEditData> data = QHexEditData::fromFile(fileName);
+    if (!data) {
+        error = QObject::tr("Cannot open %1").arg(fileName);
+    }
+    return data;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Session implementation:
+
+/*! SessionEvent is one input of an editing session: a key press, a left
+button mouse event or a paste (a key press with bytes in the clipboard). Goto,
+Top and Mode set the editor up without being measured. Events with the same
+name are reported together.
+*/
+struct SessionEvent
+{
+    enum Kind
+    {
+        Key,
+        Press,
+        Move,
+        Release,
+        Paste,
+        Goto,
+        Top,
+        Mode
+    };
+
+    Kind kind;
+    QString name;
+    int key;
+    Qt::KeyboardModifiers modifiers;
+    QString text;                       // of a Key or Paste
+    QPoint pos;                         // of a mouse event
+    QByteArray bytes;                   // of a Paste
+    size_t address;                     // of a Goto or Top
+    bool overwrite;                     // of a Mode
+};
+
+// the text a keyboard sends with key
+static QString keyText(int key, Qt::KeyboardModifiers modifiers)
+{
+    if (modifiers & (Qt::AltModifier | Qt::MetaModifier)) {
+        return QString();
+    }
+    if (key >= Qt::Key_A && key <= Qt::Key_Z)
+    {
+        if (modifiers & Qt::ControlModifier) {
+            return QString(QChar(key - Qt::Key_A + 1));
+        }
+        return QString(QChar(modifiers & Qt::ShiftModifier ? key : key - Qt::Key_A + 'a'));
+    }
+    if (modifiers & Qt::ControlModifier) {
+        return QString();
+    }
+    if (key >= Qt::Key_Space && key <= Qt::Key_AsciiTilde) {
+        return QString(QChar(key));
+    }
+    switch (key)
+    {
+        case Qt::Key_Tab:       return QString("\t");
+        case Qt::Key_Return:
+        case Qt::Key_Enter:     return QString("\r");
+        case Qt::Key_Backspace: return QString("\b");
+        case Qt::Key_Delete:    return QString("\x7f");
+        case Qt::Key_Escape:    return QString("\x1b");
+        default:                return QString();
+    }
+}
+
+static void setKey(SessionEvent & event, int combination)
+{
+    event.key = combination & ~int(Qt::KeyboardModifierMask);
+    event.modifiers = Qt::KeyboardModifiers(combination & int(Qt::KeyboardModifierMask));
+    event.text = keyText(event.key, event.modifiers);
+}
+
+// addresses in hex or decimal, or a percentage of the data size
+static bool parseAddress(const QString & text, size_t dataSize, size_t & address)
+{
+    bool ok = false;
+    if (text.endsWith('%'))
+    {
+        const double percent = text.left(text.size() - 1).toDouble(&ok);
+        ok = ok && percent >= 0 && percent <= 100;
+        address = size_t(dataSize * (percent / 100));
+    }
+    else
+    {
+        address = size_t(text.toULongLong(&ok, 0));
+    }
+    address = std::min(address, dataSize);
+    return ok;
+}
+
+// the events of one line of a session without its count
+static bool parseLine(const QStringList & words, size_t dataSize, std::vector<SessionEvent> & events)
+{
+    const QString & command = words[0];
+    SessionEvent event;
+    event.name = command;
+    event.key = 0;
+    event.modifiers = Qt::NoModifier;
+    event.address = 0;
+    event.overwrite = false;
+
+    bool ok = false;
+    if (command == "key" && words.size() == 2)
+    {
+        const QKeySequence sequence = QKeySequence::fromString(words[1], QKeySequence::PortableText);
+        ok = sequence.count() == 1 && (sequence[0] & ~int(Qt::KeyboardModifierMask)) != Qt::Key_unknown;
+        event.kind = SessionEvent::Key;
+        event.name = "key " + words[1];
+        setKey(event, ok ? sequence[0] : 0);
+        events.push_back(event);
+    }
+    else if (command == "type" && words.size() == 2)
+    {
+        ok = true;
+        event.kind = SessionEvent::Key;
+        for (const QChar & ch : words[1])
+        {
+            event.key = ch.toUpper().unicode();
+            event.modifiers = ch.isUpper() ? Qt::ShiftModifier : Qt::NoModifier;
+            event.text = QString(ch);
+            events.push_back(event);
+        }
+    }
+    else if ((command == "press" || command == "move" || command == "release") && words.size() == 3)
+    {
+        bool yOk = false;
+        event.pos = QPoint(words[1].toInt(&ok), words[2].toInt(&yOk));
+        ok = ok && yOk;
+        event.kind = command == "press" ? SessionEvent::Press
+                   : command == "move" ? SessionEvent::Move : SessionEvent::Release;
+        events.push_back(event);
+    }
+    else if (command == "drag" && (words.size() == 5 || words.size() == 6))
+    {
+        int values[5] = {0, 0, 0, 0, DRAG_STEPS};
+        ok = true;
+        for (int idx = 1; idx < words.size() && ok; idx++) {
+            values[idx - 1] = words[idx].toInt(&ok);
+        }
+        ok = ok && values[4] > 0;
+        const QPoint from(values[0], values[1]);
+        const QPoint to(values[2], values[3]);
+
+        event.kind = SessionEvent::Press;
+        event.name = "press";
+        event.pos = from;
+        events.push_back(event);
+        event.kind = SessionEvent::Move;
+        event.name = "move";
+        for (int step = 1; step <= values[4]; step++)
+        {
+            event.pos = from + (to - from) * step / values[4];
+            events.push_back(event);
+        }
+        event.kind = SessionEvent::Release;
+        event.name = "release";
+        events.push_back(event);
+    }
+    else if (command == "paste" && words.size() == 2)
+    {
+        event.kind = SessionEvent::Paste;
+        event.bytes = QByteArray::fromHex(words[1].toLatin1());
+        ok = event.bytes.size() > 0 && words[1].size() == 2 * event.bytes.size();
+        setKey(event, QKeySequence(QKeySequence::Paste)[0]);
+        events.push_back(event);
+    }
+    else if ((command == "goto" || command == "top") && words.size() == 2)
+    {
+        event.kind = command == "goto" ? SessionEvent::Goto : SessionEvent::Top;
+        ok = parseAddress(words[1], dataSize, event.address);
+        events.push_back(event);
+    }
+    else if (command == "mode" && words.size() == 2)
+    {
+        event.kind = SessionEvent::Mode;
+        event.overwrite = words[1] == "overwrite";
+        ok = event.overwrite || words[1] == "insert";
+        events.push_back(event);
+    }
+    return ok;
+}
+
+/*! Parses a session, one command per line, optionally preceded by a count,
+which repeats it. Empty lines and lines starting with # are skipped.
+
+\code
+key <keys>                  a key press, e.g. Ctrl+Z, PgDown, Shift+Right or A
+type <chars>                a key press per char, e.g. 0123abcd
+press|move|release <x> <y>  a left button mouse event at widget coordinates
+drag <x> <y> <x> <y> [n]    press, n moves (default 16) and release
+paste <bytes>               the paste shortcut with the hex bytes in the clipboard
+goto <address>              moves the cursor, hex, decimal or a percentage
+top <address>               scrolls the address to the top
+mode insert|overwrite
+\endcode
+*/
+static bool parseSession(const QString & text, size_t dataSize, std::vector<SessionEvent> & events,
+                         QString * errorString = nullptr)
+{
+    events.clear();
+    QString error;
+    const QStringList lines = text.split('\n');
+    for (int idx = 0; idx < lines.size(); idx++)
+    {
+        QStringList words = lines[idx].simplified().split(' ', QString::SkipEmptyParts);
+        if (words.isEmpty() || words[0].startsWith('#')) {
+            continue;
+        }
+
+        bool ok = true;
+        int count = 1;
+        if (words[0].at(0).isDigit())
+        {
+            count = words.takeFirst().toInt(&ok);
+            ok = ok && count > 0 && !words.isEmpty();
+        }
+        std::vector<SessionEvent> lineEvents;
+        if (!ok || !parseLine(words, dataSize, lineEvents))
+        {
+            error = QObject::tr("Line %1: cannot parse \"%2\"").arg(idx + 1).arg(lines[idx].simplified());
+            break;
+        }
+        for (int repeat = 0; repeat < count; repeat++) {
+            events.insert(events.end(), lineEvents.begin(), lineEvents.end());
+        }
+    }
+
+    if (!error.isEmpty())
+    {
+        events.clear();
+        if (errorString) {
+            *errorString = error;
+        }
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Replay implementation:
+
+/*! PaintCounter counts the paint events of the widgets it filters. */
+class PaintCounter : public QObject
+{
+public:
+    PaintCounter() :
+        _paints(0)
+    { }
+
+    int paints() const
+    {
+        return _paints;
+    }
+
+protected:
+    bool eventFilter(QObject * watched, QEvent * event)
+    {
+        if (event->type() == QEvent::Paint) {
+            _paints++;
+        }
+        return QObject::eventFilter(watched, event);
+    }
+
+private:
+    int _paints;
+};
+
+/*! Latencies collects the nanoseconds from sending an event until it was
+handled and until the editor finished painting it, by the name of the event.
+*/
+struct Latencies
+{
+    std::vector<QString> names;         // in the order of the session
+    std::map<QString, std::vector<qint64>> handled;
+    std::map<QString, std::vector<qint64>> painted;
+
+    void add(const QString & name, qint64 handledNs, qint64 paintedNs)
+    {
+        if (handled.find(name) == handled.end()) {
+            names.push_back(name);
+        }
+        handled[name].push_back(handledNs);
+        painted[name].push_back(paintedNs);
+    }
+};
+
+static std::unique_ptr<QEvent> makeEvent(const SessionEvent & event, QWidget * target)
+{
+    const QPointF local(event.pos);
+    const QPointF window(target->mapTo(target->window(), event.pos));
+    const QPointF screen(target->mapToGlobal(event.pos));
+    switch (event.kind)
+    {
+        case SessionEvent::Key:
+        case SessionEvent::Paste:
+            return std::unique_ptr<QEvent>(new QKeyEvent(QEvent::KeyPress, event.key, event.modifiers, event.text));
+        case SessionEvent::Press:
+            return std::unique_ptr<QEvent>(new QMouseEvent(QEvent::MouseButtonPress, local, window, screen,
+                                                           Qt::LeftButton, Qt::LeftButton, Qt::NoModifier));
+        case SessionEvent::Move:
+            return std::unique_ptr<QEvent>(new QMouseEvent(QEvent::MouseMove, local, window, screen,
+                                                           Qt::NoButton, Qt::LeftButton, Qt::NoModifier));
+        case SessionEvent::Release:
+            return std::unique_ptr<QEvent>(new QMouseEvent(QEvent::MouseButtonRelease, local, window, screen,
+                                                           Qt::LeftButton, Qt::NoButton, Qt::NoModifier));
+        default:
+            return std::unique_ptr<QEvent>();
+    }
+}
+
+// runs the event loop until the editor flushed its changes and stopped
+// painting, returns the time the last paint finished or the current time
+static qint64 settle(const QHexEdit & edit, const PaintCounter & counter, const QElapsedTimer & timer)
+{
+    qint64 painted = timer.nsecsElapsed();
+    int quiet = 0;
+    for (int round = 0; round < MAX_ROUNDS && quiet < QUIET_ROUNDS; round++)
+    {
+        const int paints = counter.paints();
+        QCoreApplication::processEvents();
+        if (counter.paints() != paints)
+        {
+            painted = timer.nsecsElapsed();
+            quiet = 0;
+        }
+        else if (!edit.document()->changesPending())
+        {
+            quiet++;
+        }
+    }
+    return painted;
+}
+
+static void replay(QHexEdit & edit, const std::vector<SessionEvent> & events, Latencies & latencies)
+{
+    QWidget * target = edit.widget();
+    PaintCounter counter;
+    target->installEventFilter(&counter);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (const SessionEvent & event : events)
+    {
+        if (event.kind == SessionEvent::Goto || event.kind == SessionEvent::Top || event.kind == SessionEvent::Mode)
+        {
+            if (event.kind == SessionEvent::Goto) {
+                edit.gotoAddress(event.address);
+            } else if (event.kind == SessionEvent::Top) {
+                edit.setTopAddress(event.address);
+            } else {
+                edit.setOverwriteMode(event.overwrite);
+            }
+            settle(edit, counter, timer);
+            continue;
+        }
+
+        if (event.kind == SessionEvent::Paste) {
+            QApplication::clipboard()->setText(QString::fromLatin1(event.bytes.toHex()));
+        }
+        std::unique_ptr<QEvent> input = makeEvent(event, target);
+
+        const qint64 start = timer.nsecsElapsed();
+        QCoreApplication::sendEvent(target, input.get());
+        const qint64 handled = timer.nsecsElapsed() - start;
+        const qint64 painted = std::max(handled, settle(edit, counter, timer) - start);
+        latencies.add(event.name, handled, painted);
+    }
+    target->removeEventFilter(&counter);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Report implementation:
+
+// the nearest rank percentile of sorted values
+static qint64 percentile(const std::vector<qint64> & sorted, double fraction)
+{
+    const size_t rank = size_t(std::ceil(fraction * sorted.size()));
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+static double toMs(qint64 ns)
+{
+    return ns / 1e6;
+}
+
+static QJsonObject statistics(std::vector<qint64> values)
+{
+    std::sort(values.begin(), values.end());
+    QJsonObject object;
+    object.insert("p50", toMs(percentile(values, 0.50)));
+    object.insert("p99", toMs(percentile(values, 0.99)));
+    object.insert("max", toMs(values.back()));
+    return object;
+}
+
+// one row per event name and one of all events, the latencies in ms
+static QJsonArray report(const Latencies & latencies)
+{
+    QJsonArray rows;
+    std::vector<qint64> allHandled;
+    std::vector<qint64> allPainted;
+    for (const QString & name : latencies.names)
+    {
+        const std::vector<qint64> & handled = latencies.handled.at(name);
+        const std::vector<qint64> & painted = latencies.painted.at(name);
+        allHandled.insert(allHandled.end(), handled.begin(), handled.end());
+        allPainted.insert(allPainted.end(), painted.begin(), painted.end());
+
+        QJsonObject row;
+        row.insert("event", name);
+        row.insert("count", int(handled.size()));
+        row.insert("handled", statistics(handled));
+        row.insert("painted", statistics(painted));
+        rows.append(row);
+    }
+    if (!allHandled.empty())
+    {
+        QJsonObject row;
+        row.insert("event", QString("all"));
+        row.insert("count", int(allHandled.size()));
+        row.insert("handled", statistics(allHandled));
+        row.insert("painted", statistics(allPainted));
+        rows.append(row);
+    }
+    return rows;
+}
+
+static void printReport(const QJsonArray & rows)
+{
+    std::printf("%-20s %7s   %-28s   %-28s\n", "", "", "handled (ms)", "painted (ms)");
+    std::printf("%-20s %7s   %8s %9s %9s   %8s %9s %9s\n", "event", "count", "p50", "p99", "max", "p50", "p99", "max");
+    for (const QJsonValue & value : rows)
+    {
+        const QJsonObject row = value.toObject();
+        const QJsonObject handled = row.value("handled").toObject();
+        const QJsonObject painted = row.value("painted").toObject();
+        std::printf("%-20s %7d   %8.3f %9.3f %9.3f   %8.3f %9.3f %9.3f\n",
+                    qPrintable(row.value("event").toString()), row.value("count").toInt(),
+                    handled.value("p50").toDouble(), handled.value("p99").toDouble(), handled.value("max").toDouble(),
+                    painted.value("p50").toDouble(), painted.value("p99").toDouble(), painted.value("max").toDouble());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Recorder implementation:
+
+/*! SessionRecorder writes the key presses and the left button mouse events
+of an editor as session lines. The top address is written before an event,
+whenever it changed, so mouse positions replay on the same bytes after
+scrolling, which is not recorded itself.
+*/
+class SessionRecorder : public QObject
+{
+public:
+    SessionRecorder(QHexEdit & edit, QTextStream & stream) :
+        _edit(edit),
+        _stream(stream),
+        _top(edit.topAddress())
+    {
+        _stream << "# recorded by qhexeditlatency\n";
+        _stream << "mode " << (edit.overwriteMode() ? "overwrite" : "insert") << '\n';
+        _stream << "top 0x" << QString::number(qulonglong(_top), 16) << '\n';
+    }
+
+protected:
+    bool eventFilter(QObject * watched, QEvent * event)
+    {
+        switch (event->type())
+        {
+            case QEvent::KeyPress:
+                writeKey(static_cast<QKeyEvent *>(event));
+                break;
+            case QEvent::MouseButtonPress:
+            case QEvent::MouseButtonRelease:
+            case QEvent::MouseMove:
+                writeMouse(static_cast<QMouseEvent *>(event));
+                break;
+            default:
+                break;
+        }
+        return QObject::eventFilter(watched, event);
+    }
+
+private:
+    void writeTop()
+    {
+        const size_t top = _edit.topAddress();
+        if (top != _top)
+        {
+            _top = top;
+            _stream << "top 0x" << QString::number(qulonglong(_top), 16) << '\n';
+        }
+    }
+
+    void writeKey(QKeyEvent * event)
+    {
+        const int key = event->key();
+        if (key == Qt::Key_Shift || key == Qt::Key_Control || key == Qt::Key_Alt || key == Qt::Key_Meta
+            || key == Qt::Key_AltGr || key == Qt::Key_CapsLock || key == 0 || key == Qt::Key_unknown) {
+            return;
+        }
+
+        writeTop();
+        const QByteArray bytes = QByteArray::fromHex(QApplication::clipboard()->text().toLatin1());
+        if (event->matches(QKeySequence::Paste) && !bytes.isEmpty())
+        {
+            _stream << "paste " << bytes.toHex() << '\n';
+        }
+        else
+        {
+            const int modifiers = int(event->modifiers() & ~Qt::KeypadModifier);
+            _stream << "key " << QKeySequence(key | modifiers).toString(QKeySequence::PortableText) << '\n';
+        }
+    }
+
+    void writeMouse(QMouseEvent * event)
+    {
+        const bool move = event->type() == QEvent::MouseMove;
+        if ((move && !(event->buttons() & Qt::LeftButton)) || (!move && event->button() != Qt::LeftButton)) {
+            return;
+        }
+
+        writeTop();
+        const char * command = move ? "move" : event->type() == QEvent::MouseButtonPress ? "press" : "release";
+        _stream << command << ' ' << event->pos().x() << ' ' << event->pos().y() << '\n';
+    }
+
+    const QHexEdit & _edit;
+    QTextStream & _stream;
+    size_t _top;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// main:
+
+static bool waitForExposed(QWidget & widget)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!(widget.windowHandle() && widget.windowHandle()->isExposed()) && timer.elapsed() < EXPOSE_TIMEOUT) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    return widget.windowHandle() && widget.windowHandle()->isExposed();
+}
+
+static int fail(const QString & message)
+{
+    std::fprintf(stderr, "%s\n", qPrintable(message));
+    return 1;
+}
+
+/*! qhexeditlatency replays an editing session against a QHexEdit on
+synthetic data and reports the latencies of every kind of event: until the
+editor handled it and until the editor finished painting it. Without --record
+it runs on the offscreen platform, unless QT_QPA_PLATFORM is set.
+*/
+int main(int argc, char * argv[])
+{
+    // the platform is set before QCommandLineParser runs, so --record is
+    // looked for here, also in the form --record=<file>
+    bool recording = false;
+    for (int idx = 1; idx < argc; idx++)
+    {
+        const QByteArray argument(argv[idx]);
+        recording = recording || argument == "-record" || argument == "--record" ||
+                    argument.startsWith("-record=") || argument.startsWith("--record=");
+    }
+    if (!recording && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays an editing session against QHexEdit and reports the latencies of its events.");
+    parser.addHelpOption();
+    const QCommandLineOption sessionOption("session", "Replays the session <file> instead of the default one.", "file");
+    const QCommandLineOption recordOption("record", "Records a session to <file> in an editor window.", "file");
+    const QCommandLineOption sizeOption("size", "The size of the synthetic data, e.g. 512K, 64M or 2G.", "size", "64M");
+    const QCommandLineOption backendOption("backend", "The backend of the data: bytearray or file.", "name", "file");
+    const QCommandLineOption bytesPerLineOption("bytes-per-line", "The bytes per line of the editor.", "count", "16");
+    const QCommandLineOption repeatOption("repeat", "Replays the session <count> times.", "count", "1");
+    const QCommandLineOption jsonOption("json", "Writes the latencies to a JSON <file>.", "file");
+    parser.addOption(sessionOption);
+    parser.addOption(recordOption);
+    parser.addOption(sizeOption);
+    parser.addOption(backendOption);
+    parser.addOption(bytesPerLineOption);
+    parser.addOption(repeatOption);
+    parser.addOption(jsonOption);
+    parser.process(app);
+
+    qint64 size = DEFAULT_SIZE;
+    bool bytesPerLineOk = false;
+    bool repeatOk = false;
+    const int bytesPerLine = parser.value(bytesPerLineOption).toInt(&bytesPerLineOk);
+    const int repeat = parser.value(repeatOption).toInt(&repeatOk);
+    if (!parseSize(parser.value(sizeOption), size)) {
+        return fail(QObject::tr("Invalid size %1").arg(parser.value(sizeOption)));
+    }
+    if (!bytesPerLineOk || bytesPerLine <= 0 || !repeatOk || repeat <= 0) {
+        return fail(QObject::tr("The bytes per line and the repeat count have to be positive"));
+    }
+
+    QString session = DEFAULT_SESSION;
+    if (parser.isSet(sessionOption))
+    {
+        QFile file(parser.value(sessionOption));
+        if (!file.open(QIODevice::ReadOnly)) {
+            return fail(QObject::tr("Cannot read %1: %2").arg(file.fileName()).arg(file.errorString()));
+        }
+        session = QString::fromUtf8(file.readAll());
+    }
+    std::vector<SessionEvent> events;
+    QString error;
+    if (!recording && !parseSession(session, size_t(size), events, &error)) {
+        return fail(error);
+    }
+
+    QTemporaryDir dir;
+    std::unique_ptr<QHexEditData> data = makeData(parser.value(backendOption), size, dir, error);
+    if (!data) {
+        return fail(error);
+    }
+
+    QHexEdit edit;
+    edit.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    edit.setData(std::move(data));
+    edit.setBytesPerLine(bytesPerLine);
+    edit.resize(VIEW_WIDTH, VIEW_HEIGHT);
+    edit.show();
+    edit.activateWindow();
+    edit.widget()->setFocus();
+    if (!waitForExposed(edit)) {
+        return fail(QObject::tr("The editor window was not exposed"));
+    }
+
+    if (recording)
+    {
+        QFile file(parser.value(recordOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            return fail(QObject::tr("Cannot write %1: %2").arg(file.fileName()).arg(file.errorString()));
+        }
+        QTextStream stream(&file);
+        SessionRecorder recorder(edit, stream);
+        edit.widget()->installEventFilter(&recorder);
+        const int result = app.exec();
+        edit.widget()->removeEventFilter(&recorder);
+        stream.flush();
+        return result;
+    }
+
+    // every repetition starts from the same data, the undo stack restores it
+    Latencies latencies;
+    for (int idx = 0; idx < repeat; idx++)
+    {
+        replay(edit, events, latencies);
+        while (edit.document()->undoStack()->canUndo()) {
+            edit.document()->undo();
+        }
+        QCoreApplication::processEvents();
+    }
+
+    const QJsonArray rows = report(latencies);
+    std::printf("%s, %s backend, %lld bytes, %d bytes per line, %d events\n",
+                qPrintable(QGuiApplication::platformName()), qPrintable(parser.value(backendOption)),
+                size, bytesPerLine, int(events.size()) * repeat);
+    printReport(rows);
+
+    if (parser.isSet(jsonOption))
+    {
+        QJsonObject object = reportHeader();
+        object.insert("backend", parser.value(backendOption));
+        object.insert("size", double(size));
+        object.insert("bytesPerLine", bytesPerLine);
+        object.insert("repeat", repeat);
+        object.insert("events", rows);
+
+        QFile jsonFile(parser.value(jsonOption));
+        if (!jsonFile.open(QIODevice::WriteOnly) || jsonFile.write(QJsonDocument(object).toJson()) <= 0) {
+            return fail(QObject::tr("Cannot write %1").arg(jsonFile.fileName()));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,511 @@
+#include <QApplication>
+#include <QFile>
+#include <QFontDatabase>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QXmlStreamReader>
+#include <QtTest>
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "../src/qhexedit.h"
+#include "../src/highlightrules.h"
+#include "benchcommon.h"
+
+const int SMALL_SIZE = 1024 * 1024;
+const int LARGE_SIZE = 16 * 1024 * 1024;
+const int SEGMENT_GAP = 64 * 1024;              // hole between the two segments
+const int EDIT_LENGTH = 16;
+const int RANGE_LENGTH = 4096;
+const int TEXT_LENGTH = 64 * 1024;              // bytes of toRedableString()
+const int EDIT_STEP = 4099;                     // between edits, so commands don't merge
+const int VIEW_WIDTH = 1280;
+const int VIEW_HEIGHT = 960;
+
+enum Backend
+{
+    ByteArray,
+    Memory,
+    File,
+    Segments,
+    Compressed,
+    Backends
+};
+
+static const char * const BACKEND_NAMES[] = {"bytearray", "memory", "file", "segments", "gzip"};
+
+enum PaintState
+{
+    Plain,
+    Changes,
+    Rules
+};
+
+static const char * const PAINT_STATE_NAMES[] = {"plain", "changes", "rules"};
+
+static QString sizeName(int size)
+{
+    return QString("%1M").arg(size / (1024 * 1024));
+}
+
+/*! QHexEditBench measures the backends of QHexEditData, the searches, the
+undo/redo commands and painting of QHexEdit with QBENCHMARK. Every row of a
+benchmark is one backend or one setting, so runs can be compared row by row.
+
+Besides the arguments of QtTest, "-json <file>" writes the results to a JSON
+file: the metric, the value per iteration and the iterations of every row. The
+paint benchmarks run on the offscreen platform, unless QT_QPA_PLATFORM is set.
+*/
+class QHexEditBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void insert_data();
+    void insert();
+    void remove_data();
+    void remove();
+    void replace_data();
+    void replace();
+    void range_data();
+    void range();
+
+    void indexOf_data();
+    void indexOf();
+    void lastIndexOf_data();
+    void lastIndexOf();
+    void toReadableString_data();
+    void toReadableString();
+
+    void applyCommand_data();
+    void applyCommand();
+    void undoRedo_data();
+    void undoRedo();
+
+    void paint_data();
+    void paint();
+
+private:
+    void addBackendRows(const std::vector<int> & sizes, bool resizable);
+    void addCommandRows();
+    std::unique_ptr<QHexEditData> makeData(int backend, int size);
+    QString sampleFile(int size);
+
+    QTemporaryDir _dir;
+    QByteArray _memory;                 // of the memory backend
+};
+
+void QHexEditBench::initTestCase()
+{
+    QVERIFY(_dir.isValid());
+}
+
+void QHexEditBench::insert_data()
+{
+    addBackendRows({SMALL_SIZE, LARGE_SIZE}, true);
+}
+
+void QHexEditBench::insert()
+{
+    QFETCH(int, backend);
+    QFETCH(int, size);
+    std::unique_ptr<QHexEditData> data = makeData(backend, size);
+    const QByteArray bytes(EDIT_LENGTH, 'x');
+    size_t pos = 0;
+    QBENCHMARK {
+        data->insert(pos, bytes);
+        pos = (pos + EDIT_STEP) % data->size();
+    }
+}
+
+void QHexEditBench::remove_data()
+{
+    // the data shrinks with every iteration, the large size leaves enough
+    addBackendRows({LARGE_SIZE}, true);
+}
+
+void QHexEditBench::remove()
+{
+    QFETCH(int, backend);
+    QFETCH(int, size);
+    std::unique_ptr<QHexEditData> data = makeData(backend, size);
+    size_t pos = 0;
+    QBENCHMARK {
+        data->remove(pos, EDIT_LENGTH);
+        pos = (pos + EDIT_STEP) % (data->size() - EDIT_LENGTH);
+    }
+}
+
+void QHexEditBench::replace_data()
+{
+    addBackendRows({SMALL_SIZE, LARGE_SIZE}, false);
+}
+
+void QHexEditBench::replace()
+{
+    QFETCH(int, backend);
+    QFETCH(int, size);
+    std::unique_ptr<QHexEditData> data = makeData(backend, size);
+    const QByteArray bytes(EDIT_LENGTH, 'x');
+    size_t pos = 0;
+    QBENCHMARK {
+        data->replace(pos, bytes);
+        pos = (pos + EDIT_STEP) % (data->size() - EDIT_LENGTH);
+    }
+}
+
+void QHexEditBench::range_data()
+{
+    addBackendRows({SMALL_SIZE, LARGE_SIZE}, false);
+}
+
+void QHexEditBench::range()
+{
+    QFETCH(int, backend);
+    QFETCH(int, size);
+    std::unique_ptr<QHexEditData> data = makeData(backend, size);
+    size_t pos = 0;
+    QBENCHMARK {
+        const QByteArray bytes = data->range(pos, RANGE_LENGTH);
+        Q_UNUSED(bytes);
+        pos = (pos + EDIT_STEP) % (data->size() - RANGE_LENGTH);
+    }
+}
+
+void QHexEditBench::indexOf_data()
+{
+    addBackendRows({SMALL_SIZE, LARGE_SIZE}, false);
+}
+
+void QHexEditBench::indexOf()
+{
+    // a pattern, which isn't found, scans all of the data
+    QFETCH(int, backend);
+    QFETCH(int, size);
+    std::unique_ptr<QHexEditData> data = makeData(backend, size);
+    const QByteArray pattern("\x01\x23\x45\x67\x89\xab\xcd\xef\xfe", 9);
+    QBENCHMARK {
+        const int found = data->indexOf(pattern, 0);
+        Q_UNUSED(found);
+    }
+}
+
+void QHexEditBench::lastIndexOf_data()
+{
+    addBackendRows({SMALL_SIZE, LARGE_SIZE}, false);
+}
+
+void QHexEditBench::lastIndexOf()
+{
+    QFETCH(int, backend);
+    QFETCH(int, size);
+    std::unique_ptr<QHexEditData> data = makeData(backend, size);
+    const QByteArray pattern("\x01\x23\x45\x67\x89\xab\xcd\xef\xfe", 9);
+    QBENCHMARK {
+        const int found = data->lastIndexOf(pattern, data->size() - 1);
+        Q_UNUSED(found);
+    }
+}
+
+void QHexEditBench::toReadableString_data()
+{
+    addBackendRows({SMALL_SIZE}, false);
+}
+
+void QHexEditBench::toReadableString()
+{
+    QFETCH(int, backend);
+    QFETCH(int, size);
+    std::unique_ptr<QHexEditData> data = makeData(backend, size);
+    QBENCHMARK {
+        const QString text = data->toRedableString(size / 2, size / 2 + TEXT_LENGTH);
+        Q_UNUSED(text);
+    }
+}
+
+void QHexEditBench::applyCommand_data()
+{
+    addCommandRows();
+}
+
+void QHexEditBench::applyCommand()
+{
+    // the byte array backend gets ArrayCommands, the file SpanCommands
+    QFETCH(int, backend);
+    QFETCH(bool, array);
+    QHexEditDocument document(makeData(backend, LARGE_SIZE));
+    const QByteArray bytes(EDIT_LENGTH, 'x');
+    size_t pos = 0;
+    QBENCHMARK {
+        if (array) {
+            document.applyArray(ArrayCommand::replace, pos, bytes, bytes.size());
+        } else {
+            document.applyChar(CharCommand::replace, pos, 'x');
+        }
+        pos = (pos + EDIT_STEP) % (LARGE_SIZE - EDIT_LENGTH);
+    }
+}
+
+void QHexEditBench::undoRedo_data()
+{
+    addCommandRows();
+}
+
+void QHexEditBench::undoRedo()
+{
+    QFETCH(int, backend);
+    QFETCH(bool, array);
+    QHexEditDocument document(makeData(backend, LARGE_SIZE));
+    const QByteArray bytes(EDIT_LENGTH, 'x');
+    if (array) {
+        document.applyArray(ArrayCommand::insert, LARGE_SIZE / 2, bytes, bytes.size());
+    } else {
+        document.applyChar(CharCommand::insert, LARGE_SIZE / 2, 'x');
+    }
+    QBENCHMARK {
+        document.undo();
+        document.redo();
+    }
+}
+
+void QHexEditBench::paint_data()
+{
+    QTest::addColumn<int>("backend");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("bytesPerLine");
+    QTest::addColumn<int>("state");
+
+    const int backends[] = {ByteArray, File};
+    const int sizes[] = {SMALL_SIZE, LARGE_SIZE};
+    for (int idx = 0; idx < 2; idx++)
+    {
+        for (int bytesPerLine : {16, 32, 64})
+        {
+            for (int state : {Plain, Changes, Rules})
+            {
+                const QString tag = QString("%1 %2 %3 %4")
+                                    .arg(BACKEND_NAMES[backends[idx]])
+                                    .arg(sizeName(sizes[idx]))
+                                    .arg(bytesPerLine)
+                                    .arg(PAINT_STATE_NAMES[state]);
+                QTest::newRow(tag.toLatin1().constData()) << backends[idx] << sizes[idx] << bytesPerLine << state;
+            }
+        }
+    }
+}
+
+void QHexEditBench::paint()
+{
+    QFETCH(int, backend);
+    QFETCH(int, size);
+    QFETCH(int, bytesPerLine);
+    QFETCH(int, state);
+
+    QHexEdit edit;
+    edit.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    edit.setData(makeData(backend, size));
+    edit.setBytesPerLine(bytesPerLine);
+    edit.setHighlighting(state != Plain);
+    edit.resize(VIEW_WIDTH, VIEW_HEIGHT);
+    edit.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&edit));
+    edit.setTopAddress(size / 2);
+
+    // changed bytes on every other line in view, or rules matching the
+    // zero runs and the text of the sample
+    HighlightRules rules;
+    if (state == Changes)
+    {
+        for (int line = 0; line < VIEW_HEIGHT / 8; line += 2) {
+            edit.document()->applyArray(ArrayCommand::replace, size / 2 + line * bytesPerLine, QByteArray(4, 'x'), 4);
+        }
+    }
+    else if (state == Rules)
+    {
+        std::vector<HighlightRule> ruleList;
+        QVERIFY(HighlightRules::parse("run 00 16\nascii 8\nhex 0000616263", ruleList));
+        rules.setData(&edit.data());
+        rules.setRules(ruleList);
+        edit.addHighlighter(&rules);
+    }
+    QCoreApplication::processEvents();
+
+    // the rule results are cached, like while scrolling back and forth
+    QImage image(edit.widget()->size(), QImage::Format_ARGB32_Premultiplied);
+    QBENCHMARK {
+        edit.widget()->render(&image);
+    }
+    edit.removeHighlighter(&rules);
+}
+
+void QHexEditBench::addBackendRows(const std::vector<int> & sizes, bool resizable)
+{
+    QTest::addColumn<int>("backend");
+    QTest::addColumn<int>("size");
+    for (int backend = 0; backend < Backends; backend++)
+    {
+        if (resizable && backend == Memory) {
+            continue;
+        }
+#ifndef QHEXEDIT_ZLIB
+        if (backend == Compressed) {
+            continue;
+        }
+#endif
+        for (int size : sizes)
+        {
+            const QString tag = QString("%1 %2").arg(BACKEND_NAMES[backend]).arg(sizeName(size));
+            QTest::newRow(tag.toLatin1().constData()) << backend << size;
+        }
+    }
+}
+
+void QHexEditBench::addCommandRows()
+{
+    QTest::addColumn<int>("backend");
+    QTest::addColumn<bool>("array");
+    for (int backend : {ByteArray, File})
+    {
+        QTest::newRow(QString("%1 char").arg(BACKEND_NAMES[backend]).toLatin1().constData()) << backend << false;
+        QTest::newRow(QString("%1 array").arg(BACKEND_NAMES[backend]).toLatin1().constData()) << backend << true;
+    }
+}
+
+std::unique_ptr<QHexEditData> QHexEditBench::makeData(int backend, int size)
+{
+    switch (backend)
+    {
+        case ByteArray:
+            return QHexEditData::fromByteArray(sampleBytes(size));
+        case Memory:
+            _memory = sampleBytes(size);
+            return QHexEditData::fromMemory(reinterpret_cast<u_int8_t *>(_memory.data()), size);
+        case File:
+            return QHexEditData::fromFile(sampleFile(size));
+        case Segments:
+        {
+            const QByteArray bytes = sampleBytes(size);
+            std::vector<QHexEditData::Segment> segments(2);
+            segments[0].address = 0;
+            segments[0].bytes = bytes.left(size / 2);
+            segments[1].address = size / 2 + SEGMENT_GAP;
+            segments[1].bytes = bytes.mid(size / 2);
+            return QHexEditData::fromSegments(std::move(segments));
+        }
+        case Compressed:
+        {
+            const QString fileName = sampleFile(size) + ".gz";
+            if (!QFile::exists(fileName))
+            {
+                QFile file(fileName);
+                if (!file.open(QIODevice::WriteOnly) || !makeData(File, size)->writeCompressed(file)) {
+                    return std::unique_ptr<QHexEditData>();
+                }
+            }
+            return QHexEditData::fromCompressedFile(fileName);
+        }
+        default:
+            return std::unique_ptr<QHexEditData>();
+    }
+}
+
+QString QHexEditBench::sampleFile(int size)
+{
+    const QString fileName = _dir.filePath(QString("sample%1.bin").arg(size));
+    if (!QFile::exists(fileName))
+    {
+        QString error;
+        writeSampleFile(fileName, size, error);
+    }
+    return fileName;
+}
+
+// converts the results of the XML logger of QtTest to JSON
+static bool writeJson(const QString & xmlFileName, const QString & jsonFileName)
+{
+    QFile xmlFile(xmlFileName);
+    if (!xmlFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonArray benchmarks;
+    QString function;
+    QXmlStreamReader xml(&xmlFile);
+    while (!xml.atEnd())
+    {
+        if (xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        const QXmlStreamAttributes attributes = xml.attributes();
+        if (xml.name() == QLatin1String("TestFunction"))
+        {
+            function = attributes.value("name").toString();
+        }
+        else if (xml.name() == QLatin1String("BenchmarkResult"))
+        {
+            QJsonObject result;
+            result.insert("function", function);
+            result.insert("tag", attributes.value("tag").toString());
+            result.insert("metric", attributes.value("metric").toString());
+            result.insert("value", attributes.value("value").toString().toDouble());
+            result.insert("iterations", attributes.value("iterations").toString().toInt());
+            benchmarks.append(result);
+        }
+    }
+    if (xml.hasError()) {
+        return false;
+    }
+
+    QJsonObject object = reportHeader();
+    object.insert("benchmarks", benchmarks);
+
+    QFile jsonFile(jsonFileName);
+    return jsonFile.open(QIODevice::WriteOnly) && jsonFile.write(QJsonDocument(object).toJson()) > 0;
+}
+
+int main(int argc, char * argv[])
+{
+    // the paint benchmarks need no display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    // "-json <file>" is ours, the XML logger collects the results for it
+    QStringList arguments = app.arguments();
+    QString jsonFileName;
+    const int jsonIdx = arguments.indexOf("-json");
+    if (jsonIdx > 0 && jsonIdx + 1 < arguments.size())
+    {
+        jsonFileName = arguments.at(jsonIdx + 1);
+        arguments.erase(arguments.begin() + jsonIdx, arguments.begin() + jsonIdx + 2);
+    }
+
+    QTemporaryDir dir;
+    const QString xmlFileName = dir.filePath("results.xml");
+    if (!jsonFileName.isEmpty())
+    {
+        if (!arguments.contains("-o")) {
+            arguments << "-o" << "-,txt";
+        }
+        arguments << "-o" << xmlFileName + ",xml";
+    }
+
+    QHexEditBench bench;
+    const int result = QTest::qExec(&bench, arguments);
+    if (!jsonFileName.isEmpty() && !writeJson(xmlFileName, jsonFileName))
+    {
+        std::fprintf(stderr, "Cannot write %s\n", qPrintable(jsonFileName));
+        return result != 0 ? result : 1;
+    }
+    return result;
+}
+
+#include "qhexeditbench.moc"
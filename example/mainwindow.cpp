@@ -7,8 +7,14 @@
 #include <QMenuBar>
 #include <QToolBar>
 #include <QColorDialog>
+#include <QDockWidget>
 #include <QFontDialog>
+#include <QInputDialog>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QThreadPool>
 
+#include <climits>
 #include <memory>
 
 #include "mainwindow.h"
@@ -25,9 +31,32 @@ MainWindow::MainWindow()
 /*****************************************************************************/
 /* Protected methods */
 /*****************************************************************************/
-void MainWindow::closeEvent(QCloseEvent *)
+void MainWindow::closeEvent(QCloseEvent *event)
 {
+    // unsaved edits are saved or discarded first, the journal holds them
+    // until then
+    if (!hexEdit->document()->undoStack()->isClean())
+    {
+        const QMessageBox::StandardButton button =
+            QMessageBox::warning(this, tr("QHexEdit"), tr("The data has been modified.\n"
+                                                          "Do you want to save your changes?"),
+                                 QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
+        if (button == QMessageBox::Cancel || (button == QMessageBox::Save && !save()))
+        {
+            event->ignore();
+            return;
+        }
+    }
+
+    // a regular close does not need the journal any more
+    hexEdit->closeJournal(true);
+
+    // without unsaved edits the annotations still fit the file
+    if (!isUntitled && hexEdit->document()->undoStack()->isClean()) {
+        saveAnnotations(curFile);
+    }
     writeSettings();
+    event->accept();
 }
 
 /*****************************************************************************/
@@ -39,6 +68,184 @@ void MainWindow::about()
             tr("The QHexEdit example is a short Demo of the QHexEdit Widget."));
 }
 
+void MainWindow::annotateSelection()
+{
+    // without a selection the byte under the cursor is bookmarked
+    size_t begin = hexEdit->selectionBegin();
+    size_t end = hexEdit->selectionEnd();
+    if (begin == end)
+    {
+        begin = hexEdit->cursorPosition();
+        end = begin + 1;
+    }
+    if (end > hexEdit->data().size()) {
+        return;
+    }
+
+    bool ok = false;
+    const QString label = QInputDialog::getText(this, tr("Annotate"), tr("Label:"), QLineEdit::Normal, QString(), &ok);
+    if (ok)
+    {
+        annotationPanel->addAnnotation(begin, end, label);
+        annotationPanel->parentWidget()->show();
+    }
+}
+
+void MainWindow::applyPatch()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Apply Patch"), QString(),
+                                                    tr("Patches (*.ips *.bps *.qhp)"));
+    BinaryPatch::Format format;
+    if (fileName.isEmpty() || !BinaryPatch::formatOf(fileName, format)) {
+        return;
+    }
+
+    QFile file(fileName);
+    QString error;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = file.open(QIODevice::ReadOnly) &&
+              BinaryPatch::apply(*hexEdit->document(), file, format, &error);
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot apply patch %1:\n%2.")
+                             .arg(fileName)
+                             .arg(error.isEmpty() ? file.errorString() : error));
+        return;
+    }
+    statusBar()->showMessage(tr("Patch applied"), 2000);
+}
+
+void MainWindow::compare()
+{
+    // the saved file is compared, the other one is chosen by the user
+    QString fileNameA = curFile;
+    if (isUntitled)
+    {
+        fileNameA = QFileDialog::getOpenFileName(this, tr("Compare"));
+        if (fileNameA.isEmpty()) {
+            return;
+        }
+    }
+    QString fileNameB = QFileDialog::getOpenFileName(this, tr("Compare %1 with").arg(strippedName(fileNameA)));
+    if (fileNameB.isEmpty()) {
+        return;
+    }
+
+    auto dataA = QHexEditData::fromFile(fileNameA);
+    auto dataB = QHexEditData::fromFile(fileNameB);
+    if (!dataA || !dataB) {
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot read file %1.")
+                             .arg(dataA ? fileNameB : fileNameA));
+        return;
+    }
+
+    DiffView *diffView = new DiffView(this);
+    diffView->setWindowFlags(Qt::Window);
+    diffView->setAttribute(Qt::WA_DeleteOnClose);
+    diffView->setWindowTitle(tr("%1 - %2 - QHexEdit")
+                             .arg(strippedName(fileNameA))
+                             .arg(strippedName(fileNameB)));
+    diffView->setData(std::move(dataA), std::move(dataB));
+    diffView->resize(2 * width(), height());
+    diffView->show();
+}
+
+void MainWindow::exportPatch()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export Patch"), QString(),
+                                                    tr("IPS patch (*.ips);;BPS patch (*.bps);;QHexEdit patch (*.qhp)"));
+    BinaryPatch::Format format;
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (!BinaryPatch::formatOf(fileName, format))
+    {
+        fileName += ".bps";
+        format = BinaryPatch::Bps;
+    }
+
+    QSaveFile file(fileName);
+    QString error;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = file.open(QIODevice::WriteOnly) &&
+              BinaryPatch::write(hexEdit->data(), file, format, &error) && file.commit();
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot write patch %1:\n%2.")
+                             .arg(fileName)
+                             .arg(error.isEmpty() ? file.errorString() : error));
+        return;
+    }
+    statusBar()->showMessage(tr("Patch exported"), 2000);
+}
+
+void MainWindow::followFile(bool follow)
+{
+    // the document reads the appended bytes, the view scrolls to them
+    hexEdit->document()->setFollowing(follow);
+    hexEdit->setFollowTail(follow);
+}
+
+void MainWindow::loadTemplate()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load Template"), QString(),
+                                                    tr("Templates (*.json);;All Files (*)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    QString error;
+    if (!structPanel->loadTemplate(fileName, &error))
+    {
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot load template %1:\n%2.")
+                             .arg(fileName)
+                             .arg(error));
+        return;
+    }
+    structPanel->parentWidget()->show();
+    statusBar()->showMessage(tr("Template loaded"), 2000);
+}
+
+void MainWindow::nextAnnotation()
+{
+    const size_t address = hexEdit->cursorPosition();
+    const size_t next = annotationPanel->nextAddress(address);
+    if (next == address) {
+        statusBar()->showMessage(tr("No annotation behind the cursor"), 2000);
+    } else {
+        hexEdit->gotoAddress(next);
+    }
+}
+
+void MainWindow::newView()
+{
+    // the view shares the document with its undo history, only the cursor
+    // and the selection are its own
+    QHexEdit *view = new QHexEdit(this);
+    view->setWindowFlags(Qt::Window);
+    view->setAttribute(Qt::WA_DeleteOnClose);
+    view->setWindowTitle(tr("%1 - View - QHexEdit").arg(strippedName(curFile)));
+    view->setDocument(hexEdit->document());
+    view->setFont(hexEdit->font());
+    view->setBytesPerLine(hexEdit->bytesPerLine());
+    view->setGroupSize(hexEdit->groupSize());
+    view->setInspector(hexEdit->inspectorType(), hexEdit->inspectorBigEndian(), hexEdit->inspectorStride());
+    view->setOverwriteMode(hexEdit->overwriteMode());
+    view->setReadOnly(hexEdit->isReadOnly());
+    view->setFollowTail(hexEdit->followTail());
+    view->addHighlighter(highlightRules);
+    view->addHighlighter(annotationPanel->highlighter());
+    connect(annotationPanel, SIGNAL(highlightingChanged()), view, SLOT(updateHighlighting()));
+    view->resize(size());
+    view->show();
+}
+
 void MainWindow::open()
 {
     QString fileName = QFileDialog::getOpenFileName(this);
@@ -58,6 +265,13 @@ void MainWindow::findNext()
     searchDialog->findNext();
 }
 
+void MainWindow::nextData()
+{
+    if (!hexEdit->gotoNextData()) {
+        statusBar()->showMessage(tr("No data behind the cursor"), 2000);
+    }
+}
+
 bool MainWindow::save()
 {
     if (isUntitled) {
@@ -126,6 +340,26 @@ void MainWindow::setAddress(int address)
     lbAddress->setText(QString("%1").arg(address, 1, 16));
 }
 
+void MainWindow::setHashes(size_t pos, size_t len)
+{
+    lbCrc->setText(hexEdit->hash(HashEngine::Crc32).toHex());
+    if (!checksumsPending) {
+        return;
+    }
+    checksumsPending = false;
+
+    QString text = tr("Bytes %1 to %2 (%3 bytes)\n")
+                   .arg(pos, 1, 16).arg(pos + len, 1, 16).arg(len);
+    const HashEngine::Algorithm algorithms[] = { HashEngine::Crc32, HashEngine::Sha1, HashEngine::Sha256, HashEngine::Xxh64 };
+    for (HashEngine::Algorithm algorithm : algorithms) {
+        text += QString("\n%1: %2").arg(HashEngine::algorithmName(algorithm)).arg(QString(hexEdit->hash(algorithm).toHex()));
+    }
+
+    // only the cheap CRC follows the further edits
+    hexEdit->requestHashes(HashEngine::Crc32);
+    QMessageBox::information(this, tr("Checksums"), text);
+}
+
 void MainWindow::setOverwriteMode(bool mode)
 {
     QSettings settings;
@@ -151,21 +385,132 @@ void MainWindow::showSearchDialog()
     searchDialog->show();
 }
 
+void MainWindow::showChecksums()
+{
+    checksumsPending = true;
+    hexEdit->requestHashes(HashEngine::AllAlgorithms);
+}
+
+void MainWindow::showSelectionChecksums()
+{
+    checksumsPending = true;
+    hexEdit->requestSelectionHashes(HashEngine::AllAlgorithms);
+}
+
+void MainWindow::undoHistoryLost()
+{
+    QMessageBox::warning(this, tr("QHexEdit"),
+                         tr("The undo history couldn't be read back from its temporary file. "
+                            "The last undo or redo was not applied and the history was cleared, "
+                            "the data itself is unchanged."));
+}
+
 /*****************************************************************************/
 /* Private Methods */
 /*****************************************************************************/
+void MainWindow::openProcess()
+{
+    bool ok = false;
+    const int pid = QInputDialog::getInt(this, tr("Open Process"), tr("Process ID:"), 0, 1, INT_MAX, 1, &ok);
+    if (!ok) {
+        return;
+    }
+
+    auto data = QHexEditData::fromProcess(pid);
+    if (!data) {
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot read the memory of process %1.")
+                             .arg(pid));
+        return;
+    }
+    followAct->setChecked(false);
+    setData(std::move(data));
+    annotationPanel->clear();
+
+    // the process changes its memory, the view shows it again and again
+    refreshTimer->start();
+    setCurrentFile("");
+    setWindowFilePath(tr("Process %1").arg(pid));
+    statusBar()->showMessage(tr("Process opened"), 2000);
+}
+
 void MainWindow::init()
 {
     setAttribute(Qt::WA_DeleteOnClose);
     optionsDialog = new OptionsDialog(this);
     connect(optionsDialog, SIGNAL(accepted()), this, SLOT(optionsAccepted()));
     isUntitled = true;
+    checksumsPending = false;
 
     hexEdit = new QHexEdit;
-    setCentralWidget(hexEdit);
+
+    // the overview shows the statistics of the whole data next to the editor
+    statsEngine = new StatsEngine(this);
+    statsEngine->setData(&hexEdit->data());
+    connect(hexEdit, SIGNAL(dataRangeChanged(size_t,size_t,bool)), statsEngine, SLOT(invalidate(size_t,size_t,bool)));
+    overviewBar = new OverviewBar;
+    overviewBar->setEngine(statsEngine);
+    connect(overviewBar, SIGNAL(addressClicked(size_t)), hexEdit, SLOT(gotoAddress(size_t)));
+    connect(hexEdit, SIGNAL(currentAddressChanged(int)), overviewBar, SLOT(setCursorAddress(int)));
+
+    QWidget *centralWidget = new QWidget;
+    QHBoxLayout *layout = new QHBoxLayout(centralWidget);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+    layout->addWidget(hexEdit);
+    layout->addWidget(overviewBar);
+    setCentralWidget(centralWidget);
     connect(hexEdit, SIGNAL(overwriteModeChanged(bool)), this, SLOT(setOverwriteMode(bool)));
+    connect(hexEdit, SIGNAL(undoHistoryLost()), this, SLOT(undoHistoryLost()));
+
+    // the strings of the data are listed in a dock
+    stringsPanel = new StringsPanel;
+    stringsPanel->setData(&hexEdit->data());
+    connect(hexEdit, SIGNAL(dataChanged()), stringsPanel, SLOT(dataChanged()));
+    connect(hexEdit, SIGNAL(currentAddressChanged(int)), stringsPanel, SLOT(setCursorAddress(int)));
+    connect(stringsPanel, SIGNAL(addressClicked(size_t)), hexEdit, SLOT(gotoAddress(size_t)));
+    QDockWidget *stringsDock = new QDockWidget(tr("Strings"), this);
+    stringsDock->setObjectName("StringsDock");
+    stringsDock->setWidget(stringsPanel);
+    addDockWidget(Qt::RightDockWidgetArea, stringsDock);
+
+    // the rules colour patterns and runs of bytes below the other highlighters
+    highlightRules = new HighlightRules(this);
+    highlightRules->setData(&hexEdit->data());
+    hexEdit->addHighlighter(highlightRules);
+    connect(hexEdit, SIGNAL(dataRangeChanged(size_t,size_t,bool)), highlightRules, SLOT(invalidate(size_t,size_t,bool)));
+
+    // the fields of a template are shown in a tree and coloured in the editor
+    structPanel = new StructPanel;
+    structPanel->setData(&hexEdit->data());
+    hexEdit->addHighlighter(structPanel->highlighter());
+    connect(hexEdit, SIGNAL(dataChanged()), structPanel, SLOT(dataChanged()));
+    connect(structPanel, SIGNAL(highlightingChanged()), hexEdit, SLOT(updateHighlighting()));
+    connect(structPanel, SIGNAL(addressClicked(size_t)), hexEdit, SLOT(gotoAddress(size_t)));
+    QDockWidget *structDock = new QDockWidget(tr("Structure"), this);
+    structDock->setObjectName("StructDock");
+    structDock->setWidget(structPanel);
+    addDockWidget(Qt::RightDockWidgetArea, structDock);
+
+    // the annotations are coloured in the editor and move with the bytes
+    annotationPanel = new AnnotationPanel;
+    annotationPanel->setData(&hexEdit->data());
+    hexEdit->addHighlighter(annotationPanel->highlighter());
+    connect(hexEdit, SIGNAL(dataChanged()), annotationPanel, SLOT(dataChanged()));
+    connect(annotationPanel, SIGNAL(highlightingChanged()), hexEdit, SLOT(updateHighlighting()));
+    connect(annotationPanel, SIGNAL(addressClicked(size_t)), hexEdit, SLOT(gotoAddress(size_t)));
+    QDockWidget *annotationDock = new QDockWidget(tr("Annotations"), this);
+    annotationDock->setObjectName("AnnotationDock");
+    annotationDock->setWidget(annotationPanel);
+    addDockWidget(Qt::RightDockWidgetArea, annotationDock);
+
     searchDialog = new SearchDialog(hexEdit, this);
 
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(500);
+    connect(refreshTimer, SIGNAL(timeout()), highlightRules, SLOT(clearCache()));
+    connect(refreshTimer, SIGNAL(timeout()), hexEdit->widget(), SLOT(update()));
+
     createActions();
     createMenus();
     createToolBars();
@@ -183,6 +528,10 @@ void MainWindow::createActions()
     openAct->setStatusTip(tr("Open an existing file"));
     connect(openAct, SIGNAL(triggered()), this, SLOT(open()));
 
+    openProcessAct = new QAction(tr("Open &Process..."), this);
+    openProcessAct->setStatusTip(tr("Show the memory of a running process"));
+    connect(openProcessAct, SIGNAL(triggered()), this, SLOT(openProcess()));
+
     saveAct = new QAction(QIcon(":/images/save.png"), tr("&Save"), this);
     saveAct->setShortcuts(QKeySequence::Save);
     saveAct->setStatusTip(tr("Save the document to disk"));
@@ -197,6 +546,31 @@ void MainWindow::createActions()
     saveReadable->setStatusTip(tr("Save document in readable form"));
     connect(saveReadable, SIGNAL(triggered()), this, SLOT(saveToReadableFile()));
 
+    compareAct = new QAction(tr("&Compare..."), this);
+    compareAct->setStatusTip(tr("Compare the file with another one"));
+    connect(compareAct, SIGNAL(triggered()), this, SLOT(compare()));
+
+    exportPatchAct = new QAction(tr("Export &Patch..."), this);
+    exportPatchAct->setStatusTip(tr("Save the edits as IPS, BPS or QHexEdit patch"));
+    connect(exportPatchAct, SIGNAL(triggered()), this, SLOT(exportPatch()));
+
+    applyPatchAct = new QAction(tr("Appl&y Patch..."), this);
+    applyPatchAct->setStatusTip(tr("Apply an IPS, BPS or QHexEdit patch to the document"));
+    connect(applyPatchAct, SIGNAL(triggered()), this, SLOT(applyPatch()));
+
+    newViewAct = new QAction(tr("&New View"), this);
+    newViewAct->setStatusTip(tr("Open another view of the document"));
+    connect(newViewAct, SIGNAL(triggered()), this, SLOT(newView()));
+
+    followAct = new QAction(tr("&Follow File"), this);
+    followAct->setCheckable(true);
+    followAct->setStatusTip(tr("Show the bytes, which are appended to the file"));
+    connect(followAct, SIGNAL(toggled(bool)), this, SLOT(followFile(bool)));
+
+    loadTemplateAct = new QAction(tr("Load &Template..."), this);
+    loadTemplateAct->setStatusTip(tr("Show the structures of the data described by a template file"));
+    connect(loadTemplateAct, SIGNAL(triggered()), this, SLOT(loadTemplate()));
+
     exitAct = new QAction(tr("E&xit"), this);
     exitAct->setShortcuts(QKeySequence::Quit);
     exitAct->setStatusTip(tr("Exit the application"));
@@ -232,18 +606,45 @@ void MainWindow::createActions()
     findNextAct->setStatusTip(tr("Find next occurrence of the searched pattern"));
     connect(findNextAct, SIGNAL(triggered()), this, SLOT(findNext()));
 
+    nextDataAct = new QAction(tr("Next &Data"), this);
+    nextDataAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_J));
+    nextDataAct->setStatusTip(tr("Jump over the hole to the next data region"));
+    connect(nextDataAct, SIGNAL(triggered()), this, SLOT(nextData()));
+
+    annotateAct = new QAction(tr("&Annotate Selection..."), this);
+    annotateAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_M));
+    annotateAct->setStatusTip(tr("Label and colour the selected bytes"));
+    connect(annotateAct, SIGNAL(triggered()), this, SLOT(annotateSelection()));
+
+    nextAnnotationAct = new QAction(tr("Next Anno&tation"), this);
+    nextAnnotationAct->setShortcut(QKeySequence(Qt::Key_F2));
+    nextAnnotationAct->setStatusTip(tr("Jump to the next annotation behind the cursor"));
+    connect(nextAnnotationAct, SIGNAL(triggered()), this, SLOT(nextAnnotation()));
+
     optionsAct = new QAction(tr("&Options"), this);
     optionsAct->setStatusTip(tr("Show the Dialog to select applications options"));
     connect(optionsAct, SIGNAL(triggered()), this, SLOT(showOptionsDialog()));
+
+    checksumsAct = new QAction(tr("&Checksums..."), this);
+    checksumsAct->setStatusTip(tr("Show the checksums of the document"));
+    connect(checksumsAct, SIGNAL(triggered()), this, SLOT(showChecksums()));
+
+    selectionChecksumsAct = new QAction(tr("Selection C&hecksums..."), this);
+    selectionChecksumsAct->setStatusTip(tr("Show the checksums of the selection"));
+    connect(selectionChecksumsAct, SIGNAL(triggered()), this, SLOT(showSelectionChecksums()));
 }
 
 void MainWindow::createMenus()
 {
     fileMenu = menuBar()->addMenu(tr("&File"));
     fileMenu->addAction(openAct);
+    fileMenu->addAction(openProcessAct);
     fileMenu->addAction(saveAct);
     fileMenu->addAction(saveAsAct);
     fileMenu->addAction(saveReadable);
+    fileMenu->addAction(compareAct);
+    fileMenu->addAction(exportPatchAct);
+    fileMenu->addAction(applyPatchAct);
     fileMenu->addSeparator();
     fileMenu->addAction(exitAct);
 
@@ -254,9 +655,25 @@ void MainWindow::createMenus()
     editMenu->addSeparator();
     editMenu->addAction(findAct);
     editMenu->addAction(findNextAct);
+    editMenu->addAction(nextDataAct);
+    editMenu->addSeparator();
+    editMenu->addAction(annotateAct);
+    editMenu->addAction(nextAnnotationAct);
+    editMenu->addSeparator();
+    editMenu->addAction(checksumsAct);
+    editMenu->addAction(selectionChecksumsAct);
     editMenu->addSeparator();
     editMenu->addAction(optionsAct);
 
+    viewMenu = menuBar()->addMenu(tr("&View"));
+    viewMenu->addAction(newViewAct);
+    viewMenu->addAction(followAct);
+    viewMenu->addAction(loadTemplateAct);
+    viewMenu->addSeparator();
+    for (QDockWidget *dock : findChildren<QDockWidget *>()) {
+        viewMenu->addAction(dock->toggleViewAction());
+    }
+
     helpMenu = menuBar()->addMenu(tr("&Help"));
     helpMenu->addAction(aboutAct);
     helpMenu->addAction(aboutQtAct);
@@ -297,6 +714,18 @@ void MainWindow::createStatusBar()
     statusBar()->addPermanentWidget(lbOverwriteMode);
     setOverwriteMode(hexEdit->overwriteMode());
 
+    // CRC Label, kept up to date in the background
+    lbCrcName = new QLabel();
+    lbCrcName->setText(tr("CRC-32:"));
+    statusBar()->addPermanentWidget(lbCrcName);
+    lbCrc = new QLabel();
+    lbCrc->setFrameShape(QFrame::Panel);
+    lbCrc->setFrameShadow(QFrame::Sunken);
+    lbCrc->setMinimumWidth(70);
+    statusBar()->addPermanentWidget(lbCrc);
+    connect(hexEdit, SIGNAL(hashesReady(size_t,size_t)), this, SLOT(setHashes(size_t,size_t)));
+    hexEdit->requestHashes(HashEngine::Crc32);
+
     statusBar()->showMessage(tr("Ready"), 2000);
 }
 
@@ -309,25 +738,121 @@ void MainWindow::createToolBars()
 
 void MainWindow::loadFile(const QString &fileName)
 {
+    QApplication::setOverrideCursor(Qt::WaitCursor);
 
-    QFile file(fileName);
-    if (!file.open(QFile::ReadOnly)) {
+    // the file is mapped, edits are kept in a piece table. Compressed files
+    // are decompressed on demand, other files with such a suffix are opened
+    // as they are.
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    std::unique_ptr<QHexEditData> data;
+    if (suffix == "gz" || suffix == "zst") {
+        data = QHexEditData::fromCompressedFile(fileName);
+    }
+    HexRecords::Format format;
+    QString recordsError;
+    if (HexRecords::formatOf(fileName, format))
+    {
+        // firmware images are loaded at their addresses, the gaps are holes
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadOnly)) {
+            data = HexRecords::read(file, format, &recordsError);
+        }
+    }
+    if (!data) {
+        data = QHexEditData::fromFile(fileName);
+    }
+
+    QApplication::restoreOverrideCursor();
+
+    if (!data) {
         QMessageBox::warning(this, tr("QHexEdit"),
-                             tr("Cannot read file %1:\n%2.")
-                             .arg(fileName)
-                             .arg(file.errorString()));
+                             tr("Cannot read file %1.")
+                             .arg(fileName));
         return;
     }
+    followAct->setChecked(false);
+    refreshTimer->stop();
+    setData(std::move(data));
+    loadAnnotations(fileName);
+    openJournal(fileName);
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
+    setCurrentFile(fileName);
+    if (recordsError.isEmpty()) {
+        statusBar()->showMessage(tr("File loaded"), 2000);
+    } else {
+        statusBar()->showMessage(tr("Loaded as binary file, %1").arg(recordsError), 4000);
+    }
+}
 
-    auto data = QHexEditData::fromByteArray(file.readAll());
-    hexEdit->setData(std::move(data));
+QString MainWindow::annotationsName(const QString &fileName)
+{
+    return QFileInfo(fileName).absoluteFilePath() + ".qhexedit-annotations";
+}
 
-    QApplication::restoreOverrideCursor();
+void MainWindow::loadAnnotations(const QString &fileName)
+{
+    annotationPanel->clear();
+    const QString name = annotationsName(fileName);
+    QString error;
+    if (QFile::exists(name) && !annotationPanel->load(name, &error)) {
+        statusBar()->showMessage(tr("Cannot read annotations %1: %2").arg(name).arg(error), 4000);
+    }
+}
 
-    setCurrentFile(fileName);
-    statusBar()->showMessage(tr("File loaded"), 2000);
+// files without annotations get no sidecar file
+bool MainWindow::saveAnnotations(const QString &fileName, QString *errorString)
+{
+    const QString name = annotationsName(fileName);
+    if (annotationPanel->annotations().count() == 0 && !QFile::exists(name)) {
+        return true;
+    }
+    return annotationPanel->save(name, errorString);
+}
+
+void MainWindow::openJournal(const QString &fileName)
+{
+    QFileInfo info(fileName);
+    const QString journalName = info.absoluteFilePath() + ".qhexedit-journal";
+    const qint64 stamp = info.lastModified().toMSecsSinceEpoch();
+
+    bool recover = false;
+    if (QFile::exists(journalName))
+    {
+        recover = QMessageBox::question(this, tr("QHexEdit"),
+                                        tr("There are unsaved edits of %1 from an earlier session.\n"
+                                           "Do you want to recover them?")
+                                        .arg(strippedName(fileName)))
+                  == QMessageBox::Yes;
+    }
+
+    int records = hexEdit->openJournal(journalName, stamp, recover);
+    if (records == EditJournal::Stale)
+    {
+        // the file changed since the edits were journaled, they are kept
+        // aside instead of being overwritten by the new journal
+        const QString staleName = journalName + ".stale";
+        QFile::remove(staleName);
+        if (!QFile::rename(journalName, staleName))
+        {
+            QMessageBox::warning(this, tr("QHexEdit"),
+                                 tr("The unsaved edits of %1 don't fit the changed file and are kept in %2.\n"
+                                    "Edits are not journaled until it is moved away.")
+                                 .arg(strippedName(fileName))
+                                 .arg(journalName));
+            return;
+        }
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("The unsaved edits of %1 don't fit the changed file and cannot be recovered.\n"
+                                "They are kept in %2.")
+                             .arg(strippedName(fileName))
+                             .arg(staleName));
+        records = hexEdit->openJournal(journalName, stamp, false);
+    }
+    if (records < 0) {
+        statusBar()->showMessage(tr("Cannot write journal %1").arg(journalName), 2000);
+    } else if (records > 0) {
+        statusBar()->showMessage(tr("%1 edits recovered").arg(records), 2000);
+    }
 }
 
 void MainWindow::readSettings()
@@ -350,12 +875,29 @@ void MainWindow::readSettings()
     hexEdit->setFont(settings.value("WidgetFont").value<QFont>());
 
     hexEdit->setAddressWidth(settings.value("AddressAreaWidth").toInt());
+    hexEdit->setBytesPerLine(settings.value("BytesPerLine", 16).toInt());
+    hexEdit->setGroupSize(settings.value("GroupSize", 1).toInt());
+    hexEdit->setInspector(static_cast<ValueDecoder::Type>(settings.value("InspectorType", 0).toInt()),
+                          settings.value("InspectorBigEndian").toBool(),
+                          settings.value("InspectorStride", 0).toInt());
+
+    std::vector<HighlightRule> rules;
+    QString error;
+    if (!HighlightRules::parse(settings.value("HighlightRules").toString(), rules, &error)) {
+        statusBar()->showMessage(tr("Highlight rules: %1").arg(error), 4000);
+    }
+    highlightRules->setRules(rules);
+    hexEdit->updateHighlighting();
 }
 
-bool MainWindow::saveFile(const QString &fileName)
+bool MainWindow::replaceFile(const QString &fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+    // QSaveFile::commit() renames its file over the target, which fails on
+    // Windows while the data maps the opened file. The content is written
+    // next to it, the data is released, then the file is replaced and loaded
+    // again. The undo history ends with the save.
+    QTemporaryFile file(fileName + ".XXXXXX");
+    if (!file.open()) {
         QMessageBox::warning(this, tr("QHexEdit"),
                              tr("Cannot write file %1:\n%2.")
                              .arg(fileName)
@@ -364,12 +906,106 @@ bool MainWindow::saveFile(const QString &fileName)
     }
 
     QApplication::setOverrideCursor(Qt::WaitCursor);
-    file.write(hexEdit->data().toByteArray());
+    if (!writeData(file, fileName) || !file.flush()) {
+        QApplication::restoreOverrideCursor();
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot write file %1:\n%2.")
+                             .arg(fileName)
+                             .arg(file.errorString()));
+        return false;
+    }
+    const QString tempName = file.fileName();
+    file.setAutoRemove(false);
+    file.close();
+
+    // the annotations fit the written bytes, loading the file reads them back
+    QString annotationsError;
+    const bool annotationsSaved = saveAnnotations(fileName, &annotationsError);
+
+    // the other views and the background readers hold the old data too
+    const QHexEditDocument *document = hexEdit->document().get();
+    QList<QHexEdit *> views;
+    for (QHexEdit *view : findChildren<QHexEdit *>()) {
+        if (view != hexEdit && view->document().get() == document) {
+            views.append(view);
+        }
+    }
+    hexEdit->closeJournal(true);
+    setData(QHexEditData::fromByteArray(QByteArray()));
+    for (QHexEdit *view : views) {
+        view->setDocument(hexEdit->document());
+    }
+    QThreadPool::globalInstance()->waitForDone();
 
+    QFile target(fileName);
+    QFile temp(tempName);
+    const bool replaced = target.remove() && temp.rename(fileName);
     QApplication::restoreOverrideCursor();
 
+    // without the replaced file, the written one keeps the content
+    loadFile(replaced ? fileName : tempName);
+    for (QHexEdit *view : views) {
+        view->setDocument(hexEdit->document());
+    }
+    if (!replaced) {
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot replace file %1:\n%2.\nThe data was saved to %3.")
+                             .arg(fileName)
+                             .arg(target.error() != QFile::NoError ? target.errorString() : temp.errorString())
+                             .arg(tempName));
+        return false;
+    }
+
+    if (annotationsSaved) {
+        statusBar()->showMessage(tr("File saved"), 2000);
+    } else {
+        statusBar()->showMessage(tr("File saved, cannot write annotations: %1").arg(annotationsError), 4000);
+    }
+    return true;
+}
+
+bool MainWindow::saveFile(const QString &fileName)
+{
+    if (!isUntitled && QFileInfo(fileName).canonicalFilePath() == curFile) {
+        return replaceFile(fileName);
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot write file %1:\n%2.")
+                             .arg(fileName)
+                             .arg(file.errorString()));
+        return false;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const bool ok = writeData(file, fileName) && file.commit();
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::warning(this, tr("QHexEdit"),
+                             tr("Cannot write file %1:\n%2.")
+                             .arg(fileName)
+                             .arg(file.errorString()));
+        return false;
+    }
+
+    // the saved file is the new original, further edits go to a new journal
+    hexEdit->closeJournal(true);
+    hexEdit->openJournal(QFileInfo(fileName).absoluteFilePath() + ".qhexedit-journal",
+                         QFileInfo(fileName).lastModified().toMSecsSinceEpoch());
+    hexEdit->document()->undoStack()->setClean();
+
     setCurrentFile(fileName);
-    statusBar()->showMessage(tr("File saved"), 2000);
+
+    // the annotations are saved with the file, their positions fit it
+    QString error;
+    if (saveAnnotations(fileName, &error)) {
+        statusBar()->showMessage(tr("File saved"), 2000);
+    } else {
+        statusBar()->showMessage(tr("File saved, cannot write annotations: %1").arg(error), 4000);
+    }
     return true;
 }
 
@@ -381,11 +1017,35 @@ void MainWindow::setCurrentFile(const QString &fileName)
     setWindowFilePath(curFile);
 }
 
+void MainWindow::setData(std::unique_ptr<QHexEditData> data)
+{
+    hexEdit->setData(std::move(data));
+    statsEngine->setData(&hexEdit->data());
+    stringsPanel->setData(&hexEdit->data());
+    structPanel->setData(&hexEdit->data());
+    annotationPanel->setData(&hexEdit->data());
+    highlightRules->setData(&hexEdit->data());
+}
+
 QString MainWindow::strippedName(const QString &fullFileName)
 {
     return QFileInfo(fullFileName).fileName();
 }
 
+// a name ending with .gz gets a compressed file, the names of firmware images
+// get their records
+bool MainWindow::writeData(QIODevice &device, const QString &fileName)
+{
+    HexRecords::Format format;
+    if (HexRecords::formatOf(fileName, format)) {
+        return HexRecords::write(hexEdit->data(), device, format);
+    }
+    if (fileName.endsWith(".gz", Qt::CaseInsensitive)) {
+        return hexEdit->data().writeCompressed(device);
+    }
+    return hexEdit->data().write(device);
+}
+
 void MainWindow::writeSettings()
 {
     QSettings settings;
@@ -4,6 +4,15 @@
 #include <QMainWindow>
 
 #include "../src/qhexedit.h"
+#include "../src/statsengine.h"
+#include "../src/overviewbar.h"
+#include "../src/diffview.h"
+#include "../src/stringspanel.h"
+#include "../src/structpanel.h"
+#include "../src/annotationpanel.h"
+#include "../src/highlightrules.h"
+#include "../src/hexrecords.h"
+#include "../src/binarypatch.h"
 #include "optionsdialog.h"
 #include "searchdialog.h"
 
@@ -26,18 +35,32 @@ protected:
 
 private slots:
     void about();
+    void annotateSelection();
+    void applyPatch();
+    void compare();
+    void exportPatch();
+    void followFile(bool follow);
+    void loadTemplate();
+    void nextAnnotation();
+    void newView();
     void open();
+    void openProcess();
     void optionsAccepted();
     void findNext();
+    void nextData();
     bool save();
     bool saveAs();
     void saveSelectionToReadableFile();
     void saveToReadableFile();
     void setAddress(int address);
+    void setHashes(size_t pos, size_t len);
     void setOverwriteMode(bool mode);
     void setSize(size_t size);
     void showOptionsDialog();
     void showSearchDialog();
+    void showChecksums();
+    void showSelectionChecksums();
+    void undoHistoryLost();
 
 private:
     void init();
@@ -45,11 +68,18 @@ private:
     void createMenus();
     void createStatusBar();
     void createToolBars();
+    QString annotationsName(const QString &fileName);
+    void loadAnnotations(const QString &fileName);
     void loadFile(const QString &fileName);
+    void openJournal(const QString &fileName);
     void readSettings();
+    bool saveAnnotations(const QString &fileName, QString *errorString = nullptr);
+    bool replaceFile(const QString &fileName);
     bool saveFile(const QString &fileName);
     void setCurrentFile(const QString &fileName);
+    void setData(std::unique_ptr<QHexEditData> data);
     QString strippedName(const QString &fullFileName);
+    bool writeData(QIODevice &device, const QString &fileName);
     void writeSettings();
 
     QString curFile;
@@ -57,14 +87,22 @@ private:
     
     QMenu *fileMenu;
     QMenu *editMenu;
+    QMenu *viewMenu;
     QMenu *helpMenu;
 
     QToolBar *fileToolBar;
 
     QAction *openAct;
+    QAction *openProcessAct;
     QAction *saveAct;
     QAction *saveAsAct;
     QAction *saveReadable;
+    QAction *compareAct;
+    QAction *exportPatchAct;
+    QAction *applyPatchAct;
+    QAction *newViewAct;
+    QAction *followAct;
+    QAction *loadTemplateAct;
     QAction *closeAct;
     QAction *exitAct;
 
@@ -77,13 +115,27 @@ private:
     QAction *optionsAct;
     QAction *findAct;
     QAction *findNextAct;
+    QAction *nextDataAct;
+    QAction *annotateAct;
+    QAction *nextAnnotationAct;
+    QAction *checksumsAct;
+    QAction *selectionChecksumsAct;
 
     QHexEdit *hexEdit;
+    StatsEngine *statsEngine;
+    OverviewBar *overviewBar;
+    StringsPanel *stringsPanel;
+    StructPanel *structPanel;
+    HighlightRules *highlightRules;
+    AnnotationPanel *annotationPanel;
     OptionsDialog *optionsDialog;
     SearchDialog *searchDialog;
     QLabel *lbAddress, *lbAddressName;
     QLabel *lbOverwriteMode, *lbOverwriteModeName;
     QLabel *lbSize, *lbSizeName;
+    QLabel *lbCrc, *lbCrcName;
+    bool checksumsPending;
+    QTimer *refreshTimer;
 };
 
 #endif
@@ -48,6 +48,15 @@ void OptionsDialog::readSettings()
     ui->leWidgetFont->setFont(settings.value("WidgetFont", QFont("Inconsolata", 12)).value<QFont>());
 
     ui->sbAddressAreaWidth->setValue(settings.value("AddressAreaWidth", 4).toInt());
+
+    ui->cbBytesPerLine->setCurrentText(QString::number(settings.value("BytesPerLine", 16).toInt()));
+    ui->cbGroupSize->setCurrentText(QString::number(settings.value("GroupSize", 1).toInt()));
+
+    ui->cbInspector->setCurrentIndex(settings.value("InspectorType", 0).toInt());
+    ui->cbInspectorBigEndian->setChecked(settings.value("InspectorBigEndian").toBool());
+    ui->sbInspectorStride->setValue(settings.value("InspectorStride", 0).toInt());
+
+    ui->teHighlightRules->setPlainText(settings.value("HighlightRules").toString());
 }
 
 void OptionsDialog::writeSettings()
@@ -65,6 +74,15 @@ void OptionsDialog::writeSettings()
     settings.setValue("WidgetFont",ui->leWidgetFont->font());
 
     settings.setValue("AddressAreaWidth", ui->sbAddressAreaWidth->value());
+
+    settings.setValue("BytesPerLine", ui->cbBytesPerLine->currentText().toInt());
+    settings.setValue("GroupSize", ui->cbGroupSize->currentText().toInt());
+
+    settings.setValue("InspectorType", ui->cbInspector->currentIndex());
+    settings.setValue("InspectorBigEndian", ui->cbInspectorBigEndian->isChecked());
+    settings.setValue("InspectorStride", ui->sbInspectorStride->value());
+
+    settings.setValue("HighlightRules", ui->teHighlightRules->toPlainText());
 }
 
 void OptionsDialog::setColor(QWidget *widget, QColor color)
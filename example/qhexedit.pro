@@ -5,6 +5,18 @@ QT += widgets
 
 CONFIG += c++14
 
+# gzip files are read if zlib is found, seekable zstd files if libzstd is found
+packagesExist(zlib) {
+    DEFINES += QHEXEDIT_ZLIB
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+}
+packagesExist(libzstd) {
+    DEFINES += QHEXEDIT_ZSTD
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libzstd
+}
+
 HEADERS = \
     mainwindow.h \
     optionsdialog.h \
@@ -13,6 +25,29 @@ HEADERS = \
     ../src/xbytearray.h \
     ../src/commands.h \
     ../src/qhexeditdata.h \
+    ../src/qhexeditdocument.h \
+    ../src/undostore.h \
+    ../src/piecetable.h \
+    ../src/editjournal.h \
+    ../src/hexlayout.h \
+    ../src/statsengine.h \
+    ../src/overviewbar.h \
+    ../src/checksums.h \
+    ../src/hashengine.h \
+    ../src/qhexedithighlighter.h \
+    ../src/diffengine.h \
+    ../src/diffview.h \
+    ../src/stringsengine.h \
+    ../src/stringspanel.h \
+    ../src/hexrecords.h \
+    ../src/binarypatch.h \
+    ../src/valuedecoder.h \
+    ../src/structtemplate.h \
+    ../src/structpanel.h \
+    ../src/annotations.h \
+    ../src/annotationpanel.h \
+    ../src/highlightrules.h \
+    ../src/bitscan.h \
     searchdialog.h
 
 
@@ -25,6 +60,29 @@ SOURCES = \
     ../src/xbytearray.cpp \
     ../src/commands.cpp \
     ../src/qhexeditdata.cpp \
+    ../src/qhexeditcompresseddata.cpp \
+    ../src/qhexeditprocessdata.cpp \
+    ../src/qhexeditdocument.cpp \
+    ../src/undostore.cpp \
+    ../src/piecetable.cpp \
+    ../src/editjournal.cpp \
+    ../src/hexlayout.cpp \
+    ../src/statsengine.cpp \
+    ../src/overviewbar.cpp \
+    ../src/checksums.cpp \
+    ../src/hashengine.cpp \
+    ../src/diffengine.cpp \
+    ../src/diffview.cpp \
+    ../src/stringsengine.cpp \
+    ../src/stringspanel.cpp \
+    ../src/hexrecords.cpp \
+    ../src/binarypatch.cpp \
+    ../src/valuedecoder.cpp \
+    ../src/structtemplate.cpp \
+    ../src/structpanel.cpp \
+    ../src/annotations.cpp \
+    ../src/annotationpanel.cpp \
+    ../src/highlightrules.cpp \
     searchdialog.cpp
 
 
@@ -36,7 +94,8 @@ FORMS += \
     searchdialog.ui
 
 OTHER_FILES += \
-    ../doc/release.txt
+    ../doc/release.txt \
+    templates/elf64.json
 
 TRANSLATIONS += \
     translations/qhexedit_cs.ts \
@@ -0,0 +1,260 @@
+#include <QAbstractTableModel>
+#include <QFile>
+#include <QFontDatabase>
+#include <QHeaderView>
+#include <QKeyEvent>
+#include <QSaveFile>
+#include <QVBoxLayout>
+
+#include <algorithm>
+#include <climits>
+
+#include "annotationpanel.h"
+
+static const QRgb PALETTE[] =
+{
+    0xffc8c8, 0xc8e0ff, 0xd0f0c0, 0xffe8a8, 0xe0d0ff, 0xffd0ec, 0xc0f0e8, 0xf0dcc0
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// AnnotationModel implementation:
+/** \cond docNever */
+/*! AnnotationModel shows the annotations of an AnnotationTree in the order
+of their begin. It only counts rows, an annotation is looked up by its index
+when the view asks for it.
+*/
+class AnnotationModel : public QAbstractTableModel
+{
+public:
+    enum Column
+    {
+        BeginColumn,
+        EndColumn,
+        LabelColumn,
+        Columns
+    };
+
+    explicit AnnotationModel(const AnnotationTree & tree, QObject * parent = 0) :
+        QAbstractTableModel(parent),
+        _tree(tree),
+        _rows(0)
+    { }
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const
+    {
+        return parent.isValid() ? 0 : _rows;
+    }
+
+    int columnCount(const QModelIndex & parent = QModelIndex()) const
+    {
+        return parent.isValid() ? 0 : Columns;
+    }
+
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const
+    {
+        Annotation annotation;
+        if (!index.isValid() || !_tree.at(index.row(), annotation)) {
+            return QVariant();
+        }
+
+        if (role == Qt::DecorationRole && index.column() == BeginColumn) {
+            return annotation.color;
+        }
+        if (role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (index.column())
+        {
+            case BeginColumn:
+                return QString("%1").arg(annotation.begin, 8, 16, QChar('0'));
+            case EndColumn:
+                return QString("%1").arg(annotation.end, 8, 16, QChar('0'));
+            case LabelColumn:
+                return annotation.label;
+            default:
+                return QVariant();
+        }
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const
+    {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (section)
+        {
+            case BeginColumn:   return QObject::tr("Begin");
+            case EndColumn:     return QObject::tr("End");
+            case LabelColumn:   return QObject::tr("Label");
+            default:            return QVariant();
+        }
+    }
+
+    bool annotation(const QModelIndex & index, Annotation & annotation) const
+    {
+        return index.isValid() && _tree.at(index.row(), annotation);
+    }
+
+    // the positions of all rows may have changed
+    void reset()
+    {
+        beginResetModel();
+        _rows = static_cast<int>(std::min<size_t>(_tree.count(), INT_MAX));
+        endResetModel();
+    }
+
+private:
+    const AnnotationTree & _tree;
+    int _rows;
+};
+/** \endcond docNever */
+
+////////////////////////////////////////////////////////////////////////////////
+// AnnotationPanel implementation:
+AnnotationPanel::AnnotationPanel(QWidget * parent) :
+    QWidget(parent),
+    _colors(0)
+{
+    _model = new AnnotationModel(_tree, this);
+
+    _view = new QTableView;
+    _view->setModel(_model);
+    _view->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    _view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    _view->setShowGrid(false);
+    _view->verticalHeader()->hide();
+    _view->horizontalHeader()->setStretchLastSection(true);
+    connect(_view, SIGNAL(activated(QModelIndex)), this, SLOT(activated(QModelIndex)));
+    connect(_view, SIGNAL(clicked(QModelIndex)), this, SLOT(activated(QModelIndex)));
+
+    _status = new QLabel;
+
+    QVBoxLayout * layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(_view);
+    layout->addWidget(_status);
+
+    changed();
+}
+
+AnnotationPanel::~AnnotationPanel()
+{ }
+
+void AnnotationPanel::setData(QHexEditData * data)
+{
+    _tree.setData(data);
+}
+
+const AnnotationTree & AnnotationPanel::annotations() const
+{
+    return _tree;
+}
+
+QHexEditHighlighter * AnnotationPanel::highlighter()
+{
+    return &_tree;
+}
+
+bool AnnotationPanel::load(const QString & fileName, QString * errorString)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        if (errorString) {
+            *errorString = file.errorString();
+        }
+        return false;
+    }
+    if (!_tree.load(file, errorString)) {
+        return false;
+    }
+    changed();
+    return true;
+}
+
+bool AnnotationPanel::save(const QString & fileName, QString * errorString) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || !_tree.save(file, errorString) || !file.commit())
+    {
+        if (errorString && errorString->isEmpty()) {
+            *errorString = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+size_t AnnotationPanel::nextAddress(size_t address) const
+{
+    Annotation annotation;
+    if (_tree.at(_tree.next(address), annotation)) {
+        return annotation.begin;
+    }
+    return address;
+}
+
+void AnnotationPanel::addAnnotation(size_t begin, size_t end, const QString & label)
+{
+    Annotation annotation;
+    annotation.begin = begin;
+    annotation.end = end;
+    annotation.color = QColor(PALETTE[_colors++ % (sizeof(PALETTE) / sizeof(PALETTE[0]))]);
+    annotation.label = label;
+    _tree.add(annotation);
+    changed();
+}
+
+void AnnotationPanel::removeSelected()
+{
+    // the rows are looked up first, removing changes the indexes behind them
+    std::vector<Annotation> selected;
+    for (const QModelIndex & index : _view->selectionModel()->selectedRows())
+    {
+        Annotation annotation;
+        if (_model->annotation(index, annotation)) {
+            selected.push_back(annotation);
+        }
+    }
+    for (const Annotation & annotation : selected) {
+        _tree.remove(annotation.begin, annotation.end);
+    }
+    if (!selected.empty()) {
+        changed();
+    }
+}
+
+void AnnotationPanel::clear()
+{
+    _tree.clear();
+    changed();
+}
+
+void AnnotationPanel::dataChanged()
+{
+    _model->reset();
+    _status->setText(tr("%1 annotations").arg(_tree.count()));
+}
+
+void AnnotationPanel::keyPressEvent(QKeyEvent * event)
+{
+    if (event->matches(QKeySequence::Delete)) {
+        removeSelected();
+    } else {
+        QWidget::keyPressEvent(event);
+    }
+}
+
+void AnnotationPanel::activated(const QModelIndex & index)
+{
+    Annotation annotation;
+    if (_model->annotation(index, annotation)) {
+        emit addressClicked(annotation.begin);
+    }
+}
+
+void AnnotationPanel::changed()
+{
+    dataChanged();
+    emit highlightingChanged();
+}
@@ -0,0 +1,87 @@
+#ifndef ANNOTATIONPANEL_H
+#define ANNOTATIONPANEL_H
+
+#include <QLabel>
+#include <QTableView>
+#include <QWidget>
+
+#include "annotations.h"
+
+class AnnotationModel;
+
+/*! AnnotationPanel lists the annotations of a QHexEditData, which are kept
+in an AnnotationTree. Its highlighter() colours them in QHexEdit, register it
+with QHexEdit::addHighlighter() and connect highlightingChanged() to
+QHexEdit::updateHighlighting().
+
+The annotations move with the bytes, when the data is edited. The list only
+counts rows, an annotation is looked up when the view asks for its row, so
+thousands of annotations cost nothing until they are shown.
+
+Clicking an annotation emits its address (connect it to
+QHexEdit::gotoAddress()), the delete key removes the selected ones.
+*/
+class AnnotationPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit AnnotationPanel(QWidget * parent = 0);
+    ~AnnotationPanel();
+
+    /*! Sets the data to annotate, the annotations are kept. */
+    void setData(QHexEditData * data);
+
+    /*! Returns the tree, which holds the annotations. */
+    const AnnotationTree & annotations() const;
+
+    /*! Returns the highlighter, which colours the annotations. */
+    QHexEditHighlighter * highlighter();
+
+    /*! Replaces the annotations by the ones of a file saved by save().
+    \return false, if the file can't be read or has no valid annotations
+    */
+    bool load(const QString & fileName, QString * errorString = nullptr);
+
+    /*! Saves the annotations to a file. */
+    bool save(const QString & fileName, QString * errorString = nullptr) const;
+
+    /*! Returns the address of the first annotation behind address, or
+    address, if there is none.
+    */
+    size_t nextAddress(size_t address) const;
+
+public slots:
+    /*! Annotates the bytes [begin, end) with a colour of the palette. */
+    void addAnnotation(size_t begin, size_t end, const QString & label);
+
+    /*! Removes the annotations selected in the list. */
+    void removeSelected();
+
+    /*! Removes all annotations. */
+    void clear();
+
+    /*! Updates the list, call it when the data was changed. */
+    void dataChanged();
+
+signals:
+    void addressClicked(size_t address);
+    void highlightingChanged();
+
+protected:
+    void keyPressEvent(QKeyEvent * event);
+
+private slots:
+    void activated(const QModelIndex & index);
+
+private:
+    void changed();
+
+    AnnotationTree _tree;
+    AnnotationModel * _model;
+    QTableView * _view;
+    QLabel * _status;
+    int _colors;                            // colours of the palette taken so far
+};
+
+#endif // ANNOTATIONPANEL_H
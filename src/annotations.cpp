@@ -0,0 +1,475 @@
+#include "annotations.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <cmath>
+
+const double MAX_JSON_POS = 9007199254740992.0;     // 2^53, exact in a JSON number
+
+/** \cond docNever */
+struct AnnotationTree::Node
+{
+    size_t begin, end;
+    size_t maxEnd;                      // of the subtree
+    size_t size;                        // nodes of the subtree
+    size_t pending;                     // shift of the children, not applied yet
+    quint32 priority;                   // of the heap, higher ones are closer to the root
+    Node * left;
+    Node * right;
+    QColor color;
+    QString label;
+};
+/** \endcond docNever */
+
+////////////////////////////////////////////////////////////////////////////////
+// AnnotationTree implementation:
+
+AnnotationTree::AnnotationTree() :
+    _root(nullptr),
+    _data(nullptr),
+    _seed(2463534242u)
+{ }
+
+AnnotationTree::~AnnotationTree()
+{
+    if (_data) {
+        _data->removeObserver(this);
+    }
+    destroy(_root);
+}
+
+void AnnotationTree::setData(QHexEditData * data)
+{
+    if (_data) {
+        _data->removeObserver(this);
+    }
+    _data = data;
+    if (_data) {
+        _data->addObserver(this);
+    }
+}
+
+void AnnotationTree::add(const Annotation & annotation)
+{
+    if (annotation.begin >= annotation.end) {
+        return;
+    }
+
+    // xorshift, the priorities only have to be independent of the positions
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+
+    Node * node = new Node;
+    node->begin = annotation.begin;
+    node->end = annotation.end;
+    node->color = annotation.color;
+    node->label = annotation.label;
+    node->priority = _seed;
+    insertNode(node);
+}
+
+bool AnnotationTree::remove(size_t begin, size_t end)
+{
+    if (begin >= end) {
+        return false;
+    }
+
+    // the nodes of exactly [begin, end) are split out, one of them is dropped
+    Node * left;
+    Node * rest;
+    Node * match;
+    Node * right;
+    split(_root, begin, end, left, rest);
+    split(rest, begin, end + 1, match, right);
+    const bool found = match != nullptr;
+    if (found)
+    {
+        push(match);
+        Node * other = merge(match->left, match->right);
+        delete match;
+        match = other;
+    }
+    _root = merge(merge(left, match), right);
+    return found;
+}
+
+void AnnotationTree::clear()
+{
+    destroy(_root);
+    _root = nullptr;
+}
+
+size_t AnnotationTree::count() const
+{
+    return sizeOf(_root);
+}
+
+bool AnnotationTree::at(size_t index, Annotation & annotation) const
+{
+    const Node * node = _root;
+    size_t offset = 0;
+    while (node)
+    {
+        const size_t leftSize = sizeOf(node->left);
+        if (index == leftSize)
+        {
+            annotation.begin = node->begin + offset;
+            annotation.end = node->end + offset;
+            annotation.color = node->color;
+            annotation.label = node->label;
+            return true;
+        }
+        offset += node->pending;
+        if (index < leftSize)
+        {
+            node = node->left;
+        }
+        else
+        {
+            index -= leftSize + 1;
+            node = node->right;
+        }
+    }
+    return false;
+}
+
+std::vector<Annotation> AnnotationTree::query(size_t begin, size_t end) const
+{
+    std::vector<Annotation> result;
+    if (begin < end) {
+        query(_root, 0, begin, end, result);
+    }
+    return result;
+}
+
+size_t AnnotationTree::next(size_t pos) const
+{
+    return rank(_root, pos);
+}
+
+bool AnnotationTree::save(QIODevice & device, QString * errorString) const
+{
+    QJsonArray annotations;
+    for (const Annotation & annotation : query(0, size_t(-1)))
+    {
+        QJsonObject object;
+        object.insert("begin", double(annotation.begin));
+        object.insert("end", double(annotation.end));
+        object.insert("color", annotation.color.name());
+        if (!annotation.label.isEmpty()) {
+            object.insert("label", annotation.label);
+        }
+        annotations.append(object);
+    }
+    QJsonObject object;
+    object.insert("annotations", annotations);
+
+    const QByteArray json = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    if (device.write(json) != json.size())
+    {
+        if (errorString) {
+            *errorString = device.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool AnnotationTree::load(QIODevice & device, QString * errorString)
+{
+    QString error;
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(device.readAll(), &parseError);
+    const QJsonValue annotations = document.object().value("annotations");
+    if (document.isNull()) {
+        error = parseError.errorString();
+    } else if (!annotations.isArray()) {
+        error = QObject::tr("No array of annotations");
+    }
+
+    std::vector<Annotation> loaded;
+    const QJsonArray array = annotations.toArray();
+    for (int idx = 0; idx < array.size() && error.isEmpty(); idx++)
+    {
+        const QJsonObject object = array.at(idx).toObject();
+        const double begin = object.value("begin").toDouble(-1);
+        const double end = object.value("end").toDouble(-1);
+        if (begin < 0 || end <= begin || end > MAX_JSON_POS || begin != std::floor(begin) || end != std::floor(end))
+        {
+            error = QObject::tr("Annotation %1: invalid range").arg(idx + 1);
+            break;
+        }
+        Annotation annotation;
+        annotation.begin = static_cast<size_t>(begin);
+        annotation.end = static_cast<size_t>(end);
+        annotation.color = QColor(object.value("color").toString());
+        annotation.label = object.value("label").toString();
+        loaded.push_back(annotation);
+    }
+
+    if (!error.isEmpty())
+    {
+        if (errorString) {
+            *errorString = error;
+        }
+        return false;
+    }
+
+    clear();
+    for (const Annotation & annotation : loaded) {
+        add(annotation);
+    }
+    return true;
+}
+
+void AnnotationTree::highlight(size_t begin, size_t end, QColor * colors) const
+{
+    // in the order of begin, so nested annotations paint over the outer ones
+    for (const Annotation & annotation : query(begin, end))
+    {
+        if (!annotation.color.isValid()) {
+            continue;
+        }
+        const size_t from = std::max(annotation.begin, begin);
+        const size_t to = std::min(annotation.end, end);
+        std::fill(colors + (from - begin), colors + (to - begin), annotation.color);
+    }
+}
+
+void AnnotationTree::inserted(size_t pos, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    // the annotations behind pos move, the ones across it grow
+    Node * left;
+    Node * right;
+    split(_root, pos, 0, left, right);
+    shift(right, len);
+    clipEnds(left, pos, 0, len);
+    _root = merge(left, right);
+}
+
+void AnnotationTree::removed(size_t pos, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    // the annotations behind the removed bytes move, the ones across pos
+    // shrink. Those, which begin inside the removed bytes, now begin at pos,
+    // they are inserted again, their order among the others may change.
+    Node * left;
+    Node * rest;
+    Node * inside;
+    Node * right;
+    split(_root, pos, 0, left, rest);
+    split(rest, pos + len, 0, inside, right);
+    shift(right, 0 - len);
+    clipEnds(left, pos, len, 0);
+    _root = merge(left, right);
+
+    std::vector<Node *> nodes;
+    collect(inside, nodes);
+    for (Node * node : nodes)
+    {
+        node->begin = pos;
+        node->end = node->end > pos + len ? node->end - len : pos;
+        if (node->end > node->begin) {
+            insertNode(node);
+        } else {
+            delete node;
+        }
+    }
+}
+
+void AnnotationTree::detached(QHexEditData * data)
+{
+    if (data == _data) {
+        _data = nullptr;
+    }
+}
+
+size_t AnnotationTree::sizeOf(const Node * node)
+{
+    return node ? node->size : 0;
+}
+
+// node has no pending shift
+void AnnotationTree::update(Node * node)
+{
+    node->size = 1 + sizeOf(node->left) + sizeOf(node->right);
+    node->maxEnd = node->end;
+    if (node->left) {
+        node->maxEnd = std::max(node->maxEnd, node->left->maxEnd);
+    }
+    if (node->right) {
+        node->maxEnd = std::max(node->maxEnd, node->right->maxEnd);
+    }
+}
+
+// moves the subtree by delta (which wraps around to move it down), the
+// children are moved when they are visited
+void AnnotationTree::shift(Node * node, size_t delta)
+{
+    if (!node) {
+        return;
+    }
+    node->begin += delta;
+    node->end += delta;
+    node->maxEnd += delta;
+    node->pending += delta;
+}
+
+void AnnotationTree::push(Node * node)
+{
+    if (node->pending != 0)
+    {
+        shift(node->left, node->pending);
+        shift(node->right, node->pending);
+        node->pending = 0;
+    }
+}
+
+// left gets the nodes before [begin, end), right the others
+void AnnotationTree::split(Node * node, size_t begin, size_t end, Node *& left, Node *& right)
+{
+    if (!node)
+    {
+        left = right = nullptr;
+        return;
+    }
+    push(node);
+    if (node->begin < begin || (node->begin == begin && node->end < end))
+    {
+        split(node->right, begin, end, node->right, right);
+        left = node;
+    }
+    else
+    {
+        split(node->left, begin, end, left, node->left);
+        right = node;
+    }
+    update(node);
+}
+
+// all nodes of left are before the ones of right
+AnnotationTree::Node * AnnotationTree::merge(Node * left, Node * right)
+{
+    if (!left || !right) {
+        return left ? left : right;
+    }
+    if (left->priority > right->priority)
+    {
+        push(left);
+        left->right = merge(left->right, right);
+        update(left);
+        return left;
+    }
+    push(right);
+    right->left = merge(left, right->left);
+    update(right);
+    return right;
+}
+
+void AnnotationTree::destroy(Node * node)
+{
+    if (node)
+    {
+        destroy(node->left);
+        destroy(node->right);
+        delete node;
+    }
+}
+
+// takes the nodes apart, in order and with their shift applied
+void AnnotationTree::collect(Node * node, std::vector<Node *> & nodes)
+{
+    if (!node) {
+        return;
+    }
+    push(node);
+    collect(node->left, nodes);
+    nodes.push_back(node);
+    collect(node->right, nodes);
+}
+
+// offset is the pending shift of the ancestors, node isn't changed
+void AnnotationTree::query(const Node * node, size_t offset, size_t begin, size_t end, std::vector<Annotation> & result)
+{
+    while (node && node->maxEnd + offset > begin)
+    {
+        const size_t childOffset = offset + node->pending;
+        query(node->left, childOffset, begin, end, result);
+        if (node->begin + offset >= end) {
+            return;
+        }
+        if (node->end + offset > begin)
+        {
+            Annotation annotation;
+            annotation.begin = node->begin + offset;
+            annotation.end = node->end + offset;
+            annotation.color = node->color;
+            annotation.label = node->label;
+            result.push_back(annotation);
+        }
+        node = node->right;
+        offset = childOffset;
+    }
+}
+
+// the number of nodes, which begin at or before pos
+size_t AnnotationTree::rank(const Node * node, size_t pos)
+{
+    size_t offset = 0;
+    size_t count = 0;
+    while (node)
+    {
+        const size_t childOffset = offset + node->pending;
+        if (node->begin + offset <= pos)
+        {
+            count += sizeOf(node->left) + 1;
+            node = node->right;
+        }
+        else
+        {
+            node = node->left;
+        }
+        offset = childOffset;
+    }
+    return count;
+}
+
+// the nodes, which end behind pos, lose the removed bytes behind pos and
+// get the inserted ones. Their order doesn't change, only the subtrees
+// reaching behind pos are visited.
+void AnnotationTree::clipEnds(Node * node, size_t pos, size_t removed, size_t inserted)
+{
+    if (!node || node->maxEnd <= pos) {
+        return;
+    }
+    push(node);
+    clipEnds(node->left, pos, removed, inserted);
+    clipEnds(node->right, pos, removed, inserted);
+    if (node->end > pos) {
+        node->end = (node->end > pos + removed ? node->end - removed : pos) + inserted;
+    }
+    update(node);
+}
+
+void AnnotationTree::insertNode(Node * node)
+{
+    node->left = node->right = nullptr;
+    node->pending = 0;
+    update(node);
+
+    Node * left;
+    Node * right;
+    split(_root, node->begin, node->end, left, right);
+    _root = merge(merge(left, node), right);
+}
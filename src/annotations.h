@@ -0,0 +1,107 @@
+#ifndef ANNOTATIONS_H
+#define ANNOTATIONS_H
+
+#include <QColor>
+#include <QIODevice>
+#include <QString>
+
+#include <vector>
+
+#include "qhexeditdata.h"
+#include "qhexedithighlighter.h"
+
+/** \cond docNever */
+
+/*! Annotation marks the bytes [begin, end) with a colour and a label, e.g. a
+finding or a known structure. An annotation of one byte serves as bookmark.
+*/
+struct Annotation
+{
+    size_t begin;
+    size_t end;
+    QColor color;
+    QString label;
+};
+
+/*! AnnotationTree keeps annotations in an interval tree: a treap ordered by
+begin and end, whose nodes know the highest end of their subtree. Adding and
+removing an annotation costs O(log n), finding the k annotations of the lines
+in view O(log n + k), so painting doesn't depend on the number of annotations.
+
+As observer of a QHexEditData, the annotations move with the bytes. The ones
+behind an insert or remove are moved lazily by a tag at the root of their
+subtree, only the k annotations overlapping the edit are changed one by one,
+so an edit costs O(log n + k) as well. Annotations, whose bytes were all
+removed, are dropped.
+
+The annotations are saved as JSON, e.g. to a file next to the data:
+
+\code
+{"annotations": [{"begin": 16, "end": 32, "color": "#ffd0d0", "label": "header"}]}
+\endcode
+*/
+class AnnotationTree : public QHexEditHighlighter, public QHexEditDataObserver
+{
+public:
+    AnnotationTree();
+    ~AnnotationTree();
+
+    // the tree observes data, until it is destroyed or another one is set
+    void setData(QHexEditData * data);
+
+    // empty annotations (begin >= end) are ignored
+    void add(const Annotation & annotation);
+
+    // removes one annotation of exactly [begin, end), false if there is none
+    bool remove(size_t begin, size_t end);
+    void clear();
+
+    size_t count() const;
+
+    // the annotation at index in the order of begin, false if index >= count()
+    bool at(size_t index, Annotation & annotation) const;
+
+    // the annotations, which overlap [begin, end), in the order of begin
+    std::vector<Annotation> query(size_t begin, size_t end) const;
+
+    // the index of the first annotation, which begins after pos, count() if
+    // there is none. Walks the bookmarks with at().
+    size_t next(size_t pos) const;
+
+    bool save(QIODevice & device, QString * errorString = nullptr) const;
+    bool load(QIODevice & device, QString * errorString = nullptr);
+
+    void highlight(size_t begin, size_t end, QColor * colors) const;
+
+    void inserted(size_t pos, size_t len);
+    void removed(size_t pos, size_t len);
+    void detached(QHexEditData * data);
+
+private:
+    struct Node;
+
+    AnnotationTree(const AnnotationTree & other) = delete;
+    AnnotationTree & operator=(const AnnotationTree & other) = delete;
+
+    static size_t sizeOf(const Node * node);
+    static void update(Node * node);
+    static void shift(Node * node, size_t delta);
+    static void push(Node * node);
+    static void split(Node * node, size_t begin, size_t end, Node *& left, Node *& right);
+    static Node * merge(Node * left, Node * right);
+    static void destroy(Node * node);
+    static void collect(Node * node, std::vector<Node *> & nodes);
+    static void query(const Node * node, size_t offset, size_t begin, size_t end, std::vector<Annotation> & result);
+    static size_t rank(const Node * node, size_t pos);
+    static void clipEnds(Node * node, size_t pos, size_t removed, size_t inserted);
+
+    void insertNode(Node * node);
+
+    Node * _root;
+    QHexEditData * _data;
+    quint32 _seed;                      // of the priorities
+};
+
+/** \endcond docNever */
+
+#endif // ANNOTATIONS_H
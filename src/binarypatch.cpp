@@ -0,0 +1,917 @@
+#include "binarypatch.h"
+
+#include <cstring>
+#include <vector>
+
+#include "checksums.h"
+
+const size_t PATCH_CHUNK_SIZE = 1024 * 1024;    // bytes read from the data at once
+const size_t PENDING_LIMIT = 4 * 1024 * 1024;   // new bytes held back to be turned into replacements
+const size_t OUTPUT_BUFFER_SIZE = 64 * 1024;
+
+const char IPS_MAGIC[] = "PATCH";
+const char IPS_EOF[] = "EOF";
+const quint64 IPS_EOF_OFFSET = 0x454f46;        // an offset, which reads "EOF"
+const quint64 IPS_MAX_OFFSET = 0xffffff;
+const size_t IPS_MAX_RECORD = 0xffff;
+const size_t IPS_MIN_RLE = 9;                   // a RLE record is 3 bytes longer than a plain one
+
+const char BPS_MAGIC[] = "BPS1";
+enum BpsAction { SourceRead, TargetRead, SourceCopy, TargetCopy };
+
+const char NATIVE_MAGIC[] = "QHEP";
+const quint32 NATIVE_VERSION = 1;
+
+////////////////////////////////////////////////////////////////////////////////
+// Patch streams implementation:
+/** \cond docNever */
+template <typename Data>
+static quint32 crcOf(const Data & data)
+{
+    quint32 crc = 0;
+    for (size_t pos = 0; pos < data.size(); pos += PATCH_CHUNK_SIZE)
+    {
+        const QByteArray bytes = data.range(pos, std::min(PATCH_CHUNK_SIZE, data.size() - pos));
+        crc = crc32Update(crc, reinterpret_cast<const uchar *>(bytes.constData()), bytes.size());
+    }
+    return crc;
+}
+
+/*! PatchOutput buffers the bytes of a patch and keeps their CRC-32. */
+class PatchOutput
+{
+public:
+    explicit PatchOutput(QIODevice & device) :
+        _device(device),
+        _crc(0),
+        _ok(true)
+    { }
+
+    void write(const char * bytes, size_t len)
+    {
+        _buffer.append(bytes, static_cast<int>(len));
+        if (static_cast<size_t>(_buffer.size()) >= OUTPUT_BUFFER_SIZE) {
+            flush();
+        }
+    }
+
+    void write(const QByteArray & bytes)
+    {
+        write(bytes.constData(), bytes.size());
+    }
+
+    void writeBigEndian(quint64 value, int bytes)
+    {
+        for (int i = bytes - 1; i >= 0; i--) {
+            _buffer.append(char(value >> (8 * i)));
+        }
+    }
+
+    void writeLittleEndian(quint64 value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++) {
+            _buffer.append(char(value >> (8 * i)));
+        }
+    }
+
+    // the variable length numbers of BPS, 7 bits per byte
+    void writeNumber(quint64 value)
+    {
+        for (;;)
+        {
+            const char x = char(value & 0x7f);
+            value >>= 7;
+            if (value == 0)
+            {
+                _buffer.append(char(0x80 | x));
+                break;
+            }
+            _buffer.append(x);
+            value--;
+        }
+    }
+
+    // of all bytes written so far
+    quint32 crc()
+    {
+        flush();
+        return _crc;
+    }
+
+    bool flush()
+    {
+        _crc = crc32Update(_crc, reinterpret_cast<const uchar *>(_buffer.constData()), _buffer.size());
+        _ok = _ok && _device.write(_buffer) == _buffer.size();
+        _buffer.clear();
+        return _ok;
+    }
+
+private:
+    QIODevice & _device;
+    QByteArray _buffer;
+    quint32 _crc;
+    bool _ok;
+};
+
+/*! PatchInput reads the fields of a patch and keeps the CRC-32 of the bytes
+read. The read functions return false at the end of the device.
+*/
+class PatchInput
+{
+public:
+    explicit PatchInput(QIODevice & device) :
+        _device(device),
+        _crc(0)
+    { }
+
+    bool read(char * dst, size_t len)
+    {
+        if (_device.read(dst, len) != static_cast<qint64>(len)) {
+            return false;
+        }
+        _crc = crc32Update(_crc, reinterpret_cast<const uchar *>(dst), len);
+        return true;
+    }
+
+    bool read(QByteArray & bytes, size_t len)
+    {
+        bytes.resize(static_cast<int>(len));
+        return read(bytes.data(), len);
+    }
+
+    bool readBigEndian(quint64 & value, int bytes)
+    {
+        uchar b[8];
+        if (!read(reinterpret_cast<char *>(b), bytes)) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value = (value << 8) | b[i];
+        }
+        return true;
+    }
+
+    bool readLittleEndian(quint64 & value, int bytes)
+    {
+        uchar b[8];
+        if (!read(reinterpret_cast<char *>(b), bytes)) {
+            return false;
+        }
+        value = 0;
+        for (int i = bytes - 1; i >= 0; i--) {
+            value = (value << 8) | b[i];
+        }
+        return true;
+    }
+
+    bool readNumber(quint64 & value)
+    {
+        value = 0;
+        quint64 shift = 1;
+        for (int i = 0; i < 10; i++)
+        {
+            char x;
+            if (!read(&x, 1)) {
+                return false;
+            }
+            value += (x & 0x7f) * shift;
+            if (x & 0x80) {
+                return true;
+            }
+            shift <<= 7;
+            value += shift;
+        }
+        return false;
+    }
+
+    quint32 crc() const
+    {
+        return _crc;
+    }
+
+private:
+    QIODevice & _device;
+    quint32 _crc;
+};
+/** \endcond docNever */
+
+////////////////////////////////////////////////////////////////////////////////
+// Edit planning implementation:
+/** \cond docNever */
+/*! PatchSink takes the edits, which turn the source into the target, in the
+order they have to be applied. Positions refer to the data with all earlier
+edits applied.
+*/
+class PatchSink
+{
+public:
+    virtual ~PatchSink() { }
+    virtual bool edit(EditJournal::Op op, size_t pos, size_t len, const QByteArray & bytes) = 0;
+
+    QString error() const { return _error; }
+
+protected:
+    QString _error;
+};
+
+/*! PatchPlanner turns a description of the target, as runs of source bytes
+and of new bytes, into replace, insert and remove edits of the source. The
+target is built from the front: the data before position() is the target,
+the data behind it is the rest of the source from sourceCursor on. Source
+runs behind the cursor cost a removal of the skipped bytes, new bytes in
+front of such a gap replace it. Source runs, which were passed already, are
+inserted as new bytes.
+*/
+class PatchPlanner
+{
+public:
+    PatchPlanner(QHexEditData::Snapshot source, PatchSink & sink) :
+        _source(std::move(source)),
+        _sink(sink),
+        _pos(0),
+        _sourceCursor(0),
+        _pendingSize(0)
+    { }
+
+    // len bytes of the source at sourcePos follow in the target
+    bool copy(quint64 sourcePos, quint64 len)
+    {
+        if (sourcePos + len > _source->size()) {
+            return false;
+        }
+        for (; sourcePos < _sourceCursor && len > 0; )
+        {
+            const size_t n = std::min<quint64>(std::min<quint64>(len, _sourceCursor - sourcePos), PATCH_CHUNK_SIZE);
+            if (!add(_source->range(sourcePos, n))) {
+                return false;
+            }
+            sourcePos += n;
+            len -= n;
+        }
+        if (len == 0) {
+            return true;
+        }
+        if (!flush(sourcePos - _sourceCursor)) {
+            return false;
+        }
+        _pos += len;
+        _sourceCursor += len;
+        return true;
+    }
+
+    // new bytes follow in the target
+    bool add(const QByteArray & bytes)
+    {
+        _pending.push_back(bytes);
+        _pendingSize += bytes.size();
+        return _pendingSize < PENDING_LIMIT || flush(0);
+    }
+
+    // applies everything added, the target before position() is complete
+    bool commit()
+    {
+        return flush(0);
+    }
+
+    bool finish()
+    {
+        return flush(_source->size() - _sourceCursor);
+    }
+
+    size_t position() const
+    {
+        return _pos;
+    }
+
+private:
+    // the pending bytes replace up to gap source bytes, the rest of the gap
+    // is removed
+    bool flush(quint64 gap)
+    {
+        quint64 replaced = 0;
+        for (const QByteArray & bytes : _pending)
+        {
+            const size_t n = bytes.size();
+            const size_t r = std::min<quint64>(n, gap - replaced);
+            if (r > 0 && !_sink.edit(EditJournal::Replace, _pos, r, bytes.left(static_cast<int>(r)))) {
+                return false;
+            }
+            if (n > r && !_sink.edit(EditJournal::Insert, _pos + r, n - r, bytes.mid(static_cast<int>(r)))) {
+                return false;
+            }
+            _pos += n;
+            replaced += r;
+        }
+        _pending.clear();
+        _pendingSize = 0;
+
+        if (gap > replaced && !_sink.edit(EditJournal::Remove, _pos, gap - replaced, QByteArray())) {
+            return false;
+        }
+        _sourceCursor += gap;
+        return true;
+    }
+
+    QHexEditData::Snapshot _source;
+    PatchSink & _sink;
+    quint64 _pos;                       // end of the finished target
+    quint64 _sourceCursor;              // source position of the bytes at _pos
+    std::vector<QByteArray> _pending;
+    size_t _pendingSize;
+};
+
+/*! DocumentSink applies the edits to a document as undo commands. */
+class DocumentSink : public PatchSink
+{
+public:
+    explicit DocumentSink(QHexEditDocument & document) :
+        _document(document)
+    { }
+
+    virtual bool edit(EditJournal::Op op, size_t pos, size_t len, const QByteArray & bytes)
+    {
+        const QHexEditData & data = _document.data();
+        if (op != EditJournal::Replace && data.fixedSize())
+        {
+            _error = QObject::tr("The size of the data can't change");
+            return false;
+        }
+        if (pos > data.size() || (op != EditJournal::Insert && len > data.size() - pos))
+        {
+            _error = QObject::tr("The patch doesn't fit the data");
+            return false;
+        }
+
+        switch (op)
+        {
+        case EditJournal::Insert:
+            _document.applyArray(ArrayCommand::insert, pos, bytes, len);
+            break;
+        case EditJournal::Remove:
+            _document.applyArray(ArrayCommand::remove, pos, QByteArray(), len);
+            break;
+        case EditJournal::Replace:
+            _document.applyArray(ArrayCommand::replace, pos, bytes, len);
+            break;
+        }
+        return true;
+    }
+
+private:
+    QHexEditDocument & _document;
+};
+
+/*! NativeSink writes the edits as records of the native format. */
+class NativeSink : public PatchSink
+{
+public:
+    explicit NativeSink(PatchOutput & out) :
+        _out(out)
+    { }
+
+    virtual bool edit(EditJournal::Op op, size_t pos, size_t len, const QByteArray & bytes)
+    {
+        const char type = char(op);
+        _out.write(&type, 1);
+        _out.writeLittleEndian(pos, 8);
+        _out.writeLittleEndian(len, 8);
+        if (op != EditJournal::Remove) {
+            _out.write(bytes);
+        }
+        return true;
+    }
+
+private:
+    PatchOutput & _out;
+};
+/** \endcond docNever */
+
+////////////////////////////////////////////////////////////////////////////////
+// Writing implementation:
+static bool writeIpsRecord(const QHexEditData & data, PatchOutput & out, quint64 offset,
+                           const char * bytes, size_t len, bool rle)
+{
+    if (offset > IPS_MAX_OFFSET) {
+        return false;
+    }
+    if (offset == IPS_EOF_OFFSET)
+    {
+        // the offset would end the patch, the record starts a byte earlier
+        const char prefix[2] = { char(data.at(offset - 1)), bytes[0] };
+        if (!writeIpsRecord(data, out, offset - 1, prefix, 2, false)) {
+            return false;
+        }
+        if (len == 1) {
+            return true;
+        }
+        offset++;
+        len--;
+        bytes += rle ? 0 : 1;
+    }
+
+    out.writeBigEndian(offset, 3);
+    if (rle)
+    {
+        out.writeBigEndian(0, 2);
+        out.writeBigEndian(len, 2);
+        out.write(bytes, 1);
+    }
+    else
+    {
+        out.writeBigEndian(len, 2);
+        out.write(bytes, len);
+    }
+    return true;
+}
+
+static bool writeIpsBytes(const QHexEditData & data, PatchOutput & out, quint64 offset, const QByteArray & bytes)
+{
+    const char * b = bytes.constData();
+    const size_t n = bytes.size();
+    for (size_t i = 0; i < n; )
+    {
+        size_t run = 1;
+        while (i + run < n && run < IPS_MAX_RECORD && b[i + run] == b[i]) {
+            run++;
+        }
+        if (run >= IPS_MIN_RLE)
+        {
+            if (!writeIpsRecord(data, out, offset + i, b + i, run, true)) {
+                return false;
+            }
+            i += run;
+            continue;
+        }
+
+        // plain bytes up to the next run, which is worth a RLE record
+        size_t end = i + 1;
+        size_t runStart = i;
+        for (; end < n && end - i < IPS_MAX_RECORD; end++)
+        {
+            if (b[end] != b[end - 1]) {
+                runStart = end;
+            } else if (end + 1 - runStart >= IPS_MIN_RLE) {
+                end = runStart;
+                break;
+            }
+        }
+        if (!writeIpsRecord(data, out, offset + i, b + i, end - i, false)) {
+            return false;
+        }
+        i = end;
+    }
+    return true;
+}
+
+static bool writeIps(const QHexEditData & data, PatchOutput & out, QString & error)
+{
+    const QHexEditData::Snapshot original = data.original();
+    out.write(IPS_MAGIC, strlen(IPS_MAGIC));
+
+    // IPS overwrites, bytes at their old position are left out
+    for (const QHexEditData::Origin & run : data.origins())
+    {
+        if (run.sourcePos == static_cast<qint64>(run.pos)) {
+            continue;
+        }
+        for (size_t pos = run.pos; pos < run.pos + run.len; pos += PATCH_CHUNK_SIZE)
+        {
+            const QByteArray bytes = data.range(pos, std::min(PATCH_CHUNK_SIZE, run.pos + run.len - pos));
+            if (!writeIpsBytes(data, out, pos, bytes))
+            {
+                error = QObject::tr("IPS patches can't change bytes behind 16 MiB");
+                return false;
+            }
+        }
+    }
+
+    out.write(IPS_EOF, strlen(IPS_EOF));
+    if (data.size() < original->size())
+    {
+        if (data.size() > IPS_MAX_OFFSET)
+        {
+            error = QObject::tr("IPS patches can't truncate behind 16 MiB");
+            return false;
+        }
+        out.writeBigEndian(data.size(), 3);
+    }
+    return true;
+}
+
+static bool writeBps(const QHexEditData & data, PatchOutput & out)
+{
+    const QHexEditData::Snapshot original = data.original();
+    out.write(BPS_MAGIC, strlen(BPS_MAGIC));
+    out.writeNumber(original->size());
+    out.writeNumber(data.size());
+    out.writeNumber(0);                 // no metadata
+
+    quint64 sourceRelative = 0;
+    for (const QHexEditData::Origin & run : data.origins())
+    {
+        if (run.sourcePos == static_cast<qint64>(run.pos))
+        {
+            out.writeNumber(((run.len - 1) << 2) | SourceRead);
+        }
+        else if (run.sourcePos >= 0)
+        {
+            const qint64 delta = run.sourcePos - static_cast<qint64>(sourceRelative);
+            out.writeNumber(((run.len - 1) << 2) | SourceCopy);
+            out.writeNumber((quint64(delta < 0 ? -delta : delta) << 1) | (delta < 0 ? 1 : 0));
+            sourceRelative = run.sourcePos + run.len;
+        }
+        else
+        {
+            for (size_t pos = run.pos; pos < run.pos + run.len; pos += PATCH_CHUNK_SIZE)
+            {
+                const QByteArray bytes = data.range(pos, std::min(PATCH_CHUNK_SIZE, run.pos + run.len - pos));
+                out.writeNumber(((bytes.size() - 1) << 2) | TargetRead);
+                out.write(bytes);
+            }
+        }
+    }
+
+    out.writeLittleEndian(crcOf(*original), 4);
+    out.writeLittleEndian(crcOf(data), 4);
+    out.writeLittleEndian(out.crc(), 4);
+    return true;
+}
+
+static bool writeNative(const QHexEditData & data, PatchOutput & out)
+{
+    const QHexEditData::Snapshot original = data.original();
+    out.write(NATIVE_MAGIC, strlen(NATIVE_MAGIC));
+    out.writeLittleEndian(NATIVE_VERSION, 4);
+    out.writeLittleEndian(original->size(), 8);
+    out.writeLittleEndian(data.size(), 8);
+
+    NativeSink sink(out);
+    PatchPlanner planner(original, sink);
+    for (const QHexEditData::Origin & run : data.origins())
+    {
+        if (run.sourcePos >= 0)
+        {
+            planner.copy(run.sourcePos, run.len);
+            continue;
+        }
+        for (size_t pos = run.pos; pos < run.pos + run.len; pos += PATCH_CHUNK_SIZE) {
+            planner.add(data.range(pos, std::min(PATCH_CHUNK_SIZE, run.pos + run.len - pos)));
+        }
+    }
+    planner.finish();
+
+    const char end = 0;
+    out.write(&end, 1);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Applying implementation:
+static bool applyIps(QHexEditDocument & document, PatchInput & in, PatchSink & sink, QString & error)
+{
+    char magic[sizeof(IPS_MAGIC) - 1];
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, IPS_MAGIC, sizeof(magic)) != 0)
+    {
+        error = QObject::tr("Not an IPS patch");
+        return false;
+    }
+
+    const QHexEditData & data = document.data();
+    for (;;)
+    {
+        QByteArray offsetBytes;
+        if (!in.read(offsetBytes, 3)) {
+            break;
+        }
+        if (offsetBytes == IPS_EOF)
+        {
+            // an optional size to truncate to follows
+            quint64 size;
+            if (in.readBigEndian(size, 3) && size < data.size()) {
+                return sink.edit(EditJournal::Remove, size, data.size() - size, QByteArray());
+            }
+            return true;
+        }
+
+        const uchar * o = reinterpret_cast<const uchar *>(offsetBytes.constData());
+        const quint64 offset = (o[0] << 16) | (o[1] << 8) | o[2];
+        quint64 len, count;
+        QByteArray bytes;
+        if (!in.readBigEndian(len, 2)) {
+            break;
+        }
+        if (len == 0)
+        {
+            QByteArray value;
+            if (!in.readBigEndian(count, 2) || !in.read(value, 1)) {
+                break;
+            }
+            bytes = QByteArray(static_cast<int>(count), value[0]);
+        }
+        else if (!in.read(bytes, len))
+        {
+            break;
+        }
+
+        // records behind the end extend the data, a gap is filled with zeros
+        const size_t size = data.size();
+        if (offset > size && !sink.edit(EditJournal::Insert, size, offset - size, QByteArray(static_cast<int>(offset - size), 0))) {
+            return false;
+        }
+        const size_t inPlace = std::min<quint64>(bytes.size(), offset < size ? size - offset : 0);
+        if (inPlace > 0 && !sink.edit(EditJournal::Replace, offset, inPlace, bytes.left(static_cast<int>(inPlace)))) {
+            return false;
+        }
+        if (static_cast<size_t>(bytes.size()) > inPlace &&
+            !sink.edit(EditJournal::Insert, offset + inPlace, bytes.size() - inPlace, bytes.mid(static_cast<int>(inPlace))))
+        {
+            return false;
+        }
+    }
+    error = QObject::tr("The patch is truncated");
+    return false;
+}
+
+static bool applyBps(QHexEditDocument & document, QIODevice & device, PatchInput & in, PatchSink & sink, QString & error)
+{
+    char magic[sizeof(BPS_MAGIC) - 1];
+    quint64 sourceSize, targetSize, metadataSize;
+    QByteArray metadata;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, BPS_MAGIC, sizeof(magic)) != 0 ||
+        !in.readNumber(sourceSize) || !in.readNumber(targetSize) || !in.readNumber(metadataSize))
+    {
+        error = QObject::tr("Not a BPS patch");
+        return false;
+    }
+    const QHexEditData & data = document.data();
+    if (sourceSize != data.size())
+    {
+        error = QObject::tr("The patch is for data of another size");
+        return false;
+    }
+    for (quint64 i = 0; i < metadataSize; i += PATCH_CHUNK_SIZE)
+    {
+        if (!in.read(metadata, std::min<quint64>(PATCH_CHUNK_SIZE, metadataSize - i)))
+        {
+            error = QObject::tr("The patch is truncated");
+            return false;
+        }
+    }
+
+    // the source is checked before it is changed, if the footer can be read
+    const QHexEditData::Snapshot source = data.snapshot();
+    bool sourceChecked = false;
+    if (!device.isSequential() && device.size() >= device.pos() + 12)
+    {
+        const qint64 pos = device.pos();
+        device.seek(device.size() - 12);
+        const QByteArray footer = device.read(4);
+        device.seek(pos);
+        quint32 sourceCrc;
+        memcpy(&sourceCrc, footer.constData(), 4);
+        if (qFromLittleEndian(sourceCrc) != crcOf(*source))
+        {
+            error = QObject::tr("The patch is for other data");
+            return false;
+        }
+        sourceChecked = true;
+    }
+
+    PatchPlanner planner(source, sink);
+    quint64 output = 0, sourceRelative = 0, targetRelative = 0;
+    while (output < targetSize)
+    {
+        quint64 number, delta;
+        if (!in.readNumber(number)) {
+            break;
+        }
+        const quint64 len = (number >> 2) + 1;
+        bool ok = true;
+        switch (number & 3)
+        {
+        case SourceRead:
+            ok = planner.copy(output, len);
+            break;
+        case TargetRead:
+            for (quint64 i = 0; ok && i < len; i += PATCH_CHUNK_SIZE)
+            {
+                QByteArray bytes;
+                ok = in.read(bytes, std::min<quint64>(PATCH_CHUNK_SIZE, len - i)) && planner.add(bytes);
+            }
+            break;
+        case SourceCopy:
+            ok = in.readNumber(delta);
+            sourceRelative += (delta & 1) ? -qint64(delta >> 1) : qint64(delta >> 1);
+            ok = ok && planner.copy(sourceRelative, len);
+            sourceRelative += len;
+            break;
+        case TargetCopy:
+        {
+            // the copied target is in the data, it repeats if it overlaps the output
+            ok = in.readNumber(delta) && planner.commit();
+            targetRelative += (delta & 1) ? -qint64(delta >> 1) : qint64(delta >> 1);
+            const quint64 available = planner.position() - targetRelative;
+            ok = ok && targetRelative < planner.position();
+            for (quint64 i = 0; ok && i < len; )
+            {
+                const quint64 rel = i % available;
+                const quint64 n = std::min(std::min<quint64>(len - i, available - rel), PATCH_CHUNK_SIZE);
+                ok = planner.add(data.range(targetRelative + rel, n));
+                i += n;
+            }
+            targetRelative += len;
+            break;
+        }
+        }
+        if (!ok) {
+            break;
+        }
+        output += len;
+    }
+    if (output != targetSize || !planner.finish())
+    {
+        error = sink.error().isEmpty() ? QObject::tr("The patch is damaged") : sink.error();
+        return false;
+    }
+
+    quint64 sourceCrc, targetCrc, patchCrc;
+    const bool footer = in.readLittleEndian(sourceCrc, 4) && in.readLittleEndian(targetCrc, 4);
+    const quint32 crc = in.crc();
+    if (!footer || !in.readLittleEndian(patchCrc, 4) || patchCrc != crc)
+    {
+        error = QObject::tr("The patch is damaged");
+        return false;
+    }
+    if ((!sourceChecked && sourceCrc != crcOf(*source)) || targetCrc != crcOf(data) || data.size() != targetSize)
+    {
+        error = QObject::tr("The patched data doesn't match the checksums");
+        return false;
+    }
+    return true;
+}
+
+static bool applyNative(QHexEditDocument & document, PatchInput & in, PatchSink & sink, QString & error)
+{
+    char magic[sizeof(NATIVE_MAGIC) - 1];
+    quint64 version, sourceSize, targetSize;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, NATIVE_MAGIC, sizeof(magic)) != 0 ||
+        !in.readLittleEndian(version, 4) || version != NATIVE_VERSION ||
+        !in.readLittleEndian(sourceSize, 8) || !in.readLittleEndian(targetSize, 8))
+    {
+        error = QObject::tr("Not a QHexEdit patch");
+        return false;
+    }
+    const QHexEditData & data = document.data();
+    if (sourceSize != data.size())
+    {
+        error = QObject::tr("The patch is for data of another size");
+        return false;
+    }
+
+    for (;;)
+    {
+        char type;
+        quint64 pos, len;
+        if (!in.read(&type, 1)) {
+            break;
+        }
+        if (type == 0)
+        {
+            if (data.size() != targetSize)
+            {
+                error = QObject::tr("The patch doesn't fit the data");
+                return false;
+            }
+            return true;
+        }
+        if (!in.readLittleEndian(pos, 8) || !in.readLittleEndian(len, 8)) {
+            break;
+        }
+
+        const EditJournal::Op op = static_cast<EditJournal::Op>(type);
+        if (op == EditJournal::Remove)
+        {
+            if (!sink.edit(op, pos, len, QByteArray())) {
+                return false;
+            }
+            continue;
+        }
+        if (op != EditJournal::Insert && op != EditJournal::Replace)
+        {
+            error = QObject::tr("The patch is damaged");
+            return false;
+        }
+
+        // large payloads are applied in chunks
+        QByteArray bytes;
+        quint64 i = 0;
+        for (; i < len; i += bytes.size())
+        {
+            if (!in.read(bytes, std::min<quint64>(PATCH_CHUNK_SIZE, len - i))) {
+                break;
+            }
+            if (!sink.edit(op, pos + i, bytes.size(), bytes)) {
+                return false;
+            }
+        }
+        if (i < len) {
+            break;
+        }
+    }
+    error = QObject::tr("The patch is truncated");
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BinaryPatch implementation:
+bool BinaryPatch::formatOf(const QString & fileName, Format & format)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "ips") {
+        format = Ips;
+    } else if (suffix == "bps") {
+        format = Bps;
+    } else if (suffix == "qhp") {
+        format = Native;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool BinaryPatch::write(const QHexEditData & data, QIODevice & device, Format format, QString * errorString)
+{
+    if (!data.original())
+    {
+        if (errorString) {
+            *errorString = QObject::tr("The original content isn't known");
+        }
+        return false;
+    }
+
+    PatchOutput out(device);
+    QString error;
+    bool ok = false;
+    switch (format)
+    {
+    case Ips:
+        ok = writeIps(data, out, error);
+        break;
+    case Bps:
+        ok = writeBps(data, out);
+        break;
+    case Native:
+        ok = writeNative(data, out);
+        break;
+    }
+    if (ok && !out.flush()) {
+        error = device.errorString();
+        ok = false;
+    }
+    if (!ok && errorString) {
+        *errorString = error;
+    }
+    return ok;
+}
+
+bool BinaryPatch::apply(QHexEditDocument & document, QIODevice & device, Format format, QString * errorString)
+{
+    PatchInput in(device);
+    DocumentSink sink(document);
+    QString error;
+    bool ok = false;
+
+    document.undoStack()->beginMacro(QObject::tr("Apply patch"));
+    switch (format)
+    {
+    case Ips:
+        ok = applyIps(document, in, sink, error);
+        break;
+    case Bps:
+        ok = applyBps(document, device, in, sink, error);
+        break;
+    case Native:
+        ok = applyNative(document, in, sink, error);
+        break;
+    }
+    document.undoStack()->endMacro();
+
+    // a patch is applied completely or not at all, and a failed one isn't
+    // left to be redone
+    if (!ok)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+        // QUndoStack drops an obsolete command without undoing it
+        QUndoStack * stack = document.undoStack();
+        QUndoCommand * patch = const_cast<QUndoCommand *>(stack->command(stack->index() - 1));
+        patch->undo();
+        patch->setObsolete(true);
+#endif
+        document.undo();
+        if (errorString) {
+            *errorString = sink.error().isEmpty() ? error : sink.error();
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,49 @@
+#ifndef BINARYPATCH_H
+#define BINARYPATCH_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+#include "qhexeditdata.h"
+#include "qhexeditdocument.h"
+
+/*! BinaryPatch exports the edits of a QHexEditData as a patch and applies
+patches to a QHexEditDocument. The formats are IPS, BPS (with the CRC-32 of
+the source, the target and the patch) and a native format of replace, insert
+and remove records with offset, length and payload (.qhp).
+
+A patch is made from QHexEditData::origins(), the runs of unchanged and of
+changed bytes, so its cost grows with the number of edits. Only the changed
+bytes are read, except for BPS, whose checksums cover the whole source and
+target.
+
+A patch is applied while it is read, as one undo macro of replace, insert and
+remove commands. Nothing is copied for backends with spans, so patches work
+on images of any size. If a patch doesn't fit the data or a checksum doesn't
+match, the macro is undone.
+*/
+class BinaryPatch
+{
+public:
+    enum Format
+    {
+        Ips,
+        Bps,
+        Native
+    };
+
+    // the format of a file name (.ips, .bps, .qhp), false for others
+    static bool formatOf(const QString & fileName, Format & format);
+
+    // writes the edits of data since it was loaded (see QHexEditData::original())
+    static bool write(const QHexEditData & data, QIODevice & device, Format format, QString * errorString = nullptr);
+
+    // applies a patch as one undo step. A patch which fails is rolled back
+    // and doesn't stay on the undo stack (with Qt 5.9 and later).
+    static bool apply(QHexEditDocument & document, QIODevice & device, Format format, QString * errorString = nullptr);
+};
+
+/** \endcond docNever */
+
+#endif // BINARYPATCH_H
@@ -0,0 +1,72 @@
+#ifndef BITSCAN_H
+#define BITSCAN_H
+
+/** \cond docNever */
+
+#include <QtGlobal>
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Helpers of the background engines, which classify bytes into bitmaps of
+// one bit per byte and then scan the bitmaps for runs.
+
+inline int trailingZeros(quint64 word)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int count = 0;
+    for (; (word & 1) == 0; word >>= 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+// the first position in [from, limit), whose bit has the value set, or limit
+inline size_t findBit(const quint64 * bits, size_t from, size_t limit, bool set)
+{
+    while (from < limit)
+    {
+        const size_t index = from >> 6;
+        quint64 word = set ? bits[index] : ~bits[index];
+        word &= ~quint64(0) << (from & 63);
+        if (word != 0) {
+            return std::min(limit, (index << 6) + trailingZeros(word));
+        }
+        from = (index + 1) << 6;
+    }
+    return limit;
+}
+
+// printable ASCII or a tab
+inline bool isPrintable(uchar c)
+{
+    return (c >= 0x20 && c < 0x7f) || c == '\t';
+}
+
+#ifdef __SSE2__
+// 0xff for the bytes of x, which are printable, see isPrintable()
+inline __m128i printableBytes(__m128i x)
+{
+    // bytes from 0x80 are negative and fail the first compare
+    const __m128i low = _mm_set1_epi8(0x1f);
+    const __m128i high = _mm_set1_epi8(0x7f);
+    const __m128i tab = _mm_set1_epi8('\t');
+    return _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(x, low), _mm_cmplt_epi8(x, high)), _mm_cmpeq_epi8(x, tab));
+}
+
+// sets the bits of the 16 bytes at position i, whose bytes in hits are set
+inline void setBits(quint64 * bits, size_t i, __m128i hits)
+{
+    bits[i >> 6] |= quint64(_mm_movemask_epi8(hits)) << (i & 63);
+}
+#endif
+
+/** \endcond docNever */
+
+#endif // BITSCAN_H
@@ -0,0 +1,322 @@
+#include "checksums.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CRC32_CLMUL
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// CRC-32 implementation:
+const quint32 CRC32_POLY = 0xedb88320u;         // reflected 0x04c11db7
+
+struct Crc32Tables
+{
+    quint32 slice[8][256];
+    quint32 x2n[32];
+};
+
+// a * b modulo the polynomial, in the reflected bit order
+static quint32 multModP(quint32 a, quint32 b)
+{
+    quint32 m = quint32(1) << 31;
+    quint32 p = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32_POLY : b >> 1;
+    }
+    return p;
+}
+
+static const Crc32Tables & crc32Tables()
+{
+    static const Crc32Tables tables = [] {
+        Crc32Tables t;
+        for (quint32 i = 0; i < 256; i++)
+        {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (c >> 1) ^ CRC32_POLY : c >> 1;
+            }
+            t.slice[0][i] = c;
+        }
+        for (int i = 0; i < 256; i++) {
+            for (int s = 1; s < 8; s++) {
+                t.slice[s][i] = (t.slice[s - 1][i] >> 8) ^ t.slice[0][t.slice[s - 1][i] & 0xff];
+            }
+        }
+        // x^(2^n) modulo the polynomial, needed to shift a CRC over zeros
+        t.x2n[0] = quint32(1) << 30;
+        for (int n = 1; n < 32; n++) {
+            t.x2n[n] = multModP(t.x2n[n - 1], t.x2n[n - 1]);
+        }
+        return t;
+    }();
+    return tables;
+}
+
+static quint32 crc32Slice(quint32 crc, const uchar * p, size_t len)
+{
+    const Crc32Tables & t = crc32Tables();
+    for (; len >= 8; p += 8, len -= 8)
+    {
+        quint32 lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo = qFromLittleEndian(lo) ^ crc;
+        hi = qFromLittleEndian(hi);
+        crc = t.slice[7][lo & 0xff] ^ t.slice[6][(lo >> 8) & 0xff] ^
+              t.slice[5][(lo >> 16) & 0xff] ^ t.slice[4][lo >> 24] ^
+              t.slice[3][hi & 0xff] ^ t.slice[2][(hi >> 8) & 0xff] ^
+              t.slice[1][(hi >> 16) & 0xff] ^ t.slice[0][hi >> 24];
+    }
+    for (; len > 0; p++, len--) {
+        crc = (crc >> 8) ^ t.slice[0][(crc ^ *p) & 0xff];
+    }
+    return crc;
+}
+
+#ifdef CRC32_CLMUL
+// folding constants and Barrett reduction after "Fast CRC Computation for
+// Generic Polynomials Using PCLMULQDQ Instruction" (Intel), len >= 64 and a
+// multiple of 16, crc is the inverted state
+__attribute__((target("sse4.1,pclmul")))
+static quint32 crc32Clmul(quint32 crc, const uchar * buf, size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + 0x00));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    buf += 64;
+    len -= 64;
+
+    while (len >= 64)
+    {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + 0x30)));
+        buf += 64;
+        len -= 64;
+    }
+
+    // fold the four lanes into one
+    __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+    while (len >= 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf)));
+        buf += 16;
+        len -= 16;
+    }
+
+    // fold 128 to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return _mm_extract_epi32(x1, 1);
+}
+
+static bool hasClmul()
+{
+    static const bool supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+#endif
+
+quint32 crc32Update(quint32 crc, const uchar * data, size_t len)
+{
+    crc = ~crc;
+#ifdef CRC32_CLMUL
+    if (len >= 64 && hasClmul())
+    {
+        const size_t n = len & ~size_t(15);
+        crc = crc32Clmul(crc, data, n);
+        data += n;
+        len -= n;
+    }
+#endif
+    return ~crc32Slice(crc, data, len);
+}
+
+quint32 crc32Combine(quint32 crc1, quint32 crc2, quint64 len2)
+{
+    const Crc32Tables & t = crc32Tables();
+    quint32 p = quint32(1) << 31;
+    for (unsigned k = 3; len2 != 0; len2 >>= 1, k++)
+    {
+        if (len2 & 1) {
+            p = multModP(t.x2n[k & 31], p);
+        }
+    }
+    return multModP(p, crc1) ^ crc2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// XxHash64 implementation:
+const quint64 XXH_PRIME1 = 0x9e3779b185ebca87ull;
+const quint64 XXH_PRIME2 = 0xc2b2ae3d27d4eb4full;
+const quint64 XXH_PRIME3 = 0x165667b19e3779f9ull;
+const quint64 XXH_PRIME4 = 0x85ebca77c2b2ae63ull;
+const quint64 XXH_PRIME5 = 0x27d4eb2f165667c5ull;
+
+static inline quint64 rotl64(quint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline quint64 xxhRound(quint64 acc, quint64 input)
+{
+    acc += input * XXH_PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+static inline quint64 xxhMergeRound(quint64 acc, quint64 value)
+{
+    acc ^= xxhRound(0, value);
+    return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+XxHash64::XxHash64(quint64 seed)
+{
+    reset(seed);
+}
+
+void XxHash64::reset(quint64 seed)
+{
+    _v[0] = seed + XXH_PRIME1 + XXH_PRIME2;
+    _v[1] = seed + XXH_PRIME2;
+    _v[2] = seed;
+    _v[3] = seed - XXH_PRIME1;
+    _seed = seed;
+    _total = 0;
+    _bufferSize = 0;
+}
+
+void XxHash64::addData(const uchar * data, size_t len)
+{
+    _total += len;
+    if (_bufferSize + len < sizeof(_buffer))
+    {
+        memcpy(_buffer + _bufferSize, data, len);
+        _bufferSize += len;
+        return;
+    }
+
+    if (_bufferSize > 0)
+    {
+        const size_t fill = sizeof(_buffer) - _bufferSize;
+        memcpy(_buffer + _bufferSize, data, fill);
+        consume(_buffer);
+        data += fill;
+        len -= fill;
+        _bufferSize = 0;
+    }
+
+    for (; len >= sizeof(_buffer); data += sizeof(_buffer), len -= sizeof(_buffer)) {
+        consume(data);
+    }
+    memcpy(_buffer, data, len);
+    _bufferSize = len;
+}
+
+quint64 XxHash64::result() const
+{
+    quint64 h;
+    if (_total >= sizeof(_buffer))
+    {
+        h = rotl64(_v[0], 1) + rotl64(_v[1], 7) + rotl64(_v[2], 12) + rotl64(_v[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = xxhMergeRound(h, _v[i]);
+        }
+    }
+    else
+    {
+        h = _seed + XXH_PRIME5;
+    }
+    h += _total;
+
+    const uchar * p = _buffer;
+    size_t len = _bufferSize;
+    for (; len >= 8; p += 8, len -= 8)
+    {
+        quint64 k;
+        memcpy(&k, p, sizeof(k));
+        h ^= xxhRound(0, qFromLittleEndian(k));
+        h = rotl64(h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+    if (len >= 4)
+    {
+        quint32 k;
+        memcpy(&k, p, sizeof(k));
+        h ^= quint64(qFromLittleEndian(k)) * XXH_PRIME1;
+        h = rotl64(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+        len -= 4;
+    }
+    for (; len > 0; p++, len--)
+    {
+        h ^= *p * XXH_PRIME5;
+        h = rotl64(h, 11) * XXH_PRIME1;
+    }
+
+    // avalanche
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+void XxHash64::consume(const uchar * stripe)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        quint64 k;
+        memcpy(&k, stripe + 8 * i, sizeof(k));
+        _v[i] = xxhRound(_v[i], qFromLittleEndian(k));
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef CHECKSUMS_H
+#define CHECKSUMS_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+/*! CRC-32 (ISO-HDLC, as used by zlib, PNG and zip). crc32Update() continues
+crc with the bytes of data, start with 0. On x86 CPUs with PCLMULQDQ the
+bulk is folded with carry-less multiplications, otherwise slicing-by-8
+tables are used.
+*/
+quint32 crc32Update(quint32 crc, const uchar * data, size_t len);
+
+/*! The CRC-32 of the concatenation of two byte sequences, computed from their
+CRCs and the length of the second one in O(log(len2)).
+*/
+quint32 crc32Combine(quint32 crc1, quint32 crc2, quint64 len2);
+
+/*! XxHash64 computes the 64 bit xxHash (XXH64) of a byte stream, which may be
+passed in arbitrary portions.
+*/
+class XxHash64
+{
+public:
+    explicit XxHash64(quint64 seed = 0);
+
+    void reset(quint64 seed = 0);
+    void addData(const uchar * data, size_t len);
+    quint64 result() const;
+
+private:
+    void consume(const uchar * stripe);
+
+    quint64 _v[4];
+    quint64 _seed;
+    quint64 _total;
+    uchar _buffer[32];
+    size_t _bufferSize;
+};
+
+/** \endcond docNever */
+
+#endif // CHECKSUMS_H
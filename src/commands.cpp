@@ -1,26 +1,124 @@
 #include "commands.h"
+#include "editjournal.h"
+
+// reports an applied action to the widget, the observers and to the journal
+// of the data
+static void applied(QHexEditData & data, EditJournal::Op op, size_t pos, size_t len)
+{
+    data.addChange(pos, len, op != EditJournal::Replace);
+
+    for (QHexEditDataObserver * observer : data.observers())
+    {
+        if (op == EditJournal::Insert) {
+            observer->inserted(pos, len);
+        } else if (op == EditJournal::Remove) {
+            observer->removed(pos, len);
+        }
+    }
+
+    EditJournal * journal = data.journal();
+    if (!journal) {
+        return;
+    }
+
+    if (op == EditJournal::Remove) {
+        journal->record(op, pos, len);
+    } else {
+        journal->record(op, pos, len, data.range(pos, len));
+    }
+}
 
 CharCommand::CharCommand(QHexEditData & data, Cmd cmd, size_t charPos, char newChar, QUndoCommand * parent)
     : QUndoCommand(parent),
       _data(data),
       _charPos(charPos),
-      _newChar(newChar),
+      _len(1),
+      _newChars(1, newChar),
       _cmd(cmd)
 { }
 
 bool CharCommand::mergeWith(const QUndoCommand *command)
 {
     const CharCommand *nextCommand = static_cast<const CharCommand *>(command);
-    bool result = false;
+    const size_t pos = nextCommand->_charPos;
+    const size_t end = _charPos + _len;
 
     if (_cmd != remove &&
         nextCommand->_cmd == replace &&
-        nextCommand->_charPos == _charPos)
+        pos >= _charPos && pos < end)
+    {   // overwrite a char of the range, e.g. the second nibble
+        _newChars[int(pos - _charPos)] = nextCommand->_newChars[0];
+        return true;
+    }
+
+    if (_cmd == replace && nextCommand->_cmd == replace)
     {
-        _newChar = nextCommand->_newChar;
-        result = true;
+        if (pos == end)
+        {   // overwrite forward
+            _newChars.append(nextCommand->_newChars);
+            _oldChars.append(nextCommand->_oldChars);
+            _wasChanged.append(nextCommand->_wasChanged);
+            _len++;
+            return true;
+        }
+        if (pos + 1 == _charPos)
+        {   // backspace in overwrite mode
+            _newChars.prepend(nextCommand->_newChars);
+            _oldChars.prepend(nextCommand->_oldChars);
+            _wasChanged.prepend(nextCommand->_wasChanged);
+            _charPos = pos;
+            _len++;
+            return true;
+        }
+    }
+
+    if (_cmd == insert && nextCommand->_cmd == insert &&
+        pos >= _charPos && pos <= end)
+    {   // typing in insert mode
+        _newChars.insert(int(pos - _charPos), nextCommand->_newChars);
+        _len++;
+        return true;
+    }
+
+    if (_cmd == insert && nextCommand->_cmd == remove &&
+        pos >= _charPos && pos < end)
+    {   // backspace over just inserted chars
+        _newChars.remove(int(pos - _charPos), 1);
+        _len--;
+        discardIfEmpty();
+        return true;
+    }
+
+    if (_cmd == remove && nextCommand->_cmd == remove)
+    {
+        if (pos == _charPos)
+        {   // delete forward
+            _oldChars.append(nextCommand->_oldChars);
+            _wasChanged.append(nextCommand->_wasChanged);
+            _len++;
+            return true;
+        }
+        if (pos + 1 == _charPos)
+        {   // backspace in insert mode
+            _oldChars.prepend(nextCommand->_oldChars);
+            _wasChanged.prepend(nextCommand->_wasChanged);
+            _charPos = pos;
+            _len++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CharCommand::discardIfEmpty()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    // QUndoStack drops an obsolete command after the merge
+    if (_len == 0) {
+        setObsolete(true);
     }
-    return result;
+#endif
 }
 
 void CharCommand::undo()
@@ -28,15 +126,18 @@ void CharCommand::undo()
     switch (_cmd)
     {
         case insert:
-            _data.remove(_charPos, 1);
+            _data.remove(_charPos, _len);
+            applied(_data, EditJournal::Remove, _charPos, _len);
             break;
         case replace:
-            _data.replace(_charPos, _oldChar);
+            _data.replace(_charPos, _oldChars);
             _data.setDataChanged(_charPos, _wasChanged);
+            applied(_data, EditJournal::Replace, _charPos, _oldChars.length());
             break;
         case remove:
-            _data.insert(_charPos, _oldChar);
+            _data.insert(_charPos, _oldChars);
             _data.setDataChanged(_charPos, _wasChanged);
+            applied(_data, EditJournal::Insert, _charPos, _oldChars.length());
             break;
     }
 }
@@ -46,66 +147,263 @@ void CharCommand::redo()
     switch (_cmd)
     {
         case insert:
-            _data.insert(_charPos, _newChar);
+            if (_len == 1) {
+                _data.insert(_charPos, static_cast<u_int8_t>(_newChars[0]));
+            } else if (_len > 1) {
+                _data.insert(_charPos, _newChars);
+            }
+            applied(_data, EditJournal::Insert, _charPos, _len);
             break;
         case replace:
-            _oldChar = static_cast<char>(_data.at(_charPos));
-            _wasChanged = _data.dataChanged(_charPos);
-            _data.replace(_charPos, _newChar);
+            _oldChars = _data.range(_charPos, _len);
+            _wasChanged = _data.dataChanged(_charPos, _len);
+            if (_len == 1) {
+                _data.replace(_charPos, static_cast<u_int8_t>(_newChars[0]));
+            } else {
+                _data.replace(_charPos, _newChars);
+            }
+            applied(_data, EditJournal::Replace, _charPos, _len);
             break;
         case remove:
-            _oldChar = static_cast<char>(_data.at(_charPos));
-            _wasChanged = _data.dataChanged(_charPos);
-            _data.remove(_charPos, 1);
+            _oldChars = _data.range(_charPos, _len);
+            _wasChanged = _data.dataChanged(_charPos, _len);
+            _data.remove(_charPos, _len);
+            applied(_data, EditJournal::Remove, _charPos, _len);
             break;
     }
 }
 
 
 
-ArrayCommand::ArrayCommand(QHexEditData & data, Cmd cmd, size_t baPos, QByteArray newBa, size_t len, QUndoCommand * parent)
+ArrayCommand::ArrayCommand(QHexEditData & data, UndoStore & store, Cmd cmd, size_t baPos, QByteArray newBa,
+                           size_t len, QUndoCommand * parent)
     : QUndoCommand(parent),
       _data(data),
       _cmd(cmd),
       _baPos(baPos),
       _len(len),
-      _newBa(newBa)
+      _wasChanged(store),
+      _newBa(store, newBa),
+      _oldBa(store)
 { }
 
 void ArrayCommand::undo()
 {
+    // a payload, which can't be read back, would corrupt the data. The
+    // document drops the history, which doesn't fit the data any more.
+    QByteArray oldBa;
+    QByteArray wasChanged;
+    if (_cmd != insert && (!_oldBa.data(oldBa) || !_wasChanged.data(wasChanged)))
+    {
+        qWarning("ArrayCommand: undo history lost, undo refused");
+        return;
+    }
+
     switch (_cmd)
     {
         case insert:
             _data.remove(_baPos, _newBa.length());
+            applied(_data, EditJournal::Remove, _baPos, _newBa.length());
             break;
         case replace:
-            _data.replace(_baPos, _oldBa);
-            _data.setDataChanged(_baPos, _wasChanged);
+            _data.replace(_baPos, oldBa);
+            _data.setDataChanged(_baPos, wasChanged);
+            applied(_data, EditJournal::Replace, _baPos, _oldBa.length());
             break;
         case remove:
-            _data.insert(_baPos, _oldBa);
-            _data.setDataChanged(_baPos, _wasChanged);
+            _data.insert(_baPos, oldBa);
+            _data.setDataChanged(_baPos, wasChanged);
+            applied(_data, EditJournal::Insert, _baPos, _oldBa.length());
             break;
     }
 }
 
 void ArrayCommand::redo()
 {
+    QByteArray newBa;
+    if (_cmd != remove && !_newBa.data(newBa))
+    {
+        qWarning("ArrayCommand: undo history lost, redo refused");
+        return;
+    }
+
     switch (_cmd)
     {
         case insert:
-            _data.insert(_baPos, _newBa);
+            _data.insert(_baPos, newBa);
+            applied(_data, EditJournal::Insert, _baPos, _newBa.length());
             break;
         case replace:
-            _oldBa = _data.range(_baPos, _len);
-            _wasChanged = _data.dataChanged(_baPos, _len);
-            _data.replace(_baPos, _newBa);
+            _oldBa.setData(_data.range(_baPos, _len));
+            _wasChanged.setData(_data.dataChanged(_baPos, _len));
+            _data.replace(_baPos, newBa);
+            applied(_data, EditJournal::Replace, _baPos, _newBa.length());
             break;
         case remove:
-            _oldBa = _data.range(_baPos, _len);
-            _wasChanged = _data.dataChanged(_baPos, _len);
+            _oldBa.setData(_data.range(_baPos, _len));
+            _wasChanged.setData(_data.dataChanged(_baPos, _len));
+            _data.remove(_baPos, _len);
+            applied(_data, EditJournal::Remove, _baPos, _len);
+            break;
+    }
+}
+
+
+
+SpanCommand::SpanCommand(QHexEditData & data, Cmd cmd, size_t baPos, QByteArray newBa, size_t len,
+                         QUndoCommand * parent)
+    : QUndoCommand(parent),
+      _data(data),
+      _cmd(cmd),
+      _mergeable(false),
+      _baPos(baPos),
+      _len(len),
+      _newBa(newBa)
+{ }
+
+void SpanCommand::setMergeable(bool mergeable)
+{
+    _mergeable = mergeable;
+}
+
+size_t SpanCommand::length() const
+{
+    if (_cmd == ArrayCommand::remove) {
+        return _len;
+    }
+    return PieceTable::size(_newSpans);
+}
+
+bool SpanCommand::mergeWith(const QUndoCommand *command)
+{
+    const SpanCommand *nextCommand = static_cast<const SpanCommand *>(command);
+    const size_t pos = nextCommand->_baPos;
+    const size_t len = nextCommand->length();
+    const size_t end = _baPos + length();
+
+    if (_cmd != ArrayCommand::remove &&
+        nextCommand->_cmd == ArrayCommand::replace &&
+        pos >= _baPos && pos + len <= end)
+    {   // overwrite inside the range, e.g. the second nibble
+        const size_t offset = pos - _baPos;
+        _newSpans = PieceTable::insert(PieceTable::remove(_newSpans, offset, len), offset, nextCommand->_newSpans);
+        return true;
+    }
+
+    if (_cmd == ArrayCommand::replace && nextCommand->_cmd == ArrayCommand::replace)
+    {
+        if (pos == end)
+        {   // overwrite forward
+            _newSpans = PieceTable::merge(_newSpans, nextCommand->_newSpans);
+            _oldSpans = PieceTable::merge(_oldSpans, nextCommand->_oldSpans);
+            return true;
+        }
+        if (pos + len == _baPos)
+        {   // backspace in overwrite mode
+            _newSpans = PieceTable::merge(nextCommand->_newSpans, _newSpans);
+            _oldSpans = PieceTable::merge(nextCommand->_oldSpans, _oldSpans);
+            _baPos = pos;
+            return true;
+        }
+    }
+
+    if (_cmd == ArrayCommand::insert && nextCommand->_cmd == ArrayCommand::insert &&
+        pos >= _baPos && pos <= end)
+    {   // typing in insert mode
+        _newSpans = PieceTable::insert(_newSpans, pos - _baPos, nextCommand->_newSpans);
+        return true;
+    }
+
+    if (_cmd == ArrayCommand::insert && nextCommand->_cmd == ArrayCommand::remove &&
+        pos >= _baPos && pos + len <= end)
+    {   // backspace over just inserted bytes
+        _newSpans = PieceTable::remove(_newSpans, pos - _baPos, len);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+        if (!_newSpans) {
+            setObsolete(true);
+        }
+#endif
+        return true;
+    }
+
+    if (_cmd == ArrayCommand::remove && nextCommand->_cmd == ArrayCommand::remove)
+    {
+        if (pos == _baPos)
+        {   // delete forward
+            _oldSpans = PieceTable::merge(_oldSpans, nextCommand->_oldSpans);
+            _len += len;
+            return true;
+        }
+        if (pos + len == _baPos)
+        {   // backspace in insert mode
+            _oldSpans = PieceTable::merge(nextCommand->_oldSpans, _oldSpans);
+            _baPos = pos;
+            _len += len;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SpanCommand::undo()
+{
+    switch (_cmd)
+    {
+        case ArrayCommand::insert:
+            _data.remove(_baPos, PieceTable::size(_newSpans));
+            applied(_data, EditJournal::Remove, _baPos, PieceTable::size(_newSpans));
+            break;
+        case ArrayCommand::replace:
+            _data.remove(_baPos, PieceTable::size(_newSpans));
+            _data.insertSpans(_baPos, _oldSpans);
+            applied(_data, EditJournal::Replace, _baPos, PieceTable::size(_oldSpans));
+            break;
+        case ArrayCommand::remove:
+            _data.insertSpans(_baPos, _oldSpans);
+            applied(_data, EditJournal::Insert, _baPos, PieceTable::size(_oldSpans));
+            break;
+    }
+}
+
+void SpanCommand::redo()
+{
+    const size_t available = _baPos < _data.size() ? _data.size() - _baPos : 0;
+    switch (_cmd)
+    {
+        case ArrayCommand::insert:
+            insertNew(_newBa.length());
+            applied(_data, EditJournal::Insert, _baPos, PieceTable::size(_newSpans));
+            break;
+        case ArrayCommand::replace:
+        {
+            // like ArrayCommand, the length of the new bytes counts
+            const size_t len = _newSpans ? PieceTable::size(_newSpans)
+                                         : std::min(static_cast<size_t>(_newBa.length()), available);
+            _oldSpans = _data.spans(_baPos, len);
+            _data.remove(_baPos, len);
+            insertNew(len);
+            applied(_data, EditJournal::Replace, _baPos, len);
+            break;
+        }
+        case ArrayCommand::remove:
+            _len = std::min(_len, available);
+            _oldSpans = _data.spans(_baPos, _len);
             _data.remove(_baPos, _len);
+            applied(_data, EditJournal::Remove, _baPos, _len);
             break;
     }
 }
+
+void SpanCommand::insertNew(size_t len)
+{
+    if (_newSpans) {
+        _data.insertSpans(_baPos, _newSpans);
+        return;
+    }
+
+    // the bytes are copied into the backend once, afterwards the spans are used
+    _data.insert(_baPos, _newBa.left(static_cast<int>(len)));
+    _newSpans = _data.spans(_baPos, len);
+    _newBa = QByteArray();
+}
@@ -7,6 +7,7 @@
 
 //#include "xbytearray.h"
 #include "qhexeditdata.h"
+#include "undostore.h"
 
 /*! CharCommand is a class to prived undo/redo functionality in QHexEdit.
 A QUndoCommand represents a single editing action on a document. CharCommand
@@ -20,6 +21,10 @@ the user to execute a undo command contation e.g. 3 steps in a single command.
 If you for example insert a new byt "34" this means for the editor doing 3
 steps: insert a "00", replace it with "03" and the replace it with "34". These
 3 steps are combined into a single step, insert a "34".
+
+Beyond that, a CharCommand covers a growing range of chars. Typing (insert or
+overwrite), backspacing and deleting at consecutive positions are merged into
+one command, so a typed hex string is a single undo step.
 */
 class CharCommand : public QUndoCommand
 {
@@ -36,23 +41,28 @@ public:
     int id() const { return Id; }
 
 private:
+    void discardIfEmpty();
+
     QHexEditData & _data;
-    size_t _charPos;
-    bool _wasChanged;
-    char _newChar;
-    char _oldChar;
+    size_t _charPos;                    // first char of the range
+    size_t _len;                        // chars in the range
+    QByteArray _wasChanged;
+    QByteArray _newChars;
+    QByteArray _oldChars;
     Cmd _cmd;
 };
 
 /*! ArrayCommand provides undo/redo functionality for handling binary strings. It
 can undo/redo insert, replace and remove binary strins (QByteArrays).
+The byte arrays are held as payloads of an UndoStore, which keeps the memory
+of the undo history within a budget.
 */
 class ArrayCommand : public QUndoCommand
 {
 public:
     enum Cmd {insert, remove, replace};
-    ArrayCommand(QHexEditData & data, Cmd cmd, size_t baPos, QByteArray newBa = QByteArray(), size_t len = 0,
-                 QUndoCommand * parent = 0);
+    ArrayCommand(QHexEditData & data, UndoStore & store, Cmd cmd, size_t baPos, QByteArray newBa = QByteArray(),
+                 size_t len = 0, QUndoCommand * parent = 0);
     void undo();
     void redo();
 
@@ -61,9 +71,46 @@ private:
     Cmd _cmd;
     size_t _baPos;
     size_t _len;
-    QByteArray _wasChanged;
-    QByteArray _newBa;
-    QByteArray _oldBa;
+    UndoPayload _wasChanged;
+    UndoPayload _newBa;
+    UndoPayload _oldBa;
+};
+
+/*! SpanCommand provides the actions of ArrayCommand for backends, which support
+spans (see QHexEditData::hasSpans()). Instead of copies of the bytes it keeps
+the spans of the removed and of the inserted data. Its size doesn't depend on
+the amount of changed bytes and undo/redo run in O(log n) without copying data.
+
+Commands for single chars can be made mergeable. Like CharCommand they then
+grow into one range command while the user types, backspaces or deletes at
+consecutive positions.
+*/
+class SpanCommand : public QUndoCommand
+{
+public:
+    enum { Id = 1235 };
+    typedef ArrayCommand::Cmd Cmd;
+    SpanCommand(QHexEditData & data, Cmd cmd, size_t baPos, QByteArray newBa = QByteArray(), size_t len = 0,
+                QUndoCommand * parent = 0);
+    void undo();
+    void redo();
+    bool mergeWith(const QUndoCommand *command);
+    int id() const { return _mergeable ? int(Id) : -1; }
+
+    void setMergeable(bool mergeable);
+
+private:
+    void insertNew(size_t len);
+    size_t length() const;
+
+    QHexEditData & _data;
+    Cmd _cmd;
+    bool _mergeable;
+    size_t _baPos;
+    size_t _len;
+    QByteArray _newBa;                  // released after the first redo
+    QHexEditData::Spans _newSpans;
+    QHexEditData::Spans _oldSpans;
 };
 
 /** \endcond docNever */
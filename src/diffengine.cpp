@@ -0,0 +1,649 @@
+#include "diffengine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const size_t PIECE_SIZE = 4 * 1024 * 1024;      // bytes per task and side
+const size_t MAX_TRIM_SIZE = 4 * 1024 * 1024;   // head and tail of a replaced region
+const size_t MIN_EQUAL_RUN = 8;                 // shorter equal runs are folded
+const size_t ANCHOR_WINDOW = 64;                // bytes in the rolling hash
+const size_t MIN_ANCHOR_DISTANCE = 256;
+const quint64 ANCHOR_MASK = 0xfff0000000000000ull;  // one anchor per 4 KiB on average
+const int POLL_INTERVAL = 5;                    // ms, while waiting for tasks
+
+// random values of the gear hash, the same ones in every run
+static const quint64 * gearTable()
+{
+    static const struct Table
+    {
+        quint64 values[256];
+        Table()
+        {
+            quint64 state = 0x9e3779b97f4a7c15ull;
+            for (int i = 0; i < 256; i++)
+            {
+                // splitmix64
+                quint64 z = (state += 0x9e3779b97f4a7c15ull);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+                values[i] = z ^ (z >> 31);
+            }
+        }
+    } table;
+    return table.values;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DiffResults implementation:
+/*! DiffResults collects the anchors and differences found by the tasks. It is
+shared between the engine and the tasks, so a task which finishes after the
+engine was cancelled or deleted doesn't write into freed memory.
+*/
+class DiffResults
+{
+public:
+    struct Anchor
+    {
+        size_t pos;                     // behind the window
+        quint64 hash;
+    };
+
+    DiffResults() : _finished(0) { }
+
+    void add(int side, const std::vector<Anchor> & anchors)
+    {
+        QMutexLocker locker(&_mutex);
+        _anchors[side].insert(_anchors[side].end(), anchors.begin(), anchors.end());
+        _finished++;
+    }
+
+    void add(const std::vector<DiffRange> & differences)
+    {
+        QMutexLocker locker(&_mutex);
+        _differences.insert(_differences.end(), differences.begin(), differences.end());
+        _finished++;
+    }
+
+    int takeFinished()
+    {
+        QMutexLocker locker(&_mutex);
+        const int finished = _finished;
+        _finished = 0;
+        return finished;
+    }
+
+    std::vector<Anchor> takeAnchors(int side)
+    {
+        QMutexLocker locker(&_mutex);
+        std::vector<Anchor> anchors;
+        anchors.swap(_anchors[side]);
+        return anchors;
+    }
+
+    std::vector<DiffRange> takeDifferences()
+    {
+        QMutexLocker locker(&_mutex);
+        std::vector<DiffRange> differences;
+        differences.swap(_differences);
+        return differences;
+    }
+
+private:
+    QMutex _mutex;
+    std::vector<Anchor> _anchors[2];
+    std::vector<DiffRange> _differences;
+    int _finished;
+};
+
+/*! AnchorTask searches the anchors of one piece. The bytes start up to
+ANCHOR_WINDOW - 1 bytes in front of the piece, so the hash at its first byte
+is the same as in a scan from the start.
+*/
+class AnchorTask : public QRunnable
+{
+public:
+    AnchorTask(const std::shared_ptr<DiffResults> & results, int side, const QHexEditData::Snapshot & snapshot,
+               size_t start, size_t pos, size_t len) :
+        _results(results),
+        _side(side),
+        _snapshot(snapshot),
+        _start(start),
+        _pos(pos),
+        _len(len)
+    { }
+
+    void run()
+    {
+        const QByteArray bytes = _snapshot->range(_start, _pos + _len - _start);
+        _snapshot.reset();
+
+        const quint64 * gear = gearTable();
+        const uchar * data = reinterpret_cast<const uchar *>(bytes.constData());
+        const size_t len = bytes.size();
+
+        std::vector<DiffResults::Anchor> anchors;
+        quint64 hash = 0;
+        size_t next = _pos;             // no anchor before
+        for (size_t i = 0; i < len; i++)
+        {
+            // after 64 bytes, the older ones are shifted out
+            hash = (hash << 1) + gear[data[i]];
+            const size_t pos = _start + i + 1;
+            if (pos > next && (hash & ANCHOR_MASK) == 0)
+            {
+                DiffResults::Anchor anchor;
+                anchor.pos = pos;
+                anchor.hash = hash;
+                anchors.push_back(anchor);
+                next = pos + MIN_ANCHOR_DISTANCE;
+            }
+        }
+        _results->add(_side, anchors);
+    }
+
+private:
+    std::shared_ptr<DiffResults> _results;
+    int _side;
+    QHexEditData::Snapshot _snapshot;
+    size_t _start;
+    size_t _pos;
+    size_t _len;
+};
+
+/*! CompareTask compares a piece of equal size on both sides. */
+class CompareTask : public QRunnable
+{
+public:
+    CompareTask(const std::shared_ptr<DiffResults> & results, const QHexEditData::Snapshot & a, size_t posA,
+                const QHexEditData::Snapshot & b, size_t posB, size_t len) :
+        _results(results),
+        _a(a),
+        _posA(posA),
+        _b(b),
+        _posB(posB),
+        _len(len)
+    { }
+
+    void run()
+    {
+        const QByteArray bytesA = _a->range(_posA, _len);
+        const QByteArray bytesB = _b->range(_posB, _len);
+        _a.reset();
+        _b.reset();
+
+        const uchar * a = reinterpret_cast<const uchar *>(bytesA.constData());
+        const uchar * b = reinterpret_cast<const uchar *>(bytesB.constData());
+        const size_t len = std::min(bytesA.size(), bytesB.size());
+
+        std::vector<DiffRange> differences;
+        size_t i = 0;
+        for (;;)
+        {
+            i += DiffEngine::mismatch(a + i, b + i, len - i);
+            if (i == len) {
+                break;
+            }
+
+            // the difference ends at the next long enough equal run
+            const size_t start = i;
+            for (;;)
+            {
+                i += DiffEngine::match(a + i, b + i, len - i);
+                if (i == len) {
+                    break;
+                }
+                const size_t run = DiffEngine::mismatch(a + i, b + i, std::min(len - i, MIN_EQUAL_RUN));
+                if (run == MIN_EQUAL_RUN || i + run == len) {
+                    break;
+                }
+                i += run;
+            }
+
+            DiffRange range;
+            range.posA = _posA + start;
+            range.lenA = i - start;
+            range.posB = _posB + start;
+            range.lenB = i - start;
+            differences.push_back(range);
+        }
+        _results->add(differences);
+    }
+
+private:
+    std::shared_ptr<DiffResults> _results;
+    QHexEditData::Snapshot _a;
+    size_t _posA;
+    QHexEditData::Snapshot _b;
+    size_t _posB;
+    size_t _len;
+};
+
+/*! TrimTask reports a region of different sizes as one replacement, without
+the common head and tail. Of large regions only MAX_TRIM_SIZE bytes at both
+ends are compared.
+*/
+class TrimTask : public QRunnable
+{
+public:
+    TrimTask(const std::shared_ptr<DiffResults> & results, const DiffRange & region,
+             const QHexEditData::Snapshot & a, const QHexEditData::Snapshot & b) :
+        _results(results),
+        _region(region),
+        _a(a),
+        _b(b)
+    { }
+
+    void run()
+    {
+        const size_t lenA = std::min(_region.lenA, MAX_TRIM_SIZE);
+        const size_t lenB = std::min(_region.lenB, MAX_TRIM_SIZE);
+        const QByteArray headA = _a->range(_region.posA, lenA);
+        const QByteArray headB = _b->range(_region.posB, lenB);
+        const QByteArray tailA = lenA == _region.lenA ? headA : _a->range(_region.posA + _region.lenA - lenA, lenA);
+        const QByteArray tailB = lenB == _region.lenB ? headB : _b->range(_region.posB + _region.lenB - lenB, lenB);
+        _a.reset();
+        _b.reset();
+
+        const size_t shorter = std::min(_region.lenA, _region.lenB);
+        const size_t head = DiffEngine::mismatch(reinterpret_cast<const uchar *>(headA.constData()),
+                                                 reinterpret_cast<const uchar *>(headB.constData()),
+                                                 std::min<size_t>(headA.size(), headB.size()));
+
+        const char * endA = tailA.constData() + tailA.size();
+        const char * endB = tailB.constData() + tailB.size();
+        const size_t maxTail = std::min<size_t>(std::min<size_t>(tailA.size(), tailB.size()), shorter - head);
+        size_t tail = 0;
+        while (tail < maxTail && endA[-1 - static_cast<ptrdiff_t>(tail)] == endB[-1 - static_cast<ptrdiff_t>(tail)]) {
+            tail++;
+        }
+
+        DiffRange range = _region;
+        range.posA += head;
+        range.posB += head;
+        range.lenA -= head + tail;
+        range.lenB -= head + tail;
+        _results->add(std::vector<DiffRange>(1, range));
+    }
+
+private:
+    std::shared_ptr<DiffResults> _results;
+    DiffRange _region;
+    QHexEditData::Snapshot _a;
+    QHexEditData::Snapshot _b;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// DiffEngine implementation:
+DiffEngine::DiffEngine(QObject * parent) :
+    QObject(parent),
+    _a(nullptr),
+    _b(nullptr),
+    _results(std::make_shared<DiffResults>()),
+    _running(false),
+    _scanning(false),
+    _inFlight(0),
+    _total(0),
+    _done(0),
+    _progress(0)
+{
+    _feedTimer.setSingleShot(true);
+    connect(&_feedTimer, SIGNAL(timeout()), this, SLOT(feed()));
+}
+
+DiffEngine::~DiffEngine()
+{ }
+
+void DiffEngine::setData(QHexEditData * a, QHexEditData * b)
+{
+    cancel();
+    _a = a;
+    _b = b;
+    _differences.clear();
+}
+
+bool DiffEngine::isRunning() const
+{
+    return _running;
+}
+
+const std::vector<DiffRange> & DiffEngine::differences() const
+{
+    return _differences;
+}
+
+size_t DiffEngine::findDifference(size_t pos, Side side) const
+{
+    // the differences don't overlap, so their ends are sorted too
+    return std::partition_point(_differences.begin(), _differences.end(), [pos, side](const DiffRange & range)
+    {
+        return (side == SideA ? range.posA + range.lenA : range.posB + range.lenB) <= pos;
+    }) - _differences.begin();
+}
+
+size_t DiffEngine::mapAddress(size_t pos, Side from) const
+{
+    // the last difference starting at or before pos
+    const auto it = std::partition_point(_differences.begin(), _differences.end(), [pos, from](const DiffRange & range)
+    {
+        return (from == SideA ? range.posA : range.posB) <= pos;
+    });
+    if (it == _differences.begin()) {
+        return pos;
+    }
+
+    const DiffRange & range = *(it - 1);
+    const size_t start = from == SideA ? range.posA : range.posB;
+    const size_t len = from == SideA ? range.lenA : range.lenB;
+    const size_t otherStart = from == SideA ? range.posB : range.posA;
+    const size_t otherLen = from == SideA ? range.lenB : range.lenA;
+    if (pos < start + len) {
+        return otherStart + std::min(pos - start, otherLen > 0 ? otherLen - 1 : 0);
+    }
+    return otherStart + otherLen + (pos - start - len);
+}
+
+size_t DiffEngine::mismatch(const uchar * a, const uchar * b, size_t len)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= len; i += 16)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xffff;
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i + 8 <= len; i += 8)
+    {
+        quint64 x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        if (x != y) {
+            break;
+        }
+    }
+    for (; i < len && a[i] == b[i]; i++) { }
+    return i;
+}
+
+size_t DiffEngine::match(const uchar * a, const uchar * b, size_t len)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= len; i += 16)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < len && a[i] != b[i]; i++) { }
+    return i;
+}
+
+void DiffEngine::start()
+{
+    cancel();
+    if (!_a || !_b) {
+        return;
+    }
+
+    // the sides are compared as they are now, later edits start over
+    _running = true;
+    _snapshotA = _a->snapshot();
+    _snapshotB = _b->snapshot();
+    const size_t sizeA = _snapshotA->size();
+    const size_t sizeB = _snapshotB->size();
+    if (sizeA == sizeB)
+    {
+        _scanning = false;
+        addRegion(0, sizeA, 0, sizeB);
+    }
+    else
+    {
+        // the regions are known after the anchors
+        _scanning = true;
+        for (size_t pos = 0; pos < sizeA; pos += PIECE_SIZE)
+        {
+            const Piece piece = { Piece::ScanA, pos, std::min(PIECE_SIZE, sizeA - pos), 0, 0 };
+            _todo.enqueue(piece);
+        }
+        for (size_t pos = 0; pos < sizeB; pos += PIECE_SIZE)
+        {
+            const Piece piece = { Piece::ScanB, 0, 0, pos, std::min(PIECE_SIZE, sizeB - pos) };
+            _todo.enqueue(piece);
+        }
+        _total = sizeA + sizeB;
+    }
+    feed();
+}
+
+void DiffEngine::cancel()
+{
+    // results of running tasks are dropped with the old queue
+    _results = std::make_shared<DiffResults>();
+    _feedTimer.stop();
+    _todo.clear();
+    _inFlight = 0;
+    _total = 0;
+    _done = 0;
+    _progress = 0;
+    _running = false;
+    _scanning = false;
+    _differences.clear();
+    _snapshotA.reset();
+    _snapshotB.reset();
+}
+
+void DiffEngine::feed()
+{
+    collect();
+
+    const int maxInFlight = 2 * std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    size_t fed = 0;
+    while (!_todo.isEmpty() && _inFlight < maxInFlight)
+    {
+        const Piece piece = _todo.dequeue();
+        QRunnable * task = nullptr;
+        switch (piece.kind)
+        {
+            case Piece::ScanA:
+            case Piece::ScanB:
+            {
+                const bool sideA = piece.kind == Piece::ScanA;
+                const size_t pos = sideA ? piece.posA : piece.posB;
+                const size_t len = sideA ? piece.lenA : piece.lenB;
+                const size_t start = pos - std::min(pos, ANCHOR_WINDOW - 1);
+                task = new AnchorTask(_results, sideA ? SideA : SideB, sideA ? _snapshotA : _snapshotB, start, pos, len);
+                fed += len;
+                break;
+            }
+            case Piece::Compare:
+                task = new CompareTask(_results, _snapshotA, piece.posA, _snapshotB, piece.posB, piece.lenA);
+                fed += piece.lenA + piece.lenB;
+                break;
+            case Piece::Trim:
+            {
+                const DiffRange region = { piece.posA, piece.lenA, piece.posB, piece.lenB };
+                task = new TrimTask(_results, region, _snapshotA, _snapshotB);
+                fed += 2 * (std::min(piece.lenA, MAX_TRIM_SIZE) + std::min(piece.lenB, MAX_TRIM_SIZE));
+                break;
+            }
+        }
+        QThreadPool::globalInstance()->start(task);
+        _inFlight++;
+    }
+
+    _done += fed;
+    const int percent = _total > 0 ? static_cast<int>(std::min<quint64>(99, 100 * _done / _total)) : 0;
+    if (percent != _progress)
+    {
+        _progress = percent;
+        emit progress(_progress);
+    }
+
+    if (_todo.isEmpty() && _inFlight == 0)
+    {
+        if (!_scanning)
+        {
+            finish();
+            return;
+        }
+        alignAnchors();
+    }
+
+    // go on immediately if there is room for more work, otherwise wait a bit
+    _feedTimer.start(!_todo.isEmpty() && _inFlight < maxInFlight ? 0 : POLL_INTERVAL);
+}
+
+void DiffEngine::collect()
+{
+    _inFlight -= _results->takeFinished();
+}
+
+void DiffEngine::alignAnchors()
+{
+    _scanning = false;
+
+    // only anchors, which are unique on both sides, are matched
+    std::vector<DiffResults::Anchor> anchorsA = _results->takeAnchors(SideA);
+    std::vector<DiffResults::Anchor> anchorsB = _results->takeAnchors(SideB);
+    const size_t duplicate = std::numeric_limits<size_t>::max();
+    std::unordered_map<quint64, size_t> unique;
+    unique.reserve(anchorsB.size());
+    for (const DiffResults::Anchor & anchor : anchorsB)
+    {
+        const auto result = unique.insert(std::make_pair(anchor.hash, anchor.pos));
+        if (!result.second) {
+            result.first->second = duplicate;
+        }
+    }
+
+    std::unordered_map<quint64, size_t> countA;
+    countA.reserve(anchorsA.size());
+    for (const DiffResults::Anchor & anchor : anchorsA) {
+        countA[anchor.hash]++;
+    }
+
+    std::vector<std::pair<size_t, size_t> > matches;
+    for (const DiffResults::Anchor & anchor : anchorsA)
+    {
+        const auto it = unique.find(anchor.hash);
+        if (it != unique.end() && it->second != duplicate && countA[anchor.hash] == 1) {
+            matches.push_back(std::make_pair(anchor.pos, it->second));
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+
+    // the longest chain with increasing positions in B (patience sorting)
+    std::vector<int> tails;                 // last match of the chains by length
+    std::vector<int> previous(matches.size(), -1);
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        const auto it = std::lower_bound(tails.begin(), tails.end(), matches[i].second, [&matches](int index, size_t pos)
+        {
+            return matches[index].second < pos;
+        });
+        if (it != tails.begin()) {
+            previous[i] = *(it - 1);
+        }
+        if (it == tails.end()) {
+            tails.push_back(i);
+        } else {
+            *it = i;
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t> > chain;
+    for (int i = tails.empty() ? -1 : tails.back(); i >= 0; i = previous[i]) {
+        chain.push_back(matches[i]);
+    }
+    std::reverse(chain.begin(), chain.end());
+
+    size_t posA = 0;
+    size_t posB = 0;
+    for (const std::pair<size_t, size_t> & anchor : chain)
+    {
+        addRegion(posA, anchor.first - posA, posB, anchor.second - posB);
+        posA = anchor.first;
+        posB = anchor.second;
+    }
+    addRegion(posA, _snapshotA->size() - posA, posB, _snapshotB->size() - posB);
+}
+
+void DiffEngine::addRegion(size_t posA, size_t lenA, size_t posB, size_t lenB)
+{
+    if (lenA == lenB)
+    {
+        for (size_t offset = 0; offset < lenA; offset += PIECE_SIZE)
+        {
+            const size_t len = std::min(PIECE_SIZE, lenA - offset);
+            const Piece piece = { Piece::Compare, posA + offset, len, posB + offset, len };
+            _todo.enqueue(piece);
+        }
+        _total += lenA + lenB;
+    }
+    else if (lenA == 0 || lenB == 0)
+    {
+        // pure insertion or removal, nothing to read
+        const DiffRange range = { posA, lenA, posB, lenB };
+        _differences.push_back(range);
+    }
+    else
+    {
+        const Piece piece = { Piece::Trim, posA, lenA, posB, lenB };
+        _todo.enqueue(piece);
+        _total += 2 * (std::min(lenA, MAX_TRIM_SIZE) + std::min(lenB, MAX_TRIM_SIZE));
+    }
+}
+
+void DiffEngine::finish()
+{
+    std::vector<DiffRange> differences = _results->takeDifferences();
+    differences.insert(differences.end(), _differences.begin(), _differences.end());
+    std::sort(differences.begin(), differences.end(), [](const DiffRange & x, const DiffRange & y)
+    {
+        return x.posA < y.posA || (x.posA == y.posA && x.posB < y.posB);
+    });
+
+    // neighbours, which are separated by a short equal run, are joined
+    _differences.clear();
+    for (const DiffRange & range : differences)
+    {
+        if (range.lenA == 0 && range.lenB == 0) {
+            continue;
+        }
+        if (!_differences.empty())
+        {
+            DiffRange & last = _differences.back();
+            const size_t gapA = range.posA - (last.posA + last.lenA);
+            const size_t gapB = range.posB - (last.posB + last.lenB);
+            if (gapA == gapB && gapA < MIN_EQUAL_RUN)
+            {
+                last.lenA = range.posA + range.lenA - last.posA;
+                last.lenB = range.posB + range.lenB - last.posB;
+                continue;
+            }
+        }
+        _differences.push_back(range);
+    }
+
+    _running = false;
+    _snapshotA.reset();
+    _snapshotB.reset();
+    _progress = 100;
+    emit progress(_progress);
+    emit finished();
+}
@@ -0,0 +1,122 @@
+#ifndef DIFFENGINE_H
+#define DIFFENGINE_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+#include <memory>
+#include <vector>
+
+#include "qhexeditdata.h"
+
+class DiffResults;
+
+/*! DiffRange is one difference between the data A and B: the bytes
+[posA, posA + lenA) of A are replaced by [posB, posB + lenB) of B. Bytes were
+changed where both lengths are equal, removed where lenB is shorter and
+inserted where lenA is shorter.
+*/
+struct DiffRange
+{
+    size_t posA, lenA;
+    size_t posB, lenB;
+};
+
+/*! DiffEngine compares two QHexEditData in the background.
+
+Data of equal size is compared byte by byte with SIMD instructions. If the
+sizes differ, both sides are first split into regions at anchors, which are
+found by a rolling hash over 64 bytes (content defined, so they move along
+with inserted or removed bytes). Anchors, which occur exactly once on both
+sides, are matched and the longest monotone chain of matches aligns the data.
+Matched regions of equal size are compared byte by byte, the other ones are
+trimmed by their common head and tail and reported as one replacement.
+
+start() takes snapshots of both sides, the tasks of the global QThreadPool
+read, scan and compare them while the data may be edited. Short equal runs
+are folded into the surrounding difference, which keeps the result small for
+unrelated data.
+*/
+class DiffEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Side
+    {
+        SideA,
+        SideB
+    };
+
+    explicit DiffEngine(QObject * parent = 0);
+    ~DiffEngine();
+
+    // both have to outlive the engine or be reset
+    void setData(QHexEditData * a, QHexEditData * b);
+
+    bool isRunning() const;
+    const std::vector<DiffRange> & differences() const;
+
+    // index of the first difference, which ends behind pos on side
+    size_t findDifference(size_t pos, Side side) const;
+    // the position on the other side, which corresponds to pos
+    size_t mapAddress(size_t pos, Side from) const;
+
+    // index of the first differing byte or len
+    static size_t mismatch(const uchar * a, const uchar * b, size_t len);
+    // index of the first equal byte or len
+    static size_t match(const uchar * a, const uchar * b, size_t len);
+
+public slots:
+    void start();
+    void cancel();
+
+signals:
+    void progress(int percent);
+    void finished();
+
+private slots:
+    void feed();
+
+private:
+    DiffEngine(const DiffEngine & other) = delete;
+    DiffEngine & operator=(const DiffEngine & other) = delete;
+
+    struct Piece                        // a part of the data to read
+    {
+        enum Kind
+        {
+            ScanA,                      // anchors of [posA, posA + lenA)
+            ScanB,                      // anchors of [posB, posB + lenB)
+            Compare,                    // equal sizes, byte by byte
+            Trim                        // different sizes, head and tail
+        } kind;
+        size_t posA, lenA;
+        size_t posB, lenB;
+    };
+
+    void collect();
+    void alignAnchors();
+    void addRegion(size_t posA, size_t lenA, size_t posB, size_t lenB);
+    void finish();
+
+    QHexEditData * _a;
+    QHexEditData * _b;
+    QHexEditData::Snapshot _snapshotA;  // the compared versions
+    QHexEditData::Snapshot _snapshotB;
+    std::shared_ptr<DiffResults> _results;
+    bool _running;
+    bool _scanning;                     // anchors are searched, else compared
+    QQueue<Piece> _todo;
+    int _inFlight;
+    quint64 _total, _done;              // bytes to read and read
+    int _progress;
+    std::vector<DiffRange> _differences;
+
+    QTimer _feedTimer;
+};
+
+/** \endcond docNever */
+
+#endif // DIFFENGINE_H
@@ -0,0 +1,208 @@
+#include <QAction>
+#include <QScrollBar>
+#include <QVBoxLayout>
+
+#include <algorithm>
+
+#include "diffview.h"
+
+const int COMPARE_DELAY = 500;          // ms after the last edit
+
+////////////////////////////////////////////////////////////////////////////////
+// DiffHighlighter implementation:
+/** \cond docNever */
+/*! DiffHighlighter colours the differences of one side of a DiffEngine. */
+class DiffHighlighter : public QHexEditHighlighter
+{
+public:
+    DiffHighlighter(const DiffEngine & engine, DiffEngine::Side side) :
+        _engine(engine),
+        _side(side)
+    { }
+
+    void highlight(size_t begin, size_t end, QColor * colors) const
+    {
+        static const QColor changed(0xff, 0xb0, 0xb0);
+        static const QColor unmatched(0xb0, 0xe8, 0xb0);
+
+        const std::vector<DiffRange> & differences = _engine.differences();
+        for (size_t i = _engine.findDifference(begin, _side); i < differences.size(); i++)
+        {
+            const DiffRange & range = differences[i];
+            const size_t pos = _side == DiffEngine::SideA ? range.posA : range.posB;
+            const size_t len = _side == DiffEngine::SideA ? range.lenA : range.lenB;
+            if (pos >= end) {
+                break;
+            }
+
+            // the bytes beyond the length of the other side were inserted or removed
+            const size_t common = std::min(range.lenA, range.lenB);
+            const size_t last = std::min(pos + len, end);
+            for (size_t p = std::max(pos, begin); p < last; p++) {
+                colors[p - begin] = p - pos < common ? changed : unmatched;
+            }
+        }
+    }
+
+private:
+    const DiffEngine & _engine;
+    DiffEngine::Side _side;
+};
+/** \endcond docNever */
+
+////////////////////////////////////////////////////////////////////////////////
+// DiffView implementation:
+DiffView::DiffView(QWidget * parent) :
+    QWidget(parent),
+    _current(-1),
+    _syncing(false)
+{
+    _editA = new QHexEdit;
+    _editB = new QHexEdit;
+    _splitter = new QSplitter(Qt::Horizontal);
+    _splitter->addWidget(_editA);
+    _splitter->addWidget(_editB);
+    _status = new QLabel;
+
+    QVBoxLayout * layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(_splitter);
+    layout->addWidget(_status);
+
+    _highlighterA.reset(new DiffHighlighter(_engine, DiffEngine::SideA));
+    _highlighterB.reset(new DiffHighlighter(_engine, DiffEngine::SideB));
+    _editA->addHighlighter(_highlighterA.get());
+    _editB->addHighlighter(_highlighterB.get());
+
+    connect(_editA->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(scrolledA()));
+    connect(_editB->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(scrolledB()));
+    connect(&_engine, SIGNAL(progress(int)), this, SLOT(progress(int)));
+    connect(&_engine, SIGNAL(finished()), this, SLOT(finished()));
+
+    _compareTimer.setSingleShot(true);
+    _compareTimer.setInterval(COMPARE_DELAY);
+    connect(&_compareTimer, SIGNAL(timeout()), this, SLOT(compare()));
+    connect(_editA, SIGNAL(dataChanged()), &_compareTimer, SLOT(start()));
+    connect(_editB, SIGNAL(dataChanged()), &_compareTimer, SLOT(start()));
+
+    QAction * nextAct = new QAction(tr("Next Difference"), this);
+    nextAct->setShortcut(Qt::Key_F8);
+    nextAct->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(nextAct, SIGNAL(triggered()), this, SLOT(nextDifference()));
+    addAction(nextAct);
+
+    QAction * previousAct = new QAction(tr("Previous Difference"), this);
+    previousAct->setShortcut(Qt::SHIFT + Qt::Key_F8);
+    previousAct->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(previousAct, SIGNAL(triggered()), this, SLOT(previousDifference()));
+    addAction(previousAct);
+}
+
+DiffView::~DiffView()
+{
+    // the panes may paint until they are deleted by QWidget
+    _editA->removeHighlighter(_highlighterA.get());
+    _editB->removeHighlighter(_highlighterB.get());
+}
+
+void DiffView::setData(std::unique_ptr<QHexEditData> a, std::unique_ptr<QHexEditData> b)
+{
+    _engine.setData(nullptr, nullptr);
+    _editA->setData(std::move(a));
+    _editB->setData(std::move(b));
+    _engine.setData(&_editA->data(), &_editB->data());
+    compare();
+}
+
+QHexEdit * DiffView::editA() const
+{
+    return _editA;
+}
+
+QHexEdit * DiffView::editB() const
+{
+    return _editB;
+}
+
+const std::vector<DiffRange> & DiffView::differences() const
+{
+    return _engine.differences();
+}
+
+void DiffView::compare()
+{
+    _compareTimer.stop();
+    _current = -1;
+    _status->setText(tr("Comparing..."));
+    _engine.start();
+    _editA->updateHighlighting();
+    _editB->updateHighlighting();
+}
+
+void DiffView::nextDifference()
+{
+    if (!_engine.isRunning() && _current + 1 < static_cast<int>(_engine.differences().size())) {
+        showDifference(_current + 1);
+    }
+}
+
+void DiffView::previousDifference()
+{
+    if (!_engine.isRunning() && _current > 0) {
+        showDifference(_current - 1);
+    }
+}
+
+void DiffView::finished()
+{
+    const int count = static_cast<int>(_engine.differences().size());
+    if (count == 0) {
+        _status->setText(tr("No differences"));
+    } else {
+        _status->setText(tr("%1 differences").arg(count));
+    }
+
+    _editA->updateHighlighting();
+    _editB->updateHighlighting();
+    emit compared(count);
+}
+
+void DiffView::progress(int percent)
+{
+    if (_engine.isRunning()) {
+        _status->setText(tr("Comparing... %1%").arg(percent));
+    }
+}
+
+void DiffView::scrolledA()
+{
+    if (_syncing) {
+        return;
+    }
+    _syncing = true;
+    _editB->setTopAddress(_engine.mapAddress(_editA->topAddress(), DiffEngine::SideA));
+    _syncing = false;
+}
+
+void DiffView::scrolledB()
+{
+    if (_syncing) {
+        return;
+    }
+    _syncing = true;
+    _editA->setTopAddress(_engine.mapAddress(_editB->topAddress(), DiffEngine::SideB));
+    _syncing = false;
+}
+
+void DiffView::showDifference(int index)
+{
+    _current = index;
+    const DiffRange & range = _engine.differences()[index];
+
+    // both panes go to their own side of the difference
+    _syncing = true;
+    _editA->gotoAddress(range.posA);
+    _editB->gotoAddress(range.posB);
+    _syncing = false;
+    _status->setText(tr("Difference %1 of %2").arg(index + 1).arg(_engine.differences().size()));
+}
@@ -0,0 +1,81 @@
+#ifndef DIFFVIEW_H
+#define DIFFVIEW_H
+
+#include <QLabel>
+#include <QSplitter>
+#include <QWidget>
+
+#include <memory>
+
+#include "qhexedit.h"
+#include "diffengine.h"
+
+class DiffHighlighter;
+
+/*! DiffView shows two data side by side and marks their differences.
+
+Both panes are QHexEdit widgets, which scroll together: the other pane keeps
+the corresponding address at its top, also when bytes were inserted or
+removed. Changed bytes are painted in red, bytes which exist only on one side
+in green. nextDifference() and previousDifference() (F8 and Shift+F8) move
+both cursors to the neighbouring difference. The comparison runs in the
+background and is repeated shortly after the data of a pane was edited.
+*/
+class DiffView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DiffView(QWidget * parent = 0);
+    ~DiffView();
+
+    /*! Sets the data of both panes and starts to compare them. */
+    void setData(std::unique_ptr<QHexEditData> a, std::unique_ptr<QHexEditData> b);
+
+    /*! Returns the left pane. */
+    QHexEdit * editA() const;
+
+    /*! Returns the right pane. */
+    QHexEdit * editB() const;
+
+    /*! Returns the differences of the last comparison. */
+    const std::vector<DiffRange> & differences() const;
+
+public slots:
+    /*! Compares the data of both panes again. */
+    void compare();
+
+    /*! Moves both cursors to the next difference. */
+    void nextDifference();
+
+    /*! Moves both cursors to the previous difference. */
+    void previousDifference();
+
+signals:
+    /*! The signal is emited, when a comparison is finished.
+    \param differences Amount of differing ranges
+    */
+    void compared(int differences);
+
+private slots:
+    void finished();
+    void progress(int percent);
+    void scrolledA();
+    void scrolledB();
+
+private:
+    void showDifference(int index);
+
+    QSplitter * _splitter;
+    QHexEdit * _editA;
+    QHexEdit * _editB;
+    QLabel * _status;
+    DiffEngine _engine;
+    std::unique_ptr<DiffHighlighter> _highlighterA;
+    std::unique_ptr<DiffHighlighter> _highlighterB;
+    QTimer _compareTimer;                   // collects edits before comparing
+    int _current;                           // index of the shown difference
+    bool _syncing;
+};
+
+#endif // DIFFVIEW_H
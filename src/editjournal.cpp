@@ -0,0 +1,308 @@
+#include "editjournal.h"
+#include "qhexeditdata.h"
+
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+const char JOURNAL_MAGIC[4] = { 'Q', 'H', 'E', 'J' };
+const quint32 JOURNAL_VERSION = 1;
+const int JOURNAL_HEADER_SIZE = 4 + 4 + 8 + 8;      // magic, version, size, stamp
+const quint8 RECORD_TAG = 0xa5;
+const int RECORD_HEADER_SIZE = 1 + 1 + 8 + 8 + 4;   // tag, op, pos, len, payload length
+
+static bool syncFile(QFile & file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// JournalWriter implementation:
+class JournalWriter : public QThread
+{
+public:
+    explicit JournalWriter(QFile & file);
+
+    void enqueue(const QByteArray & record);
+    bool sync();
+    void stop();
+
+protected:
+    void run();
+
+private:
+    QFile & _file;
+    QMutex _mutex;
+    QWaitCondition _work;
+    QWaitCondition _synced;
+    QByteArray _pending;
+    quint64 _queuedRecords;
+    quint64 _syncedRecords;
+    bool _stop;
+    bool _failed;
+};
+
+JournalWriter::JournalWriter(QFile & file) :
+    _file(file),
+    _queuedRecords(0),
+    _syncedRecords(0),
+    _stop(false),
+    _failed(false)
+{ }
+
+void JournalWriter::enqueue(const QByteArray & record)
+{
+    QMutexLocker locker(&_mutex);
+    _pending.append(record);
+    _queuedRecords++;
+    _work.wakeOne();
+}
+
+bool JournalWriter::sync()
+{
+    QMutexLocker locker(&_mutex);
+    const quint64 target = _queuedRecords;
+    while (_syncedRecords < target && !_failed) {
+        _synced.wait(&_mutex);
+    }
+    return !_failed;
+}
+
+void JournalWriter::stop()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _stop = true;
+        _work.wakeOne();
+    }
+    wait();
+}
+
+void JournalWriter::run()
+{
+    QMutexLocker locker(&_mutex);
+    for (;;)
+    {
+        while (_pending.isEmpty() && !_stop) {
+            _work.wait(&_mutex);
+        }
+        if (_pending.isEmpty()) {
+            break;
+        }
+
+        // everything queued so far goes to disk with a single sync
+        QByteArray batch;
+        batch.swap(_pending);
+        const quint64 target = _queuedRecords;
+
+        locker.unlock();
+        const bool ok = _file.write(batch) == batch.size() && syncFile(_file);
+        locker.relock();
+
+        if (!ok && !_failed)
+        {
+            qWarning("EditJournal: cannot write %s", qPrintable(_file.fileName()));
+            _failed = true;
+        }
+        _syncedRecords = target;
+        _synced.wakeAll();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EditJournal implementation:
+EditJournal::EditJournal()
+{ }
+
+EditJournal::~EditJournal()
+{
+    close();
+}
+
+int EditJournal::open(const QString & fileName, QHexEditData & data, qint64 stamp, bool recover)
+{
+    close();
+    _file.setFileName(fileName);
+
+    int records = 0;
+    qint64 validLength = Failed;
+    if (recover && _file.exists())
+    {
+        if (!_file.open(QIODevice::ReadWrite)) {
+            return Failed;
+        }
+        validLength = replay(data, stamp, records);
+        if (validLength < 0) {
+            _file.close();
+        }
+        if (validLength == Stale) {
+            return Stale;
+        }
+    }
+
+    if (validLength < 0)
+    {
+        // start a new journal, a file without a valid header holds no edits
+        records = 0;
+        if (!_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+            return Failed;
+        }
+
+        QByteArray header(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        QDataStream stream(&header, QIODevice::WriteOnly | QIODevice::Append);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        stream << JOURNAL_VERSION << quint64(data.size()) << quint64(stamp);
+        if (_file.write(header) != header.size() || !syncFile(_file))
+        {
+            _file.close();
+            return Failed;
+        }
+        validLength = JOURNAL_HEADER_SIZE;
+    }
+
+    // a torn record at the end must not stay in front of new records
+    if (!_file.resize(validLength) || !_file.seek(validLength))
+    {
+        _file.close();
+        return Failed;
+    }
+
+    _writer.reset(new JournalWriter(_file));
+    _writer->start();
+    return records;
+}
+
+qint64 EditJournal::replay(QHexEditData & data, qint64 stamp, int & records)
+{
+    QDataStream stream(&_file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[sizeof(JOURNAL_MAGIC)];
+    quint32 version;
+    quint64 size, journalStamp;
+    if (stream.readRawData(magic, sizeof(magic)) != sizeof(magic) ||
+        memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0)
+    {
+        return Failed;
+    }
+    stream >> version >> size >> journalStamp;
+    if (stream.status() != QDataStream::Ok || version != JOURNAL_VERSION) {
+        return Failed;
+    }
+    if (size != data.size() || journalStamp != quint64(stamp)) {
+        return Stale;
+    }
+
+    // all records are applied in one pass directly to the backend
+    qint64 validLength = JOURNAL_HEADER_SIZE;
+    for (;;)
+    {
+        const QByteArray head = _file.read(RECORD_HEADER_SIZE);
+        if (head.size() != RECORD_HEADER_SIZE) {
+            break;
+        }
+
+        QDataStream headStream(head);
+        headStream.setByteOrder(QDataStream::LittleEndian);
+        quint8 tag, op;
+        quint64 pos, len;
+        quint32 payloadLength;
+        headStream >> tag >> op >> pos >> len >> payloadLength;
+        if (tag != RECORD_TAG || payloadLength > _file.bytesAvailable()) {
+            break;
+        }
+
+        const QByteArray payload = _file.read(payloadLength);
+        quint16 checksum;
+        if (payload.size() != int(payloadLength) ||
+            _file.read(reinterpret_cast<char *>(&checksum), sizeof(checksum)) != sizeof(checksum))
+        {
+            break;
+        }
+        const QByteArray record = head + payload;
+        if (qFromLittleEndian(checksum) != qChecksum(record.constData(), record.size())) {
+            break;
+        }
+
+        if (pos > data.size() || (op == Remove && len > data.size() - pos)) {
+            break;
+        }
+        switch (op)
+        {
+            case Insert:
+                data.insert(pos, payload);
+                break;
+            case Remove:
+                data.remove(pos, len);
+                break;
+            case Replace:
+                data.replace(pos, payload);
+                break;
+            default:
+                return validLength;
+        }
+
+        records++;
+        validLength = _file.pos();
+    }
+    return validLength;
+}
+
+void EditJournal::close(bool discard)
+{
+    if (_writer)
+    {
+        _writer->stop();
+        _writer.reset();
+    }
+
+    if (_file.isOpen()) {
+        _file.close();
+    }
+    if (discard && !_file.fileName().isEmpty()) {
+        _file.remove();
+    }
+}
+
+bool EditJournal::isOpen() const
+{
+    return _writer != nullptr;
+}
+
+QString EditJournal::fileName() const
+{
+    return _file.fileName();
+}
+
+void EditJournal::record(Op op, size_t pos, size_t len, const QByteArray & bytes)
+{
+    if (!_writer) {
+        return;
+    }
+
+    QByteArray record;
+    record.reserve(RECORD_HEADER_SIZE + bytes.size() + 2);
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << RECORD_TAG << quint8(op) << quint64(pos) << quint64(len) << quint32(bytes.size());
+    stream.writeRawData(bytes.constData(), bytes.size());
+    stream << qChecksum(record.constData(), record.size());
+
+    _writer->enqueue(record);
+}
+
+bool EditJournal::sync()
+{
+    return _writer ? _writer->sync() : false;
+}
@@ -0,0 +1,67 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+#include <memory>
+
+class QHexEditData;
+class JournalWriter;
+
+/*! EditJournal is an append-only log of all edits applied to a QHexEditData.
+The undo/redo commands report every action after it was applied, the
+journal serializes it and hands it to a writer thread. The writer collects
+all records which arrived while the last write was in progress and syncs them
+to disk with a single fsync (group commit), so the GUI thread never waits for
+the disk.
+
+If the editor dies, the journal can be replayed onto the unchanged original
+data with open(..., recover = true). Every record carries a checksum, a
+partially written record at the end is ignored and cut off.
+*/
+class EditJournal
+{
+public:
+    enum Op { Insert = 1, Remove = 2, Replace = 3 };
+    enum Result { Failed = -1, Stale = -2 };
+
+    EditJournal();
+    ~EditJournal();
+
+    /*! Opens the journal fileName for data. stamp identifies the original
+    (e.g. the modification time of the file). With recover, the records of an
+    existing journal are applied to data and new records are appended.
+    Otherwise a new journal is started. Returns the number of replayed records,
+    Failed on errors or Stale, if recover was asked for, but the journal was
+    written for another size or stamp. A stale journal is left untouched and
+    not opened, the caller decides about it before it is overwritten.
+    */
+    int open(const QString & fileName, QHexEditData & data, qint64 stamp, bool recover);
+
+    // syncs all records and closes the file, with discard the file is removed
+    void close(bool discard = false);
+
+    bool isOpen() const;
+    QString fileName() const;
+
+    // queues an applied edit, bytes are the new bytes for Insert and Replace
+    void record(Op op, size_t pos, size_t len, const QByteArray & bytes = QByteArray());
+
+    // blocks until all queued records are on disk
+    bool sync();
+
+private:
+    EditJournal(const EditJournal & other) = delete;
+    EditJournal & operator=(const EditJournal & other) = delete;
+
+    qint64 replay(QHexEditData & data, qint64 stamp, int & records);
+
+    QFile _file;
+    std::unique_ptr<JournalWriter> _writer;
+};
+
+/** \endcond docNever */
+
+#endif // EDITJOURNAL_H
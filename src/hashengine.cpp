@@ -0,0 +1,618 @@
+#include "hashengine.h"
+#include "checksums.h"
+
+#include <algorithm>
+
+const size_t MIN_HASH_BLOCK_SIZE = 64 * 1024;
+const size_t MAX_HASH_BLOCKS = 1024 * 1024;     // more blocks get bigger instead
+const size_t MAX_QUEUED = 32 * 1024 * 1024;     // bytes waiting for the worker
+const int POLL_INTERVAL = 5;                    // ms, while waiting for the worker
+const int RESTART_DELAY = 150;                  // ms, collects typing bursts
+
+static const int STREAM_ALGORITHMS = HashEngine::Sha1 | HashEngine::Sha256 | HashEngine::Xxh64;
+
+////////////////////////////////////////////////////////////////////////////////
+// HashWorker implementation:
+/*! HashWorker reads and hashes the segments of a run in the order they were
+queued. Segments of a run, which was replaced by a newer one, are skipped.
+*/
+class HashWorker : public QThread
+{
+public:
+    struct Item
+    {
+        quint32 job;
+        int algorithms;
+        size_t pos;
+        int block;
+        quint32 generation;
+        bool first, last;               // first and last segment of the stream
+        size_t len;
+        QHexEditData::Snapshot snapshot;
+    };
+
+    struct Result
+    {
+        quint32 job;
+        size_t pos;
+        int block;
+        quint32 generation;
+        quint32 crc;
+        bool last;
+        QMap<int, QByteArray> digests;  // filled for the last segment
+    };
+
+    HashWorker();
+
+    void enqueue(const Item & item);
+    void setJob(quint32 job);
+    QVector<Result> take();
+    size_t queuedBytes();
+    void stop();
+
+protected:
+    void run();
+
+private:
+    QMutex _mutex;
+    QWaitCondition _work;
+    QQueue<Item> _queue;
+    QVector<Result> _results;
+    size_t _queuedBytes;
+    quint32 _job;
+    bool _stop;
+};
+
+HashWorker::HashWorker() :
+    _queuedBytes(0),
+    _job(0),
+    _stop(false)
+{ }
+
+void HashWorker::enqueue(const Item & item)
+{
+    QMutexLocker locker(&_mutex);
+    _queue.enqueue(item);
+    _queuedBytes += item.len;
+    _work.wakeOne();
+}
+
+void HashWorker::setJob(quint32 job)
+{
+    QMutexLocker locker(&_mutex);
+    _job = job;
+}
+
+QVector<HashWorker::Result> HashWorker::take()
+{
+    QMutexLocker locker(&_mutex);
+    QVector<Result> results;
+    results.swap(_results);
+    return results;
+}
+
+size_t HashWorker::queuedBytes()
+{
+    QMutexLocker locker(&_mutex);
+    return _queuedBytes;
+}
+
+void HashWorker::stop()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _stop = true;
+        _work.wakeOne();
+    }
+    wait();
+}
+
+void HashWorker::run()
+{
+    QCryptographicHash sha1(QCryptographicHash::Sha1);
+    QCryptographicHash sha256(QCryptographicHash::Sha256);
+    XxHash64 xxh64;
+
+    QMutexLocker locker(&_mutex);
+    for (;;)
+    {
+        while (_queue.isEmpty() && !_stop) {
+            _work.wait(&_mutex);
+        }
+        if (_stop) {
+            break;
+        }
+
+        Item item = _queue.dequeue();
+        _queuedBytes -= item.len;
+        if (item.job != _job) {
+            continue;
+        }
+
+        locker.unlock();
+        const QByteArray bytes = item.snapshot->range(item.pos, item.len);
+        item.snapshot.reset();
+        const uchar * data = reinterpret_cast<const uchar *>(bytes.constData());
+        const size_t len = bytes.size();
+
+        Result result;
+        result.job = item.job;
+        result.pos = item.pos;
+        result.block = item.block;
+        result.generation = item.generation;
+        result.crc = crc32Update(0, data, len);
+        result.last = item.last;
+
+        if (item.algorithms & STREAM_ALGORITHMS)
+        {
+            if (item.first)
+            {
+                sha1.reset();
+                sha256.reset();
+                xxh64.reset();
+            }
+            if (item.algorithms & HashEngine::Sha1) {
+                sha1.addData(bytes);
+            }
+            if (item.algorithms & HashEngine::Sha256) {
+                sha256.addData(bytes);
+            }
+            if (item.algorithms & HashEngine::Xxh64) {
+                xxh64.addData(data, len);
+            }
+
+            if (item.last)
+            {
+                if (item.algorithms & HashEngine::Sha1) {
+                    result.digests[HashEngine::Sha1] = sha1.result();
+                }
+                if (item.algorithms & HashEngine::Sha256) {
+                    result.digests[HashEngine::Sha256] = sha256.result();
+                }
+                if (item.algorithms & HashEngine::Xxh64)
+                {
+                    QByteArray digest(8, 0);
+                    qToBigEndian(xxh64.result(), reinterpret_cast<uchar *>(digest.data()));
+                    result.digests[HashEngine::Xxh64] = digest;
+                }
+            }
+        }
+        locker.relock();
+
+        _results.append(result);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// HashEngine implementation:
+HashEngine::HashEngine(QObject * parent) :
+    QObject(parent),
+    _data(nullptr),
+    _dataSize(0),
+    _blockSize(MIN_HASH_BLOCK_SIZE),
+    _epoch(0),
+    _job(0),
+    _whole(false),
+    _pos(0),
+    _len(0),
+    _algorithms(0),
+    _nextSegment(0),
+    _pending(0),
+    _streamDone(false),
+    _ready(false),
+    _resultPos(0),
+    _resultLen(0),
+    _worker(new HashWorker())
+{
+    _worker->start(QThread::LowPriority);
+
+    _feedTimer.setSingleShot(true);
+    connect(&_feedTimer, SIGNAL(timeout()), this, SLOT(feed()));
+    _restartTimer.setSingleShot(true);
+    _restartTimer.setInterval(RESTART_DELAY);
+    connect(&_restartTimer, SIGNAL(timeout()), this, SLOT(start()));
+}
+
+HashEngine::~HashEngine()
+{
+    _worker->stop();
+}
+
+void HashEngine::setData(QHexEditData * data)
+{
+    _data = data;
+    _crcLevels.clear();
+    _crcValid.clear();
+    _generation.clear();
+    _ready = false;
+    _results.clear();
+    resize();
+
+    if (_algorithms != 0)
+    {
+        if (_whole) {
+            _len = _dataSize;
+        }
+        start();
+    }
+}
+
+void HashEngine::request(size_t pos, size_t len, int algorithms)
+{
+    _whole = false;
+    _pos = pos;
+    _len = len;
+    _algorithms = algorithms;
+    start();
+}
+
+void HashEngine::requestAll(int algorithms)
+{
+    _whole = true;
+    _pos = 0;
+    _len = _dataSize;
+    _algorithms = algorithms;
+    start();
+}
+
+bool HashEngine::isReady() const
+{
+    return _ready;
+}
+
+size_t HashEngine::resultPos() const
+{
+    return _resultPos;
+}
+
+size_t HashEngine::resultLength() const
+{
+    return _resultLen;
+}
+
+QByteArray HashEngine::result(Algorithm algorithm) const
+{
+    return _results.value(algorithm);
+}
+
+QString HashEngine::algorithmName(Algorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case Crc32:
+            return "CRC-32";
+        case Sha1:
+            return "SHA-1";
+        case Sha256:
+            return "SHA-256";
+        case Xxh64:
+            return "XXH64";
+        default:
+            return QString();
+    }
+}
+
+void HashEngine::invalidate(size_t pos, size_t len, bool sizeChanged)
+{
+    if (!_data) {
+        return;
+    }
+
+    int first = pos / _blockSize;
+    int last = (pos + len + _blockSize - 1) / _blockSize;
+    if (sizeChanged)
+    {
+        // all following bytes have moved, the last block may have lost its tail
+        resize();
+        last = _generation.size();
+        first = std::max(0, std::min(first, last - 1));
+    }
+
+    last = std::min<int>(last, _generation.size());
+    for (int block = first; block < last; block++) {
+        invalidateBlock(block);
+    }
+
+    if (_algorithms == 0) {
+        return;
+    }
+    if (_whole)
+    {
+        _len = _dataSize;
+    }
+    else if (!sizeChanged && (pos >= _pos + _len || pos + len <= _pos))
+    {
+        // the requested range is not affected
+        return;
+    }
+
+    // the running computation has read outdated bytes
+    _job++;
+    _worker->setJob(_job);
+    _feedTimer.stop();
+    _ready = false;
+    _restartTimer.start();
+}
+
+void HashEngine::start()
+{
+    _restartTimer.stop();
+    _job++;
+    _worker->setJob(_job);
+    _segments.clear();
+    _nextSegment = 0;
+    _pending = 0;
+    _partCrcs.clear();
+    _streamDigests.clear();
+    const bool stream = (_algorithms & STREAM_ALGORITHMS) != 0;
+    _streamDone = !stream;
+    _ready = false;
+    _snapshot.reset();
+    if (!_data || _algorithms == 0) {
+        return;
+    }
+
+    // the run reads one version, edits meanwhile start a new run
+    _snapshot = _data->snapshot();
+
+    // the range is cut into segments along the block borders
+    _pos = std::min(_pos, _dataSize);
+    _len = std::min(_len, _dataSize - _pos);
+    const size_t end = _pos + _len;
+    for (size_t pos = _pos; pos < end;)
+    {
+        const int block = pos / _blockSize;
+        const size_t blockEnd = std::min(size_t(block + 1) * _blockSize, _dataSize);
+        Segment segment;
+        segment.pos = pos;
+        segment.len = std::min(blockEnd, end) - pos;
+        segment.block = (pos == size_t(block) * _blockSize && segment.len == blockEnd - pos) ? block : -1;
+
+        // cached blocks are only read again for the streamed algorithms
+        if (stream || segment.block < 0 || !_crcValid[0][block]) {
+            _segments.push_back(segment);
+        }
+        pos += segment.len;
+    }
+
+    // an empty range streams one empty segment, so the digests are the ones
+    // of the empty input
+    if (stream && _segments.empty())
+    {
+        Segment segment;
+        segment.pos = _pos;
+        segment.len = 0;
+        segment.block = -1;
+        _segments.push_back(segment);
+    }
+
+    feed();
+}
+
+void HashEngine::feed()
+{
+    collect();
+    if (!_data || _algorithms == 0 || _ready) {
+        return;
+    }
+
+    const bool stream = (_algorithms & STREAM_ALGORITHMS) != 0;
+    while (_nextSegment < _segments.size() &&
+           _worker->queuedBytes() < MAX_QUEUED)
+    {
+        const Segment & segment = _segments[_nextSegment];
+        HashWorker::Item item;
+        item.job = _job;
+        item.algorithms = _algorithms;
+        item.pos = segment.pos;
+        item.block = segment.block;
+        item.generation = segment.block >= 0 ? _generation[segment.block] : 0;
+        item.first = stream && _nextSegment == 0;
+        item.last = stream && _nextSegment + 1 == _segments.size();
+        item.len = segment.len;
+        item.snapshot = _snapshot;
+        _worker->enqueue(item);
+
+        _nextSegment++;
+        _pending++;
+    }
+
+    if (_nextSegment == _segments.size() && _pending == 0)
+    {
+        finish();
+        return;
+    }
+    _feedTimer.start(_nextSegment < _segments.size() && _worker->queuedBytes() < MAX_QUEUED ? 0 : POLL_INTERVAL);
+}
+
+void HashEngine::collect()
+{
+    const QVector<HashWorker::Result> results = _worker->take();
+    for (const HashWorker::Result & result : results)
+    {
+        // block crcs stay valid even if their run was replaced
+        if (result.block >= 0 &&
+            result.block < static_cast<int>(_generation.size()) &&
+            result.generation == _generation[result.block])
+        {
+            setBlockCrc(result.block, result.crc);
+        }
+
+        if (result.job != _job) {
+            continue;
+        }
+        _pending--;
+        if (result.block < 0) {
+            _partCrcs[result.pos] = result.crc;
+        }
+        if (result.last)
+        {
+            _streamDigests = result.digests;
+            _streamDone = true;
+        }
+    }
+}
+
+void HashEngine::finish()
+{
+    _results.clear();
+    if (_algorithms & Crc32)
+    {
+        // partial segments in front and behind, the full blocks from the tree
+        const size_t end = _pos + _len;
+        const int firstBlock = (_pos + _blockSize - 1) / _blockSize;
+        const int lastBlock = end == _dataSize ? _generation.size() : end / _blockSize;
+
+        quint32 crc = 0;
+        if (firstBlock < lastBlock)
+        {
+            for (int block = firstBlock; block < lastBlock; block++)
+            {
+                if (!_crcValid[0][block])
+                {
+                    // invalidated meanwhile, a restart is pending
+                    return;
+                }
+            }
+            if (_partCrcs.contains(_pos)) {
+                crc = _partCrcs.value(_pos);
+            }
+            const size_t middle = std::min(end, size_t(lastBlock) * _blockSize) - size_t(firstBlock) * _blockSize;
+            crc = crc32Combine(crc, blocksCrc(firstBlock, lastBlock), middle);
+            const size_t tail = size_t(lastBlock) * _blockSize;
+            if (tail < end) {
+                crc = crc32Combine(crc, _partCrcs.value(tail), end - tail);
+            }
+        }
+        else
+        {
+            // no full block, at most two parts
+            for (QMap<size_t, quint32>::const_iterator it = _partCrcs.constBegin(); it != _partCrcs.constEnd(); ++it)
+            {
+                const size_t next = std::min(end, (it.key() / _blockSize + 1) * _blockSize);
+                crc = crc32Combine(crc, it.value(), next - it.key());
+            }
+        }
+
+        QByteArray digest(4, 0);
+        qToBigEndian(crc, reinterpret_cast<uchar *>(digest.data()));
+        _results[Crc32] = digest;
+    }
+    for (QMap<int, QByteArray>::const_iterator it = _streamDigests.constBegin(); it != _streamDigests.constEnd(); ++it) {
+        _results[it.key()] = it.value();
+    }
+
+    _ready = true;
+    _snapshot.reset();
+    _resultPos = _pos;
+    _resultLen = _len;
+    emit hashesReady(_resultPos, _resultLen);
+}
+
+void HashEngine::resize()
+{
+    _dataSize = _data ? _data->size() : 0;
+
+    // a new block size invalidates all cached crcs
+    size_t blockSize = MIN_HASH_BLOCK_SIZE;
+    while (_dataSize / blockSize > MAX_HASH_BLOCKS) {
+        blockSize *= 2;
+    }
+    if (blockSize != _blockSize)
+    {
+        _blockSize = blockSize;
+        _crcLevels.clear();
+        _crcValid.clear();
+        _generation.clear();
+    }
+
+    const size_t blocks = (_dataSize + _blockSize - 1) / _blockSize;
+    for (size_t block = _generation.size(); block < blocks; block++) {
+        _generation.push_back(++_epoch);
+    }
+    _generation.resize(blocks);
+
+    // the tree keeps its valid nodes, new nodes start invalid
+    size_t count = blocks;
+    size_t level = 0;
+    do
+    {
+        if (level == _crcLevels.size())
+        {
+            _crcLevels.push_back(std::vector<quint32>());
+            _crcValid.push_back(std::vector<char>());
+        }
+        _crcLevels[level].resize(count, 0);
+        _crcValid[level].resize(count, 0);
+        count = (count + 1) / 2;
+        level++;
+    } while (_crcLevels[level - 1].size() > 1);
+    _crcLevels.resize(level);
+    _crcValid.resize(level);
+}
+
+void HashEngine::setBlockCrc(int block, quint32 crc)
+{
+    _crcLevels[0][block] = crc;
+    _crcValid[0][block] = 1;
+
+    int index = block;
+    for (size_t level = 1; level < _crcLevels.size(); level++)
+    {
+        index >>= 1;
+        const size_t left = 2 * index;
+        const size_t right = left + 1;
+        const std::vector<quint32> & below = _crcLevels[level - 1];
+        const std::vector<char> & valid = _crcValid[level - 1];
+
+        if (!valid[left] || (right < below.size() && !valid[right])) {
+            break;
+        }
+        _crcLevels[level][index] = right < below.size()
+                                   ? crc32Combine(below[left], below[right], nodeLength(level - 1, right))
+                                   : below[left];
+        _crcValid[level][index] = 1;
+    }
+}
+
+void HashEngine::invalidateBlock(int block)
+{
+    _generation[block] = ++_epoch;
+    int index = block;
+    for (size_t level = 0; level < _crcValid.size() && index < static_cast<int>(_crcValid[level].size()); level++)
+    {
+        _crcValid[level][index] = 0;
+        index >>= 1;
+    }
+}
+
+size_t HashEngine::nodeLength(int level, int index) const
+{
+    const size_t begin = (size_t(index) << level) * _blockSize;
+    const size_t end = std::min(_dataSize, (size_t(index + 1) << level) * _blockSize);
+    return end - begin;
+}
+
+quint32 HashEngine::blocksCrc(int first, int last) const
+{
+    // the covering nodes from left to right, as in a segment tree
+    QVector<QPair<int, int> > left, right;
+    for (int level = 0; first < last; level++)
+    {
+        if (first & 1) {
+            left.append(qMakePair(level, first++));
+        }
+        if (last & 1) {
+            right.prepend(qMakePair(level, --last));
+        }
+        first >>= 1;
+        last >>= 1;
+    }
+
+    quint32 crc = 0;
+    left += right;
+    for (const QPair<int, int> & node : left) {
+        crc = crc32Combine(crc, _crcLevels[node.first][node.second], nodeLength(node.first, node.second));
+    }
+    return crc;
+}
@@ -0,0 +1,125 @@
+#ifndef HASHENGINE_H
+#define HASHENGINE_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+#include <memory>
+#include <vector>
+
+#include "qhexeditdata.h"
+
+class HashWorker;
+
+/*! HashEngine computes checksums of a range of QHexEditData in a background
+thread: CRC-32, SHA-1, SHA-256 and XXH64.
+
+The CRC-32 of every block of the data is kept in a tree, where each node
+holds the CRC of all blocks below it (two CRCs are combined with the length
+of the second part). An edit only invalidates the blocks it touched, so
+after typing a byte the CRC of a multi-GB file needs one block to be read
+again and O(log n) combinations. SHA and XXH64 can't be composed from parts,
+they are streamed over the whole range; their last results stay available
+until fresh ones are ready.
+
+A run reads a snapshot of the data taken when it starts, so the reading and
+the hashing both happen in a worker thread.
+*/
+class HashEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Algorithm
+    {
+        Crc32 = 0x1,
+        Sha1 = 0x2,
+        Sha256 = 0x4,
+        Xxh64 = 0x8,
+        AllAlgorithms = 0xf
+    };
+
+    explicit HashEngine(QObject * parent = 0);
+    ~HashEngine();
+
+    // starts over for data, which has to outlive the engine or be reset
+    void setData(QHexEditData * data);
+
+    // hashes [pos, pos + len) and again after every change of the range
+    void request(size_t pos, size_t len, int algorithms);
+    // hashes the whole data, also when its size changes
+    void requestAll(int algorithms);
+
+    bool isReady() const;
+    size_t resultPos() const;
+    size_t resultLength() const;
+    // the digest of the last finished run, empty if it wasn't requested
+    QByteArray result(Algorithm algorithm) const;
+
+    static QString algorithmName(Algorithm algorithm);
+
+public slots:
+    // the bytes [pos, pos + len) changed, with sizeChanged all following too
+    void invalidate(size_t pos, size_t len, bool sizeChanged);
+
+signals:
+    void hashesReady(size_t pos, size_t len);
+
+private slots:
+    void start();
+    void feed();
+
+private:
+    HashEngine(const HashEngine & other) = delete;
+    HashEngine & operator=(const HashEngine & other) = delete;
+
+    struct Segment
+    {
+        size_t pos;
+        size_t len;
+        int block;                      // -1 if it covers only a part of a block
+    };
+
+    void resize();
+    void collect();
+    void finish();
+    void setBlockCrc(int block, quint32 crc);
+    void invalidateBlock(int block);
+    size_t nodeLength(int level, int index) const;
+    quint32 blocksCrc(int first, int last) const;
+
+    QHexEditData * _data;
+    QHexEditData::Snapshot _snapshot;   // read by the running job
+    size_t _dataSize;
+    size_t _blockSize;
+    std::vector<std::vector<quint32> > _crcLevels;
+    std::vector<std::vector<char> > _crcValid;
+    std::vector<quint32> _generation;   // renewed, when a block is invalidated
+    quint32 _epoch;                     // source of unique generations
+
+    // the current run
+    quint32 _job;
+    bool _whole;
+    size_t _pos, _len;
+    int _algorithms;
+    std::vector<Segment> _segments;
+    size_t _nextSegment;
+    int _pending;                       // segments sent, but not returned
+    bool _streamDone;
+    QMap<size_t, quint32> _partCrcs;    // crcs of the partial segments
+    QMap<int, QByteArray> _streamDigests;
+
+    // the last finished run
+    bool _ready;
+    size_t _resultPos, _resultLen;
+    QMap<int, QByteArray> _results;
+
+    std::unique_ptr<HashWorker> _worker;
+    QTimer _feedTimer;
+    QTimer _restartTimer;
+};
+
+/** \endcond docNever */
+
+#endif // HASHENGINE_H
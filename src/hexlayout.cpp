@@ -0,0 +1,147 @@
+#include "hexlayout.h"
+
+#include <QFontMetrics>
+
+#include <algorithm>
+
+static int floorPowerOfTwo(int value, int max)
+{
+    int power = 1;
+    while (power * 2 <= value && power * 2 <= max) {
+        power *= 2;
+    }
+    return power;
+}
+
+HexLayout::HexLayout() :
+    bytesPerLine(DEFAULT_BYTES_PER_LINE),
+    groupSize(1),
+    lineShift(0),
+    hexChars(0),
+    charWidth(0),
+    charHeight(0),
+    xPosAdr(0),
+    xPosHex(0),
+    xPosAscii(0),
+    addressNumbers(-1),
+    addressAreaWidth(0),
+    separatorX(0),
+    hexAreaEnd(0),
+    asciiAreaEnd(0),
+    xPosInspector(0),
+    inspectorSeparatorX(0),
+    inspectorChars(0),
+    minimumWidth(0),
+    _metricsValid(false),
+    _columnsValid(false),
+    _addressArea(false),
+    _asciiArea(false)
+{ }
+
+void HexLayout::invalidate()
+{
+    _metricsValid = false;
+}
+
+void HexLayout::setBytesPerLine(int bytesPerLine)
+{
+    this->bytesPerLine = floorPowerOfTwo(bytesPerLine, MAX_BYTES_PER_LINE);
+    groupSize = std::min(groupSize, this->bytesPerLine);
+    _columnsValid = false;
+}
+
+void HexLayout::setGroupSize(int groupSize)
+{
+    this->groupSize = floorPowerOfTwo(groupSize, bytesPerLine);
+    _columnsValid = false;
+}
+
+bool HexLayout::update(const QFont & font, int addressNumbers, bool addressArea, bool asciiArea, int inspectorChars)
+{
+    if (!addressArea) {
+        addressNumbers = 0;
+    }
+    if (_metricsValid && _columnsValid &&
+        addressNumbers == this->addressNumbers &&
+        addressArea == _addressArea &&
+        asciiArea == _asciiArea &&
+        inspectorChars == this->inspectorChars)
+    {
+        return false;
+    }
+
+    if (!_metricsValid)
+    {
+        QFontMetrics metrics(font);
+        charWidth = metrics.width(QLatin1Char('9'));
+        charHeight = metrics.height();
+        _metricsValid = true;
+    }
+
+    this->addressNumbers = addressNumbers;
+    _addressArea = addressArea;
+    _asciiArea = asciiArea;
+    this->inspectorChars = inspectorChars;
+    _columnsValid = true;
+
+    lineShift = 0;
+    while ((1 << lineShift) < bytesPerLine) {
+        lineShift++;
+    }
+    // two chars per byte and a blank in front of every group but the first
+    hexChars = 2 * bytesPerLine + bytesPerLine / groupSize - 1;
+
+    xPosAdr = 0;
+    if (addressArea)
+        xPosHex = addressNumbers * charWidth + GAP_ADR_HEX;
+    else
+        xPosHex = 0;
+    xPosAscii = xPosHex + hexChars * charWidth + GAP_HEX_ASCII;
+
+    addressAreaWidth = xPosHex - GAP_ADR_HEX + charWidth / 2;
+    separatorX = xPosAscii - (GAP_HEX_ASCII / 2);
+    hexAreaEnd = xPosHex + (hexChars + 2) * charWidth;
+    asciiAreaEnd = xPosAscii + bytesPerLine * charWidth;
+
+    if (asciiArea)
+        minimumWidth = asciiAreaEnd;
+    else
+        minimumWidth = xPosHex + hexChars * charWidth;
+
+    // the inspector follows the rightmost of the other areas
+    xPosInspector = minimumWidth + GAP_HEX_ASCII;
+    inspectorSeparatorX = xPosInspector - (GAP_HEX_ASCII / 2);
+    if (inspectorChars > 0)
+        minimumWidth = xPosInspector + inspectorChars * charWidth;
+
+    // column tables, a blank belongs to the nibble in front of it
+    nibbleX.resize(2 * bytesPerLine);
+    asciiX.resize(bytesPerLine);
+    _cellNibble.resize(hexChars + 2);
+    int cell = 0;
+    for (int byte = 0; byte < bytesPerLine; byte++)
+    {
+        if (byte != 0 && (byte & (groupSize - 1)) == 0) {
+            _cellNibble[cell++] = 2 * byte - 1;
+        }
+        nibbleX[2 * byte] = xPosHex + cell * charWidth;
+        _cellNibble[cell++] = 2 * byte;
+        nibbleX[2 * byte + 1] = xPosHex + cell * charWidth;
+        _cellNibble[cell++] = 2 * byte + 1;
+        asciiX[byte] = xPosAscii + byte * charWidth;
+    }
+    for (; cell < hexChars + 2; cell++) {
+        _cellNibble[cell] = 2 * bytesPerLine - 1;
+    }
+
+    return true;
+}
+
+int HexLayout::hexColumnAt(int x) const
+{
+    if (x < xPosHex || charWidth == 0) {
+        return 0;
+    }
+    const size_t cell = (x - xPosHex) / charWidth;
+    return _cellNibble[std::min(cell, _cellNibble.size() - 1)];
+}
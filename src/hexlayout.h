@@ -0,0 +1,74 @@
+#ifndef HEXLAYOUT_H
+#define HEXLAYOUT_H
+
+/** \cond docNever */
+
+#include <QFont>
+
+#include <vector>
+
+const int GAP_ADR_HEX = 10;
+const int GAP_HEX_ASCII = 16;
+const int DEFAULT_BYTES_PER_LINE = 16;
+const int MAX_BYTES_PER_LINE = 256;
+
+/*! HexLayout holds the geometry of QHexEditPrivate: the metrics of the font,
+the x positions of the areas and of every column. Measuring glyphs is
+expensive, so the layout is only recomputed after it was invalidated (the
+font changed), when the visible areas, the columns or the width of the
+address area changed (the size of the data crossed a power of 16).
+Everything else, like painting or moving the cursor, just reads the cached
+values and tables.
+
+A line holds bytesPerLine bytes, which are shown in groups of groupSize bytes
+in the hex area. Both are powers of two, so a position is split into line
+and column with a shift and a mask.
+*/
+class HexLayout
+{
+public:
+    HexLayout();
+
+    // the font changed
+    void invalidate();
+
+    // both values are rounded down to a power of two
+    void setBytesPerLine(int bytesPerLine);
+    void setGroupSize(int groupSize);
+
+    // recomputes the layout if needed, returns true if it was recomputed
+    bool update(const QFont & font, int addressNumbers, bool addressArea, bool asciiArea, int inspectorChars = 0);
+
+    // nibble column (0 .. 2 * bytesPerLine - 1) for x inside the hex area
+    int hexColumnAt(int x) const;
+
+    int bytesPerLine;                   // bytes in a line
+    int groupSize;                      // bytes in a group
+    int lineShift;                      // log2(bytesPerLine)
+    int hexChars;                       // chars in the hex area of a line
+
+    int charWidth, charHeight;          // char dimensions
+    int xPosAdr, xPosHex, xPosAscii;    // x position of the areas
+    int addressNumbers;                 // digits in the address area
+    int addressAreaWidth;               // width of the background of the address area
+    int separatorX;                     // x position of the line in front of the ascii area
+    int hexAreaEnd, asciiAreaEnd;       // right borders of the areas
+    int xPosInspector;                  // x position of the inspector area, right of the others
+    int inspectorSeparatorX;            // x position of the line in front of it
+    int inspectorChars;                 // chars in the inspector area of a line, 0: hidden
+    int minimumWidth;
+
+    std::vector<int> nibbleX;           // x position of every nibble column in the hex area
+    std::vector<int> asciiX;            // x position of every byte column in the ascii area
+
+private:
+    std::vector<int> _cellNibble;       // nibble column of every char cell in the hex area
+    bool _metricsValid;
+    bool _columnsValid;
+    bool _addressArea;
+    bool _asciiArea;
+};
+
+/** \endcond docNever */
+
+#endif // HEXLAYOUT_H
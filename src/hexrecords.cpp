@@ -0,0 +1,446 @@
+#include "hexrecords.h"
+
+#include <cctype>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const int MAX_LINE_SIZE = 1024;         // a record has at most 255 bytes
+const size_t BYTES_PER_RECORD = 16;
+const size_t WRITE_CHUNK_SIZE = 64 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////
+// Hex digits implementation:
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+struct HexValues
+{
+    qint8 values[256];                  // -1 for other characters
+};
+
+static const HexValues & hexValues()
+{
+    static const HexValues table = [] {
+        HexValues t;
+        for (int c = 0; c < 256; c++) {
+            t.values[c] = -1;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            t.values[uchar(HEX_DIGITS[i])] = i;
+            t.values[uchar(tolower(HEX_DIGITS[i]))] = i;
+        }
+        return t;
+    }();
+    return table;
+}
+
+bool HexRecords::decodeHex(const char * src, size_t len, uchar * dst)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_set1_epi8('0' - 1);
+    const __m128i nine = _mm_set1_epi8('9' + 1);
+    const __m128i a = _mm_set1_epi8('a' - 1);
+    const __m128i f = _mm_set1_epi8('f' + 1);
+    const __m128i lowerCase = _mm_set1_epi8(0x20);
+    const __m128i digitBase = _mm_set1_epi8('0');
+    const __m128i letterBase = _mm_set1_epi8('a' - 10);
+    const __m128i lowByte = _mm_set1_epi16(0x00ff);
+    for (; i + 8 <= len; i += 8)
+    {
+        // every character is a digit or a letter a-f after setting bit 5
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+        const __m128i lower = _mm_or_si128(x, lowerCase);
+        const __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(x, zero), _mm_cmplt_epi8(x, nine));
+        const __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, a), _mm_cmplt_epi8(lower, f));
+        if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xffff) {
+            return false;
+        }
+        const __m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, _mm_sub_epi8(x, digitBase)),
+                                             _mm_and_si128(isLetter, _mm_sub_epi8(lower, letterBase)));
+
+        // the high nibble is the first character, the low byte of a word
+        const __m128i bytes = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, lowByte), 4),
+                                           _mm_srli_epi16(nibbles, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(bytes, bytes));
+    }
+#endif
+    const qint8 * values = hexValues().values;
+    for (; i < len; i++)
+    {
+        const qint8 high = values[uchar(src[2 * i])];
+        const qint8 low = values[uchar(src[2 * i + 1])];
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        dst[i] = uchar((high << 4) | low);
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reading implementation:
+/** \cond docNever */
+class RecordReader
+{
+public:
+    explicit RecordReader(HexRecords::Format format);
+
+    // false on a bad record, done() after the end record
+    bool parse(const char * line, int len);
+    bool done() const { return _done; }
+    QString error() const { return _error; }
+
+    std::vector<QHexEditData::Segment> & segments() { return _segments; }
+
+private:
+    bool parseIntelHex(const uchar * bytes, int len);
+    bool parseSRecord(char type, const uchar * bytes, int len);
+    void addData(quint64 address, const uchar * bytes, int len);
+
+    HexRecords::Format _format;
+    std::vector<QHexEditData::Segment> _segments;
+    quint64 _upperAddress;              // of Intel HEX extended address records
+    bool _done;
+    QString _error;
+};
+
+RecordReader::RecordReader(HexRecords::Format format) :
+    _format(format),
+    _upperAddress(0),
+    _done(false)
+{ }
+
+void RecordReader::addData(quint64 address, const uchar * bytes, int len)
+{
+    // consecutive records continue the last segment
+    if (_segments.empty() ||
+        _segments.back().address + _segments.back().bytes.size() != address)
+    {
+        _segments.push_back({ address, QByteArray() });
+    }
+    _segments.back().bytes.append(reinterpret_cast<const char *>(bytes), len);
+}
+
+bool RecordReader::parse(const char * line, int len)
+{
+    const char start = _format == HexRecords::IntelHex ? ':' : 'S';
+    const int prefix = _format == HexRecords::IntelHex ? 1 : 2;
+    if (len < prefix || line[0] != start || (len - prefix) % 2 != 0)
+    {
+        _error = QObject::tr("not a record");
+        return false;
+    }
+
+    uchar bytes[MAX_LINE_SIZE / 2];
+    const int count = (len - prefix) / 2;
+    if (!HexRecords::decodeHex(line + prefix, count, bytes))
+    {
+        _error = QObject::tr("invalid hex digit");
+        return false;
+    }
+    return _format == HexRecords::IntelHex ? parseIntelHex(bytes, count)
+                                           : parseSRecord(line[1], bytes, count);
+}
+
+bool RecordReader::parseIntelHex(const uchar * bytes, int len)
+{
+    // length, address, type, data, checksum: all bytes add up to 0
+    uchar sum = 0;
+    for (int i = 0; i < len; i++) {
+        sum += bytes[i];
+    }
+    if (len < 5 || bytes[0] != len - 5)
+    {
+        _error = QObject::tr("wrong record length");
+        return false;
+    }
+    if (sum != 0)
+    {
+        _error = QObject::tr("checksum mismatch");
+        return false;
+    }
+
+    const int address = (bytes[1] << 8) | bytes[2];
+    const uchar * data = bytes + 4;
+    switch (bytes[3])
+    {
+    case 0x00:
+        addData(_upperAddress + address, data, bytes[0]);
+        return true;
+    case 0x01:
+        _done = true;
+        return true;
+    case 0x02:                          // extended segment address
+    case 0x04:                          // extended linear address
+        if (bytes[0] != 2) {
+            break;
+        }
+        _upperAddress = quint64((data[0] << 8) | data[1]) << (bytes[3] == 0x02 ? 4 : 16);
+        return true;
+    case 0x03:                          // start addresses aren't kept
+    case 0x05:
+        return true;
+    }
+    _error = QObject::tr("unknown record type");
+    return false;
+}
+
+bool RecordReader::parseSRecord(char type, const uchar * bytes, int len)
+{
+    // count, address, data, checksum: all bytes add up to 0xff
+    uchar sum = 0;
+    for (int i = 0; i < len; i++) {
+        sum += bytes[i];
+    }
+    if (len < 3 || bytes[0] != len - 1)
+    {
+        _error = QObject::tr("wrong record length");
+        return false;
+    }
+    if (sum != 0xff)
+    {
+        _error = QObject::tr("checksum mismatch");
+        return false;
+    }
+
+    int addressSize;
+    switch (type)
+    {
+    case '0': case '1': case '5': case '9':
+        addressSize = 2;
+        break;
+    case '2': case '6': case '8':
+        addressSize = 3;
+        break;
+    case '3': case '7':
+        addressSize = 4;
+        break;
+    default:
+        _error = QObject::tr("unknown record type");
+        return false;
+    }
+    if (len < addressSize + 2)
+    {
+        _error = QObject::tr("wrong record length");
+        return false;
+    }
+
+    quint64 address = 0;
+    for (int i = 0; i < addressSize; i++) {
+        address = (address << 8) | bytes[1 + i];
+    }
+    if (type >= '1' && type <= '3') {
+        addData(address, bytes + 1 + addressSize, len - addressSize - 2);
+    }
+    _done = type >= '7';
+    return true;
+}
+/** \endcond docNever */
+
+bool HexRecords::formatOf(const QString & fileName, Format & format)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "hex" || suffix == "ihx" || suffix == "ihex")
+    {
+        format = IntelHex;
+        return true;
+    }
+    if (suffix == "srec" || suffix == "s19" || suffix == "s28" || suffix == "s37" ||
+        suffix == "mot" || suffix == "s")
+    {
+        format = SRecord;
+        return true;
+    }
+    return false;
+}
+
+std::unique_ptr<QHexEditData> HexRecords::read(QIODevice & device, Format format, QString * errorString)
+{
+    RecordReader reader(format);
+    char line[MAX_LINE_SIZE + 2];
+    for (int lineNumber = 1; !reader.done(); lineNumber++)
+    {
+        qint64 len = device.readLine(line, sizeof(line));
+        if (len <= 0) {
+            break;
+        }
+        if (line[len - 1] != '\n' && !device.atEnd())
+        {
+            if (errorString) {
+                *errorString = QObject::tr("Line %1: line too long").arg(lineNumber);
+            }
+            return std::unique_ptr<QHexEditData>();
+        }
+        while (len > 0 && isspace(uchar(line[len - 1]))) {
+            len--;
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        if (!reader.parse(line, static_cast<int>(len)))
+        {
+            if (errorString) {
+                *errorString = QObject::tr("Line %1: %2").arg(lineNumber).arg(reader.error());
+            }
+            return std::unique_ptr<QHexEditData>();
+        }
+    }
+    return QHexEditData::fromSegments(std::move(reader.segments()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Writing implementation:
+/** \cond docNever */
+class RecordWriter
+{
+public:
+    RecordWriter(QIODevice & device, HexRecords::Format format, int addressSize);
+
+    bool writeData(quint64 address, const char * data, size_t len);
+    bool finish();
+
+private:
+    void record(char type, quint64 address, int addressSize, const char * data, size_t len);
+    bool flush();
+
+    QIODevice & _device;
+    HexRecords::Format _format;
+    int _addressSize;                   // of S-records
+    quint64 _upperAddress;              // of the last extended linear address record
+    quint64 _records;                   // data records written
+    QByteArray _buffer;
+};
+
+RecordWriter::RecordWriter(QIODevice & device, HexRecords::Format format, int addressSize) :
+    _device(device),
+    _format(format),
+    _addressSize(addressSize),
+    _upperAddress(0),
+    _records(0)
+{
+    if (_format == HexRecords::SRecord) {
+        record('0', 0, 2, nullptr, 0);
+    }
+}
+
+void RecordWriter::record(char type, quint64 address, int addressSize, const char * data, size_t len)
+{
+    uchar bytes[8];
+    int header = 0;
+    if (_format == HexRecords::IntelHex)
+    {
+        _buffer.append(':');
+        bytes[header++] = uchar(len);
+        bytes[header++] = uchar(address >> 8);
+        bytes[header++] = uchar(address);
+        bytes[header++] = uchar(type);
+    }
+    else
+    {
+        _buffer.append('S').append(type);
+        bytes[header++] = uchar(addressSize + len + 1);
+        for (int i = addressSize - 1; i >= 0; i--) {
+            bytes[header++] = uchar(address >> (8 * i));
+        }
+    }
+
+    uchar sum = 0;
+    auto appendByte = [&](uchar byte) {
+        _buffer.append(HEX_DIGITS[byte >> 4]).append(HEX_DIGITS[byte & 0xf]);
+        sum += byte;
+    };
+    for (int i = 0; i < header; i++) {
+        appendByte(bytes[i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+        appendByte(uchar(data[i]));
+    }
+    appendByte(_format == HexRecords::IntelHex ? uchar(-sum) : uchar(~sum));
+    _buffer.append('\n');
+}
+
+bool RecordWriter::flush()
+{
+    const bool ok = _device.write(_buffer) == _buffer.size();
+    _buffer.clear();
+    return ok;
+}
+
+bool RecordWriter::writeData(quint64 address, const char * data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n = std::min(len, BYTES_PER_RECORD);
+        if (_format == HexRecords::IntelHex)
+        {
+            // a record doesn't cross a 64 KiB boundary
+            n = std::min<size_t>(n, 0x10000 - (address & 0xffff));
+            if (_records == 0 || (address >> 16) != (_upperAddress >> 16))
+            {
+                const char upper[2] = { char(address >> 24), char(address >> 16) };
+                record(0x04, 0, 0, upper, 2);
+                _upperAddress = address & ~quint64(0xffff);
+            }
+            record(0x00, address & 0xffff, 0, data, n);
+        }
+        else
+        {
+            record(char('1' + _addressSize - 2), address, _addressSize, data, n);
+        }
+        _records++;
+        address += n;
+        data += n;
+        len -= n;
+    }
+    return _buffer.size() < int(WRITE_CHUNK_SIZE) || flush();
+}
+
+bool RecordWriter::finish()
+{
+    if (_format == HexRecords::IntelHex)
+    {
+        record(0x01, 0, 0, nullptr, 0);
+    }
+    else
+    {
+        // the count record is optional, it is left out if it doesn't fit
+        if (_records <= 0xffffff) {
+            record(_records <= 0xffff ? '5' : '6', _records, _records <= 0xffff ? 2 : 3, nullptr, 0);
+        }
+        record(char('9' - _addressSize + 2), 0, _addressSize, nullptr, 0);
+    }
+    return flush();
+}
+/** \endcond docNever */
+
+bool HexRecords::write(const QHexEditData & data, QIODevice & device, Format format)
+{
+    // the highest address decides the size of the addresses
+    const size_t size = data.size();
+    const quint64 highest = size > 0 ? data.address(size - 1) : 0;
+    if (highest > 0xffffffff) {
+        return false;
+    }
+    const int addressSize = highest > 0xffffff ? 4 : highest > 0xffff ? 3 : 2;
+
+    RecordWriter writer(device, format, addressSize);
+    for (size_t pos = data.nextData(0); pos < size; pos = data.nextData(pos))
+    {
+        const size_t end = data.nextHole(pos);
+        const quint64 address = data.address(pos);
+        for (size_t chunk = pos; chunk < end; chunk += WRITE_CHUNK_SIZE)
+        {
+            const QByteArray bytes = data.range(chunk, std::min(WRITE_CHUNK_SIZE, end - chunk));
+            if (!writer.writeData(address + (chunk - pos), bytes.constData(), bytes.size())) {
+                return false;
+            }
+        }
+        pos = end;
+    }
+    return writer.finish();
+}
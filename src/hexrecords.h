@@ -0,0 +1,43 @@
+#ifndef HEXRECORDS_H
+#define HEXRECORDS_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+#include <memory>
+
+#include "qhexeditdata.h"
+
+/*! HexRecords reads and writes the text formats of firmware images: Intel HEX
+and Motorola S-records. A file is read line by line, the records go straight
+into the segments of QHexEditData::fromSegments(), so there is no flat copy
+of the address space. The gaps between the segments are holes.
+
+write() walks the data with nextData() and nextHole() and writes only the
+parts outside of holes, at the addresses shown by QHexEditData::address().
+*/
+class HexRecords
+{
+public:
+    enum Format
+    {
+        IntelHex,
+        SRecord
+    };
+
+    // the format of a file name (.hex, .ihx, .srec, .s19 ...), false for others
+    static bool formatOf(const QString & fileName, Format & format);
+
+    // null on errors, errorString tells the line
+    static std::unique_ptr<QHexEditData> read(QIODevice & device, Format format, QString * errorString = nullptr);
+    static bool write(const QHexEditData & data, QIODevice & device, Format format);
+
+    // decodes 2 * len hex digits (both cases) into len bytes, 16 digits at
+    // once with SSE2. False if there is any other character.
+    static bool decodeHex(const char * src, size_t len, uchar * dst);
+};
+
+/** \endcond docNever */
+
+#endif // HEXRECORDS_H
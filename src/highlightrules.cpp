@@ -0,0 +1,304 @@
+#include "highlightrules.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "bitscan.h"
+
+const size_t BLOCK_SIZE = 4096;                 // bytes, the results are cached by block
+const size_t MAX_CACHED_BLOCKS = 512;           // 2 MiB of marks
+const int MAX_PATTERN_LENGTH = 256;
+const int MAX_RUN_LENGTH = 4096;                // longer minimum runs would need too much context
+
+static const QRgb PALETTE[] =
+{
+    0xffc0c0, 0xc0d8ff, 0xd0ffd0, 0xffe8a0, 0xe8d0ff, 0xe0e0e0
+};
+
+// sets the bits of the bytes, which are value (ByteRun) or printable (AsciiRun)
+static void classify(const uchar * data, size_t len, const HighlightRule & rule, quint64 * bits)
+{
+    const bool ascii = rule.kind == HighlightRule::AsciiRun;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i value = _mm_set1_epi8(char(rule.value));
+    for (; i + 16 <= len; i += 16)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        setBits(bits, i, ascii ? printableBytes(x) : _mm_cmpeq_epi8(x, value));
+    }
+#endif
+    for (; i < len; i++)
+    {
+        const uchar c = data[i];
+        if (ascii ? isPrintable(c) : c == rule.value) {
+            bits[i >> 6] |= quint64(1) << (i & 63);
+        }
+    }
+}
+
+// marks the runs of at least minLength set bits
+static void markRuns(const quint64 * bits, size_t len, int minLength, uchar mark, uchar * marks)
+{
+    size_t pos = 0;
+    while (pos < len)
+    {
+        const size_t begin = findBit(bits, pos, len, true);
+        const size_t end = findBit(bits, begin, len, false);
+        if (end - begin >= size_t(minLength)) {
+            std::memset(marks + begin, mark, end - begin);
+        }
+        pos = end;
+    }
+}
+
+// marks every occurrence of pattern, candidates are found by comparing the
+// first and the last byte of the pattern at 16 positions at once
+static void markPattern(const uchar * data, size_t len, const QByteArray & pattern, uchar mark, uchar * marks)
+{
+    const size_t plen = pattern.size();
+    const uchar * p = reinterpret_cast<const uchar *>(pattern.constData());
+    if (plen == 0 || plen > len) {
+        return;
+    }
+
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(char(p[0]));
+    const __m128i last = _mm_set1_epi8(char(p[plen - 1]));
+    for (; i + plen - 1 + 16 <= len; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + plen - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask != 0)
+        {
+            const size_t pos = i + trailingZeros(mask);
+            if (std::memcmp(data + pos, p, plen) == 0) {
+                std::memset(marks + pos, mark, plen);
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i + plen <= len; i++)
+    {
+        if (data[i] == p[0] && std::memcmp(data + i, p, plen) == 0) {
+            std::memset(marks + i, mark, plen);
+        }
+    }
+}
+
+// the bytes before and behind a byte, a rule needs to decide about it
+static size_t contextOf(const HighlightRule & rule)
+{
+    return rule.kind == HighlightRule::Pattern ? rule.pattern.size() - 1 : rule.minLength - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// HighlightRules implementation:
+
+HighlightRules::HighlightRules(QObject * parent) :
+    QObject(parent),
+    _data(nullptr),
+    _context(0)
+{ }
+
+HighlightRules::~HighlightRules()
+{ }
+
+void HighlightRules::setData(QHexEditData * data)
+{
+    _data = data;
+    clearCache();
+}
+
+void HighlightRules::setRules(const std::vector<HighlightRule> & rules)
+{
+    // there is one mark per rule, 0 is no rule
+    _rules.assign(rules.begin(), rules.begin() + std::min<size_t>(rules.size(), 255));
+    _context = 0;
+    for (const HighlightRule & rule : _rules) {
+        _context = std::max(_context, contextOf(rule));
+    }
+    clearCache();
+}
+
+const std::vector<HighlightRule> & HighlightRules::rules() const
+{
+    return _rules;
+}
+
+bool HighlightRules::parse(const QString & text, std::vector<HighlightRule> & rules, QString * errorString)
+{
+    rules.clear();
+    QString error;
+    const QStringList lines = text.split('\n');
+    for (int idx = 0; idx < lines.size() && error.isEmpty(); idx++)
+    {
+        const QStringList words = lines[idx].simplified().split(' ', QString::SkipEmptyParts);
+        if (words.isEmpty() || words[0].startsWith("//")) {
+            continue;
+        }
+
+        HighlightRule rule;
+        rule.value = 0;
+        rule.minLength = 1;
+        int colorWord = 2;
+        bool ok = false;
+        if (words[0] == "hex" && words.size() >= 2)
+        {
+            rule.kind = HighlightRule::Pattern;
+            rule.pattern = QByteArray::fromHex(words[1].toLatin1());
+            ok = rule.pattern.size() > 0 && rule.pattern.size() <= MAX_PATTERN_LENGTH
+                 && words[1].size() == 2 * rule.pattern.size();
+        }
+        else if (words[0] == "run" && words.size() >= 3)
+        {
+            rule.kind = HighlightRule::ByteRun;
+            bool valueOk = false;
+            const uint value = words[1].toUInt(&valueOk, 16);
+            rule.value = uchar(value);
+            rule.minLength = words[2].toInt(&ok);
+            ok = ok && valueOk && value <= 0xff && rule.minLength > 0 && rule.minLength <= MAX_RUN_LENGTH;
+            colorWord = 3;
+        }
+        else if (words[0] == "ascii" && words.size() >= 2)
+        {
+            rule.kind = HighlightRule::AsciiRun;
+            rule.minLength = words[1].toInt(&ok);
+            ok = ok && rule.minLength > 0 && rule.minLength <= MAX_RUN_LENGTH;
+        }
+        if (!ok)
+        {
+            error = QObject::tr("Line %1: expected \"hex <bytes>\", \"run <byte> <length>\" or \"ascii <length>\"")
+                    .arg(idx + 1);
+            break;
+        }
+
+        rule.color = QColor(PALETTE[rules.size() % (sizeof(PALETTE) / sizeof(PALETTE[0]))]);
+        if (words.size() > colorWord)
+        {
+            rule.color = QColor(words[colorWord]);
+            if (!rule.color.isValid() || words.size() > colorWord + 1) {
+                error = QObject::tr("Line %1: invalid colour %2").arg(idx + 1).arg(words.mid(colorWord).join(' '));
+            }
+        }
+        rules.push_back(rule);
+    }
+
+    if (!error.isEmpty())
+    {
+        rules.clear();
+        if (errorString) {
+            *errorString = error;
+        }
+        return false;
+    }
+    return true;
+}
+
+void HighlightRules::highlight(size_t begin, size_t end, QColor * colors) const
+{
+    if (!_data || _rules.empty()) {
+        return;
+    }
+    end = std::min(end, _data->size());
+    if (begin >= end) {
+        return;
+    }
+
+    const size_t first = begin / BLOCK_SIZE;
+    const size_t last = (end - 1) / BLOCK_SIZE;
+    for (size_t block = first; block <= last; block++)
+    {
+        // the blocks missing in a row are evaluated at once
+        std::map<size_t, QByteArray>::const_iterator it = _blocks.find(block);
+        if (it == _blocks.end())
+        {
+            size_t stop = block;
+            while (stop < last && _blocks.find(stop + 1) == _blocks.end()) {
+                stop++;
+            }
+            evaluateBlocks(block, stop);
+            it = _blocks.find(block);
+        }
+
+        const uchar * marks = reinterpret_cast<const uchar *>(it->second.constData());
+        const size_t blockPos = block * BLOCK_SIZE;
+        const size_t from = std::max(begin, blockPos);
+        const size_t to = std::min(end, blockPos + it->second.size());
+        for (size_t pos = from; pos < to; pos++)
+        {
+            const uchar mark = marks[pos - blockPos];
+            if (mark != 0) {
+                colors[pos - begin] = _rules[mark - 1].color;
+            }
+        }
+    }
+}
+
+void HighlightRules::evaluate(const std::vector<HighlightRule> & rules, const uchar * data, size_t len, uchar * marks)
+{
+    std::memset(marks, 0, len);
+    std::vector<quint64> bits;
+    for (size_t idx = 0; idx < rules.size(); idx++)
+    {
+        const HighlightRule & rule = rules[idx];
+        const uchar mark = uchar(idx + 1);
+        if (rule.kind == HighlightRule::Pattern)
+        {
+            markPattern(data, len, rule.pattern, mark, marks);
+        }
+        else
+        {
+            bits.assign((len + 63) / 64, 0);
+            classify(data, len, rule, bits.data());
+            markRuns(bits.data(), len, rule.minLength, mark, marks);
+        }
+    }
+}
+
+void HighlightRules::invalidate(size_t pos, size_t len, bool sizeChanged)
+{
+    // a change reaches the blocks, whose context contains it
+    const size_t from = pos - std::min(pos, _context);
+    std::map<size_t, QByteArray>::iterator first = _blocks.lower_bound(from / BLOCK_SIZE);
+    std::map<size_t, QByteArray>::iterator last = _blocks.end();
+    if (!sizeChanged)
+    {
+        const size_t to = pos + len + _context;
+        last = _blocks.upper_bound(to / BLOCK_SIZE);
+    }
+    _blocks.erase(first, last);
+}
+
+void HighlightRules::clearCache()
+{
+    _blocks.clear();
+}
+
+// the blocks [first, last] with the context of the rules around them
+void HighlightRules::evaluateBlocks(size_t first, size_t last) const
+{
+    const size_t size = _data->size();
+    const size_t from = first * BLOCK_SIZE;
+    const size_t to = std::min((last + 1) * BLOCK_SIZE, size);
+    const size_t readFrom = from - std::min(from, _context);
+    const size_t readTo = std::min(size, to + _context);
+
+    const QByteArray bytes = _data->range(readFrom, readTo - readFrom);
+    const size_t len = std::min<size_t>(bytes.size(), readTo - readFrom);
+    _buffer.resize(static_cast<int>(len));
+    evaluate(_rules, reinterpret_cast<const uchar *>(bytes.constData()), len, reinterpret_cast<uchar *>(_buffer.data()));
+
+    if (_blocks.size() + (last - first + 1) > MAX_CACHED_BLOCKS) {
+        _blocks.clear();
+    }
+    for (size_t block = first; block <= last; block++)
+    {
+        const size_t blockPos = block * BLOCK_SIZE;
+        const size_t blockEnd = std::min(blockPos + BLOCK_SIZE, to);
+        _blocks[block] = _buffer.mid(static_cast<int>(blockPos - readFrom), static_cast<int>(blockEnd - blockPos));
+    }
+}
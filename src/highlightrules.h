@@ -0,0 +1,99 @@
+#ifndef HIGHLIGHTRULES_H
+#define HIGHLIGHTRULES_H
+
+/** \cond docNever */
+
+#include <QtCore>
+#include <QColor>
+
+#include <map>
+#include <vector>
+
+#include "qhexeditdata.h"
+#include "qhexedithighlighter.h"
+
+/*! HighlightRule colours the bytes of a pattern or of runs of a kind of
+bytes: every occurrence of pattern, runs of at least minLength times value
+(e.g. zeros) or of at least minLength printable ascii chars.
+*/
+struct HighlightRule
+{
+    enum Kind
+    {
+        Pattern,
+        ByteRun,
+        AsciiRun
+    };
+
+    Kind kind;
+    QByteArray pattern;                 // of a Pattern
+    uchar value;                        // of a ByteRun
+    int minLength;                      // of the runs
+    QColor color;
+};
+
+/*! HighlightRules is a QHexEditHighlighter, which applies HighlightRules to
+the bytes QHexEdit paints. Later rules overwrite the colours of earlier ones.
+
+Only the painted bytes are evaluated, together with the bytes around them a
+rule needs to decide (e.g. minLength - 1 bytes for a run). The bytes are
+classified 16 at a time with SSE2, where available. The results are cached
+per block of the data, so scrolling evaluates only the blocks, which come
+into view, and repaints of the same lines cost a copy. invalidate() drops
+the blocks a change can affect, connect it to QHexEdit::dataRangeChanged().
+
+The rules can be written as text, one rule per line:
+
+\code
+hex DEADBEEF #ffc0c0        every 0xDEADBEEF
+run 00 16 #e0e0e0           runs of at least 16 zeros
+ascii 8 #d0ffd0             runs of at least 8 printable chars
+\endcode
+
+The colour is optional, empty lines and lines starting with // are skipped.
+*/
+class HighlightRules : public QObject, public QHexEditHighlighter
+{
+    Q_OBJECT
+
+public:
+    explicit HighlightRules(QObject * parent = 0);
+    ~HighlightRules();
+
+    // data has to outlive the rules or be reset
+    void setData(QHexEditData * data);
+
+    void setRules(const std::vector<HighlightRule> & rules);
+    const std::vector<HighlightRule> & rules() const;
+
+    // parses rules written as text, see above
+    static bool parse(const QString & text, std::vector<HighlightRule> & rules, QString * errorString = nullptr);
+
+    void highlight(size_t begin, size_t end, QColor * colors) const;
+
+    // marks the bytes of [0, len), which a rule applies to, with its index + 1
+    static void evaluate(const std::vector<HighlightRule> & rules, const uchar * data, size_t len, uchar * marks);
+
+public slots:
+    // the bytes [pos, pos + len) changed, with sizeChanged all following too
+    void invalidate(size_t pos, size_t len, bool sizeChanged);
+
+    // drops all results, e.g. when the data changes without notice
+    void clearCache();
+
+private:
+    HighlightRules(const HighlightRules & other) = delete;
+    HighlightRules & operator=(const HighlightRules & other) = delete;
+
+    void evaluateBlocks(size_t first, size_t last) const;
+
+    QHexEditData * _data;
+    std::vector<HighlightRule> _rules;
+    size_t _context;                    // bytes around a block the rules need
+    mutable std::map<size_t, QByteArray> _blocks;   // marks by block index
+    mutable QByteArray _buffer;         // marks of the evaluated bytes
+};
+
+/** \endcond docNever */
+
+#endif // HIGHLIGHTRULES_H
@@ -0,0 +1,135 @@
+#include <QMouseEvent>
+#include <QPainter>
+
+#include <algorithm>
+
+#include "overviewbar.h"
+#include "statsengine.h"
+
+const int OVERVIEW_WIDTH = 16;
+
+OverviewBar::OverviewBar(QWidget * parent) :
+    QWidget(parent),
+    _engine(nullptr),
+    _cursorAddress(0)
+{
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
+    setCursor(Qt::PointingHandCursor);
+}
+
+void OverviewBar::setEngine(StatsEngine * engine)
+{
+    if (_engine) {
+        disconnect(_engine, 0, this, 0);
+    }
+
+    _engine = engine;
+    if (_engine) {
+        connect(_engine, SIGNAL(blocksChanged(int,int)), this, SLOT(blocksChanged(int,int)));
+    }
+    update();
+}
+
+StatsEngine * OverviewBar::engine() const
+{
+    return _engine;
+}
+
+QSize OverviewBar::sizeHint() const
+{
+    return QSize(OVERVIEW_WIDTH, 100);
+}
+
+void OverviewBar::setCursorAddress(int address)
+{
+    const int oldRow = rowOf(_cursorAddress);
+    _cursorAddress = static_cast<size_t>(std::max(address, 0));
+    const int newRow = rowOf(_cursorAddress);
+    if (oldRow != newRow)
+    {
+        update(0, oldRow - 1, width(), 3);
+        update(0, newRow - 1, width(), 3);
+    }
+}
+
+void OverviewBar::paintEvent(QPaintEvent * event)
+{
+    QPainter painter(this);
+    const QRect rect = event->rect();
+    painter.fillRect(rect, palette().color(QPalette::Mid));
+    if (!_engine || _engine->dataSize() == 0 || height() == 0) {
+        return;
+    }
+
+    // every row merges its blocks on the coarsest fitting level of the pyramid
+    const int blocks = static_cast<int>(_engine->level(0).size());
+    for (int y = rect.top(); y <= rect.bottom(); y++)
+    {
+        const int first = static_cast<int>(qint64(y) * blocks / height());
+        const int last = std::max(first + 1, static_cast<int>(qint64(y + 1) * blocks / height()));
+        if (first >= blocks) {
+            break;
+        }
+
+        const BlockStats stats = _engine->summary(first, std::min(last, blocks));
+        if (stats.weight == 0.0f) {
+            continue;
+        }
+
+        QColor color;
+        if (stats.zeros > 0.9f) {
+            color = QColor(0x30, 0x30, 0x30);
+        } else if (stats.ascii > 0.75f) {
+            color = QColor(0x40, 0x70, 0xe0);
+        } else {
+            color = QColor::fromHsvF((1.0 - stats.entropy) / 3.0, 0.8, 0.9);
+        }
+        painter.fillRect(0, y, width(), 1, color);
+    }
+
+    // cursor marker
+    painter.fillRect(0, rowOf(_cursorAddress), width(), 1, palette().color(QPalette::Highlight));
+}
+
+void OverviewBar::mousePressEvent(QMouseEvent * event)
+{
+    if (event->button() == Qt::LeftButton && _engine && _engine->dataSize() > 0) {
+        emit addressClicked(addressAt(event->pos().y()));
+    }
+}
+
+void OverviewBar::mouseMoveEvent(QMouseEvent * event)
+{
+    if ((event->buttons() & Qt::LeftButton) && _engine && _engine->dataSize() > 0) {
+        emit addressClicked(addressAt(event->pos().y()));
+    }
+}
+
+void OverviewBar::blocksChanged(int first, int last)
+{
+    if (!_engine || _engine->dataSize() == 0)
+    {
+        update();
+        return;
+    }
+
+    const size_t blockSize = _engine->blockSize();
+    const int top = rowOf(first * blockSize);
+    const int bottom = rowOf(last * blockSize);
+    update(0, top, width(), bottom - top + 1);
+}
+
+size_t OverviewBar::addressAt(int y) const
+{
+    const size_t size = _engine->dataSize();
+    y = std::max(0, std::min(y, height() - 1));
+    return std::min(size - 1, static_cast<size_t>(double(y) / height() * size));
+}
+
+int OverviewBar::rowOf(size_t address) const
+{
+    if (!_engine || _engine->dataSize() == 0) {
+        return 0;
+    }
+    return static_cast<int>(double(address) / _engine->dataSize() * height());
+}
@@ -0,0 +1,53 @@
+#ifndef OVERVIEWBAR_H
+#define OVERVIEWBAR_H
+
+/** \cond docNever */
+
+#include <QWidget>
+
+class StatsEngine;
+
+/*! OverviewBar is a narrow vertical strip, which shows the whole data of a
+StatsEngine at once. Every pixel row covers the same share of the data and is
+coloured by the statistics of its blocks: zeros are dark, text is blue and
+the rest goes from green (low entropy) to red (high entropy, e.g. compressed
+or encrypted data). Clicking or dragging emits the address under the mouse.
+*/
+class OverviewBar : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit OverviewBar(QWidget * parent = 0);
+
+    void setEngine(StatsEngine * engine);
+    StatsEngine * engine() const;
+
+    QSize sizeHint() const;
+
+public slots:
+    // marks the address of the cursor
+    void setCursorAddress(int address);
+
+signals:
+    void addressClicked(size_t address);
+
+protected:
+    void paintEvent(QPaintEvent * event);
+    void mousePressEvent(QMouseEvent * event);
+    void mouseMoveEvent(QMouseEvent * event);
+
+private slots:
+    void blocksChanged(int first, int last);
+
+private:
+    size_t addressAt(int y) const;
+    int rowOf(size_t address) const;
+
+    StatsEngine * _engine;
+    size_t _cursorAddress;
+};
+
+/** \endcond docNever */
+
+#endif // OVERVIEWBAR_H
@@ -0,0 +1,189 @@
+#include "piecetable.h"
+
+// priorities only have to be distributed evenly, xorshift is good enough
+static unsigned nextPriority()
+{
+    static unsigned state = 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+PieceTable::Tree PieceTable::make(const Piece & piece)
+{
+    return make(Tree(), piece, Tree(), nextPriority());
+}
+
+PieceTable::Tree PieceTable::make(const Tree & left, const Piece & piece, const Tree & right, unsigned priority)
+{
+    std::shared_ptr<Node> node = std::make_shared<Node>();
+    node->left = left;
+    node->right = right;
+    node->piece = piece;
+    node->priority = priority;
+    node->size = size(left) + piece.length + size(right);
+    node->count = count(left) + 1 + count(right);
+    return node;
+}
+
+size_t PieceTable::size(const Tree & tree)
+{
+    return tree ? tree->size : 0;
+}
+
+size_t PieceTable::count(const Tree & tree)
+{
+    return tree ? tree->count : 0;
+}
+
+PieceTable::Tree PieceTable::merge(const Tree & left, const Tree & right)
+{
+    if (!left) {
+        return right;
+    }
+    if (!right) {
+        return left;
+    }
+
+    if (left->priority > right->priority) {
+        return make(left->left, left->piece, merge(left->right, right), left->priority);
+    } else {
+        return make(merge(left, right->left), right->piece, right->right, right->priority);
+    }
+}
+
+void PieceTable::split(const Tree & tree, size_t pos, Tree & left, Tree & right)
+{
+    // tree may alias left or right
+    const Tree node = tree;
+    if (pos == 0)
+    {
+        left = Tree();
+        right = node;
+        return;
+    }
+    if (pos >= size(node))
+    {
+        left = node;
+        right = Tree();
+        return;
+    }
+
+    const size_t leftSize = size(node->left);
+    if (pos <= leftSize)
+    {
+        Tree r;
+        split(node->left, pos, left, r);
+        right = make(r, node->piece, node->right, node->priority);
+        return;
+    }
+
+    const size_t rel = pos - leftSize;
+    if (rel >= node->piece.length)
+    {
+        Tree l;
+        split(node->right, rel - node->piece.length, l, right);
+        left = make(node->left, node->piece, l, node->priority);
+        return;
+    }
+
+    // cut the piece, both halves keep the priority, so the heap order stays
+    Piece head = node->piece;
+    Piece tail = node->piece;
+    head.length = rel;
+    tail.offset += rel;
+    tail.length -= rel;
+    left = make(node->left, head, Tree(), node->priority);
+    right = make(Tree(), tail, node->right, node->priority);
+}
+
+PieceTable::Tree PieceTable::extract(const Tree & tree, size_t pos, size_t len)
+{
+    Tree left, right, middle, rest;
+    split(tree, pos, left, right);
+    split(right, len, middle, rest);
+    return middle;
+}
+
+PieceTable::Tree PieceTable::remove(const Tree & tree, size_t pos, size_t len)
+{
+    Tree left, right, middle, rest;
+    split(tree, pos, left, right);
+    split(right, len, middle, rest);
+    return merge(left, rest);
+}
+
+PieceTable::Tree PieceTable::insert(const Tree & tree, size_t pos, const Tree & other)
+{
+    Tree left, right;
+    split(tree, pos, left, right);
+    return merge(merge(left, other), right);
+}
+
+PieceTable::Tree PieceTable::insert(const Tree & tree, size_t pos, const Piece & piece)
+{
+    if (piece.length == 0) {
+        return tree;
+    }
+
+    Tree left, right;
+    split(tree, pos, left, right);
+
+    Tree extended = extendLast(left, piece);
+    if (!extended) {
+        extended = merge(left, make(piece));
+    }
+    return merge(extended, right);
+}
+
+PieceTable::Tree PieceTable::extendLast(const Tree & tree, const Piece & piece)
+{
+    if (!tree) {
+        return Tree();
+    }
+
+    if (tree->right)
+    {
+        Tree right = extendLast(tree->right, piece);
+        if (!right) {
+            return Tree();
+        }
+        return make(tree->left, tree->piece, right, tree->priority);
+    }
+
+    if (tree->piece.buffer != piece.buffer ||
+        tree->piece.offset + tree->piece.length != piece.offset)
+    {
+        return Tree();
+    }
+
+    Piece extended = tree->piece;
+    extended.length += piece.length;
+    return make(tree->left, extended, Tree(), tree->priority);
+}
+
+const Piece * PieceTable::find(const Tree & tree, size_t pos, size_t & rel)
+{
+    const Node * node = tree.get();
+    while (node)
+    {
+        const size_t leftSize = size(node->left);
+        if (pos < leftSize)
+        {
+            node = node->left.get();
+            continue;
+        }
+
+        pos -= leftSize;
+        if (pos < node->piece.length)
+        {
+            rel = pos;
+            return &node->piece;
+        }
+
+        pos -= node->piece.length;
+        node = node->right.get();
+    }
+    return nullptr;
+}
@@ -0,0 +1,113 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+/** \cond docNever */
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+/*! A Piece describes a contiguous run of bytes inside one of the buffers of a
+piece table backend. The buffers are never modified once bytes were written
+into them, so pieces can be shared freely (e.g. by undo commands).
+*/
+struct Piece
+{
+    int buffer;                         // index of the buffer
+    size_t offset;                      // first byte inside the buffer
+    size_t length;                      // number of bytes
+};
+
+/*! PieceTable implements a persistent (immutable) treap of pieces, ordered by
+their position in the document. Every node knows the number of bytes in its
+subtree, so a position is found in O(log n). Modifications never change
+existing nodes, they copy the path to the root instead. Therefore a Tree can
+be kept as a cheap snapshot of a document or of a part of it (spans), and
+handed back later without copying any data.
+*/
+class PieceTable
+{
+public:
+    struct Node;
+    typedef std::shared_ptr<const Node> Tree;
+
+    struct Node
+    {
+        Tree left;
+        Tree right;
+        Piece piece;
+        unsigned priority;
+        size_t size;                    // bytes in this subtree
+        size_t count;                   // pieces in this subtree
+    };
+
+    static Tree make(const Piece & piece);
+
+    static size_t size(const Tree & tree);
+    static size_t count(const Tree & tree);
+
+    // concatenates two trees
+    static Tree merge(const Tree & left, const Tree & right);
+
+    // splits the tree at byte position pos, pieces are cut if needed
+    static void split(const Tree & tree, size_t pos, Tree & left, Tree & right);
+
+    // the bytes [pos, pos + len) as a tree of their own
+    static Tree extract(const Tree & tree, size_t pos, size_t len);
+
+    // tree with the bytes [pos, pos + len) removed
+    static Tree remove(const Tree & tree, size_t pos, size_t len);
+
+    // tree with other inserted at pos
+    static Tree insert(const Tree & tree, size_t pos, const Tree & other);
+
+    // tree with a single piece inserted at pos, the piece is merged into its
+    // left neighbour, if it continues it inside the same buffer
+    static Tree insert(const Tree & tree, size_t pos, const Piece & piece);
+
+    // the piece containing pos, rel is the position of pos inside the piece
+    static const Piece * find(const Tree & tree, size_t pos, size_t & rel);
+
+    // calls f(piece, rel, len) for all fragments of [pos, pos + len) in order
+    template <typename F>
+    static void visit(const Tree & tree, size_t pos, size_t len, F && f);
+
+private:
+    static Tree make(const Tree & left, const Piece & piece, const Tree & right, unsigned priority);
+    static Tree extendLast(const Tree & tree, const Piece & piece);
+};
+
+template <typename F>
+void PieceTable::visit(const Tree & tree, size_t pos, size_t len, F && f)
+{
+    const Node * node = tree.get();
+    if (!node || len == 0) {
+        return;
+    }
+
+    const size_t leftSize = size(node->left);
+    if (pos < leftSize)
+    {
+        const size_t n = std::min(len, leftSize - pos);
+        visit(node->left, pos, n, f);
+        pos = leftSize;
+        len -= n;
+    }
+
+    size_t rel = pos - leftSize;
+    if (len > 0 && rel < node->piece.length)
+    {
+        const size_t n = std::min(len, node->piece.length - rel);
+        f(node->piece, rel, n);
+        rel += n;
+        len -= n;
+    }
+
+    if (len > 0) {
+        visit(node->right, rel - node->piece.length, len, f);
+    }
+}
+
+/** \endcond docNever */
+
+#endif // PIECETABLE_H
@@ -12,7 +12,10 @@ QHexEdit::QHexEdit(QWidget *parent) : QScrollArea(parent)
     connect(qHexEdit_p, SIGNAL(currentAddressChanged(int)), this, SIGNAL(currentAddressChanged(int)));
     connect(qHexEdit_p, SIGNAL(currentSizeChanged(size_t)), this, SIGNAL(currentSizeChanged(size_t)));
     connect(qHexEdit_p, SIGNAL(dataChanged()), this, SIGNAL(dataChanged()));
+    connect(qHexEdit_p, SIGNAL(dataRangeChanged(size_t,size_t,bool)), this, SIGNAL(dataRangeChanged(size_t,size_t,bool)));
+    connect(qHexEdit_p, SIGNAL(hashesReady(size_t,size_t)), this, SIGNAL(hashesReady(size_t,size_t)));
     connect(qHexEdit_p, SIGNAL(overwriteModeChanged(bool)), this, SIGNAL(overwriteModeChanged(bool)));
+    connect(qHexEdit_p, SIGNAL(undoHistoryLost()), this, SIGNAL(undoHistoryLost()));
     setFocusPolicy(Qt::NoFocus);
 }
 
@@ -46,6 +49,86 @@ void QHexEdit::replace( int pos, int len, const QByteArray & after)
     qHexEdit_p->replace(pos, len, after);
 }
 
+void QHexEdit::setUndoMemoryLimit(size_t limit)
+{
+    qHexEdit_p->setUndoMemoryLimit(limit);
+}
+
+size_t QHexEdit::undoMemoryLimit() const
+{
+    return qHexEdit_p->undoMemoryLimit();
+}
+
+size_t QHexEdit::undoMemoryUsage() const
+{
+    return qHexEdit_p->undoMemoryUsage();
+}
+
+size_t QHexEdit::undoSpilledBytes() const
+{
+    return qHexEdit_p->undoSpilledBytes();
+}
+
+int QHexEdit::openJournal(const QString & fileName, qint64 stamp, bool recover)
+{
+    return qHexEdit_p->openJournal(fileName, stamp, recover);
+}
+
+void QHexEdit::closeJournal(bool discard)
+{
+    qHexEdit_p->closeJournal(discard);
+}
+
+bool QHexEdit::hasJournal() const
+{
+    return qHexEdit_p->hasJournal();
+}
+
+void QHexEdit::requestHashes(int algorithms)
+{
+    qHexEdit_p->requestHashes(algorithms, false);
+}
+
+void QHexEdit::requestSelectionHashes(int algorithms)
+{
+    qHexEdit_p->requestHashes(algorithms, true);
+}
+
+QByteArray QHexEdit::hash(HashEngine::Algorithm algorithm) const
+{
+    return qHexEdit_p->hash(algorithm);
+}
+
+void QHexEdit::addHighlighter(QHexEditHighlighter * highlighter)
+{
+    qHexEdit_p->addHighlighter(highlighter);
+}
+
+void QHexEdit::removeHighlighter(QHexEditHighlighter * highlighter)
+{
+    qHexEdit_p->removeHighlighter(highlighter);
+}
+
+size_t QHexEdit::topAddress() const
+{
+    return qHexEdit_p->topAddress();
+}
+
+void QHexEdit::setTopAddress(size_t address)
+{
+    qHexEdit_p->setTopAddress(address);
+}
+
+size_t QHexEdit::selectionBegin() const
+{
+    return qHexEdit_p->getSelectionBegin();
+}
+
+size_t QHexEdit::selectionEnd() const
+{
+    return qHexEdit_p->getSelectionEnd();
+}
+
 QString QHexEdit::toReadableString()
 {
     return qHexEdit_p->toRedableString();
@@ -61,6 +144,16 @@ void QHexEdit::setAddressArea(bool addressArea)
     qHexEdit_p->setAddressArea(addressArea);
 }
 
+void QHexEdit::gotoAddress(size_t address)
+{
+    qHexEdit_p->gotoAddress(address);
+}
+
+bool QHexEdit::gotoNextData()
+{
+    return qHexEdit_p->gotoNextData();
+}
+
 void QHexEdit::redo()
 {
     qHexEdit_p->redo();
@@ -71,16 +164,61 @@ void QHexEdit::undo()
     qHexEdit_p->undo();
 }
 
+void QHexEdit::updateHighlighting()
+{
+    qHexEdit_p->update();
+}
+
 void QHexEdit::setAddressWidth(int addressWidth)
 {
     qHexEdit_p->setAddressWidth(addressWidth);
 }
 
+void QHexEdit::setBytesPerLine(int bytesPerLine)
+{
+    qHexEdit_p->setBytesPerLine(bytesPerLine);
+}
+
+int QHexEdit::bytesPerLine() const
+{
+    return qHexEdit_p->bytesPerLine();
+}
+
+void QHexEdit::setGroupSize(int groupSize)
+{
+    qHexEdit_p->setGroupSize(groupSize);
+}
+
+int QHexEdit::groupSize() const
+{
+    return qHexEdit_p->groupSize();
+}
+
 void QHexEdit::setAsciiArea(bool asciiArea)
 {
     qHexEdit_p->setAsciiArea(asciiArea);
 }
 
+void QHexEdit::setInspector(ValueDecoder::Type type, bool bigEndian, int stride)
+{
+    qHexEdit_p->setInspector(type, bigEndian, stride);
+}
+
+ValueDecoder::Type QHexEdit::inspectorType() const
+{
+    return qHexEdit_p->inspector().type();
+}
+
+bool QHexEdit::inspectorBigEndian() const
+{
+    return qHexEdit_p->inspector().bigEndian();
+}
+
+int QHexEdit::inspectorStride() const
+{
+    return qHexEdit_p->inspector().stride();
+}
+
 void QHexEdit::setHighlighting(bool mode)
 {
     qHexEdit_p->setHighlighting(mode);
@@ -130,6 +268,16 @@ QHexEditData & QHexEdit::data() const
     return qHexEdit_p->data();
 }
 
+void QHexEdit::setDocument(std::shared_ptr<QHexEditDocument> document)
+{
+    qHexEdit_p->setDocument(std::move(document));
+}
+
+std::shared_ptr<QHexEditDocument> QHexEdit::document() const
+{
+    return qHexEdit_p->document();
+}
+
 void QHexEdit::setAddressAreaColor(const QColor &color)
 {
     qHexEdit_p->setAddressAreaColor(color);
@@ -180,6 +328,16 @@ bool QHexEdit::isReadOnly()
     return qHexEdit_p->isReadOnly();
 }
 
+void QHexEdit::setFollowTail(bool followTail)
+{
+    qHexEdit_p->setFollowTail(followTail);
+}
+
+bool QHexEdit::followTail() const
+{
+    return qHexEdit_p->followTail();
+}
+
 void QHexEdit::setFont(const QFont &font)
 {
     qHexEdit_p->setFont(font);
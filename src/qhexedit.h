@@ -38,7 +38,8 @@ characters will be ignored.
 QHexEdit comes with undo/redo functionality. All changes can be undone, by
 pressing the undo-key (usually ctr-z). They can also be redone afterwards.
 The undo/redo framework is cleared, when setData() sets up a new
-content for the editor. You can search data inside the content with indexOf()
+content for the editor. Several QHexEdit views can show the same content,
+see setDocument(). You can search data inside the content with indexOf()
 and lastIndexOf(). The replace() function is to change located subdata. This
 'replaced' data can also be undone by the undo/redo framework.
 
@@ -101,6 +102,24 @@ class QHexEdit : public QScrollArea
     /*! Set the font of the widget. Please use fixed width fonts like Mono or Courier.*/
     Q_PROPERTY(QFont font READ font WRITE setFont)
 
+    /*! Property bytesPerLine holds the number of bytes shown in one line. It
+    is rounded down to a power of two (1 .. 256), the default is 16.
+    */
+    Q_PROPERTY(int bytesPerLine READ bytesPerLine WRITE setBytesPerLine)
+
+    /*! Property groupSize holds the number of bytes, which are shown without a
+    blank between them in the hex area. It is rounded down to a power of two
+    not greater than bytesPerLine, the default is 1.
+    */
+    Q_PROPERTY(int groupSize READ groupSize WRITE setGroupSize)
+
+    /*! Property followTail keeps the end of the data in view, when bytes are
+    appended to it, e.g. by QHexEditDocument::setFollowing(). The view only
+    scrolls, if the last line was shown before, so the user can scroll back
+    and read. This property's default is false.
+    */
+    Q_PROPERTY(bool followTail READ followTail WRITE setFollowTail)
+
 
 public:
     /*! Creates an instance of QHexEdit.
@@ -153,6 +172,96 @@ public:
     */
     void replace( int pos, int len, const QByteArray & after);
 
+    /*! Sets the memory budget of the undo/redo history in bytes. Payloads of
+    older undo steps, which exceed the budget, are moved into a temporary
+    journal file and are read back when needed.
+    */
+    void setUndoMemoryLimit(size_t limit);
+
+    /*! Returns the memory budget of the undo/redo history in bytes. */
+    size_t undoMemoryLimit() const;
+
+    /*! Returns the bytes held in memory by the undo/redo history. */
+    size_t undoMemoryUsage() const;
+
+    /*! Returns the bytes of the undo/redo history, which were moved into the
+    temporary journal file.
+    */
+    size_t undoSpilledBytes() const;
+
+    /*! Starts journaling all edits of the current data into fileName. Every
+    edit is written to disk in the background, so a crashed session can be
+    recovered. stamp identifies the unchanged original (e.g. the modification
+    time of the file).
+    \param recover Replay an existing journal with the same stamp onto the data
+    \return Number of recovered edits, EditJournal::Failed (-1), if the journal
+    cannot be opened, or EditJournal::Stale (-2), if recover was asked for, but
+    the journal was written for another size or stamp of the data. A stale
+    journal is left untouched and journaling doesn't start, so the caller can
+    keep it, before it opens the journal again without recover.
+    */
+    int openJournal(const QString & fileName, qint64 stamp, bool recover = false);
+
+    /*! Stops journaling. With discard the journal file is removed, which is
+    the right thing after the data was saved.
+    */
+    void closeJournal(bool discard = false);
+
+    /*! Returns true, if the edits are journaled. */
+    bool hasJournal() const;
+
+    /*! Starts computing checksums of the whole data in the background.
+    They are computed again after every edit, hashesReady() announces fresh
+    values. The CRC-32 of unchanged blocks is cached, so it is cheap to keep
+    up to date even for large files.
+    \param algorithms Or-ed values of HashEngine::Algorithm
+    */
+    void requestHashes(int algorithms = HashEngine::AllAlgorithms);
+
+    /*! Same as requestHashes(), but for the bytes selected right now. */
+    void requestSelectionHashes(int algorithms = HashEngine::AllAlgorithms);
+
+    /*! Returns the digest of the last finished computation (big endian),
+    which is empty, if the algorithm was not requested.
+    */
+    QByteArray hash(HashEngine::Algorithm algorithm) const;
+
+    /*! Adds a highlighter, which colours bytes (see QHexEditHighlighter). The
+    highlighter is not owned and has to be removed before it is deleted.
+    */
+    void addHighlighter(QHexEditHighlighter * highlighter);
+
+    /*! Removes a highlighter added by addHighlighter(). */
+    void removeHighlighter(QHexEditHighlighter * highlighter);
+
+    /*! Attaches the view to a document, which may be shown by other views
+    too. The views share the data, the undo/redo history, the journal and the
+    checksums without copies, each has its own cursor and selection. Edits of
+    one view are repainted by the others as far as they show the changed
+    bytes. setData() attaches a new document, other views of the old one keep
+    it.
+    */
+    void setDocument(std::shared_ptr<QHexEditDocument> document);
+
+    /*! Returns the document of the view, pass it to setDocument() of another
+    view to show the same data.
+    */
+    std::shared_ptr<QHexEditDocument> document() const;
+
+    /*! Returns the address of the first visible line. */
+    size_t topAddress() const;
+
+    /*! Scrolls the line of address to the top, the cursor stays where it is. */
+    void setTopAddress(size_t address);
+
+    /*! Returns the first selected byte. */
+    size_t selectionBegin() const;
+
+    /*! Returns the byte behind the selection, selectionBegin() if nothing
+    is selected.
+    */
+    size_t selectionEnd() const;
+
     /*! Gives back a formatted image of the content of QHexEdit
     */
     QString toReadableString();
@@ -178,11 +287,30 @@ public:
     bool overwriteMode();
     void setReadOnly(bool);
     bool isReadOnly();
+    void setFollowTail(bool);
+    bool followTail() const;
     const QFont &font() const;
     void setFont(const QFont &);
+    int bytesPerLine() const;
+    int groupSize() const;
+    ValueDecoder::Type inspectorType() const;
+    bool inspectorBigEndian() const;
+    int inspectorStride() const;
     /*! \endcond docNever */
 
 public slots:
+    /*! Moves the cursor to a byte and scrolls the view, so that it is visible.
+      \param address Index position of the byte
+      */
+    void gotoAddress(size_t address);
+
+    /*! Moves the cursor to the start of the next data region, behind the
+      next hole of the data (e.g. the sparse parts of a disk image or the
+      unmapped memory of a process).
+      \return false, if there is no data behind the cursor
+      */
+    bool gotoNextData();
+
     /*! Redoes the last operation. If there is no operation to redo, i.e.
       there is no redo step in the undo/redo history, nothing happens.
       */
@@ -193,6 +321,16 @@ public slots:
       */
     void setAddressWidth(int addressWidth);
 
+    /*! Set the number of bytes in one line.
+      \param bytesPerLine Power of two, e.g. 16, 32 or 64.
+      */
+    void setBytesPerLine(int bytesPerLine);
+
+    /*! Set the number of bytes in one group of the hex area.
+      \param groupSize Power of two, e.g. 1, 2, 4 or 8.
+      */
+    void setGroupSize(int groupSize);
+
     /*! Switch the address area on or off.
       \param addressArea true (show it), false (hide it).
       */
@@ -203,6 +341,15 @@ public slots:
       */
     void setAsciiArea(bool asciiArea);
 
+    /*! Shows the visible lines as values of a type in an area right of the
+      others, e.g. to read the fields of a header. The values start at every
+      stride bytes of a line.
+      \param type ValueDecoder::Int8 .. ValueDecoder::Float64, ValueDecoder::None hides the area.
+      \param bigEndian true (big endian), false (little endian).
+      \param stride Bytes from one value to the next, 0 for the size of the type.
+      */
+    void setInspector(ValueDecoder::Type type, bool bigEndian = false, int stride = 0);
+
     /*! Switch the highlighting feature on or of.
       \param mode true (show it), false (hide it).
       */
@@ -213,6 +360,9 @@ public slots:
       */
     void undo();
 
+    /*! Repaints the bytes, e.g. after the colours of a highlighter changed. */
+    void updateHighlighting();
+
 signals:
 
     /*! Contains the address, where the cursor is located. */
@@ -221,12 +371,36 @@ signals:
     /*! Contains the size of the data to edit. */
     void currentSizeChanged(size_t size);
 
-    /*! The signal is emited every time, the data is changed. */
+    /*! The signal is emited every time, the data is changed. All changes of one
+    event loop iteration are announced by a single signal.
+    */
     void dataChanged();
 
+    /*! The signal is emited together with dataChanged(). It contains the
+    range of bytes, which were changed in the last event loop iteration.
+    \param pos Index position of the first changed byte
+    \param len Amount of changed bytes
+    \param sizeChanged True, if bytes were inserted or removed. Then all bytes
+    behind pos have moved.
+    */
+    void dataRangeChanged(size_t pos, size_t len, bool sizeChanged);
+
+    /*! The signal is emited, when requested checksums are available by hash().
+    \param pos Index position of the first hashed byte
+    \param len Amount of hashed bytes
+    */
+    void hashesReady(size_t pos, size_t len);
+
     /*! The signal is emited every time, the overwrite mode is changed. */
     void overwriteModeChanged(bool state);
 
+    /*! The signal is emited, when an undo or redo failed, because the undo
+    journal (see setUndoMemoryLimit()) couldn't be read back. The data was
+    left unchanged and the undo/redo history was cleared, because it doesn't
+    fit the data any more.
+    */
+    void undoHistoryLost();
+
 private:
     /*! \cond docNever */
     QHexEditPrivate *qHexEdit_p;
@@ -1,31 +1,39 @@
 
 #include <QApplication>
+#include <QScrollBar>
+
+#include <algorithm>
+#include <limits>
 
 #include "qhexedit_p.h"
 #include "commands.h"
 
-const int HEXCHARS_IN_LINE = 47;
-const int GAP_ADR_HEX = 10;
-const int GAP_HEX_ASCII = 16;
-const int BYTES_PER_LINE = 16;
-
 QHexEditPrivate::QHexEditPrivate(QScrollArea *parent) : QWidget(parent)
 {
+    // partial repaints use these before the first layout
+    _cursorX = 0;
+    _cursorY = 0;
+    _selectionBegin = 0;
+    _selectionEnd = 0;
+    _selectionInit = 0;
+
     // initial data (empty byte array)
     static QByteArray buffer;
 //    static QByteArray buffer("Hello World");
-    _data = QHexEditData::fromByteArray(buffer);
+    _document = std::make_shared<QHexEditDocument>(QHexEditData::fromByteArray(buffer));
     // Test fixed size
-//    _data = QHexEditData::fromMemory((u_int8_t *)buffer.data(), buffer.size());
+//    _document = std::make_shared<QHexEditDocument>(QHexEditData::fromMemory((u_int8_t *)buffer.data(), buffer.size()));
+    _data = &_document->data();
 
     // one of the first things to do because the following calls will depend on adjust()
     // setFont(QFont("Inconsolata", 12));
     // http://stackoverflow.com/questions/1468022/how-to-specify-monospace-fonts-for-cross-platform-qt-applications
     setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
 
-    _undoStack = new QUndoStack(this);
-
     _scrollArea = parent;
+    _followTail = false;
+    _scrollToEnd = false;
+    connect(_scrollArea->verticalScrollBar(), SIGNAL(rangeChanged(int,int)), this, SLOT(scrollRangeChanged(int,int)));
     setAddressWidth(4);
     setAddressOffset(0);
     setAddressArea(true);
@@ -45,11 +53,19 @@ QHexEditPrivate::QHexEditPrivate(QScrollArea *parent) : QWidget(parent)
     setFocusPolicy(Qt::StrongFocus);
 
     connect(&_cursorTimer, SIGNAL(timeout()), this, SLOT(updateCursor()));
-    connect(this, SIGNAL(dataChanged()), this, SLOT(adjust()));
     _cursorTimer.setInterval(500);
     _cursorTimer.start();
+
+    // the document announces the edits of all its views once per event loop iteration
+    _ensureVisiblePending = false;
+    connect(_document.get(), SIGNAL(dataRangeChanged(size_t,size_t,bool)), this, SLOT(documentChanged(size_t,size_t,bool)));
+    connect(_document.get(), SIGNAL(hashesReady(size_t,size_t)), this, SIGNAL(hashesReady(size_t,size_t)));
+    connect(_document.get(), SIGNAL(undoHistoryLost()), this, SIGNAL(undoHistoryLost()));
 }
 
+QHexEditPrivate::~QHexEditPrivate()
+{ }
+
 void QHexEditPrivate::setAddressOffset(int offset)
 {
     _data->setAddressOffset(offset);
@@ -63,16 +79,37 @@ int QHexEditPrivate::addressOffset()
 
 void QHexEditPrivate::setData(std::unique_ptr<QHexEditData> data)
 {
-    _data = std::move(data);
+    // other views of the current document keep it with its undo history
+    setDocument(std::make_shared<QHexEditDocument>(std::move(data)));
+}
+
+QHexEditData & QHexEditPrivate::data()
+{
+    return *_data;
+}
+
+void QHexEditPrivate::setDocument(std::shared_ptr<QHexEditDocument> document)
+{
+    disconnect(_document.get(), 0, this, 0);
+    _document = std::move(document);
+    _data = &_document->data();
+    connect(_document.get(), SIGNAL(dataRangeChanged(size_t,size_t,bool)), this, SLOT(documentChanged(size_t,size_t,bool)));
+    connect(_document.get(), SIGNAL(hashesReady(size_t,size_t)), this, SIGNAL(hashesReady(size_t,size_t)));
+    connect(_document.get(), SIGNAL(undoHistoryLost()), this, SIGNAL(undoHistoryLost()));
+
+    _ensureVisiblePending = false;
+    if (!_data->canInsert()) {
+        setOverwriteMode(true);
+    }
     adjust();
     adjustCursor(0, CURSORAREA_HEX);
     resetSelection();
     ensureVisible(); // scroll to start
 }
 
-QHexEditData & QHexEditPrivate::data()
+std::shared_ptr<QHexEditDocument> QHexEditPrivate::document() const
 {
-    return *_data;
+    return _document;
 }
 
 void QHexEditPrivate::setAddressAreaColor(const QColor &color)
@@ -118,6 +155,17 @@ bool QHexEditPrivate::isReadOnly()
     return _readOnly;
 }
 
+void QHexEditPrivate::setFollowTail(bool followTail)
+{
+    _followTail = followTail;
+    _scrollToEnd = false;
+}
+
+bool QHexEditPrivate::followTail() const
+{
+    return _followTail;
+}
+
 int QHexEditPrivate::indexOf(const QByteArray & ba, size_t from)
 {
     from = std::min(from, _data->size() - 1);
@@ -145,15 +193,11 @@ void QHexEditPrivate::insert(size_t index, const QByteArray & ba)
         return;
     }
 
-    QUndoCommand * arrayCommand;
     if (_overwriteMode) {
-        arrayCommand = new ArrayCommand(*_data, ArrayCommand::replace, index, ba, ba.length());
+        _document->applyArray(ArrayCommand::replace, index, ba, ba.length());
     } else {
-        arrayCommand = new ArrayCommand(*_data, ArrayCommand::insert, index, ba, ba.length());
+        _document->applyArray(ArrayCommand::insert, index, ba, ba.length());
     }
-
-    _undoStack->push(arrayCommand);
-    emit dataChanged();
 }
 
 void QHexEditPrivate::insert(size_t index, char ch)
@@ -164,9 +208,7 @@ void QHexEditPrivate::insert(size_t index, char ch)
         return;
     }
 
-    QUndoCommand *charCommand = new CharCommand(*_data, CharCommand::insert, index, ch);
-    _undoStack->push(charCommand);
-    emit dataChanged();
+    _document->applyChar(CharCommand::insert, index, ch);
 }
 
 int QHexEditPrivate::lastIndexOf(const QByteArray & ba, size_t from)
@@ -206,15 +248,11 @@ void QHexEditPrivate::remove(size_t index, int len)
     {
         if (_overwriteMode)
         {
-            QUndoCommand *charCommand = new CharCommand(*_data, CharCommand::replace, index, char(0));
-            _undoStack->push(charCommand);
-            emit dataChanged();
+            _document->applyChar(CharCommand::replace, index, char(0));
         }
         else
         {
-            QUndoCommand *charCommand = new CharCommand(*_data, CharCommand::remove, index, char(0));
-            _undoStack->push(charCommand);
-            emit dataChanged();
+            _document->applyChar(CharCommand::remove, index, char(0));
         }
     }
     else
@@ -222,15 +260,11 @@ void QHexEditPrivate::remove(size_t index, int len)
         QByteArray ba = QByteArray(len, char(0));
         if (_overwriteMode)
         {
-            QUndoCommand *arrayCommand = new ArrayCommand(*_data, ArrayCommand::replace, index, ba, ba.length());
-            _undoStack->push(arrayCommand);
-            emit dataChanged();
+            _document->applyArray(ArrayCommand::replace, index, ba, ba.length());
         }
         else
         {
-            QUndoCommand *arrayCommand= new ArrayCommand(*_data, ArrayCommand::remove, index, ba, len);
-            _undoStack->push(arrayCommand);
-            emit dataChanged();
+            _document->applyArray(ArrayCommand::remove, index, QByteArray(), len);
         }
     }
 }
@@ -241,10 +275,8 @@ void QHexEditPrivate::replace(size_t index, char ch)
         return;
     }
 
-    QUndoCommand *charCommand = new CharCommand(*_data, CharCommand::replace, index, ch);
-    _undoStack->push(charCommand);
+    _document->applyChar(CharCommand::replace, index, ch);
     resetSelection();
-    emit dataChanged();
 }
 
 void QHexEditPrivate::replace(size_t index, const QByteArray & ba)
@@ -253,10 +285,8 @@ void QHexEditPrivate::replace(size_t index, const QByteArray & ba)
         return;
     }
 
-    QUndoCommand *arrayCommand= new ArrayCommand(*_data, ArrayCommand::replace, index, ba, ba.length());
-    _undoStack->push(arrayCommand);
+    _document->applyArray(ArrayCommand::replace, index, ba, ba.length());
     resetSelection();
-    emit dataChanged();
 }
 
 void QHexEditPrivate::replace(size_t from, int len, const QByteArray & after)
@@ -265,10 +295,8 @@ void QHexEditPrivate::replace(size_t from, int len, const QByteArray & after)
         return;
     }
 
-    QUndoCommand *arrayCommand= new ArrayCommand(*_data, ArrayCommand::replace, from, after, len);
-    _undoStack->push(arrayCommand);
+    _document->applyArray(ArrayCommand::replace, from, after, len);
     resetSelection();
-    emit dataChanged();
 }
 
 void QHexEditPrivate::setAddressArea(bool addressArea)
@@ -287,16 +315,57 @@ void QHexEditPrivate::setAddressWidth(int addressWidth)
     adjustCursor(_cursorPosition, _cursorArea);
 }
 
+void QHexEditPrivate::setBytesPerLine(int bytesPerLine)
+{
+    _layout.setBytesPerLine(bytesPerLine);
+    adjust();
+
+    adjustCursor(_cursorPosition, _cursorArea);
+    ensureVisible();
+}
+
+int QHexEditPrivate::bytesPerLine() const
+{
+    return _layout.bytesPerLine;
+}
+
+void QHexEditPrivate::setGroupSize(int groupSize)
+{
+    _layout.setGroupSize(groupSize);
+    adjust();
+
+    adjustCursor(_cursorPosition, _cursorArea);
+}
+
+int QHexEditPrivate::groupSize() const
+{
+    return _layout.groupSize;
+}
+
 void QHexEditPrivate::setAsciiArea(bool asciiArea)
 {
     _asciiArea = asciiArea;
     adjust();
 }
 
+void QHexEditPrivate::setInspector(ValueDecoder::Type type, bool bigEndian, int stride)
+{
+    _inspector.setType(type);
+    _inspector.setBigEndian(bigEndian);
+    _inspector.setStride(stride);
+    adjust();
+}
+
+const ValueDecoder & QHexEditPrivate::inspector() const
+{
+    return _inspector;
+}
+
 void QHexEditPrivate::setFont(const QFont &font)
 {
     // we have to maintain our own font because Qt doesn't always respect our choice
     _monospacedFont = font;
+    _layout.invalidate();
     adjust();
 }
 
@@ -313,6 +382,8 @@ void QHexEditPrivate::setHighlighting(bool mode)
 
 void QHexEditPrivate::setOverwriteMode(bool overwriteMode)
 {
+    // data, which can't insert, is always overwritten
+    overwriteMode = overwriteMode || !_data->canInsert();
     if (overwriteMode != _overwriteMode)
     {
         _overwriteMode = overwriteMode;
@@ -327,20 +398,87 @@ bool QHexEditPrivate::overwriteMode()
 
 void QHexEditPrivate::redo()
 {
-    _undoStack->redo();
-    emit dataChanged();
+    _document->redo();
     adjustCursor(_cursorPosition, _cursorArea);
-    update();
 }
 
 void QHexEditPrivate::undo()
 {
-    _undoStack->undo();
-    emit dataChanged();
+    _document->undo();
     adjustCursor(_cursorPosition, _cursorArea);
+}
+
+void QHexEditPrivate::setUndoMemoryLimit(size_t limit)
+{
+    _document->setUndoMemoryLimit(limit);
+}
+
+size_t QHexEditPrivate::undoMemoryLimit() const
+{
+    return _document->undoMemoryLimit();
+}
+
+size_t QHexEditPrivate::undoMemoryUsage() const
+{
+    return _document->undoMemoryUsage();
+}
+
+size_t QHexEditPrivate::undoSpilledBytes() const
+{
+    return _document->undoSpilledBytes();
+}
+
+int QHexEditPrivate::openJournal(const QString & fileName, qint64 stamp, bool recover)
+{
+    return _document->openJournal(fileName, stamp, recover);
+}
+
+void QHexEditPrivate::closeJournal(bool discard)
+{
+    _document->closeJournal(discard);
+}
+
+bool QHexEditPrivate::hasJournal() const
+{
+    return _document->hasJournal();
+}
+
+void QHexEditPrivate::requestHashes(int algorithms, bool selection)
+{
+    if (selection) {
+        _document->hashEngine().request(getSelectionBegin(), getSelectionEnd() - getSelectionBegin(), algorithms);
+    } else {
+        _document->hashEngine().requestAll(algorithms);
+    }
+}
+
+QByteArray QHexEditPrivate::hash(HashEngine::Algorithm algorithm) const
+{
+    return _document->hashEngine().result(algorithm);
+}
+
+void QHexEditPrivate::addHighlighter(QHexEditHighlighter * highlighter)
+{
+    _highlighters.push_back(highlighter);
     update();
 }
 
+void QHexEditPrivate::removeHighlighter(QHexEditHighlighter * highlighter)
+{
+    _highlighters.erase(std::remove(_highlighters.begin(), _highlighters.end(), highlighter), _highlighters.end());
+    update();
+}
+
+size_t QHexEditPrivate::topAddress() const
+{
+    return static_cast<size_t>(_scrollArea->verticalScrollBar()->value() / _layout.charHeight) << _layout.lineShift;
+}
+
+void QHexEditPrivate::setTopAddress(size_t address)
+{
+    _scrollArea->verticalScrollBar()->setValue((address >> _layout.lineShift) * _layout.charHeight);
+}
+
 QString QHexEditPrivate::toRedableString()
 {
     return _data->toRedableString();
@@ -369,7 +507,10 @@ void QHexEditPrivate::keyPressEvent(QKeyEvent *event)
     }
 
     ensureVisible();
-    update();
+    // the size may grow with the pending edits, then the cursor is visible afterwards
+    if (_document->changesPending()) {
+        _ensureVisiblePending = true;
+    }
 }
 
 bool QHexEditPrivate::cursorEvent(QKeyEvent * event)
@@ -386,27 +527,27 @@ bool QHexEditPrivate::cursorEvent(QKeyEvent * event)
         adjustCursor(_cursorPosition - 1, _cursorArea);
         resetSelection(_cursorPosition);
     } else if (event->matches(QKeySequence::MoveToEndOfLine)) {
-        int cPos = _cursorPosition | (steps * BYTES_PER_LINE - 1);
+        int cPos = _cursorPosition | (steps * _layout.bytesPerLine - 1);
         adjustCursor(cPos, _cursorArea);
         resetSelection(_cursorPosition);
     } else if (event->matches(QKeySequence::MoveToStartOfLine)) {
-        int cPos = _cursorPosition - (_cursorPosition % (steps * BYTES_PER_LINE));
+        int cPos = _cursorPosition - (_cursorPosition % (steps * _layout.bytesPerLine));
         adjustCursor(cPos, _cursorArea);
         resetSelection(_cursorPosition);
     } else if (event->matches(QKeySequence::MoveToPreviousLine)) {
-        int cPos = _cursorPosition - (steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition - (steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         resetSelection(_cursorPosition);
     } else if (event->matches(QKeySequence::MoveToNextLine)) {
-        int cPos = _cursorPosition + (steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition + (steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         resetSelection(_cursorPosition);
     } else if (event->matches(QKeySequence::MoveToNextPage)) {
-        int cPos = _cursorPosition + (((_scrollArea->viewport()->height() / _charHeight) - 1) * steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition + (((_scrollArea->viewport()->height() / _layout.charHeight) - 1) * steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         resetSelection(_cursorPosition);
     } else if (event->matches(QKeySequence::MoveToPreviousPage)) {
-        int cPos = _cursorPosition - (((_scrollArea->viewport()->height() / _charHeight) - 1) * steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition - (((_scrollArea->viewport()->height() / _layout.charHeight) - 1) * steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         resetSelection(_cursorPosition);
     } else if (event->matches(QKeySequence::MoveToEndOfDocument)) {
@@ -442,27 +583,27 @@ bool QHexEditPrivate::selectEvent(QKeyEvent * event)
         adjustCursor(cPos, _cursorArea);
         setSelection(cPos);
     } else if (event->matches(QKeySequence::SelectEndOfLine)) {
-        int cPos = _cursorPosition - (_cursorPosition % (steps * BYTES_PER_LINE)) + (steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition - (_cursorPosition % (steps * _layout.bytesPerLine)) + (steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         setSelection(cPos);
     } else if (event->matches(QKeySequence::SelectStartOfLine)) {
-        int cPos = _cursorPosition - (_cursorPosition % (steps * BYTES_PER_LINE));
+        int cPos = _cursorPosition - (_cursorPosition % (steps * _layout.bytesPerLine));
         adjustCursor(cPos, _cursorArea);
         setSelection(cPos);
     } else if (event->matches(QKeySequence::SelectPreviousLine)) {
-        int cPos = _cursorPosition - (steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition - (steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         setSelection(cPos);
     } else if (event->matches(QKeySequence::SelectNextLine)) {
-        int cPos = _cursorPosition + (steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition + (steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         setSelection(cPos);
     } else if (event->matches(QKeySequence::SelectNextPage)) {
-        int cPos = _cursorPosition + (((_scrollArea->viewport()->height() / _charHeight) - 1) * steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition + (((_scrollArea->viewport()->height() / _layout.charHeight) - 1) * steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         setSelection(cPos);
     } else if (event->matches(QKeySequence::SelectPreviousPage)) {
-        int cPos = _cursorPosition - (((_scrollArea->viewport()->height() / _charHeight) - 1) * steps * BYTES_PER_LINE);
+        int cPos = _cursorPosition - (((_scrollArea->viewport()->height() / _layout.charHeight) - 1) * steps * _layout.bytesPerLine);
         adjustCursor(cPos, _cursorArea);
         setSelection(cPos);
     } else if (event->matches(QKeySequence::SelectEndOfDocument)) {
@@ -484,17 +625,16 @@ bool QHexEditPrivate::selectEvent(QKeyEvent * event)
 bool QHexEditPrivate::editEvent(QKeyEvent * event)
 {
     const int size = static_cast<int>(_data->size());
-    int steps, charX, posX, posBa;
+    int steps, posBa;
+    bool firstNibble;
     if (_cursorArea == CURSORAREA_HEX) {
         steps = 2;
-        charX = (_cursorX - _xPosHex) / _charWidth;
-        posX  = (charX / 3) * 2 + (charX % 3);
-        posBa = (_cursorY / _charHeight) * BYTES_PER_LINE + posX / 2;
+        posBa = _cursorPosition / 2;
+        firstNibble = (_cursorPosition & 1) == 0;
     } else {
         steps = 1;
-        charX = (_cursorX - _xPosAscii) / _charWidth;
-        posX  = charX;
-        posBa = (_cursorY / _charHeight) * BYTES_PER_LINE + posX;
+        posBa = _cursorPosition;
+        firstNibble = true;
     }
 
     /*****************************************************************************/
@@ -518,7 +658,7 @@ bool QHexEditPrivate::editEvent(QKeyEvent * event)
         }
 
         // If insert mode, then insert a byte
-        if (_overwriteMode == false && (charX % 3) == 0) {
+        if (_overwriteMode == false && firstNibble) {
             insert(posBa, char(0));
         }
 
@@ -526,7 +666,7 @@ bool QHexEditPrivate::editEvent(QKeyEvent * event)
         if (_data->size() > 0)
         {
             QByteArray hexValue = _data->range(posBa, 1).toHex();
-            if ((charX % 3) == 0)
+            if (firstNibble)
                 hexValue[0] = key;
             else
                 hexValue[1] = key;
@@ -565,7 +705,7 @@ bool QHexEditPrivate::editEvent(QKeyEvent * event)
         for (int idx = getSelectionBegin(); idx < getSelectionEnd(); idx++)
         {
             result += _data->range(idx, 1).toHex() + " ";
-            if ((idx % 16) == 15)
+            if ((idx & (_layout.bytesPerLine - 1)) == _layout.bytesPerLine - 1)
                 result.append("\n");
         }
         remove(getSelectionBegin(), getSelectionEnd() - getSelectionBegin());
@@ -658,7 +798,7 @@ bool QHexEditPrivate::copyEvent(QKeyEvent * event)
         {
             //result += _xData.data().mid(idx, 1).toHex() + " ";
             result += _data->range(idx, 1).toHex() + " ";
-            if ((idx % 16) == 15)
+            if ((idx & (_layout.bytesPerLine - 1)) == _layout.bytesPerLine - 1)
                 result.append('\n');
         }
         QClipboard *clipboard = QApplication::clipboard();
@@ -731,10 +871,16 @@ void QHexEditPrivate::paintEvent(QPaintEvent *event)
     // draw some patterns if needed
     painter.fillRect(event->rect(), this->palette().color(QPalette::Base));
     if (_addressArea)
-        painter.fillRect(QRect(_xPosAdr, event->rect().top(), _xPosHex - GAP_ADR_HEX + _charWidth / 2, height()), _addressAreaColor);
+        painter.fillRect(QRect(_layout.xPosAdr, event->rect().top(), _layout.addressAreaWidth, height()), _addressAreaColor);
     if (_asciiArea)
     {
-        int linePos = _xPosAscii - (GAP_HEX_ASCII / 2);
+        int linePos = _layout.separatorX;
+        painter.setPen(Qt::gray);
+        painter.drawLine(linePos, event->rect().top(), linePos, height());
+    }
+    if (_layout.inspectorChars > 0)
+    {
+        int linePos = _layout.inspectorSeparatorX;
         painter.setPen(Qt::gray);
         painter.drawLine(linePos, event->rect().top(), linePos, height());
     }
@@ -743,30 +889,56 @@ void QHexEditPrivate::paintEvent(QPaintEvent *event)
 
     // calc position
     size_t firstLineIdx = 0;
-    if (top > (_charHeight * _charHeight)) { // underflow condition
-        firstLineIdx = ((top /  _charHeight) - _charHeight) * BYTES_PER_LINE;
+    if (top > (_layout.charHeight * _layout.charHeight)) { // underflow condition
+        firstLineIdx = ((top /  _layout.charHeight) - _layout.charHeight) << _layout.lineShift;
     }
 
-    size_t lastLineIdx = ((bottom / _charHeight) + _charHeight) * BYTES_PER_LINE;
+    size_t lastLineIdx = ((bottom / _layout.charHeight) + _layout.charHeight) << _layout.lineShift;
     if (lastLineIdx > _data->size()) {
         lastLineIdx = _data->size();
     }
 
-    int yPosStart = ((firstLineIdx) / BYTES_PER_LINE) * _charHeight + _charHeight;
+    int yPosStart = (firstLineIdx >> _layout.lineShift) * _layout.charHeight + _layout.charHeight;
 
     // paint address area
     if (_addressArea)
     {
-        for (size_t lineIdx = firstLineIdx, yPos = yPosStart; lineIdx < lastLineIdx; lineIdx += BYTES_PER_LINE, yPos +=_charHeight)
+        for (size_t lineIdx = firstLineIdx, yPos = yPosStart; lineIdx < lastLineIdx; lineIdx += _layout.bytesPerLine, yPos +=_layout.charHeight)
         {
             QString address = QString("%1")
-                              .arg(lineIdx + _data->addressOffset(), _data->realAddressNumbers(), 16, QChar('0'));
-            painter.drawText(_xPosAdr, yPos, address);
+                              .arg(_data->address(lineIdx), _layout.addressNumbers, 16, QChar('0'));
+            painter.drawText(_layout.xPosAdr, yPos, address);
+        }
+    }
+
+    // colours of the highlighters, later ones win
+    std::vector<QColor> colors;
+    if (!_highlighters.empty() && firstLineIdx < lastLineIdx)
+    {
+        colors.resize(lastLineIdx - firstLineIdx);
+        for (const QHexEditHighlighter * highlighter : _highlighters) {
+            highlighter->highlight(firstLineIdx, lastLineIdx, colors.data());
         }
     }
 
-    // paint hex area
-    QByteArray hexBa(_data->range(firstLineIdx, lastLineIdx - firstLineIdx + 1).toHex());
+    // holes of the data are shown empty
+    std::vector<char> holes;
+    size_t hole = _data->nextHole(firstLineIdx);
+    if (hole < lastLineIdx)
+    {
+        holes.resize(lastLineIdx - firstLineIdx);
+        while (hole < lastLineIdx)
+        {
+            const size_t holeEnd = std::min(_data->nextData(hole), lastLineIdx);
+            std::fill(holes.begin() + (hole - firstLineIdx), holes.begin() + (holeEnd - firstLineIdx), 1);
+            hole = _data->nextHole(holeEnd);
+        }
+    }
+
+    // paint hex area, the window holds the bytes of the values reaching into the next line
+    const size_t windowSize = std::min(lastLineIdx - firstLineIdx + ValueDecoder::MAX_SIZE, _data->size() - std::min(firstLineIdx, _data->size()));
+    const QByteArray window = _data->range(firstLineIdx, windowSize);
+    QByteArray hexBa(window.toHex());
     QBrush highLighted = QBrush(_highlightingColor);
     QPen colHighlighted = QPen(this->palette().color(QPalette::WindowText));
     QBrush selected = QBrush(_selectionColor);
@@ -775,11 +947,11 @@ void QHexEditPrivate::paintEvent(QPaintEvent *event)
 
     painter.setBackgroundMode(Qt::TransparentMode);
 
-    for (size_t lineIdx = firstLineIdx, yPos = yPosStart; lineIdx < lastLineIdx; lineIdx += BYTES_PER_LINE, yPos +=_charHeight)
+    const int groupMask = _layout.groupSize - 1;
+    for (size_t lineIdx = firstLineIdx, yPos = yPosStart; lineIdx < lastLineIdx; lineIdx += _layout.bytesPerLine, yPos +=_layout.charHeight)
     {
         QByteArray hex;
-        int xPos = _xPosHex;
-        for (int colIdx = 0; ((lineIdx + colIdx) < _data->size() and (colIdx < BYTES_PER_LINE)); colIdx++)
+        for (int colIdx = 0; ((lineIdx + colIdx) < _data->size() and (colIdx < _layout.bytesPerLine)); colIdx++)
         {
             int posBa = lineIdx + colIdx;
             if ((getSelectionBegin() <= posBa) && (getSelectionEnd() > posBa))
@@ -788,6 +960,12 @@ void QHexEditPrivate::paintEvent(QPaintEvent *event)
                 painter.setBackgroundMode(Qt::OpaqueMode);
                 painter.setPen(colSelected);
             }
+            else if (!colors.empty() && colors[posBa - firstLineIdx].isValid())
+            {
+                painter.setBackground(colors[posBa - firstLineIdx]);
+                painter.setBackgroundMode(Qt::OpaqueMode);
+                painter.setPen(colStandard);
+            }
             else if (_highlighting)
             {
                 // highlight diff bytes
@@ -804,27 +982,17 @@ void QHexEditPrivate::paintEvent(QPaintEvent *event)
                 }
             }
 
-            // render hex value
-            if (colIdx == 0)
-            {
-                hex = hexBa.mid((lineIdx - firstLineIdx) * 2, 2);
-                painter.drawText(xPos, yPos, hex);
-                xPos += 2 * _charWidth;
+            // render hex value, a group starts with the blank in front of it
+            if (!holes.empty() && holes[posBa - firstLineIdx]) {
+                hex = "  ";
             } else {
-                hex = hexBa.mid((lineIdx + colIdx - firstLineIdx) * 2, 2).prepend(" ");
-                painter.drawText(xPos, yPos, hex);
-                xPos += 3 * _charWidth;
+                hex = hexBa.mid((lineIdx + colIdx - firstLineIdx) * 2, 2);
             }
-
-#if 0
-            if (colIdx != 0) {
-                xPos += _charWidth;
+            if (colIdx != 0 && (colIdx & groupMask) == 0) {
+                painter.drawText(_layout.nibbleX[2 * colIdx] - _layout.charWidth, yPos, hex.prepend(" "));
+            } else {
+                painter.drawText(_layout.nibbleX[2 * colIdx], yPos, hex);
             }
-
-            hex = hexBa.mid((lineIdx + colIdx - firstLineIdx) * 2, 2);
-            painter.drawText(xPos, yPos, hex);
-            xPos += 2 * _charWidth;
-#endif
         }
     }
     painter.setBackgroundMode(Qt::TransparentMode);
@@ -833,10 +1001,9 @@ void QHexEditPrivate::paintEvent(QPaintEvent *event)
     // paint ascii area
     if (_asciiArea)
     {
-        for (size_t lineIdx = firstLineIdx, yPos = yPosStart; lineIdx < lastLineIdx; lineIdx += BYTES_PER_LINE, yPos +=_charHeight)
+        for (size_t lineIdx = firstLineIdx, yPos = yPosStart; lineIdx < lastLineIdx; lineIdx += _layout.bytesPerLine, yPos +=_layout.charHeight)
         {
-            int xPosAscii = _xPosAscii;
-            for (int colIdx = 0; ((lineIdx + colIdx) < _data->size() and (colIdx < BYTES_PER_LINE)); colIdx++)
+            for (int colIdx = 0; ((lineIdx + colIdx) < _data->size() and (colIdx < _layout.bytesPerLine)); colIdx++)
             {
                 int posBa = lineIdx + colIdx;
 
@@ -845,24 +1012,57 @@ void QHexEditPrivate::paintEvent(QPaintEvent *event)
                     painter.setBackground(selected);
                     painter.setBackgroundMode(Qt::OpaqueMode);
                     painter.setPen(colSelected);
+                } else if (!colors.empty() && colors[posBa - firstLineIdx].isValid()) {
+                    painter.setBackground(colors[posBa - firstLineIdx]);
+                    painter.setBackgroundMode(Qt::OpaqueMode);
+                    painter.setPen(colStandard);
                 } else {
                     painter.setBackgroundMode(Qt::TransparentMode);
                     painter.setPen(colStandard);
                 }
 
-                painter.drawText(xPosAscii, yPos, _data->asciiChar(lineIdx + colIdx));
-                xPosAscii += _charWidth;
+                const bool inHole = !holes.empty() && holes[posBa - firstLineIdx];
+                painter.drawText(_layout.asciiX[colIdx], yPos, inHole ? QChar(' ') : _data->asciiChar(lineIdx + colIdx));
             }
         }
     }
 
+    // paint inspector area, one text per line
+    if (_layout.inspectorChars > 0 && firstLineIdx < lastLineIdx)
+    {
+        const size_t lines = ((lastLineIdx - firstLineIdx - 1) >> _layout.lineShift) + 1;
+        _inspector.decode(reinterpret_cast<const uchar *>(window.constData()), window.size(), lines, _layout.bytesPerLine, _inspectorText);
+
+        const int perLine = _inspector.valuesPerLine(_layout.bytesPerLine);
+        const int cell = _inspector.cellChars();
+        const size_t step = _inspector.step();
+        if (!holes.empty())
+        {
+            // a value starting in a hole is shown empty
+            for (size_t idx = 0; idx < lines * perLine; idx++)
+            {
+                const size_t pos = ((idx / perLine) << _layout.lineShift) + (idx % perLine) * step;
+                if (pos < holes.size() && holes[pos]) {
+                    std::fill_n(_inspectorText.begin() + (idx / perLine) * _layout.inspectorChars + (idx % perLine) * cell, cell, ' ');
+                }
+            }
+        }
+
+        const char * text = _inspectorText.data();
+        for (size_t lineIdx = firstLineIdx, yPos = yPosStart; lineIdx < lastLineIdx; lineIdx += _layout.bytesPerLine, yPos +=_layout.charHeight)
+        {
+            painter.drawText(_layout.xPosInspector, yPos, QString::fromLatin1(text, _layout.inspectorChars));
+            text += _layout.inspectorChars;
+        }
+    }
+
     // paint cursor
     if (_blink && !_readOnly && hasFocus())
     {
         if (_overwriteMode)
-            painter.fillRect(_cursorX, _cursorY + _charHeight - 2, _charWidth, 2, this->palette().color(QPalette::WindowText));
+            painter.fillRect(_cursorX, _cursorY + _layout.charHeight - 2, _layout.charWidth, 2, this->palette().color(QPalette::WindowText));
         else
-            painter.fillRect(_cursorX, _cursorY, 2, _charHeight, this->palette().color(QPalette::WindowText));
+            painter.fillRect(_cursorX, _cursorY, 2, _layout.charHeight, this->palette().color(QPalette::WindowText));
     }
 
     if (_size != _data->size())
@@ -881,7 +1081,7 @@ void QHexEditPrivate::adjustCursor(size_t position, CursorArea_t area)
 
     // delete cursor
     _blink = false;
-    update();
+    update(_cursorX, _cursorY, _layout.charWidth, _layout.charHeight);
 
     // cursor in range?
     if (_overwriteMode) {
@@ -893,18 +1093,19 @@ void QHexEditPrivate::adjustCursor(size_t position, CursorArea_t area)
 
     // calc position
     _cursorPosition = cursorPosition;
-    _cursorY = (cursorPosition / (factor * BYTES_PER_LINE)) * _charHeight + 4;
+    const int shift = _layout.lineShift + factor - 1;
+    _cursorY = (cursorPosition >> shift) * _layout.charHeight + 4;
 
-    int x = (cursorPosition % (factor * BYTES_PER_LINE));
+    int x = cursorPosition & ((1 << shift) - 1);
     if (area == CURSORAREA_HEX) {
-        _cursorX = (((x / 2) * 3) + (x % 2)) * _charWidth + _xPosHex;
+        _cursorX = _layout.nibbleX[x];
     } else {
-        _cursorX = x * _charWidth + _xPosAscii;
+        _cursorX = _layout.asciiX[x];
     }
 
     // immiadately draw cursor
     _blink = true;
-    update();
+    update(_cursorX, _cursorY, _layout.charWidth, _layout.charHeight);
 
     emit currentAddressChanged(_cursorPosition / factor);
 }
@@ -912,25 +1113,21 @@ void QHexEditPrivate::adjustCursor(size_t position, CursorArea_t area)
 int QHexEditPrivate::calcCursorInfo(QPoint pnt, int & pos, CursorArea_t & area)
 {
     // find char under cursor
-    const int hexAreaEnd = _xPosHex + (HEXCHARS_IN_LINE + 2) * _charWidth;
-    if ((pnt.x() >= _xPosHex) and (pnt.x() < hexAreaEnd))
+    const int hexAreaEnd = _layout.hexAreaEnd;
+    if ((pnt.x() >= _layout.xPosHex) and (pnt.x() < hexAreaEnd))
     {
-        int x = (pnt.x() - _xPosHex) / _charWidth;
-        if ((x % 3) == 0)
-            x = (x / 3) * 2;
-        else
-            x = ((x / 3) * 2) + 1;
-        int y = ((pnt.y() - 3) / _charHeight) * 2 * BYTES_PER_LINE;
+        int x = _layout.hexColumnAt(pnt.x());
+        int y = ((pnt.y() - 3) / _layout.charHeight) << (_layout.lineShift + 1);
 
         pos = x + y;
         area = CURSORAREA_HEX;
         return 0;
     }
 
-    const int asciiAreaEnd = _xPosAscii + (BYTES_PER_LINE * _charWidth);
-    if (_asciiArea and (pnt.x() >= _xPosAscii) and (pnt.x() < asciiAreaEnd)) {
-        int x = (pnt.x() - _xPosAscii) / _charWidth;
-        int y = ((pnt.y() - 3) / _charHeight) * BYTES_PER_LINE;
+    const int asciiAreaEnd = _layout.asciiAreaEnd;
+    if (_asciiArea and (pnt.x() >= _layout.xPosAscii) and (pnt.x() < asciiAreaEnd)) {
+        int x = (pnt.x() - _layout.xPosAscii) / _layout.charWidth;
+        int y = ((pnt.y() - 3) / _layout.charHeight) << _layout.lineShift;
 /*
         printf("ascii cursor: %d\n", x+y);
         fflush(stdout);
@@ -948,10 +1145,33 @@ int QHexEditPrivate::cursorPos() const
     return _cursorPosition;
 }
 
+void QHexEditPrivate::gotoAddress(size_t address)
+{
+    adjustCursor(2 * address, CURSORAREA_HEX);
+    resetSelection(_cursorPosition);
+    ensureVisible();
+}
+
+bool QHexEditPrivate::gotoNextData()
+{
+    // inside a hole its end is the next data, otherwise the end of the
+    // following hole
+    const size_t pos = _cursorArea == CURSORAREA_HEX ? _cursorPosition / 2 : _cursorPosition;
+    const size_t data = _data->nextData(_data->nextHole(pos));
+    if (data >= _data->size()) {
+        return false;
+    }
+    gotoAddress(data);
+    return true;
+}
+
 void QHexEditPrivate::resetSelection()
 {
+    const int oldBegin = _selectionBegin;
+    const int oldEnd = _selectionEnd;
     _selectionBegin = _selectionInit;
     _selectionEnd = _selectionInit;
+    updateSelection(oldBegin, oldEnd);
 }
 
 void QHexEditPrivate::resetSelection(int pos)
@@ -963,9 +1183,12 @@ void QHexEditPrivate::resetSelection(int pos)
     pos = std::max(pos, 0);
     pos = std::min(pos, static_cast<int>(_data->size()));
 
+    const int oldBegin = _selectionBegin;
+    const int oldEnd = _selectionEnd;
     _selectionInit = pos;
     _selectionBegin = pos;
     _selectionEnd = pos;
+    updateSelection(oldBegin, oldEnd);
 }
 
 void QHexEditPrivate::setSelection(int pos)
@@ -977,6 +1200,8 @@ void QHexEditPrivate::setSelection(int pos)
     pos = std::max(pos, 0);
     pos = std::min(pos, static_cast<int>(_data->size()));
 
+    const int oldBegin = _selectionBegin;
+    const int oldEnd = _selectionEnd;
     if (pos >= _selectionInit) {
         _selectionEnd = pos;
         _selectionBegin = _selectionInit;
@@ -984,6 +1209,7 @@ void QHexEditPrivate::setSelection(int pos)
         _selectionBegin = pos;
         _selectionEnd = _selectionInit;
     }
+    updateSelection(oldBegin, oldEnd);
 
 //    std::cout << "begin:" << _selectionBegin << " end:" << _selectionEnd << std::endl;
 }
@@ -1002,35 +1228,135 @@ int QHexEditPrivate::getSelectionEnd()
 void QHexEditPrivate::updateCursor()
 {
     _blink = !_blink;
-    update(_cursorX, _cursorY, _charWidth, _charHeight);
+    update(_cursorX, _cursorY, _layout.charWidth, _layout.charHeight);
+}
+
+void QHexEditPrivate::documentChanged(size_t pos, size_t len, bool sizeChanged)
+{
+    // only inserted or removed bytes change the layout, they move all
+    // following lines
+    const int xPosHex = _layout.xPosHex;
+    if (sizeChanged)
+    {
+        // the scroll area resizes this widget later, it follows then
+        const QScrollBar * bar = _scrollArea->verticalScrollBar();
+        _scrollToEnd = _followTail && bar->value() == bar->maximum();
+        relayout();
+        updateBytes(pos, std::numeric_limits<size_t>::max());
+
+        // another view of the document may have removed the bytes under
+        // the cursor or the selection
+        const int size = static_cast<int>(_data->size());
+        if (_selectionEnd > size)
+        {
+            const int oldBegin = _selectionBegin;
+            const int oldEnd = _selectionEnd;
+            _selectionInit = std::min(_selectionInit, size);
+            _selectionBegin = std::min(_selectionBegin, size);
+            _selectionEnd = size;
+            updateSelection(oldBegin, oldEnd);
+        }
+        adjustCursor(_cursorPosition, _cursorArea);
+    }
+    else
+    {
+        updateBytes(pos, pos + len);
+    }
+
+    // the address area may have grown
+    if (xPosHex != _layout.xPosHex)
+    {
+        update();
+        adjustCursor(_cursorPosition, _cursorArea);
+    }
+
+    emit dataRangeChanged(pos, len, sizeChanged);
+    emit dataChanged();
+
+    if (_ensureVisiblePending)
+    {
+        _ensureVisiblePending = false;
+        ensureVisible();
+    }
+}
+
+void QHexEditPrivate::scrollRangeChanged(int /*min*/, int max)
+{
+    if (_scrollToEnd)
+    {
+        _scrollToEnd = false;
+        _scrollArea->verticalScrollBar()->setValue(max);
+    }
 }
 
 void QHexEditPrivate::adjust()
 {
-    QFontMetrics metrics(_monospacedFont);
-    _charWidth = metrics.width(QLatin1Char('9'));
-    _charHeight = metrics.height();
+    relayout();
+    update();
+}
 
-    _xPosAdr = 0;
-    if (_addressArea)
-        _xPosHex = _data->realAddressNumbers() * _charWidth + GAP_ADR_HEX;
-    else
-        _xPosHex = 0;
-    _xPosAscii = _xPosHex + HEXCHARS_IN_LINE * _charWidth + GAP_HEX_ASCII;
+void QHexEditPrivate::relayout()
+{
+    _layout.update(_monospacedFont, _data->realAddressNumbers(), _addressArea, _asciiArea, _inspector.lineChars(_layout.bytesPerLine));
 
     // tell QAbstractScollbar, how big we are
-    setMinimumHeight(((_data->size() / 16 + 1) * _charHeight) + 5);
-    if(_asciiArea)
-        setMinimumWidth(_xPosAscii + (BYTES_PER_LINE * _charWidth));
-    else
-        setMinimumWidth(_xPosHex + HEXCHARS_IN_LINE * _charWidth);
+    setMinimumHeight((((_data->size() >> _layout.lineShift) + 1) * _layout.charHeight) + 5);
+    setMinimumWidth(_layout.minimumWidth);
+}
 
-    update();
+void QHexEditPrivate::updateBytes(size_t begin, size_t end)
+{
+    // lines outside of the viewport are painted when they are scrolled in,
+    // so views of other parts of the document skip the edits
+    const QRect visible = visibleRegion().boundingRect();
+    if (visible.isEmpty()) {
+        return;
+    }
+    const size_t firstVisible = static_cast<size_t>(std::max(visible.top() / _layout.charHeight - 1, 0)) << _layout.lineShift;
+    const size_t lastVisible = static_cast<size_t>(visible.bottom() / _layout.charHeight + 1) << _layout.lineShift;
+    begin = std::max(begin, firstVisible);
+    end = std::min(end, lastVisible);
+    if (end <= begin) {
+        return;
+    }
+
+    // the glyphs of a line reach a few pixels into the following line
+    const int firstLine = begin >> _layout.lineShift;
+    const int top = firstLine * _layout.charHeight;
+    if (end - begin >= static_cast<size_t>(height()) * _layout.bytesPerLine)
+    {
+        update(0, top, width(), height() - top);
+        return;
+    }
+
+    const int lastLine = (end - 1) >> _layout.lineShift;
+    update(0, top, width(), (lastLine - firstLine + 2) * _layout.charHeight);
+}
+
+void QHexEditPrivate::updateSelection(int oldBegin, int oldEnd)
+{
+    // the bytes which changed their selection state
+    if (oldBegin == _selectionBegin && oldEnd == _selectionEnd) {
+        return;
+    }
+    if (oldBegin == oldEnd)
+    {
+        updateBytes(_selectionBegin, _selectionEnd);
+    }
+    else if (_selectionBegin == _selectionEnd)
+    {
+        updateBytes(oldBegin, oldEnd);
+    }
+    else
+    {
+        updateBytes(std::min(oldBegin, _selectionBegin), std::max(oldBegin, _selectionBegin));
+        updateBytes(std::min(oldEnd, _selectionEnd), std::max(oldEnd, _selectionEnd));
+    }
 }
 
 void QHexEditPrivate::ensureVisible()
 {
     // scrolls to cursorx, cusory (which are set by setCursorPos)
     // x-margin is 3 pixels, y-margin is half of charHeight
-    _scrollArea->ensureVisible(_cursorX, _cursorY + _charHeight/2, 3, _charHeight/2 + 2);
+    _scrollArea->ensureVisible(_cursorX, _cursorY + _layout.charHeight/2, 3, _layout.charHeight/2 + 2);
 }
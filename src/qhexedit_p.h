@@ -12,6 +12,11 @@
 
 #include "xbytearray.h"
 #include "qhexeditdata.h"
+#include "commands.h"
+#include "hexlayout.h"
+#include "qhexeditdocument.h"
+#include "qhexedithighlighter.h"
+#include "valuedecoder.h"
 
 typedef enum _CursorArea {
     CURSORAREA_HEX,
@@ -24,6 +29,7 @@ Q_OBJECT
 
 public:
     QHexEditPrivate(QScrollArea *parent);
+    ~QHexEditPrivate();
 
     void setAddressAreaColor(QColor const &color);
     QColor addressAreaColor();
@@ -33,10 +39,14 @@ public:
 
     void adjustCursor(size_t position, CursorArea_t area);
     int cursorPos() const;
+    void gotoAddress(size_t address);       // moves the cursor and scrolls to it
+    bool gotoNextData();                    // to the data behind the next hole
     CursorArea_t cursorArea() const;
 
     void setData(std::unique_ptr<QHexEditData> data);
     QHexEditData & data();
+    void setDocument(std::shared_ptr<QHexEditDocument> document);
+    std::shared_ptr<QHexEditDocument> document() const;
 
     void setHighlightingColor(QColor const &color);
     QColor highlightingColor();
@@ -47,6 +57,9 @@ public:
     void setReadOnly(bool readOnly);
     bool isReadOnly();
 
+    void setFollowTail(bool followTail);
+    bool followTail() const;
+
     void setSelectionColor(QColor const &color);
     QColor selectionColor();
 
@@ -61,8 +74,14 @@ public:
 
     void setAddressArea(bool addressArea);
     void setAddressWidth(int addressWidth);
+    void setBytesPerLine(int bytesPerLine);
+    int bytesPerLine() const;
+    void setGroupSize(int groupSize);
+    int groupSize() const;
     void setAsciiArea(bool asciiArea);
     void setHighlighting(bool mode);
+    void setInspector(ValueDecoder::Type type, bool bigEndian, int stride);
+    const ValueDecoder & inspector() const;
 
     virtual void setFont(const QFont &font);
     virtual const QFont & font() const;
@@ -70,6 +89,24 @@ public:
     void undo();
     void redo();
 
+    void setUndoMemoryLimit(size_t limit);
+    size_t undoMemoryLimit() const;
+    size_t undoMemoryUsage() const;
+    size_t undoSpilledBytes() const;
+
+    int openJournal(const QString & fileName, qint64 stamp, bool recover);
+    void closeJournal(bool discard);
+    bool hasJournal() const;
+
+    void requestHashes(int algorithms, bool selection);
+    QByteArray hash(HashEngine::Algorithm algorithm) const;
+
+    void addHighlighter(QHexEditHighlighter * highlighter);
+    void removeHighlighter(QHexEditHighlighter * highlighter);
+
+    size_t topAddress() const;              // address of the first visible line
+    void setTopAddress(size_t address);     // scrolls without moving the cursor
+
     QString toRedableString();
     QString selectionToReadableString();
 
@@ -77,7 +114,10 @@ signals:
     void currentAddressChanged(int address);
     void currentSizeChanged(size_t size);
     void dataChanged();
+    void dataRangeChanged(size_t pos, size_t len, bool sizeChanged);
+    void hashesReady(size_t pos, size_t len);
     void overwriteModeChanged(bool state);
+    void undoHistoryLost();
 
 protected:
     void keyPressEvent(QKeyEvent * event);
@@ -106,9 +146,14 @@ protected:
 private slots:
     void updateCursor();
     void adjust();
+    void documentChanged(size_t pos, size_t len, bool sizeChanged);
+    void scrollRangeChanged(int min, int max);
 
 private:
     void ensureVisible();
+    void relayout();
+    void updateBytes(size_t begin, size_t end);     // repaints the visible lines of [begin, end)
+    void updateSelection(int oldBegin, int oldEnd);
 
     QFont _monospacedFont;
 
@@ -117,9 +162,13 @@ private:
     QColor _selectionColor;
     QScrollArea * _scrollArea;
     QTimer _cursorTimer;
-    QUndoStack * _undoStack;
 
-    std::unique_ptr<QHexEditData> _data;
+    std::shared_ptr<QHexEditDocument> _document;
+    QHexEditData * _data;                   // of _document
+    HexLayout _layout;                      // cached metrics and x-positions
+    std::vector<QHexEditHighlighter *> _highlighters;
+    ValueDecoder _inspector;                // values of the inspector area
+    std::vector<char> _inspectorText;       // of the painted lines, reused
 
     bool _blink;                            // true: then cursor blinks
     bool _renderingRequired;                // Flag to store that rendering is necessary
@@ -128,11 +177,12 @@ private:
     bool _highlighting;                     // highlighting of changed bytes
     bool _overwriteMode;
     bool _readOnly;                         // true: the user can only look and navigate
+    bool _ensureVisiblePending;             // ensure cursor visibility after the pending edits
+    bool _followTail;                       // true: appended bytes scroll a view showing the end
+    bool _scrollToEnd;                      // scroll when the scroll area has grown
 
-    int _charWidth, _charHeight;            // char dimensions (dpendend on font)
     int _cursorX, _cursorY;                 // graphics position of the cursor
     int _cursorPosition;                    // character positioin in stream (on byte ends in to steps)
-    int _xPosAdr, _xPosHex, _xPosAscii;     // graphics x-position of the areas
 
     int _selectionBegin;                    // First selected char
     int _selectionEnd;                      // Last selected char
@@ -0,0 +1,583 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#ifdef QHEXEDIT_ZLIB
+#include <zlib.h>
+#endif
+#ifdef QHEXEDIT_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <vector>
+
+#include "qhexeditdata.h"
+
+const size_t CHECKPOINT_SPAN = 4 * 1024 * 1024;     // uncompressed bytes between two gzip checkpoints
+const size_t GZIP_WINDOW = 32768;                   // history needed to resume inflating
+const size_t INPUT_CHUNK = 64 * 1024;
+const size_t CACHED_FRAMES = 8;                     // decompressed frames kept by the reader
+const size_t COMPRESS_CHUNK = 1024 * 1024;
+const quint32 INDEX_VERSION = 1;
+
+const quint32 ZSTD_SEEKABLE_MAGIC = 0x8F92EAB1;
+const quint32 ZSTD_SKIPPABLE_MAGIC = 0x184D2A5E;
+const int ZSTD_SEEK_FOOTER_SIZE = 9;
+
+static quint32 littleEndian32(const char * bytes)
+{
+    const uchar * b = reinterpret_cast<const uchar *>(bytes);
+    return b[0] | (b[1] << 8) | (b[2] << 16) | (quint32(b[3]) << 24);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CompressedReader implementation:
+/** \cond docNever */
+/*! CompressedReader serves a compressed file, which consists of frames that
+can be decompressed on their own: the frames of a zstd file or the parts of a
+gzip stream between two checkpoints. Only the frames which are read are
+decompressed, the last ones are kept in an LRU cache.
+*/
+class CompressedReader : public QHexEditReader
+{
+public:
+    struct Frame
+    {
+        quint64 in;                     // offset in the compressed file
+        quint64 out;                    // offset of the content
+        quint64 len;                    // uncompressed bytes
+    };
+
+    explicit CompressedReader(const QString & fileName);
+
+    bool open();
+
+    virtual size_t size() const;
+    virtual void read(size_t pos, char * dst, size_t len) const;
+
+protected:
+    // decompresses a frame, called with the file locked
+    virtual QByteArray decompress(size_t frame) const = 0;
+
+    std::vector<Frame> _frames;
+    mutable QFile _file;
+
+private:
+    QByteArray frame(size_t index) const;
+
+    mutable QMutex _mutex;              // guards _file and _cache
+    mutable std::list<std::pair<size_t, QByteArray>> _cache;    // most recently used first
+};
+
+CompressedReader::CompressedReader(const QString & fileName) :
+    _file(fileName)
+{ }
+
+bool CompressedReader::open()
+{
+    return _file.open(QIODevice::ReadOnly);
+}
+
+size_t CompressedReader::size() const
+{
+    return _frames.empty() ? 0 : _frames.back().out + _frames.back().len;
+}
+
+QByteArray CompressedReader::frame(size_t index) const
+{
+    for (auto it = _cache.begin(); it != _cache.end(); ++it)
+    {
+        if (it->first == index)
+        {
+            _cache.splice(_cache.begin(), _cache, it);
+            return it->second;
+        }
+    }
+
+    _cache.emplace_front(index, decompress(index));
+    if (_cache.size() > CACHED_FRAMES) {
+        _cache.pop_back();
+    }
+    return _cache.front().second;
+}
+
+void CompressedReader::read(size_t pos, char * dst, size_t len) const
+{
+    QMutexLocker locker(&_mutex);
+    auto it = std::upper_bound(_frames.begin(), _frames.end(), pos,
+        [](size_t p, const Frame & frame) { return p < frame.out; });
+    for (size_t index = it - _frames.begin() - 1; len > 0 && index < _frames.size(); index++)
+    {
+        const Frame & current = _frames[index];
+        const size_t rel = pos - current.out;
+        const size_t n = std::min<size_t>(len, current.len - rel);
+
+        // a damaged frame is filled up with zeros
+        const QByteArray bytes = frame(index);
+        const size_t valid = std::min<size_t>(n, rel < static_cast<size_t>(bytes.size()) ? bytes.size() - rel : 0);
+        memcpy(dst, bytes.constData() + rel, valid);
+        memset(dst + valid, 0, n - valid);
+
+        pos += n;
+        dst += n;
+        len -= n;
+    }
+}
+/** \endcond docNever */
+
+#ifdef QHEXEDIT_ZLIB
+////////////////////////////////////////////////////////////////////////////////
+// GzipReader implementation:
+/** \cond docNever */
+/*! GzipReader builds an index of checkpoints in the deflate stream on the
+first open, every CHECKPOINT_SPAN bytes. A checkpoint keeps the last 32 KiB of
+content, so inflating can resume there. The index is cached in the cache
+directory of the application and used again while the file is unchanged.
+Files with several gzip members (e.g. from pigz) and zlib streams are read
+as well.
+*/
+class GzipReader : public CompressedReader
+{
+public:
+    explicit GzipReader(const QString & fileName);
+
+    bool buildIndex();
+    bool loadIndex();
+    void saveIndex() const;
+
+protected:
+    virtual QByteArray decompress(size_t frame) const;
+
+private:
+    struct Checkpoint
+    {
+        quint64 in, out;
+        int bits;                       // of the byte in front of in, which belong to the block
+        bool member;                    // start of a gzip member, no history needed
+        QByteArray window;              // compressed history
+    };
+
+    void addCheckpoint(quint64 in, quint64 out, int bits, const uchar * window, size_t left);
+    void setFrames(quint64 total);
+    QString indexFileName() const;
+
+    std::vector<Checkpoint> _checkpoints;
+};
+
+GzipReader::GzipReader(const QString & fileName) :
+    CompressedReader(fileName)
+{ }
+
+void GzipReader::addCheckpoint(quint64 in, quint64 out, int bits, const uchar * window, size_t left)
+{
+    // the circular window starts behind the last output
+    Checkpoint point = { in, out, bits, window == nullptr, QByteArray() };
+    if (window)
+    {
+        QByteArray history(static_cast<int>(GZIP_WINDOW), Qt::Uninitialized);
+        memcpy(history.data(), window + GZIP_WINDOW - left, left);
+        memcpy(history.data() + left, window, GZIP_WINDOW - left);
+        point.window = qCompress(history);
+    }
+    _checkpoints.push_back(point);
+}
+
+void GzipReader::setFrames(quint64 total)
+{
+    _frames.clear();
+    for (size_t i = 0; i < _checkpoints.size(); i++)
+    {
+        const quint64 end = i + 1 < _checkpoints.size() ? _checkpoints[i + 1].out : total;
+        _frames.push_back({ _checkpoints[i].in, _checkpoints[i].out, end - _checkpoints[i].out });
+    }
+}
+
+bool GzipReader::buildIndex()
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 15 + 32) != Z_OK) {         // gzip or zlib header
+        return false;
+    }
+
+    std::vector<uchar> input(INPUT_CHUNK);
+    std::vector<uchar> window(GZIP_WINDOW, 0);
+    quint64 totalIn = 0, totalOut = 0, last = 0;
+    bool memberStart = true;                            // no output since the last header
+    bool ok = true;
+    _checkpoints.clear();
+    addCheckpoint(0, 0, 0, nullptr, 0);
+
+    _file.seek(0);
+    for (;;)
+    {
+        if (strm.avail_in == 0)
+        {
+            const qint64 n = _file.read(reinterpret_cast<char *>(input.data()), input.size());
+            if (n <= 0)
+            {
+                ok = n == 0 && memberStart;
+                break;
+            }
+            strm.next_in = input.data();
+            strm.avail_in = static_cast<uInt>(n);
+        }
+        if (strm.avail_out == 0)
+        {
+            strm.next_out = window.data();
+            strm.avail_out = GZIP_WINDOW;
+        }
+
+        // stops at the end of every deflate block
+        totalIn += strm.avail_in;
+        totalOut += strm.avail_out;
+        const int ret = inflate(&strm, Z_BLOCK);
+        totalIn -= strm.avail_in;
+        totalOut -= strm.avail_out;
+
+        if (ret == Z_STREAM_END)
+        {
+            // another member may follow, it starts without history
+            if (totalOut - last > CHECKPOINT_SPAN)
+            {
+                addCheckpoint(totalIn, totalOut, 0, nullptr, 0);
+                last = totalOut;
+            }
+            inflateReset(&strm);
+            memberStart = true;
+            continue;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            // garbage behind the last member (e.g. padding) is ignored
+            ok = memberStart && totalOut > 0;
+            break;
+        }
+        memberStart = memberStart && strm.total_out == 0;
+
+        const bool blockEnd = (strm.data_type & 128) && !(strm.data_type & 64);
+        if (blockEnd && totalOut - last > CHECKPOINT_SPAN)
+        {
+            addCheckpoint(totalIn, totalOut, strm.data_type & 7, window.data(), strm.avail_out);
+            last = totalOut;
+        }
+    }
+    inflateEnd(&strm);
+
+    // a checkpoint at the very end has no content
+    while (_checkpoints.size() > 1 && _checkpoints.back().out == totalOut) {
+        _checkpoints.pop_back();
+    }
+    setFrames(totalOut);
+    return ok;
+}
+
+QByteArray GzipReader::decompress(size_t frame) const
+{
+    const Checkpoint & point = _checkpoints[frame];
+    const size_t want = _frames[frame].len;
+    QByteArray result(static_cast<int>(want), Qt::Uninitialized);
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    bool raw = !point.member;
+    if (inflateInit2(&strm, raw ? -15 : 15 + 32) != Z_OK) {
+        return QByteArray();
+    }
+
+    // the first bits of the block are in the byte in front of the checkpoint
+    _file.seek(point.in - (point.bits ? 1 : 0));
+    std::vector<uchar> input(INPUT_CHUNK);
+    if (point.bits)
+    {
+        char byte = 0;
+        _file.getChar(&byte);
+        inflatePrime(&strm, point.bits, static_cast<uchar>(byte) >> (8 - point.bits));
+    }
+    if (raw)
+    {
+        const QByteArray history = qUncompress(point.window);
+        inflateSetDictionary(&strm, reinterpret_cast<const Bytef *>(history.constData()), history.size());
+    }
+
+    size_t have = 0;
+    size_t skip = 0;                                    // trailer of a member read raw
+    while (have < want)
+    {
+        if (strm.avail_in == 0)
+        {
+            const qint64 n = _file.read(reinterpret_cast<char *>(input.data()), input.size());
+            if (n <= 0) {
+                break;
+            }
+            strm.next_in = input.data();
+            strm.avail_in = static_cast<uInt>(n);
+        }
+        if (skip > 0)
+        {
+            const size_t n = std::min<size_t>(skip, strm.avail_in);
+            strm.next_in += n;
+            strm.avail_in -= n;
+            skip -= n;
+            continue;
+        }
+
+        strm.next_out = reinterpret_cast<Bytef *>(result.data() + have);
+        strm.avail_out = static_cast<uInt>(want - have);
+        const int ret = inflate(&strm, Z_NO_FLUSH);
+        have = want - strm.avail_out;
+        if (ret == Z_STREAM_END)
+        {
+            // the next member starts behind the CRC and the length
+            skip = raw ? 8 : 0;
+            raw = false;
+            inflateReset2(&strm, 15 + 32);
+        }
+        else if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            break;
+        }
+    }
+    inflateEnd(&strm);
+
+    result.resize(static_cast<int>(have));
+    return result;
+}
+
+QString GzipReader::indexFileName() const
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    const QByteArray key = QCryptographicHash::hash(QFileInfo(_file).canonicalFilePath().toUtf8(),
+                                                    QCryptographicHash::Sha1).toHex();
+    return dir.isEmpty() ? QString() : dir + "/gzindex/" + key;
+}
+
+bool GzipReader::loadIndex()
+{
+    QFile file(indexFileName());
+    if (file.fileName().isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // the index belongs to the file with this size and time
+    const QFileInfo info(_file);
+    QDataStream in(&file);
+    quint32 version, count;
+    qint64 size, modified;
+    quint64 total;
+    in >> version >> size >> modified >> total >> count;
+    if (in.status() != QDataStream::Ok || version != INDEX_VERSION || size != info.size() ||
+        modified != info.lastModified().toMSecsSinceEpoch() || count == 0)
+    {
+        return false;
+    }
+
+    _checkpoints.clear();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+    {
+        Checkpoint point;
+        qint32 bits;
+        in >> point.in >> point.out >> bits >> point.member >> point.window;
+        point.bits = bits;
+        _checkpoints.push_back(point);
+    }
+    if (in.status() != QDataStream::Ok) {
+        _checkpoints.clear();
+        return false;
+    }
+    setFrames(total);
+    return true;
+}
+
+void GzipReader::saveIndex() const
+{
+    const QString fileName = indexFileName();
+    if (fileName.isEmpty() || !QDir().mkpath(QFileInfo(fileName).path())) {
+        return;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    const QFileInfo info(_file);
+    QDataStream out(&file);
+    out << INDEX_VERSION << info.size() << info.lastModified().toMSecsSinceEpoch()
+        << static_cast<quint64>(size()) << static_cast<quint32>(_checkpoints.size());
+    for (const Checkpoint & point : _checkpoints) {
+        out << point.in << point.out << static_cast<qint32>(point.bits) << point.member << point.window;
+    }
+    file.commit();
+}
+/** \endcond docNever */
+#endif // QHEXEDIT_ZLIB
+
+#ifdef QHEXEDIT_ZSTD
+////////////////////////////////////////////////////////////////////////////////
+// ZstdReader implementation:
+/** \cond docNever */
+/*! ZstdReader reads files in the zstd seekable format: independent frames,
+followed by a skippable frame with the sizes of all frames. The seek table is
+the index, nothing has to be built.
+*/
+class ZstdReader : public CompressedReader
+{
+public:
+    explicit ZstdReader(const QString & fileName);
+
+    bool readSeekTable();
+
+protected:
+    virtual QByteArray decompress(size_t frame) const;
+
+private:
+    std::vector<quint64> _compressedSizes;
+};
+
+ZstdReader::ZstdReader(const QString & fileName) :
+    CompressedReader(fileName)
+{ }
+
+bool ZstdReader::readSeekTable()
+{
+    // footer: number of frames, descriptor, magic number
+    const qint64 fileSize = _file.size();
+    if (fileSize < ZSTD_SEEK_FOOTER_SIZE + 8 || !_file.seek(fileSize - ZSTD_SEEK_FOOTER_SIZE)) {
+        return false;
+    }
+    const QByteArray footer = _file.read(ZSTD_SEEK_FOOTER_SIZE);
+    if (footer.size() != ZSTD_SEEK_FOOTER_SIZE || littleEndian32(footer.constData() + 5) != ZSTD_SEEKABLE_MAGIC) {
+        return false;
+    }
+    const quint64 frames = littleEndian32(footer.constData());
+    const int entrySize = (footer[4] & 0x80) ? 12 : 8;     // with checksums
+    const quint64 tableSize = frames * entrySize + ZSTD_SEEK_FOOTER_SIZE;
+    if (tableSize + 8 > static_cast<quint64>(fileSize)) {
+        return false;
+    }
+
+    // the table is the content of a skippable frame
+    _file.seek(fileSize - tableSize - 8);
+    const QByteArray table = _file.read(tableSize + 8);
+    if (static_cast<quint64>(table.size()) != tableSize + 8 ||
+        littleEndian32(table.constData()) != ZSTD_SKIPPABLE_MAGIC ||
+        littleEndian32(table.constData() + 4) != tableSize)
+    {
+        return false;
+    }
+
+    quint64 in = 0, out = 0;
+    for (quint64 i = 0; i < frames; i++)
+    {
+        const char * entry = table.constData() + 8 + i * entrySize;
+        const quint64 compressed = littleEndian32(entry);
+        const quint64 decompressed = littleEndian32(entry + 4);
+        _frames.push_back({ in, out, decompressed });
+        _compressedSizes.push_back(compressed);
+        in += compressed;
+        out += decompressed;
+    }
+    return in + tableSize + 8 <= static_cast<quint64>(fileSize);
+}
+
+QByteArray ZstdReader::decompress(size_t frame) const
+{
+    _file.seek(_frames[frame].in);
+    const QByteArray compressed = _file.read(_compressedSizes[frame]);
+    QByteArray result(static_cast<int>(_frames[frame].len), Qt::Uninitialized);
+    const size_t n = ZSTD_decompress(result.data(), result.size(), compressed.constData(), compressed.size());
+    if (ZSTD_isError(n)) {
+        return QByteArray();
+    }
+    result.resize(static_cast<int>(n));
+    return result;
+}
+/** \endcond docNever */
+#endif // QHEXEDIT_ZSTD
+
+////////////////////////////////////////////////////////////////////////////////
+// QHexEditData compression:
+std::unique_ptr<QHexEditData> QHexEditData::fromCompressedFile(const QString & fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::unique_ptr<QHexEditData>();
+    }
+    const QByteArray magic = file.read(4);
+    file.close();
+
+#ifdef QHEXEDIT_ZLIB
+    if (magic.startsWith("\x1f\x8b"))
+    {
+        std::shared_ptr<GzipReader> reader = std::make_shared<GzipReader>(fileName);
+        if (!reader->open()) {
+            return std::unique_ptr<QHexEditData>();
+        }
+        if (!reader->loadIndex())
+        {
+            if (!reader->buildIndex()) {
+                return std::unique_ptr<QHexEditData>();
+            }
+            reader->saveIndex();
+        }
+        return fromReader(std::move(reader));
+    }
+#endif
+
+#ifdef QHEXEDIT_ZSTD
+    if (magic == QByteArray("\x28\xb5\x2f\xfd", 4))
+    {
+        std::shared_ptr<ZstdReader> reader = std::make_shared<ZstdReader>(fileName);
+        if (!reader->open() || !reader->readSeekTable()) {
+            return std::unique_ptr<QHexEditData>();
+        }
+        return fromReader(std::move(reader));
+    }
+#endif
+    return std::unique_ptr<QHexEditData>();
+}
+
+bool QHexEditData::writeCompressed(QIODevice & device) const
+{
+#ifdef QHEXEDIT_ZLIB
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    std::vector<char> output(INPUT_CHUNK);
+    const size_t total = size();
+    bool ok = true;
+    for (size_t pos = 0; ok; pos += COMPRESS_CHUNK)
+    {
+        const bool finish = pos >= total;
+        QByteArray chunk = finish ? QByteArray() : range(pos, std::min(COMPRESS_CHUNK, total - pos));
+        strm.next_in = reinterpret_cast<Bytef *>(chunk.data());
+        strm.avail_in = static_cast<uInt>(chunk.size());
+        int ret;
+        do
+        {
+            strm.next_out = reinterpret_cast<Bytef *>(output.data());
+            strm.avail_out = static_cast<uInt>(output.size());
+            ret = deflate(&strm, finish ? Z_FINISH : Z_NO_FLUSH);
+            const qint64 n = output.size() - strm.avail_out;
+            ok = ret != Z_STREAM_ERROR && device.write(output.data(), n) == n;
+        } while (ok && strm.avail_out == 0);
+        if (finish) {
+            ok = ok && ret == Z_STREAM_END;
+            break;
+        }
+    }
+    deflateEnd(&strm);
+    return ok;
+#else
+    Q_UNUSED(device);
+    return false;
+#endif
+}
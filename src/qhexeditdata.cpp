@@ -1,16 +1,43 @@
 #include "qhexeditdata.h"
 
+#include <algorithm>
 #include <cassert>
-#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+const size_t WRITE_CHUNK_SIZE = 1024 * 1024;
+const size_t SEARCH_CHUNK_SIZE = 1024 * 1024;
+const size_t APPEND_BUFFER_SIZE = 64 * 1024;
+const size_t TAIL_BUFFER_SIZE = 1024 * 1024;    // collects small appends to a followed file
+const size_t MIN_TAIL_MAP_SIZE = 256 * 1024;    // larger appends are mapped
+const qint64 MIN_HOLE_SIZE = 1024 * 1024;       // smaller holes of sparse files are mapped with the data
 
 QHexEditData::QHexEditData()
 {
+    _journal = nullptr;
+    _changePending = false;
+    _changeSize = false;
+    _changeBegin = 0;
+    _changeEnd = 0;
     _addressNumbers = 4;
+    _realAddressNumbers = 0;
+    _highestAddress = 0;
     _addressOffset = 0;
 }
 
 QHexEditData::~QHexEditData()
-{ }
+{
+    // a copy, the observers may remove themselves
+    const std::vector<QHexEditDataObserver *> observers = _observers;
+    for (QHexEditDataObserver * observer : observers) {
+        observer->detached(this);
+    }
+}
 
 int QHexEditData::addressOffset() const
 {
@@ -58,12 +85,79 @@ void QHexEditData::setDataChanged(int i, const QByteArray & state)
     _changedData.replace(i, len, state);
 }
 
+EditJournal * QHexEditData::journal() const
+{
+    return _journal;
+}
+
+void QHexEditData::setJournal(EditJournal * journal)
+{
+    _journal = journal;
+}
+
+void QHexEditData::addObserver(QHexEditDataObserver * observer)
+{
+    _observers.push_back(observer);
+}
+
+void QHexEditData::removeObserver(QHexEditDataObserver * observer)
+{
+    _observers.erase(std::remove(_observers.begin(), _observers.end(), observer), _observers.end());
+}
+
+const std::vector<QHexEditDataObserver *> & QHexEditData::observers() const
+{
+    return _observers;
+}
+
+void QHexEditData::addChange(size_t addr, size_t len, bool sizeChanged)
+{
+    if (_changePending)
+    {
+        _changeBegin = std::min(_changeBegin, addr);
+        _changeEnd = std::max(_changeEnd, addr + len);
+        _changeSize = _changeSize || sizeChanged;
+    }
+    else
+    {
+        _changePending = true;
+        _changeBegin = addr;
+        _changeEnd = addr + len;
+        _changeSize = sizeChanged;
+    }
+}
+
+bool QHexEditData::takeChanges(size_t & addr, size_t & len, bool & sizeChanged)
+{
+    if (!_changePending) {
+        return false;
+    }
+
+    addr = _changeBegin;
+    len = _changeEnd - _changeBegin;
+    sizeChanged = _changeSize;
+    _changePending = false;
+    return true;
+}
+
+quint64 QHexEditData::address(size_t pos) const
+{
+    return pos + _addressOffset;
+}
+
 size_t QHexEditData::realAddressNumbers() const
 {
-    // the number of nibbles
-    _realAddressNumbers = std::ceil(std::log(size() + _addressOffset + 1) / (std::log(2) * 4.0));
-    _realAddressNumbers = std::max(_realAddressNumbers, _addressNumbers);
-    return _realAddressNumbers;
+    // the number of nibbles of the highest address, only recounted if it changed
+    const quint64 highestAddress = address(size());
+    if (highestAddress != _highestAddress)
+    {
+        _highestAddress = highestAddress;
+        _realAddressNumbers = 0;
+        for (quint64 rest = highestAddress; rest != 0; rest >>= 4) {
+            _realAddressNumbers++;
+        }
+    }
+    return std::max(_realAddressNumbers, _addressNumbers);
 }
 
 QChar QHexEditData::asciiChar(size_t index) const
@@ -99,6 +193,125 @@ QString QHexEditData::toRedableString(size_t start, size_t end) const
     return result;
 }
 
+bool QHexEditData::write(QIODevice & device) const
+{
+    const size_t total = size();
+    for (size_t pos = 0; pos < total; pos += WRITE_CHUNK_SIZE)
+    {
+        const QByteArray chunk = range(pos, std::min(WRITE_CHUNK_SIZE, total - pos));
+        if (device.write(chunk) != chunk.length()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool QHexEditData::canInsert() const
+{
+    return true;
+}
+
+bool QHexEditData::hasSpans() const
+{
+    return false;
+}
+
+QHexEditData::Spans QHexEditData::spans(size_t, size_t) const
+{
+    return Spans();
+}
+
+void QHexEditData::insertSpans(size_t, const Spans &)
+{
+    assert(!"insertSpans() called on a backend without spans");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Snapshot implementation:
+QHexEditSnapshot::~QHexEditSnapshot()
+{ }
+
+QHexEditReader::~QHexEditReader()
+{ }
+
+QHexEditDataObserver::~QHexEditDataObserver()
+{ }
+
+size_t QHexEditSnapshot::nextHole(size_t) const
+{
+    return size();
+}
+
+size_t QHexEditSnapshot::nextData(size_t pos) const
+{
+    return std::min(pos, size());
+}
+
+// A snapshot of a byte array. QByteArray is implicitly shared with atomic
+// reference counts, the data detaches from the snapshot with its next edit.
+class ByteArraySnapshot : public QHexEditSnapshot
+{
+public:
+    explicit ByteArraySnapshot(const QByteArray & bytes) :
+        _bytes(bytes)
+    { }
+
+    virtual size_t size() const
+    {
+        return _bytes.size();
+    }
+
+    virtual QByteArray range(size_t addr, size_t len) const
+    {
+        if (addr >= size()) {
+            return QByteArray();
+        }
+        return _bytes.mid(static_cast<int>(addr), static_cast<int>(std::min(len, size() - addr)));
+    }
+
+private:
+    const QByteArray _bytes;
+};
+
+QHexEditData::Snapshot QHexEditData::snapshot() const
+{
+    return std::make_shared<ByteArraySnapshot>(toByteArray());
+}
+
+QHexEditData::Snapshot QHexEditData::original() const
+{
+    return Snapshot();
+}
+
+std::vector<QHexEditData::Origin> QHexEditData::origins() const
+{
+    std::vector<Origin> runs;
+    if (size() > 0) {
+        runs.push_back({ 0, size(), -1 });
+    }
+    return runs;
+}
+
+QString QHexEditData::fileName() const
+{
+    return QString();
+}
+
+size_t QHexEditData::readAppended()
+{
+    return 0;
+}
+
+size_t QHexEditData::nextHole(size_t) const
+{
+    return size();
+}
+
+size_t QHexEditData::nextData(size_t pos) const
+{
+    return std::min(pos, size());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // QHexEditByteArrayData implementation:
 class QHexEditMemoryData : public QHexEditData
@@ -128,6 +341,7 @@ public:
     virtual void replace(size_t addr, size_t len, const QByteArray & ba);
 
     virtual QByteArray toByteArray() const;
+    virtual Snapshot snapshot() const;
 
 private:
     void moveUp(size_t addr, size_t n);
@@ -265,6 +479,12 @@ QByteArray QHexEditMemoryData::toByteArray() const
     return _wrapper;
 }
 
+QHexEditData::Snapshot QHexEditMemoryData::snapshot() const
+{
+    // the wrapper reads the memory, which is still edited
+    return std::make_shared<ByteArraySnapshot>(QByteArray(reinterpret_cast<const char *>(_ptr), int(_size)));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // QHexEditByteArrayData implementation:
 class QHexEditByteArrayData : public QHexEditData
@@ -294,6 +514,8 @@ public:
 
     virtual QByteArray toByteArray() const;
 
+    virtual Snapshot snapshot() const;
+
 private:
     QByteArray _data;
 };
@@ -382,6 +604,768 @@ QByteArray QHexEditByteArrayData::toByteArray() const
     return _data;
 }
 
+QHexEditData::Snapshot QHexEditByteArrayData::snapshot() const
+{
+    return std::make_shared<ByteArraySnapshot>(_data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// QHexEditPieceData implementation:
+
+// A buffer of the piece table. The original content is either a memory
+// mapped file or a byte array, inserted bytes are appended to buffers which
+// are allocated in chunks and never move. Bytes once written into a buffer
+// never change, so snapshots read them without locking. The holes of a
+// sparse file are pieces of a buffer without data, they read as zeros.
+// Content which isn't in memory at all is read by a QHexEditReader.
+struct PieceBuffer
+{
+    QByteArray bytes;                   // owned memory (if not mapped)
+    std::shared_ptr<QFile> file;        // mapped file
+    std::shared_ptr<const QHexEditReader> reader;
+    const char * data;                  // null for holes and readers
+    size_t size;                        // used bytes
+    size_t capacity;
+    bool original;                      // false: inserted bytes (changed)
+    qint64 source;                      // position of offset 0 in the original content
+};
+
+// The list of buffers is replaced instead of changed, when a buffer is
+// added. Snapshots keep the list of their version.
+typedef std::vector<std::shared_ptr<PieceBuffer>> PieceBuffers;
+
+static QByteArray readPieces(const PieceTable::Tree & pieces, const PieceBuffers & buffers, size_t addr, size_t len)
+{
+    const size_t total = PieceTable::size(pieces);
+    if (addr >= total) {
+        return QByteArray();
+    }
+    len = std::min(len, total - addr);
+
+    QByteArray result(static_cast<int>(len), Qt::Uninitialized);
+    char * dst = result.data();
+    PieceTable::visit(pieces, addr, len, [&](const Piece & piece, size_t rel, size_t n) {
+        const PieceBuffer & buffer = *buffers[piece.buffer];
+        if (buffer.data) {
+            memcpy(dst, buffer.data + piece.offset + rel, n);
+        } else if (buffer.reader) {
+            buffer.reader->read(piece.offset + rel, dst, n);
+        } else {
+            memset(dst, 0, n);
+        }
+        dst += n;
+    });
+    return result;
+}
+
+// the first position >= pos, which is (hole true) or isn't inside a hole
+static size_t findPieces(const PieceTable::Tree & pieces, const PieceBuffers & buffers, size_t pos, bool hole)
+{
+    const size_t total = PieceTable::size(pieces);
+    while (pos < total)
+    {
+        size_t rel;
+        const Piece * piece = PieceTable::find(pieces, pos, rel);
+        const PieceBuffer & buffer = *buffers[piece->buffer];
+        if ((!buffer.data && !buffer.reader) == hole) {
+            return pos;
+        }
+        pos += piece->length - rel;
+    }
+    return total;
+}
+
+// The ranges of a file, which hold data. Holes smaller than MIN_HOLE_SIZE
+// are counted to the data. Without holes or if the file system can't tell,
+// the whole file is one extent.
+struct FileExtent
+{
+    qint64 begin, end;
+};
+
+static std::vector<FileExtent> dataExtents(QFile & file, qint64 length)
+{
+    const std::vector<FileExtent> whole(1, FileExtent({ 0, length }));
+#ifdef SEEK_HOLE
+    const int fd = file.handle();
+    if (fd < 0 || file.isSequential() || length < MIN_HOLE_SIZE) {
+        return whole;
+    }
+
+    std::vector<FileExtent> extents;
+    for (qint64 pos = 0; pos < length;)
+    {
+        const off_t data = lseek(fd, pos, SEEK_DATA);
+        if (data < 0)
+        {
+            // ENXIO: only a hole up to the end
+            if (errno != ENXIO) {
+                extents = whole;
+            }
+            break;
+        }
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        if (hole < 0 || hole > length) {
+            hole = length;
+        }
+
+        if (!extents.empty() && data - extents.back().end < MIN_HOLE_SIZE) {
+            extents.back().end = hole;
+        } else {
+            extents.push_back({ data, hole });
+        }
+        pos = hole;
+    }
+    lseek(fd, 0, SEEK_SET);
+
+    if (!extents.empty())
+    {
+        if (extents.front().begin < MIN_HOLE_SIZE) {
+            extents.front().begin = 0;
+        }
+        if (length - extents.back().end < MIN_HOLE_SIZE) {
+            extents.back().end = length;
+        }
+    }
+    return extents;
+#else
+    Q_UNUSED(file);
+    return whole;
+#endif
+}
+
+// A snapshot of the piece table. The tree is persistent, so the snapshot
+// shares all nodes with the data; they are freed with the last tree using them.
+class PieceSnapshot : public QHexEditSnapshot
+{
+public:
+    PieceSnapshot(const PieceTable::Tree & pieces, const std::shared_ptr<const PieceBuffers> & buffers, bool holes) :
+        _pieces(pieces),
+        _buffers(buffers),
+        _holes(holes)
+    { }
+
+    virtual size_t size() const
+    {
+        return PieceTable::size(_pieces);
+    }
+
+    virtual QByteArray range(size_t addr, size_t len) const
+    {
+        return readPieces(_pieces, *_buffers, addr, len);
+    }
+
+    virtual size_t nextHole(size_t pos) const
+    {
+        return _holes ? findPieces(_pieces, *_buffers, pos, true) : size();
+    }
+
+    virtual size_t nextData(size_t pos) const
+    {
+        return _holes ? findPieces(_pieces, *_buffers, pos, false) : std::min(pos, size());
+    }
+
+private:
+    const PieceTable::Tree _pieces;
+    const std::shared_ptr<const PieceBuffers> _buffers;
+    const bool _holes;                  // the pieces may refer to holes
+};
+
+class QHexEditPieceData : public QHexEditData
+{
+public:
+    explicit QHexEditPieceData(std::unique_ptr<QFile> file);
+    explicit QHexEditPieceData(std::shared_ptr<const QHexEditReader> reader);
+    explicit QHexEditPieceData(std::vector<Segment> segments);
+    virtual ~QHexEditPieceData();
+
+    virtual quint64 address(size_t pos) const;
+
+    virtual bool dataChanged(int i);
+    virtual QByteArray dataChanged(int i, int len);
+    virtual void setDataChanged(int i, bool state);
+    virtual void setDataChanged(int i, const QByteArray & state);
+
+    virtual u_int8_t at(size_t addr) const;
+    virtual QByteArray range(size_t addr, size_t len) const;
+
+    virtual int indexOf(const QByteArray & ba, size_t from) const;
+    virtual int lastIndexOf(const QByteArray & ba, size_t from) const;
+
+    virtual size_t size() const;
+    virtual bool fixedSize() const;
+
+    virtual void insert(size_t addr, u_int8_t byte);
+    virtual void insert(size_t addr, const QByteArray & ba);
+
+    virtual void remove(size_t addr, size_t len);
+
+    virtual void replace(size_t addr, u_int8_t byte);
+    virtual void replace(size_t addr, const QByteArray & ba);
+    virtual void replace(size_t addr, size_t len, const QByteArray & ba);
+
+    virtual QByteArray toByteArray() const;
+
+    virtual bool hasSpans() const;
+    virtual Spans spans(size_t addr, size_t len) const;
+    virtual void insertSpans(size_t addr, const Spans & spans);
+
+    virtual Snapshot snapshot() const;
+    virtual Snapshot original() const;
+    virtual std::vector<Origin> origins() const;
+
+    virtual QString fileName() const;
+    virtual size_t readAppended();
+
+    virtual size_t nextHole(size_t pos) const;
+    virtual size_t nextData(size_t pos) const;
+
+private:
+    void addBuffer(std::shared_ptr<PieceBuffer> buffer);
+    void addOriginal(std::shared_ptr<PieceBuffer> buffer);
+    void addSparse(const std::shared_ptr<QFile> & source, qint64 length, const std::vector<FileExtent> & extents);
+    Piece append(const char * bytes, size_t len);
+    bool readTail(size_t len, Piece & piece);
+    bool holeAt(size_t pos, size_t & begin, size_t & end) const;
+
+    std::shared_ptr<const PieceBuffers> _buffers;
+    int _appendBuffer;                  // buffer which takes inserted bytes, -1 if none
+    int _tailBuffer;                    // buffer which takes small appends to the file, -1 if none
+    int _holeBuffer;                    // buffer of the holes of a sparse file, -1 if none
+    PieceTable::Tree _pieces;
+    PieceTable::Tree _originalPieces;   // the pieces after loading and following
+    std::shared_ptr<QFile> _source;     // the file, if it is a regular one
+    size_t _sourceSize;                 // bytes of the file in the data
+    quint64 _baseAddress;               // address of position 0
+};
+
+QHexEditPieceData::QHexEditPieceData(std::unique_ptr<QFile> file) :
+    _buffers(std::make_shared<PieceBuffers>()),
+    _appendBuffer(-1),
+    _tailBuffer(-1),
+    _holeBuffer(-1),
+    _sourceSize(0),
+    _baseAddress(0)
+{
+    std::shared_ptr<QFile> source(std::move(file));
+    const qint64 length = source->size();
+    const std::vector<FileExtent> extents = dataExtents(*source, length);
+    if (extents.size() != 1 || extents.front().begin != 0 || extents.front().end != length)
+    {
+        addSparse(source, length, extents);
+        _originalPieces = _pieces;
+        return;
+    }
+
+    std::shared_ptr<PieceBuffer> buffer = std::make_shared<PieceBuffer>();
+    uchar * mapped = length > 0 ? source->map(0, length) : nullptr;
+    if (mapped)
+    {
+        buffer->data = reinterpret_cast<const char *>(mapped);
+        buffer->file = source;
+    }
+    else
+    {
+        // e.g. pipes or file systems without mmap support
+        buffer->bytes = source->readAll();
+        buffer->data = buffer->bytes.constData();
+    }
+    buffer->size = buffer->capacity = length > 0 ? length : buffer->bytes.size();
+
+    // regular files stay open, they can be followed when they grow
+    if (!source->isSequential())
+    {
+        _source = source;
+        _sourceSize = buffer->size;
+    }
+    buffer->source = 0;
+    addOriginal(std::move(buffer));
+    _originalPieces = _pieces;
+}
+
+QHexEditPieceData::QHexEditPieceData(std::shared_ptr<const QHexEditReader> reader) :
+    _buffers(std::make_shared<PieceBuffers>()),
+    _appendBuffer(-1),
+    _tailBuffer(-1),
+    _holeBuffer(-1),
+    _sourceSize(0),
+    _baseAddress(0)
+{
+    std::shared_ptr<PieceBuffer> buffer = std::make_shared<PieceBuffer>();
+    buffer->data = nullptr;
+    buffer->size = buffer->capacity = reader->size();
+    buffer->reader = std::move(reader);
+    buffer->source = 0;
+    addOriginal(std::move(buffer));
+    _originalPieces = _pieces;
+}
+
+QHexEditPieceData::QHexEditPieceData(std::vector<Segment> segments) :
+    _appendBuffer(-1),
+    _tailBuffer(-1),
+    _holeBuffer(-1),
+    _sourceSize(0),
+    _baseAddress(0)
+{
+    std::stable_sort(segments.begin(), segments.end(), [](const Segment & a, const Segment & b) {
+        return a.address < b.address;
+    });
+
+    // the buffers are collected first, every segment owns one. Buffer 0
+    // holds the gaps.
+    std::shared_ptr<PieceBuffers> buffers = std::make_shared<PieceBuffers>();
+    std::shared_ptr<PieceBuffer> holes = std::make_shared<PieceBuffer>();
+    holes->data = nullptr;
+    holes->original = true;
+    holes->source = 0;
+    buffers->push_back(holes);
+
+    _baseAddress = segments.empty() ? 0 : segments.front().address;
+    quint64 end = _baseAddress;
+    for (Segment & segment : segments)
+    {
+        const quint64 segmentEnd = segment.address + segment.bytes.size();
+        if (segmentEnd <= end) {
+            continue;
+        }
+        if (segment.address > end)
+        {
+            Piece hole = { 0, static_cast<size_t>(end - _baseAddress), static_cast<size_t>(segment.address - end) };
+            _pieces = PieceTable::merge(_pieces, PieceTable::make(hole));
+            _holeBuffer = 0;
+        }
+
+        std::shared_ptr<PieceBuffer> buffer = std::make_shared<PieceBuffer>();
+        buffer->bytes = std::move(segment.bytes);
+        buffer->data = buffer->bytes.constData();
+        buffer->size = buffer->capacity = buffer->bytes.size();
+        buffer->original = true;
+        buffer->source = segment.address - _baseAddress;
+        const size_t skip = segment.address < end ? end - segment.address : 0;
+        Piece piece = { static_cast<int>(buffers->size()), skip, buffer->size - skip };
+        _pieces = PieceTable::merge(_pieces, PieceTable::make(piece));
+        buffers->push_back(std::move(buffer));
+        end = segmentEnd;
+    }
+    holes->size = holes->capacity = end - _baseAddress;
+    _buffers = buffers;
+    _originalPieces = _pieces;
+}
+
+QHexEditPieceData::~QHexEditPieceData()
+{ }
+
+quint64 QHexEditPieceData::address(size_t pos) const
+{
+    return _baseAddress + QHexEditData::address(pos);
+}
+
+void QHexEditPieceData::addSparse(const std::shared_ptr<QFile> & source, qint64 length, const std::vector<FileExtent> & extents)
+{
+    // the holes are never read, every extent of data is mapped on its own
+    std::shared_ptr<PieceBuffer> holes = std::make_shared<PieceBuffer>();
+    holes->data = nullptr;
+    holes->size = holes->capacity = length;
+    holes->original = true;
+    holes->source = 0;
+    _holeBuffer = static_cast<int>(_buffers->size());
+    addBuffer(std::move(holes));
+
+    qint64 pos = 0;
+    for (size_t i = 0; i <= extents.size(); i++)
+    {
+        const qint64 begin = i < extents.size() ? extents[i].begin : length;
+        if (begin > pos)
+        {
+            Piece hole = { _holeBuffer, static_cast<size_t>(pos), static_cast<size_t>(begin - pos) };
+            _pieces = PieceTable::merge(_pieces, PieceTable::make(hole));
+        }
+        if (i == extents.size()) {
+            break;
+        }
+
+        std::shared_ptr<PieceBuffer> buffer = std::make_shared<PieceBuffer>();
+        const qint64 len = extents[i].end - begin;
+        uchar * mapped = source->map(begin, len);
+        if (mapped)
+        {
+            buffer->data = reinterpret_cast<const char *>(mapped);
+            buffer->file = source;
+        }
+        else
+        {
+            source->seek(begin);
+            buffer->bytes = source->read(len);
+            buffer->data = buffer->bytes.constData();
+        }
+        buffer->size = buffer->capacity = mapped ? len : buffer->bytes.size();
+        buffer->source = begin;
+        addOriginal(std::move(buffer));
+        pos = extents[i].end;
+    }
+
+    _source = source;
+    _sourceSize = length;
+}
+
+void QHexEditPieceData::addBuffer(std::shared_ptr<PieceBuffer> buffer)
+{
+    std::shared_ptr<PieceBuffers> buffers = std::make_shared<PieceBuffers>(*_buffers);
+    buffers->push_back(std::move(buffer));
+    _buffers = buffers;
+}
+
+void QHexEditPieceData::addOriginal(std::shared_ptr<PieceBuffer> buffer)
+{
+    buffer->original = true;
+    if (buffer->size > 0)
+    {
+        Piece piece = { static_cast<int>(_buffers->size()), 0, buffer->size };
+        _pieces = PieceTable::merge(_pieces, PieceTable::make(piece));
+    }
+    addBuffer(std::move(buffer));
+}
+
+Piece QHexEditPieceData::append(const char * bytes, size_t len)
+{
+    if (_appendBuffer < 0 ||
+        (*_buffers)[_appendBuffer]->capacity - (*_buffers)[_appendBuffer]->size < len)
+    {
+        std::shared_ptr<PieceBuffer> buffer = std::make_shared<PieceBuffer>();
+        buffer->capacity = std::max(APPEND_BUFFER_SIZE, len);
+        buffer->bytes = QByteArray(static_cast<int>(buffer->capacity), Qt::Uninitialized);
+        buffer->data = buffer->bytes.constData();
+        buffer->size = 0;
+        buffer->original = false;
+        buffer->source = -1;
+        _appendBuffer = static_cast<int>(_buffers->size());
+        addBuffer(std::move(buffer));
+    }
+
+    // only the unused end of the buffer is written, snapshots don't see it
+    PieceBuffer & buffer = *(*_buffers)[_appendBuffer];
+    memcpy(buffer.bytes.data() + buffer.size, bytes, len);
+    Piece piece = { _appendBuffer, buffer.size, len };
+    buffer.size += len;
+    return piece;
+}
+
+bool QHexEditPieceData::dataChanged(int i)
+{
+    size_t rel;
+    const Piece * piece = PieceTable::find(_pieces, i, rel);
+    return piece && !(*_buffers)[piece->buffer]->original;
+}
+
+QByteArray QHexEditPieceData::dataChanged(int i, int len)
+{
+    QByteArray result;
+    PieceTable::visit(_pieces, i, len, [&](const Piece & piece, size_t, size_t n) {
+        result.append(QByteArray(static_cast<int>(n), char(!(*_buffers)[piece.buffer]->original)));
+    });
+    return result;
+}
+
+void QHexEditPieceData::setDataChanged(int, bool)
+{
+    // the state is derived from the pieces
+}
+
+void QHexEditPieceData::setDataChanged(int, const QByteArray &)
+{
+    // the state is derived from the pieces
+}
+
+u_int8_t QHexEditPieceData::at(size_t addr) const
+{
+    size_t rel;
+    const Piece * piece = PieceTable::find(_pieces, addr, rel);
+    assert(piece);
+    const PieceBuffer & buffer = *(*_buffers)[piece->buffer];
+    char byte = 0;
+    if (buffer.data) {
+        byte = buffer.data[piece->offset + rel];
+    } else if (buffer.reader) {
+        buffer.reader->read(piece->offset + rel, &byte, 1);
+    }
+    return static_cast<u_int8_t>(byte);
+}
+
+QByteArray QHexEditPieceData::range(size_t addr, size_t len) const
+{
+    return readPieces(_pieces, *_buffers, addr, len);
+}
+
+bool QHexEditPieceData::holeAt(size_t pos, size_t & begin, size_t & end) const
+{
+    size_t rel;
+    const Piece * piece = _holeBuffer < 0 ? nullptr : PieceTable::find(_pieces, pos, rel);
+    if (!piece || piece->buffer != _holeBuffer) {
+        return false;
+    }
+    begin = pos - rel;
+    end = begin + piece->length;
+    return true;
+}
+
+int QHexEditPieceData::indexOf(const QByteArray & ba, size_t from) const
+{
+    const size_t total = size();
+    const size_t overlap = ba.isEmpty() ? 0 : ba.length() - 1;
+
+    // a pattern with other bytes than zeros can only start in the last
+    // overlap bytes of a hole, the rest of the hole is skipped. Zeros are
+    // found in the hole without reading it.
+    const bool zeros = ba.count('\0') == ba.length();
+    for (size_t pos = from; pos < total; pos += SEARCH_CHUNK_SIZE)
+    {
+        size_t holeBegin, holeEnd;
+        if (holeAt(pos, holeBegin, holeEnd) && pos + overlap < holeEnd)
+        {
+            if (zeros) {
+                return static_cast<int>(pos);
+            }
+            pos = holeEnd - overlap;
+        }
+
+        const int idx = range(pos, SEARCH_CHUNK_SIZE + overlap).indexOf(ba);
+        if (idx >= 0) {
+            return static_cast<int>(pos + idx);
+        }
+    }
+    return -1;
+}
+
+int QHexEditPieceData::lastIndexOf(const QByteArray & ba, size_t from) const
+{
+    const size_t total = size();
+    if (total == 0) {
+        return -1;
+    }
+
+    const size_t overlap = ba.isEmpty() ? 0 : ba.length() - 1;
+    const bool zeros = ba.count('\0') == ba.length();
+    size_t end = std::min(from, total - 1);     // last possible start of a match
+    for (;;)
+    {
+        size_t holeBegin, holeEnd;
+        if (holeAt(end, holeBegin, holeEnd) && end + overlap < holeEnd)
+        {
+            if (zeros) {
+                return static_cast<int>(end);
+            }
+            if (holeBegin == 0) {
+                return -1;
+            }
+            end = holeBegin - 1;
+            continue;
+        }
+
+        const size_t start = (end >= SEARCH_CHUNK_SIZE) ? end - SEARCH_CHUNK_SIZE + 1 : 0;
+        const QByteArray chunk = range(start, end - start + 1 + overlap);
+        const int idx = chunk.lastIndexOf(ba, static_cast<int>(end - start));
+        if (idx >= 0) {
+            return static_cast<int>(start + idx);
+        }
+        if (start == 0) {
+            return -1;
+        }
+        end = start - 1;
+    }
+}
+
+size_t QHexEditPieceData::size() const
+{
+    return PieceTable::size(_pieces);
+}
+
+bool QHexEditPieceData::fixedSize() const
+{
+    return false;
+}
+
+void QHexEditPieceData::insert(size_t addr, u_int8_t byte)
+{
+    const char ch = static_cast<char>(byte);
+    _pieces = PieceTable::insert(_pieces, addr, append(&ch, 1));
+}
+
+void QHexEditPieceData::insert(size_t addr, const QByteArray & ba)
+{
+    _pieces = PieceTable::insert(_pieces, addr, append(ba.constData(), ba.length()));
+}
+
+void QHexEditPieceData::remove(size_t addr, size_t len)
+{
+    _pieces = PieceTable::remove(_pieces, addr, len);
+}
+
+void QHexEditPieceData::replace(size_t addr, u_int8_t byte)
+{
+    remove(addr, 1);
+    insert(addr, byte);
+}
+
+void QHexEditPieceData::replace(size_t addr, const QByteArray & ba)
+{
+    replace(addr, ba.length(), ba);
+}
+
+void QHexEditPieceData::replace(size_t addr, size_t len, const QByteArray & ba)
+{
+    const size_t total = size();
+    if (addr >= total) {
+        return;
+    }
+    len = std::min(len, total - addr);
+    len = std::min(len, static_cast<size_t>(ba.length()));
+
+    remove(addr, len);
+    _pieces = PieceTable::insert(_pieces, addr, append(ba.constData(), len));
+}
+
+QByteArray QHexEditPieceData::toByteArray() const
+{
+    return range(0, size());
+}
+
+bool QHexEditPieceData::hasSpans() const
+{
+    return true;
+}
+
+QHexEditData::Spans QHexEditPieceData::spans(size_t addr, size_t len) const
+{
+    return PieceTable::extract(_pieces, addr, len);
+}
+
+void QHexEditPieceData::insertSpans(size_t addr, const Spans & spans)
+{
+    _pieces = PieceTable::insert(_pieces, addr, spans);
+}
+
+QHexEditData::Snapshot QHexEditPieceData::snapshot() const
+{
+    return std::make_shared<PieceSnapshot>(_pieces, _buffers, _holeBuffer >= 0);
+}
+
+QHexEditData::Snapshot QHexEditPieceData::original() const
+{
+    return std::make_shared<PieceSnapshot>(_originalPieces, _buffers, _holeBuffer >= 0);
+}
+
+std::vector<QHexEditData::Origin> QHexEditPieceData::origins() const
+{
+    // pieces following each other in the original are joined
+    std::vector<Origin> runs;
+    size_t pos = 0;
+    PieceTable::visit(_pieces, 0, size(), [&](const Piece & piece, size_t rel, size_t n) {
+        const PieceBuffer & buffer = *(*_buffers)[piece.buffer];
+        const qint64 sourcePos = buffer.original ? buffer.source + qint64(piece.offset + rel) : -1;
+        if (!runs.empty())
+        {
+            Origin & last = runs.back();
+            if ((sourcePos < 0 && last.sourcePos < 0) ||
+                (sourcePos >= 0 && last.sourcePos >= 0 && last.sourcePos + qint64(last.len) == sourcePos))
+            {
+                last.len += n;
+                pos += n;
+                return;
+            }
+        }
+        runs.push_back({ pos, n, sourcePos });
+        pos += n;
+    });
+    return runs;
+}
+
+size_t QHexEditPieceData::nextHole(size_t pos) const
+{
+    return _holeBuffer < 0 ? size() : findPieces(_pieces, *_buffers, pos, true);
+}
+
+size_t QHexEditPieceData::nextData(size_t pos) const
+{
+    return _holeBuffer < 0 ? std::min(pos, size()) : findPieces(_pieces, *_buffers, pos, false);
+}
+
+QString QHexEditPieceData::fileName() const
+{
+    return _source ? _source->fileName() : QString();
+}
+
+size_t QHexEditPieceData::readAppended()
+{
+    // a truncated or replaced file can't be followed
+    const qint64 fileSize = _source ? _source->size() : 0;
+    if (fileSize <= static_cast<qint64>(_sourceSize)) {
+        return 0;
+    }
+
+    const size_t len = fileSize - _sourceSize;
+    Piece piece;
+    uchar * mapped = len >= MIN_TAIL_MAP_SIZE ? _source->map(_sourceSize, len) : nullptr;
+    if (mapped)
+    {
+        std::shared_ptr<PieceBuffer> buffer = std::make_shared<PieceBuffer>();
+        buffer->data = reinterpret_cast<const char *>(mapped);
+        buffer->file = _source;
+        buffer->size = buffer->capacity = len;
+        buffer->original = true;
+        buffer->source = _sourceSize;
+        piece.buffer = static_cast<int>(_buffers->size());
+        piece.offset = 0;
+        piece.length = len;
+        addBuffer(std::move(buffer));
+
+        // the bytes of a tail buffer have to follow each other in the file
+        _tailBuffer = -1;
+    }
+    else if (!readTail(len, piece))
+    {
+        return 0;
+    }
+
+    // the piece continues the last one, if that was read from the tail buffer
+    _pieces = PieceTable::insert(_pieces, size(), piece);
+    _originalPieces = PieceTable::insert(_originalPieces, PieceTable::size(_originalPieces), piece);
+    _sourceSize += piece.length;
+    return piece.length;
+}
+
+bool QHexEditPieceData::readTail(size_t len, Piece & piece)
+{
+    if (_tailBuffer < 0 ||
+        (*_buffers)[_tailBuffer]->capacity - (*_buffers)[_tailBuffer]->size < len)
+    {
+        std::shared_ptr<PieceBuffer> buffer = std::make_shared<PieceBuffer>();
+        buffer->capacity = std::max(TAIL_BUFFER_SIZE, len);
+        buffer->bytes = QByteArray(static_cast<int>(buffer->capacity), Qt::Uninitialized);
+        buffer->data = buffer->bytes.constData();
+        buffer->size = 0;
+        buffer->original = true;
+        buffer->source = _sourceSize;
+        _tailBuffer = static_cast<int>(_buffers->size());
+        addBuffer(std::move(buffer));
+    }
+
+    // like inserted bytes, only the unused end of the buffer is written
+    PieceBuffer & buffer = *(*_buffers)[_tailBuffer];
+    if (!_source->seek(_sourceSize)) {
+        return false;
+    }
+    const qint64 read = _source->read(buffer.bytes.data() + buffer.size, len);
+    if (read <= 0) {
+        return false;
+    }
+
+    piece.buffer = _tailBuffer;
+    piece.offset = buffer.size;
+    piece.length = read;
+    buffer.size += read;
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // QHexEditData construction:
 std::unique_ptr<QHexEditData> QHexEditData::fromMemory(u_int8_t * ptr, size_t size)
@@ -393,3 +1377,22 @@ std::unique_ptr<QHexEditData> QHexEditData::fromByteArray(QByteArray ba)
 {
     return std::unique_ptr<QHexEditData>(new QHexEditByteArrayData(ba));
 }
+
+std::unique_ptr<QHexEditData> QHexEditData::fromFile(const QString & fileName)
+{
+    std::unique_ptr<QFile> file(new QFile(fileName));
+    if (!file->open(QIODevice::ReadOnly)) {
+        return std::unique_ptr<QHexEditData>();
+    }
+    return std::unique_ptr<QHexEditData>(new QHexEditPieceData(std::move(file)));
+}
+
+std::unique_ptr<QHexEditData> QHexEditData::fromReader(std::shared_ptr<const QHexEditReader> reader)
+{
+    return std::unique_ptr<QHexEditData>(new QHexEditPieceData(std::move(reader)));
+}
+
+std::unique_ptr<QHexEditData> QHexEditData::fromSegments(std::vector<Segment> segments)
+{
+    return std::unique_ptr<QHexEditData>(new QHexEditPieceData(std::move(segments)));
+}
@@ -6,6 +6,60 @@
 #include <QtCore>
 
 #include <memory>
+#include <vector>
+
+#include "piecetable.h"
+
+class EditJournal;
+class QHexEditData;
+
+/*! QHexEditSnapshot is an immutable version of the content of QHexEditData,
+taken by QHexEditData::snapshot(). It can be read from any thread without
+locking, while the data is edited on the GUI thread. A snapshot keeps the
+memory of its version alive, it is freed with the last snapshot referring
+to it.
+*/
+class QHexEditSnapshot
+{
+public:
+    virtual ~QHexEditSnapshot();
+
+    virtual size_t size() const = 0;
+    virtual QByteArray range(size_t addr, size_t len) const = 0;
+
+    // see QHexEditData::nextHole(), workers skip holes without reading them
+    virtual size_t nextHole(size_t pos) const;
+    virtual size_t nextData(size_t pos) const;
+};
+
+/*! QHexEditReader provides original content, which isn't kept in memory,
+e.g. a compressed file, which is decompressed on demand. QHexEditData keeps
+the edits of such content apart from it. read() may be called from several
+threads at once.
+*/
+class QHexEditReader
+{
+public:
+    virtual ~QHexEditReader();
+
+    virtual size_t size() const = 0;
+    virtual void read(size_t pos, char * dst, size_t len) const = 0;
+};
+
+/*! QHexEditDataObserver is told about every edit applied to QHexEditData by
+the undo/redo commands, e.g. to move positions it keeps along with the bytes.
+Replaced bytes keep their positions, so only inserts and removes are told.
+detached() is called, when the observed data is destroyed.
+*/
+class QHexEditDataObserver
+{
+public:
+    virtual ~QHexEditDataObserver();
+
+    virtual void inserted(size_t pos, size_t len) = 0;
+    virtual void removed(size_t pos, size_t len) = 0;
+    virtual void detached(QHexEditData * data) = 0;
+};
 
 /*! QHexEditData represents the content of QHexEdit.
 QHexEditData comprehend the data itself and informations to store if it was
@@ -32,14 +86,32 @@ public:
     int addressWidth() const;
     void setAddressWidth(size_t width);
 
+    // the address shown for the byte at pos. Backends presenting a foreign
+    // address space map their positions, the others add addressOffset().
+    virtual quint64 address(size_t pos) const;
+
     // TODO improve
-    bool dataChanged(int i);
-    QByteArray dataChanged(int i, int len);
-    void setDataChanged(int i, bool state);
-    void setDataChanged(int i, const QByteArray & state);
+    virtual bool dataChanged(int i);
+    virtual QByteArray dataChanged(int i, int len);
+    virtual void setDataChanged(int i, bool state);
+    virtual void setDataChanged(int i, const QByteArray & state);
 
     size_t realAddressNumbers() const;
 
+    // the journal gets all edits applied by the undo/redo commands
+    EditJournal * journal() const;
+    void setJournal(EditJournal * journal);
+
+    // observers are told about the inserts and removes of the commands
+    void addObserver(QHexEditDataObserver * observer);
+    void removeObserver(QHexEditDataObserver * observer);
+    const std::vector<QHexEditDataObserver *> & observers() const;
+
+    // the commands note the range of every applied edit, the widget collects
+    // the union of all noted ranges since the last call of takeChanges()
+    void addChange(size_t addr, size_t len, bool sizeChanged);
+    bool takeChanges(size_t & addr, size_t & len, bool & sizeChanged);
+
     QChar asciiChar(size_t index) const;
     QString toRedableString(size_t start = 0, size_t end = -1) const;
 
@@ -53,6 +125,11 @@ public:
     virtual size_t size() const = 0;
     virtual bool fixedSize() const = 0;
 
+    // false for backends, whose bytes can only be replaced (e.g. the memory
+    // of a process). QHexEditDocument applies inserts as replaces and drops
+    // removes then, QHexEdit stays in overwrite mode.
+    virtual bool canInsert() const;
+
     virtual void insert(size_t addr, u_int8_t byte) = 0;
     virtual void insert(size_t addr, const QByteArray & ba) = 0;
 
@@ -64,8 +141,78 @@ public:
 
     virtual QByteArray toByteArray() const = 0;
 
+    // writes the content in chunks, so it doesn't have to fit into memory
+    bool write(QIODevice & device) const;
+    bool writeCompressed(QIODevice & device) const;     // gzip, false without zlib
+
+    // spans are immutable descriptions of a part of the content, they don't
+    // copy any bytes. Backends which return true for hasSpans() support them.
+    typedef PieceTable::Tree Spans;
+    virtual bool hasSpans() const;
+    virtual Spans spans(size_t addr, size_t len) const;
+    virtual void insertSpans(size_t addr, const Spans & spans);
+
+    // an immutable version of the content for background workers. The piece
+    // table and the byte array backends share their memory with it, so it
+    // is taken in O(1). Other backends, including the memory backend,
+    // copy their content.
+    typedef std::shared_ptr<const QHexEditSnapshot> Snapshot;
+    virtual Snapshot snapshot() const;
+
+    // the content as it was loaded, null if the backend doesn't keep it
+    virtual Snapshot original() const;
+
+    // the content as runs, which are either unchanged bytes of original() or
+    // changed bytes, in the order of the data. Backends with spans find them
+    // in O(edits), the others return one changed run.
+    struct Origin
+    {
+        size_t pos;
+        size_t len;
+        qint64 sourcePos;               // in original(), -1 for changed bytes
+    };
+    virtual std::vector<Origin> origins() const;
+
+    // backends reading a file add the bytes, which were appended to the file
+    // since the last call, to the end of the data. The cost depends on the
+    // number of new bytes only. Returns that number.
+    virtual QString fileName() const;
+    virtual size_t readAppended();
+
+    // holes are ranges without content, e.g. unmapped memory of a process or
+    // the sparse parts of a file. They read as zeros without any I/O and are
+    // shown empty. nextHole() returns the first position >= pos inside a
+    // hole, nextData() the first one outside of a hole, both return size()
+    // if there is none.
+    virtual size_t nextHole(size_t pos) const;
+    virtual size_t nextData(size_t pos) const;
+
     static std::unique_ptr<QHexEditData> fromMemory(u_int8_t * ptr, size_t size);
     static std::unique_ptr<QHexEditData> fromByteArray(QByteArray ba);
+    static std::unique_ptr<QHexEditData> fromFile(const QString & fileName);
+
+    // read-only content, the edits are kept in memory
+    static std::unique_ptr<QHexEditData> fromReader(std::shared_ptr<const QHexEditReader> reader);
+
+    // a sparse image of segments at arbitrary addresses, e.g. a firmware
+    // image. The data starts at the lowest address, address() maps the
+    // positions back, the gaps between the segments are holes. Bytes of a
+    // segment overlapping an earlier one are dropped.
+    struct Segment
+    {
+        quint64 address;
+        QByteArray bytes;
+    };
+    static std::unique_ptr<QHexEditData> fromSegments(std::vector<Segment> segments);
+
+    // a gzip file or a zstd file in the seekable format, which is
+    // decompressed on demand. Returns null for other files, and for the
+    // formats whose library wasn't found at build time.
+    static std::unique_ptr<QHexEditData> fromCompressedFile(const QString & fileName);
+
+    // the memory of another process (Linux only), which has to be traceable
+    // by this one, e.g. a child. Returns null if it can't be read.
+    static std::unique_ptr<QHexEditData> fromProcess(qint64 pid);
 signals:
 
 public slots:
@@ -74,9 +221,15 @@ protected:
     QByteArray _changedData;
 
 private:
+    EditJournal * _journal;             // not owned, may be null
+    std::vector<QHexEditDataObserver *> _observers;     // not owned
+    bool _changePending;                // a change was noted since takeChanges()
+    bool _changeSize;                   // one of the changes inserted or removed bytes
+    size_t _changeBegin, _changeEnd;    // union of the changed ranges
     int _addressOffset;                 // will be added to the real addres inside bytearray
     size_t _addressNumbers;             // wanted width of address area
-    mutable size_t _realAddressNumbers; // real width of address area (can be greater then wanted width)
+    mutable size_t _realAddressNumbers; // nibbles of the highest address
+    mutable quint64 _highestAddress;    // address _realAddressNumbers was counted for
 };
 
 /** \endcond docNever */
@@ -0,0 +1,245 @@
+#include "qhexeditdocument.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// QHexEditDocument implementation:
+QHexEditDocument::QHexEditDocument(std::unique_ptr<QHexEditData> data) :
+    _data(std::move(data)),
+    _watcher(nullptr)
+{
+    _undoStack = new QUndoStack(this);
+
+    _changesTimer.setSingleShot(true);
+    _changesTimer.setInterval(0);
+    connect(&_changesTimer, SIGNAL(timeout()), this, SLOT(flushChanges()));
+
+    _hashEngine.setData(_data.get());
+    connect(this, SIGNAL(dataRangeChanged(size_t,size_t,bool)), &_hashEngine, SLOT(invalidate(size_t,size_t,bool)));
+    connect(&_hashEngine, SIGNAL(hashesReady(size_t,size_t)), this, SIGNAL(hashesReady(size_t,size_t)));
+}
+
+QHexEditDocument::~QHexEditDocument()
+{
+    // the commands hold payloads of _undoStore, so they have to go first
+    delete _undoStack;
+    closeJournal(false);
+}
+
+QHexEditData & QHexEditDocument::data() const
+{
+    return *_data;
+}
+
+QUndoStack * QHexEditDocument::undoStack() const
+{
+    return _undoStack;
+}
+
+void QHexEditDocument::applyChar(CharCommand::Cmd cmd, size_t pos, char ch)
+{
+    // backends, which can't insert, get their bytes replaced
+    if (!_data->canInsert())
+    {
+        if (cmd == CharCommand::remove) {
+            return;
+        }
+        cmd = CharCommand::replace;
+    }
+
+    if (_data->hasSpans())
+    {
+        // both enums list insert, remove, replace
+        static const ArrayCommand::Cmd cmds[] = { ArrayCommand::insert, ArrayCommand::remove, ArrayCommand::replace };
+        SpanCommand * command = new SpanCommand(*_data, cmds[cmd], pos, QByteArray(1, ch), 1);
+        command->setMergeable(true);
+        _undoStack->push(command);
+    }
+    else
+    {
+        _undoStack->push(new CharCommand(*_data, cmd, pos, ch));
+    }
+    scheduleChanges();
+}
+
+void QHexEditDocument::applyArray(ArrayCommand::Cmd cmd, size_t pos, const QByteArray & ba, size_t len)
+{
+    if (!_data->canInsert())
+    {
+        if (cmd == ArrayCommand::remove) {
+            return;
+        }
+        if (cmd == ArrayCommand::insert)
+        {
+            cmd = ArrayCommand::replace;
+            len = ba.length();
+        }
+    }
+
+    if (_data->hasSpans()) {
+        _undoStack->push(new SpanCommand(*_data, cmd, pos, ba, len));
+    } else {
+        _undoStack->push(new ArrayCommand(*_data, _undoStore, cmd, pos, ba, len));
+    }
+    scheduleChanges();
+}
+
+bool QHexEditDocument::changesPending() const
+{
+    return _changesTimer.isActive();
+}
+
+void QHexEditDocument::undo()
+{
+    _undoStack->undo();
+    checkUndoHistory();
+    scheduleChanges();
+}
+
+void QHexEditDocument::redo()
+{
+    _undoStack->redo();
+    checkUndoHistory();
+    scheduleChanges();
+}
+
+void QHexEditDocument::setUndoMemoryLimit(size_t limit)
+{
+    _undoStore.setMemoryLimit(limit);
+}
+
+size_t QHexEditDocument::undoMemoryLimit() const
+{
+    return _undoStore.memoryLimit();
+}
+
+size_t QHexEditDocument::undoMemoryUsage() const
+{
+    return _undoStore.memoryUsage();
+}
+
+size_t QHexEditDocument::undoSpilledBytes() const
+{
+    return _undoStore.spilledBytes();
+}
+
+int QHexEditDocument::openJournal(const QString & fileName, qint64 stamp, bool recover)
+{
+    closeJournal(false);
+
+    std::unique_ptr<EditJournal> journal(new EditJournal());
+    const int records = journal->open(fileName, *_data, stamp, recover);
+    if (records < 0) {
+        return records;
+    }
+
+    _journal = std::move(journal);
+    _data->setJournal(_journal.get());
+    if (records > 0)
+    {
+        // the recovered edits are not part of the undo history
+        _undoStack->clear();
+        _data->addChange(0, _data->size(), true);
+        scheduleChanges();
+    }
+    return records;
+}
+
+void QHexEditDocument::closeJournal(bool discard)
+{
+    if (!_journal) {
+        return;
+    }
+
+    _data->setJournal(nullptr);
+    _journal->close(discard);
+    _journal.reset();
+}
+
+bool QHexEditDocument::hasJournal() const
+{
+    return _journal != nullptr;
+}
+
+HashEngine & QHexEditDocument::hashEngine()
+{
+    return _hashEngine;
+}
+
+const HashEngine & QHexEditDocument::hashEngine() const
+{
+    return _hashEngine;
+}
+
+void QHexEditDocument::setFollowing(bool follow)
+{
+    if (follow == isFollowing()) {
+        return;
+    }
+
+    if (!follow)
+    {
+        delete _watcher;
+        _watcher = nullptr;
+        return;
+    }
+
+    const QString fileName = _data->fileName();
+    if (fileName.isEmpty()) {
+        return;
+    }
+    _watcher = new QFileSystemWatcher(QStringList(fileName), this);
+    connect(_watcher, SIGNAL(fileChanged(QString)), this, SLOT(readAppended()));
+
+    // catch up with what was written since the file was opened
+    readAppended();
+}
+
+bool QHexEditDocument::isFollowing() const
+{
+    return _watcher != nullptr;
+}
+
+void QHexEditDocument::readAppended()
+{
+    const size_t pos = _data->size();
+    const size_t len = _data->readAppended();
+    if (len > 0)
+    {
+        _data->addChange(pos, len, true);
+        scheduleChanges();
+    }
+}
+
+void QHexEditDocument::checkUndoHistory()
+{
+    // a command refused to act, because its payload couldn't be read back.
+    // The stack moved on nevertheless, so none of its commands fits the data.
+    if (!_undoStore.takeLoadFailed()) {
+        return;
+    }
+    _undoStack->clear();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+    // the data still differs from the saved file
+    _undoStack->resetClean();
+#endif
+    emit undoHistoryLost();
+}
+
+void QHexEditDocument::scheduleChanges()
+{
+    if (!_changesTimer.isActive()) {
+        _changesTimer.start();
+    }
+}
+
+void QHexEditDocument::flushChanges()
+{
+    _changesTimer.stop();
+
+    // undo on an empty stack or a command, which changed nothing, noted no
+    // range, so the views and the engines are left alone
+    size_t pos, len;
+    bool sizeChanged;
+    if (_data->takeChanges(pos, len, sizeChanged)) {
+        emit dataRangeChanged(pos, len, sizeChanged);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef QHEXEDITDOCUMENT_H
+#define QHEXEDITDOCUMENT_H
+
+/** \cond docNever */
+
+#include <QtCore>
+#include <QFileSystemWatcher>
+#include <QUndoStack>
+
+#include <memory>
+
+#include "qhexeditdata.h"
+#include "undostore.h"
+#include "commands.h"
+#include "editjournal.h"
+#include "hashengine.h"
+
+/*! QHexEditDocument is the content shared by one or more QHexEdit views. It
+owns the QHexEditData with everything, which belongs to the data and not to a
+view: the undo/redo history, the edit journal and the checksums.
+
+A document is held by std::shared_ptr, every view attached with
+QHexEdit::setDocument() keeps it alive. The views have their own cursor,
+selection and layout. Edits of all views are applied through apply*() and are
+announced once per event loop iteration by dataRangeChanged(), so every view
+repaints the part of the range it shows and nothing is copied.
+
+With setFollowing() a growing file (e.g. a log or a capture) is watched, the
+appended bytes are added to the end of the data like an edit, which is not
+part of the undo history.
+*/
+class QHexEditDocument : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QHexEditDocument(std::unique_ptr<QHexEditData> data);
+    ~QHexEditDocument();
+
+    QHexEditData & data() const;
+    QUndoStack * undoStack() const;
+
+    // pushes an undoable edit, the changed range is announced later
+    void applyChar(CharCommand::Cmd cmd, size_t pos, char ch);
+    void applyArray(ArrayCommand::Cmd cmd, size_t pos, const QByteArray & ba, size_t len);
+    bool changesPending() const;
+
+    void undo();
+    void redo();
+
+    void setUndoMemoryLimit(size_t limit);
+    size_t undoMemoryLimit() const;
+    size_t undoMemoryUsage() const;
+    size_t undoSpilledBytes() const;
+
+    int openJournal(const QString & fileName, qint64 stamp, bool recover);
+    void closeJournal(bool discard);
+    bool hasJournal() const;
+
+    HashEngine & hashEngine();
+    const HashEngine & hashEngine() const;
+
+    // watches the file of the data and appends what is written to it
+    void setFollowing(bool follow);
+    bool isFollowing() const;
+
+signals:
+    void dataRangeChanged(size_t pos, size_t len, bool sizeChanged);
+    void hashesReady(size_t pos, size_t len);
+    void undoHistoryLost();
+
+private slots:
+    void flushChanges();
+    void readAppended();
+
+private:
+    QHexEditDocument(const QHexEditDocument & other) = delete;
+    QHexEditDocument & operator=(const QHexEditDocument & other) = delete;
+
+    void scheduleChanges();
+    void checkUndoHistory();
+
+    std::unique_ptr<QHexEditData> _data;
+    std::unique_ptr<EditJournal> _journal;
+    UndoStore _undoStore;
+    QUndoStack * _undoStack;
+    HashEngine _hashEngine;                 // follows the edits of _data
+    QTimer _changesTimer;                   // collects the edits of one event loop iteration
+    QFileSystemWatcher * _watcher;          // only while following the file
+};
+
+/** \endcond docNever */
+
+#endif // QHEXEDITDOCUMENT_H
@@ -0,0 +1,29 @@
+#ifndef QHEXEDITHIGHLIGHTER_H
+#define QHEXEDITHIGHLIGHTER_H
+
+#include <QColor>
+
+#include <cstddef>
+
+/*! QHexEditHighlighter is the extension point to colour bytes of QHexEdit,
+e.g. the differences of a compare or the fields of a structure. Register an
+implementation with QHexEdit::addHighlighter(), QHexEdit does not take
+ownership.
+
+While painting, QHexEdit asks every highlighter once for all visible bytes.
+Highlighters are asked in the order they were added, a later one overwrites
+the colours of an earlier one. The selection is painted above all of them.
+*/
+class QHexEditHighlighter
+{
+public:
+    virtual ~QHexEditHighlighter() { }
+
+    /*! Sets the background colours of the bytes [begin, end).
+    \param colors Array of end - begin colours, one per byte. Bytes, whose
+    colour is left invalid, are painted as usual.
+    */
+    virtual void highlight(size_t begin, size_t end, QColor * colors) const = 0;
+};
+
+#endif // QHEXEDITHIGHLIGHTER_H
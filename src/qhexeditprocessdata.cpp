@@ -0,0 +1,516 @@
+#include "qhexeditdata.h"
+
+#ifdef Q_OS_LINUX
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+const qint64 CACHE_TTL = 200;           // ms a cached page is shown without reading it again
+const int CACHE_PAGES = 1024;           // pages kept for repaints
+const size_t CACHE_READ_LIMIT = 64;     // pages, larger reads bypass the cache
+const size_t SEARCH_CHUNK_SIZE = 1024 * 1024;
+
+// A readable mapping of the process. The mappings are laid out one after the
+// other, separated by a hole of one page, so the gaps of the address space
+// don't take any room.
+struct ProcessRegion
+{
+    quint64 begin, end;                 // addresses in the process
+    size_t pos;                         // position in the data
+};
+
+typedef std::vector<ProcessRegion> ProcessRegions;
+
+static size_t pageSize()
+{
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+// reads the readable mappings from /proc/<pid>/maps
+static ProcessRegions readMaps(qint64 pid)
+{
+    ProcessRegions regions;
+    QFile maps(QString("/proc/%1/maps").arg(pid));
+    if (!maps.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return regions;
+    }
+
+    // "begin-end perms offset dev inode path", e.g.
+    // "7f2c1a000000-7f2c1a021000 rw-p 00000000 00:00 0"
+    size_t pos = 0;
+    for (QByteArray line = maps.readLine(); !line.isEmpty(); line = maps.readLine())
+    {
+        const QList<QByteArray> fields = line.simplified().split(' ');
+        if (fields.size() < 2 || !fields[1].startsWith('r')) {
+            continue;
+        }
+
+        const QList<QByteArray> bounds = fields[0].split('-');
+        bool beginOk = false, endOk = false;
+        const quint64 begin = bounds.value(0).toULongLong(&beginOk, 16);
+        const quint64 end = bounds.value(1).toULongLong(&endOk, 16);
+        if (!beginOk || !endOk || end <= begin) {
+            continue;
+        }
+
+        // adjacent mappings (e.g. the parts of a library) are joined
+        if (!regions.empty() && regions.back().end == begin)
+        {
+            regions.back().end = end;
+            pos += end - begin;
+            continue;
+        }
+        if (!regions.empty()) {
+            pos += pageSize();
+        }
+        regions.push_back({ begin, end, pos });
+        pos += end - begin;
+    }
+    return regions;
+}
+
+static size_t regionsSize(const ProcessRegions & regions)
+{
+    return regions.empty() ? 0 : regions.back().pos + (regions.back().end - regions.back().begin);
+}
+
+// the region containing pos or the last one in front of it
+static ProcessRegions::const_iterator findRegion(const ProcessRegions & regions, size_t pos)
+{
+    ProcessRegions::const_iterator it = std::upper_bound(regions.begin(), regions.end(), pos,
+        [](size_t p, const ProcessRegion & region) { return p < region.pos; });
+    return it == regions.begin() ? regions.end() : it - 1;
+}
+
+// the holes are the pages between the regions
+static size_t regionsNextHole(const ProcessRegions & regions, size_t pos)
+{
+    const size_t total = regionsSize(regions);
+    ProcessRegions::const_iterator it = findRegion(regions, pos);
+    if (it == regions.end() || pos >= total) {
+        return std::min(pos, total);
+    }
+    return std::max(pos, it->pos + static_cast<size_t>(it->end - it->begin));
+}
+
+static size_t regionsNextData(const ProcessRegions & regions, size_t pos)
+{
+    const size_t total = regionsSize(regions);
+    ProcessRegions::const_iterator it = findRegion(regions, pos);
+    if (it == regions.end() || pos >= total || pos < it->pos + static_cast<size_t>(it->end - it->begin)) {
+        return std::min(pos, total);
+    }
+    return ++it == regions.end() ? total : it->pos;
+}
+
+// reads len bytes at address, unreadable pages (e.g. guard pages) are zeros
+static void readMemory(pid_t pid, quint64 address, char * dst, size_t len)
+{
+    while (len > 0)
+    {
+        struct iovec local = { dst, len };
+        struct iovec remote = { reinterpret_cast<void *>(address), len };
+        ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+        if (n <= 0)
+        {
+            n = static_cast<ssize_t>(std::min(len, pageSize() - (address & (pageSize() - 1))));
+            memset(dst, 0, n);
+        }
+        dst += n;
+        address += n;
+        len -= n;
+    }
+}
+
+// calls visit(address, offset, n) for the parts of the positions
+// [pos, pos + len) inside a region, offset is relative to pos
+template <typename Visitor>
+static void visitRegions(const ProcessRegions & regions, size_t pos, size_t len, Visitor visit)
+{
+    const size_t end = pos + len;
+    ProcessRegions::const_iterator it = findRegion(regions, pos);
+    for (it = (it == regions.end() ? regions.begin() : it); it != regions.end() && it->pos < end; ++it)
+    {
+        const size_t first = std::max(pos, it->pos);
+        const size_t last = std::min(end, it->pos + static_cast<size_t>(it->end - it->begin));
+        if (first < last) {
+            visit(it->begin + (first - it->pos), first - pos, last - first);
+        }
+    }
+}
+
+// reads the positions [pos, pos + len), holes are zeros
+template <typename Reader>
+static QByteArray readRegions(const ProcessRegions & regions, size_t pos, size_t len, Reader read)
+{
+    const size_t total = regionsSize(regions);
+    if (pos >= total) {
+        return QByteArray();
+    }
+    len = std::min(len, total - pos);
+
+    QByteArray result(static_cast<int>(len), '\0');
+    char * data = result.data();
+    visitRegions(regions, pos, len, [&](quint64 address, size_t offset, size_t n) {
+        read(address, data + offset, n);
+    });
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ProcessSnapshot implementation:
+/** \cond docNever */
+// The memory of a process changes by itself, so a snapshot only keeps the
+// layout. It reads the process directly from any thread.
+class ProcessSnapshot : public QHexEditSnapshot
+{
+public:
+    ProcessSnapshot(pid_t pid, const std::shared_ptr<const ProcessRegions> & regions) :
+        _pid(pid),
+        _regions(regions)
+    { }
+
+    virtual size_t size() const
+    {
+        return regionsSize(*_regions);
+    }
+
+    virtual QByteArray range(size_t addr, size_t len) const
+    {
+        const pid_t pid = _pid;
+        return readRegions(*_regions, addr, len, [pid](quint64 address, char * dst, size_t n) {
+            readMemory(pid, address, dst, n);
+        });
+    }
+
+    virtual size_t nextHole(size_t pos) const
+    {
+        return regionsNextHole(*_regions, pos);
+    }
+
+    virtual size_t nextData(size_t pos) const
+    {
+        return regionsNextData(*_regions, pos);
+    }
+
+private:
+    const pid_t _pid;
+    const std::shared_ptr<const ProcessRegions> _regions;
+};
+/** \endcond docNever */
+
+////////////////////////////////////////////////////////////////////////////////
+// QHexEditProcessData implementation:
+/** \cond docNever */
+/*! QHexEditProcessData shows the readable mappings of another process, read
+with process_vm_readv() and written with process_vm_writev(). The gaps
+between the mappings are holes. Repaints read the same lines again and again,
+so the pages are cached for a short time.
+
+The size is fixed and canInsert() is false, so insert() and remove() must
+not be called. Callers check canInsert(), QHexEditDocument turns inserts into
+replaces and drops removes. Writes to read-only mappings fail silently, the
+next repaint shows the real content.
+*/
+class QHexEditProcessData : public QHexEditData
+{
+public:
+    QHexEditProcessData(pid_t pid, ProcessRegions regions);
+    virtual ~QHexEditProcessData();
+
+    virtual quint64 address(size_t pos) const;
+
+    virtual bool dataChanged(int i);
+    virtual QByteArray dataChanged(int i, int len);
+    virtual void setDataChanged(int i, bool state);
+    virtual void setDataChanged(int i, const QByteArray & state);
+
+    virtual u_int8_t at(size_t addr) const;
+    virtual QByteArray range(size_t addr, size_t len) const;
+
+    virtual int indexOf(const QByteArray & ba, size_t from) const;
+    virtual int lastIndexOf(const QByteArray & ba, size_t from) const;
+
+    virtual size_t size() const;
+    virtual bool fixedSize() const;
+    virtual bool canInsert() const;
+
+    virtual void insert(size_t addr, u_int8_t byte);
+    virtual void insert(size_t addr, const QByteArray & ba);
+
+    virtual void remove(size_t addr, size_t len);
+
+    virtual void replace(size_t addr, u_int8_t byte);
+    virtual void replace(size_t addr, const QByteArray & ba);
+    virtual void replace(size_t addr, size_t len, const QByteArray & ba);
+
+    virtual QByteArray toByteArray() const;
+
+    virtual Snapshot snapshot() const;
+
+    virtual size_t nextHole(size_t pos) const;
+    virtual size_t nextData(size_t pos) const;
+
+private:
+    struct CachedPage
+    {
+        QByteArray bytes;
+        qint64 time;                    // of the read
+    };
+
+    void readCached(quint64 address, char * dst, size_t len) const;
+
+    const pid_t _pid;
+    std::shared_ptr<const ProcessRegions> _regions;
+    size_t _size;
+    mutable QHash<quint64, CachedPage> _cache;      // by page address
+    mutable QElapsedTimer _clock;
+};
+
+QHexEditProcessData::QHexEditProcessData(pid_t pid, ProcessRegions regions) :
+    _pid(pid),
+    _regions(std::make_shared<ProcessRegions>(std::move(regions)))
+{
+    _size = regionsSize(*_regions);
+    _clock.start();
+}
+
+QHexEditProcessData::~QHexEditProcessData()
+{ }
+
+quint64 QHexEditProcessData::address(size_t pos) const
+{
+    // positions in a hole continue the addresses of the region in front of it
+    ProcessRegions::const_iterator it = findRegion(*_regions, pos);
+    if (it == _regions->end()) {
+        return pos;
+    }
+    return it->begin + (pos - it->pos);
+}
+
+bool QHexEditProcessData::dataChanged(int)
+{
+    return false;
+}
+
+QByteArray QHexEditProcessData::dataChanged(int, int len)
+{
+    return QByteArray(len, char(0));
+}
+
+void QHexEditProcessData::setDataChanged(int, bool)
+{ }
+
+void QHexEditProcessData::setDataChanged(int, const QByteArray &)
+{ }
+
+void QHexEditProcessData::readCached(quint64 address, char * dst, size_t len) const
+{
+    // large reads (searching, saving) would only evict the visible pages
+    const size_t page = pageSize();
+    if (len > CACHE_READ_LIMIT * page)
+    {
+        readMemory(_pid, address, dst, len);
+        return;
+    }
+
+    const qint64 now = _clock.elapsed();
+    const quint64 end = address + len;
+    quint64 pageAddress = address & ~quint64(page - 1);
+    while (pageAddress < end)
+    {
+        // the pages to read again are fetched with one call
+        quint64 staleEnd = pageAddress;
+        for (;;)
+        {
+            QHash<quint64, CachedPage>::const_iterator it = _cache.constFind(staleEnd);
+            if (staleEnd >= end || (it != _cache.constEnd() && now - it->time < CACHE_TTL)) {
+                break;
+            }
+            staleEnd += page;
+        }
+        if (staleEnd > pageAddress)
+        {
+            if (_cache.size() > CACHE_PAGES) {
+                _cache.clear();
+            }
+            QByteArray bytes(static_cast<int>(staleEnd - pageAddress), Qt::Uninitialized);
+            readMemory(_pid, pageAddress, bytes.data(), bytes.size());
+            for (quint64 p = pageAddress; p < staleEnd; p += page) {
+                _cache.insert(p, { bytes.mid(static_cast<int>(p - pageAddress), static_cast<int>(page)), now });
+            }
+        }
+
+        for (; pageAddress < end; pageAddress += page)
+        {
+            QHash<quint64, CachedPage>::const_iterator it = _cache.constFind(pageAddress);
+            if (it == _cache.constEnd() || now - it->time >= CACHE_TTL) {
+                break;
+            }
+            const quint64 first = std::max(address, pageAddress);
+            const quint64 last = std::min(end, pageAddress + page);
+            memcpy(dst + (first - address), it->bytes.constData() + (first - pageAddress), last - first);
+        }
+    }
+}
+
+u_int8_t QHexEditProcessData::at(size_t addr) const
+{
+    const QByteArray byte = range(addr, 1);
+    return byte.isEmpty() ? 0 : static_cast<u_int8_t>(byte[0]);
+}
+
+QByteArray QHexEditProcessData::range(size_t addr, size_t len) const
+{
+    return readRegions(*_regions, addr, len, [this](quint64 address, char * dst, size_t n) {
+        readCached(address, dst, n);
+    });
+}
+
+int QHexEditProcessData::indexOf(const QByteArray & ba, size_t from) const
+{
+    const size_t overlap = ba.isEmpty() ? 0 : ba.length() - 1;
+    for (size_t pos = from; pos < _size; pos += SEARCH_CHUNK_SIZE)
+    {
+        const int idx = range(pos, SEARCH_CHUNK_SIZE + overlap).indexOf(ba);
+        if (idx >= 0) {
+            return static_cast<int>(pos + idx);
+        }
+    }
+    return -1;
+}
+
+int QHexEditProcessData::lastIndexOf(const QByteArray & ba, size_t from) const
+{
+    if (_size == 0) {
+        return -1;
+    }
+
+    const size_t overlap = ba.isEmpty() ? 0 : ba.length() - 1;
+    size_t end = std::min(from, _size - 1);
+    for (;;)
+    {
+        const size_t start = (end >= SEARCH_CHUNK_SIZE) ? end - SEARCH_CHUNK_SIZE + 1 : 0;
+        const QByteArray chunk = range(start, end - start + 1 + overlap);
+        const int idx = chunk.lastIndexOf(ba, static_cast<int>(end - start));
+        if (idx >= 0) {
+            return static_cast<int>(start + idx);
+        }
+        if (start == 0) {
+            return -1;
+        }
+        end = start - 1;
+    }
+}
+
+size_t QHexEditProcessData::size() const
+{
+    return _size;
+}
+
+bool QHexEditProcessData::fixedSize() const
+{
+    return true;
+}
+
+bool QHexEditProcessData::canInsert() const
+{
+    return false;
+}
+
+// the mappings of a process can't grow or shrink, the document never applies
+// inserts and removes to this backend (see canInsert())
+void QHexEditProcessData::insert(size_t, u_int8_t)
+{
+    Q_ASSERT(false);
+}
+
+void QHexEditProcessData::insert(size_t, const QByteArray &)
+{
+    Q_ASSERT(false);
+}
+
+void QHexEditProcessData::remove(size_t, size_t)
+{
+    Q_ASSERT(false);
+}
+
+void QHexEditProcessData::replace(size_t addr, u_int8_t byte)
+{
+    replace(addr, 1, QByteArray(1, static_cast<char>(byte)));
+}
+
+void QHexEditProcessData::replace(size_t addr, const QByteArray & ba)
+{
+    replace(addr, ba.length(), ba);
+}
+
+void QHexEditProcessData::replace(size_t addr, size_t len, const QByteArray & ba)
+{
+    if (addr >= _size) {
+        return;
+    }
+    len = std::min(len, std::min(static_cast<size_t>(ba.length()), _size - addr));
+
+    const pid_t pid = _pid;
+    visitRegions(*_regions, addr, len, [&](quint64 address, size_t offset, size_t n) {
+        struct iovec local = { const_cast<char *>(ba.constData()) + offset, n };
+        struct iovec remote = { reinterpret_cast<void *>(address), n };
+        process_vm_writev(pid, &local, 1, &remote, 1, 0);
+    });
+    _cache.clear();
+}
+
+QByteArray QHexEditProcessData::toByteArray() const
+{
+    return range(0, _size);
+}
+
+QHexEditData::Snapshot QHexEditProcessData::snapshot() const
+{
+    return std::make_shared<ProcessSnapshot>(_pid, _regions);
+}
+
+size_t QHexEditProcessData::nextHole(size_t pos) const
+{
+    return regionsNextHole(*_regions, pos);
+}
+
+size_t QHexEditProcessData::nextData(size_t pos) const
+{
+    return regionsNextData(*_regions, pos);
+}
+/** \endcond docNever */
+
+std::unique_ptr<QHexEditData> QHexEditData::fromProcess(qint64 pid)
+{
+    ProcessRegions regions = readMaps(pid);
+    if (regions.empty()) {
+        return std::unique_ptr<QHexEditData>();
+    }
+
+    // fails e.g. for processes, which aren't children of this one
+    char probe;
+    struct iovec local = { &probe, 1 };
+    struct iovec remote = { reinterpret_cast<void *>(regions.front().begin), 1 };
+    if (process_vm_readv(static_cast<pid_t>(pid), &local, 1, &remote, 1, 0) < 0 && errno == EPERM) {
+        return std::unique_ptr<QHexEditData>();
+    }
+    return std::unique_ptr<QHexEditData>(new QHexEditProcessData(static_cast<pid_t>(pid), std::move(regions)));
+}
+
+#else
+
+std::unique_ptr<QHexEditData> QHexEditData::fromProcess(qint64)
+{
+    return std::unique_ptr<QHexEditData>();
+}
+
+#endif // Q_OS_LINUX
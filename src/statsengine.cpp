@@ -0,0 +1,428 @@
+#include "statsengine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+const size_t MIN_BLOCK_SIZE = 64 * 1024;
+const size_t MAX_BLOCKS = 64 * 1024;            // more blocks get bigger instead
+const int POLL_INTERVAL = 5;                    // ms, while waiting for workers
+
+static size_t blockSizeFor(size_t size)
+{
+    size_t blockSize = MIN_BLOCK_SIZE;
+    while (size / blockSize > MAX_BLOCKS) {
+        blockSize *= 2;
+    }
+    return blockSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// StatsResults implementation:
+/*! StatsResults collects the results of the workers. It is shared between the
+engine and the tasks, so a task which finishes after the engine was deleted
+doesn't write into freed memory.
+*/
+class StatsResults
+{
+public:
+    struct Result
+    {
+        int block;
+        quint32 generation;
+        BlockStats stats;
+    };
+
+    void push(const Result & result)
+    {
+        QMutexLocker locker(&_mutex);
+        _results.append(result);
+    }
+
+    QVector<Result> take()
+    {
+        QMutexLocker locker(&_mutex);
+        QVector<Result> results;
+        results.swap(_results);
+        return results;
+    }
+
+private:
+    QMutex _mutex;
+    QVector<Result> _results;
+};
+
+class StatsTask : public QRunnable
+{
+public:
+    StatsTask(const std::shared_ptr<StatsResults> & results, const QHexEditData::Snapshot & snapshot,
+              size_t pos, size_t len, int block, quint32 generation) :
+        _results(results),
+        _snapshot(snapshot),
+        _pos(pos),
+        _len(len),
+        _block(block),
+        _generation(generation)
+    { }
+
+    void run()
+    {
+        quint32 counts[256];
+        memset(counts, 0, sizeof(counts));
+
+        // holes are counted as zeros, only the data between them is read
+        const size_t end = std::min(_pos + _len, _snapshot->size());
+        for (size_t pos = _pos; pos < end;)
+        {
+            const size_t hole = std::min(_snapshot->nextHole(pos), end);
+            if (hole > pos)
+            {
+                const QByteArray bytes = _snapshot->range(pos, hole - pos);
+                StatsEngine::histogram(reinterpret_cast<const uchar *>(bytes.constData()), bytes.size(), counts);
+            }
+            pos = std::min(_snapshot->nextData(hole), end);
+            counts[0] += static_cast<quint32>(pos - hole);
+        }
+        _snapshot.reset();
+
+        StatsResults::Result result;
+        result.block = _block;
+        result.generation = _generation;
+        result.stats = StatsEngine::evaluate(counts, end > _pos ? end - _pos : 0);
+        _results->push(result);
+    }
+
+private:
+    std::shared_ptr<StatsResults> _results;
+    QHexEditData::Snapshot _snapshot;
+    size_t _pos, _len;
+    int _block;
+    quint32 _generation;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// StatsEngine implementation:
+StatsEngine::StatsEngine(QObject * parent) :
+    QObject(parent),
+    _data(nullptr),
+    _dataSize(0),
+    _blockSize(MIN_BLOCK_SIZE),
+    _results(std::make_shared<StatsResults>()),
+    _inFlight(0)
+{
+    _feedTimer.setSingleShot(true);
+    connect(&_feedTimer, SIGNAL(timeout()), this, SLOT(feed()));
+}
+
+StatsEngine::~StatsEngine()
+{ }
+
+void StatsEngine::setData(QHexEditData * data)
+{
+    _data = data;
+    _snapshot.reset();
+    reset();
+}
+
+size_t StatsEngine::dataSize() const
+{
+    return _dataSize;
+}
+
+size_t StatsEngine::blockSize() const
+{
+    return _blockSize;
+}
+
+int StatsEngine::levels() const
+{
+    return static_cast<int>(_levels.size());
+}
+
+const std::vector<BlockStats> & StatsEngine::level(int level) const
+{
+    return _levels[level];
+}
+
+BlockStats StatsEngine::summary(int first, int last) const
+{
+    BlockStats result = BlockStats();
+    if (_levels.empty()) {
+        return result;
+    }
+
+    // walk up the pyramid, only the borders are merged on the lower levels
+    int level = 0;
+    while (first < last)
+    {
+        const std::vector<BlockStats> & entries = _levels[level];
+        if (first & 1) {
+            result = merge(result, entries[first++]);
+        }
+        if (last & 1) {
+            result = merge(result, entries[--last]);
+        }
+        if (level + 1 == levels())
+        {
+            for (; first < last; first++) {
+                result = merge(result, entries[first]);
+            }
+            break;
+        }
+        first >>= 1;
+        last >>= 1;
+        level++;
+    }
+    return result;
+}
+
+int StatsEngine::pendingBlocks() const
+{
+    return _todo.size() + _inFlight;
+}
+
+void StatsEngine::histogram(const uchar * data, size_t len, quint32 * counts)
+{
+    // four tables break the dependency between increments of equal bytes,
+    // which otherwise serializes the loop on the store-to-load forwarding
+    quint32 tables[4][256];
+    memset(tables, 0, sizeof(tables));
+
+    const uchar * p = data;
+    const uchar * end = data + len;
+    for (; end - p >= 8; p += 8)
+    {
+        quint64 word;
+        memcpy(&word, p, sizeof(word));
+        tables[0][word & 0xff]++;
+        tables[1][(word >> 8) & 0xff]++;
+        tables[2][(word >> 16) & 0xff]++;
+        tables[3][(word >> 24) & 0xff]++;
+        tables[0][(word >> 32) & 0xff]++;
+        tables[1][(word >> 40) & 0xff]++;
+        tables[2][(word >> 48) & 0xff]++;
+        tables[3][word >> 56]++;
+    }
+    for (; p < end; p++) {
+        tables[0][*p]++;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        counts[i] += tables[0][i] + tables[1][i] + tables[2][i] + tables[3][i];
+    }
+}
+
+BlockStats StatsEngine::evaluate(const quint32 * counts, size_t len)
+{
+    BlockStats stats = BlockStats();
+    if (len == 0) {
+        return stats;
+    }
+
+    quint64 ascii = counts['\t'] + counts['\n'] + counts['\r'];
+    for (int i = 0x20; i < 0x7f; i++) {
+        ascii += counts[i];
+    }
+
+    double entropy = 0.0;
+    for (int i = 0; i < 256; i++)
+    {
+        if (counts[i] != 0)
+        {
+            const double p = double(counts[i]) / len;
+            entropy -= p * std::log2(p);
+        }
+    }
+
+    stats.entropy = entropy / 8.0;
+    stats.zeros = double(counts[0]) / len;
+    stats.ascii = double(ascii) / len;
+    stats.weight = 1.0f;
+    return stats;
+}
+
+BlockStats StatsEngine::merge(const BlockStats & a, const BlockStats & b)
+{
+    const float weight = a.weight + b.weight;
+    if (weight == 0.0f) {
+        return BlockStats();
+    }
+
+    BlockStats stats;
+    stats.entropy = (a.entropy * a.weight + b.entropy * b.weight) / weight;
+    stats.zeros = (a.zeros * a.weight + b.zeros * b.weight) / weight;
+    stats.ascii = (a.ascii * a.weight + b.ascii * b.weight) / weight;
+    stats.weight = weight;
+    return stats;
+}
+
+void StatsEngine::invalidate(size_t pos, size_t len, bool sizeChanged)
+{
+    if (!_data) {
+        return;
+    }
+
+    const size_t size = _data->size();
+    if (sizeChanged && blockSizeFor(size) != _blockSize)
+    {
+        reset();
+        return;
+    }
+
+    // the queued blocks are read from the edited data
+    _snapshot.reset();
+
+    int first = pos / _blockSize;
+    int last;
+    if (sizeChanged)
+    {
+        // all following bytes have moved
+        _dataSize = size;
+        const int blocks = (size + _blockSize - 1) / _blockSize;
+        _levels[0].resize(blocks, BlockStats());
+        _generation.resize(blocks, 0);
+        _queued.resize(blocks, false);
+        last = blocks;
+    }
+    else
+    {
+        last = std::min<size_t>(_levels[0].size(), (pos + len + _blockSize - 1) / _blockSize);
+    }
+
+    // the old statistics stay visible until the new ones arrive
+    for (int block = first; block < last; block++)
+    {
+        _generation[block]++;
+        if (!_queued[block])
+        {
+            _queued[block] = true;
+            _todo.enqueue(block);
+        }
+    }
+
+    if (sizeChanged)
+    {
+        // the upper levels may have changed their shape, rebuild them
+        _levels.resize(1);
+        while (_levels.back().size() > 1)
+        {
+            const std::vector<BlockStats> & below = _levels.back();
+            std::vector<BlockStats> above((below.size() + 1) / 2);
+            for (size_t i = 0; i < above.size(); i++) {
+                above[i] = merge(below[2 * i], 2 * i + 1 < below.size() ? below[2 * i + 1] : BlockStats());
+            }
+            _levels.push_back(above);
+        }
+        emit blocksChanged(first, last);
+    }
+
+    if (!_feedTimer.isActive()) {
+        _feedTimer.start(0);
+    }
+}
+
+void StatsEngine::reset()
+{
+    _todo.clear();
+    _levels.clear();
+    _generation.clear();
+    _queued.clear();
+    _snapshot.reset();
+    _dataSize = _data ? _data->size() : 0;
+    _blockSize = blockSizeFor(_dataSize);
+
+    // results of the old data are dropped with the old queue
+    _results = std::make_shared<StatsResults>();
+    _inFlight = 0;
+
+    const size_t blocks = (_dataSize + _blockSize - 1) / _blockSize;
+    _levels.push_back(std::vector<BlockStats>(blocks, BlockStats()));
+    while (_levels.back().size() > 1) {
+        _levels.push_back(std::vector<BlockStats>((_levels.back().size() + 1) / 2, BlockStats()));
+    }
+    _generation.resize(blocks, 0);
+    _queued.resize(blocks, true);
+    for (size_t block = 0; block < blocks; block++) {
+        _todo.enqueue(block);
+    }
+
+    emit blocksChanged(0, blocks);
+    _feedTimer.start(0);
+}
+
+void StatsEngine::collect()
+{
+    const QVector<StatsResults::Result> results = _results->take();
+    if (results.isEmpty()) {
+        return;
+    }
+
+    int first = std::numeric_limits<int>::max();
+    int last = 0;
+    for (const StatsResults::Result & result : results)
+    {
+        _inFlight--;
+        if (result.block >= static_cast<int>(_levels[0].size()) ||
+            result.generation != _generation[result.block])
+        {
+            continue;
+        }
+
+        _levels[0][result.block] = result.stats;
+        updateParents(result.block);
+        first = std::min(first, result.block);
+        last = std::max(last, result.block + 1);
+    }
+
+    if (first < last) {
+        emit blocksChanged(first, last);
+    }
+}
+
+void StatsEngine::feed()
+{
+    collect();
+
+    const int maxInFlight = 2 * std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    if (_data && !_todo.isEmpty() && !_snapshot) {
+        _snapshot = _data->snapshot();
+    }
+
+    while (_data && !_todo.isEmpty() && _inFlight < maxInFlight)
+    {
+        const int block = _todo.dequeue();
+        if (block >= static_cast<int>(_levels[0].size())) {
+            continue;
+        }
+        _queued[block] = false;
+
+        const size_t pos = static_cast<size_t>(block) * _blockSize;
+        const size_t len = std::min(_blockSize, _dataSize - pos);
+        QThreadPool::globalInstance()->start(new StatsTask(_results, _snapshot, pos, len, block, _generation[block]));
+        _inFlight++;
+    }
+
+    if (_todo.isEmpty() && _inFlight == 0)
+    {
+        // don't keep the old version alive
+        _snapshot.reset();
+        emit finished();
+        return;
+    }
+
+    // go on immediately if there is room for more work, otherwise wait a bit
+    _feedTimer.start(!_todo.isEmpty() && _inFlight < maxInFlight ? 0 : POLL_INTERVAL);
+}
+
+void StatsEngine::updateParents(int block)
+{
+    int index = block;
+    for (size_t level = 1; level < _levels.size(); level++)
+    {
+        index >>= 1;
+        const std::vector<BlockStats> & below = _levels[level - 1];
+        const size_t left = 2 * index;
+        _levels[level][index] = merge(below[left], left + 1 < below.size() ? below[left + 1] : BlockStats());
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef STATSENGINE_H
+#define STATSENGINE_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+#include <memory>
+#include <vector>
+
+#include "qhexeditdata.h"
+
+class StatsResults;
+
+/*! BlockStats summarizes the bytes of one block (or of a node of the pyramid,
+which covers several blocks). All values are fractions in [0, 1], entropy is
+the Shannon entropy divided by 8 bits.
+*/
+struct BlockStats
+{
+    float entropy;
+    float zeros;                        // 0x00 bytes
+    float ascii;                        // printable ascii and whitespace
+    float weight;                       // computed blocks below this node, 0 if none
+};
+
+/*! StatsEngine computes byte histograms of QHexEditData block by block and
+keeps their summaries in a multi-resolution pyramid: level 0 holds one entry
+per block, every further level merges two entries of the level below. A
+view picks the level which matches its resolution, so drawing an overview
+of a huge file never touches more entries than it has pixels.
+
+The blocks are read from a snapshot of the data and counted on the global
+QThreadPool, so the GUI thread neither copies nor counts bytes. Only a
+bounded number of blocks is in flight, so memory stays low for multi-GB
+data. invalidate() schedules the blocks of a changed range again, they are
+read from a new snapshot; results of blocks, which were invalidated while
+they were counted, are dropped.
+*/
+class StatsEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StatsEngine(QObject * parent = 0);
+    ~StatsEngine();
+
+    // starts over for data, which has to outlive the engine or be reset
+    void setData(QHexEditData * data);
+
+    size_t dataSize() const;
+    size_t blockSize() const;
+    int levels() const;
+    const std::vector<BlockStats> & level(int level) const;
+
+    // merged statistics of the blocks [first, last) of level 0
+    BlockStats summary(int first, int last) const;
+
+    // number of blocks, which still have to be counted
+    int pendingBlocks() const;
+
+    // counts the bytes of data into counts, which has to be zeroed
+    static void histogram(const uchar * data, size_t len, quint32 * counts);
+    static BlockStats evaluate(const quint32 * counts, size_t len);
+    static BlockStats merge(const BlockStats & a, const BlockStats & b);
+
+public slots:
+    // the bytes [pos, pos + len) changed, with sizeChanged all following too
+    void invalidate(size_t pos, size_t len, bool sizeChanged);
+
+signals:
+    // blocks [first, last) of level 0 got new statistics
+    void blocksChanged(int first, int last);
+    void finished();
+
+private slots:
+    void feed();
+
+private:
+    StatsEngine(const StatsEngine & other) = delete;
+    StatsEngine & operator=(const StatsEngine & other) = delete;
+
+    void reset();
+    void collect();
+    void updateParents(int block);
+
+    QHexEditData * _data;
+    QHexEditData::Snapshot _snapshot;   // taken for the queued blocks
+    size_t _dataSize;
+    size_t _blockSize;
+    std::vector<std::vector<BlockStats> > _levels;
+    std::vector<quint32> _generation;   // bumped, when a block is invalidated
+    std::vector<bool> _queued;
+    QQueue<int> _todo;
+    std::shared_ptr<StatsResults> _results;
+    int _inFlight;
+    QTimer _feedTimer;
+};
+
+/** \endcond docNever */
+
+#endif // STATSENGINE_H
@@ -0,0 +1,454 @@
+#include "stringsengine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include "bitscan.h"
+
+const size_t CHUNK_SIZE = 4 * 1024 * 1024;      // even, so parities stay the same
+const int POLL_INTERVAL = 5;                    // ms, while waiting for tasks
+const int STREAMS = 3;                          // ASCII, UTF-16 even and odd
+
+////////////////////////////////////////////////////////////////////////////////
+// StringsResults implementation:
+/*! StringsResults collects the results of the tasks by chunk. It is shared
+between the engine and the tasks, so a task which finishes after the engine
+was cancelled or deleted doesn't write into freed memory.
+*/
+class StringsResults
+{
+public:
+    struct Open                         // runs at the borders of a chunk, in units
+    {
+        size_t head;
+        size_t tail;
+        size_t tailPos;
+        bool full;                      // the whole chunk is one run
+    };
+
+    struct Chunk
+    {
+        size_t pos;
+        Open streams[STREAMS];
+        std::vector<StringHit> hits;    // the closed runs inside the chunk
+    };
+
+    void add(size_t index, Chunk & chunk)
+    {
+        QMutexLocker locker(&_mutex);
+        _chunks[index] = std::move(chunk);
+    }
+
+    // the chunk index, if it is done
+    bool take(size_t index, Chunk & chunk)
+    {
+        QMutexLocker locker(&_mutex);
+        const auto it = _chunks.find(index);
+        if (it == _chunks.end()) {
+            return false;
+        }
+        chunk = std::move(it->second);
+        _chunks.erase(it);
+        return true;
+    }
+
+private:
+    QMutex _mutex;
+    std::map<size_t, Chunk> _chunks;
+};
+
+class StringsTask : public QRunnable
+{
+public:
+    StringsTask(const std::shared_ptr<StringsResults> & results, size_t index, size_t pos, size_t len,
+                const QHexEditData::Snapshot & snapshot, int encodings, int minimumLength) :
+        _results(results),
+        _index(index),
+        _pos(pos),
+        _len(len),
+        _snapshot(snapshot),
+        _encodings(encodings),
+        _minimumLength(minimumLength)
+    { }
+
+    void run()
+    {
+        // a hole has no strings, the chunk is done without reading it
+        StringsResults::Chunk chunk;
+        chunk.pos = _pos;
+        memset(chunk.streams, 0, sizeof(chunk.streams));
+        if (_snapshot->nextData(_pos) >= _pos + _len)
+        {
+            _snapshot.reset();
+            _results->add(_index, chunk);
+            return;
+        }
+
+        // one byte behind the chunk completes its last UTF-16 unit
+        const QByteArray bytes = _snapshot->range(_pos, _len + 1);
+        _snapshot.reset();
+        const size_t size = bytes.size();
+        const size_t words = (size + 63) / 64 + 1;
+        std::vector<quint64> printable(words, 0);
+        std::vector<quint64> zeros(words, 0);
+        StringsEngine::classify(reinterpret_cast<const uchar *>(bytes.constData()), size, printable.data(), zeros.data());
+
+        if (_encodings & StringsEngine::Ascii) {
+            scan(printable.data(), 0, 1, chunk);
+        }
+
+        if (_encodings & StringsEngine::Utf16Le)
+        {
+            // a unit is a printable byte followed by a zero byte
+            std::vector<quint64> units(words, 0);
+            for (size_t i = 0; i + 1 < words; i++) {
+                units[i] = printable[i] & ((zeros[i] >> 1) | (zeros[i + 1] << 63));
+            }
+
+            // both bytes of the units of one parity, so a run is a run of bits
+            std::vector<quint64> bits(words, 0);
+            for (int parity = 0; parity < 2; parity++)
+            {
+                const quint64 mask = parity == 0 ? 0x5555555555555555ull : 0xaaaaaaaaaaaaaaaaull;
+                quint64 carry = 0;
+                for (size_t i = 0; i < words; i++)
+                {
+                    const quint64 starts = units[i] & mask;
+                    bits[i] = starts | (starts << 1) | carry;
+                    carry = starts >> 63;
+                }
+                scan(bits.data(), 1 + parity, 2, chunk);
+            }
+        }
+
+        std::sort(chunk.hits.begin(), chunk.hits.end(), [](const StringHit & a, const StringHit & b)
+        {
+            return a.pos < b.pos;
+        });
+        _results->add(_index, chunk);
+    }
+
+private:
+    // runs of units starting in the chunk, from the bitmap of their bytes
+    void scan(const quint64 * bits, int stream, size_t unit, StringsResults::Chunk & chunk)
+    {
+        const size_t first = stream == 2 ? 1 : 0;
+        if (first >= _len) {
+            return;
+        }
+        const size_t last = _len - 1 - ((_len - 1 - first) % unit);     // the last unit
+        const size_t end = last + unit;
+        const quint32 encoding = stream == 0 ? StringsEngine::Ascii : StringsEngine::Utf16Le;
+        StringsResults::Open & open = chunk.streams[stream];
+
+        for (size_t pos = findBit(bits, first, end, true); pos < end;)
+        {
+            const size_t stop = findBit(bits, pos, end, false);
+            const size_t units = (stop - pos) / unit;
+            if (pos == first && stop == end)
+            {
+                open.head = units;
+                open.tail = units;
+                open.tailPos = _pos + pos;
+                open.full = true;
+            }
+            else if (pos == first)
+            {
+                open.head = units;
+            }
+            else if (stop == end)
+            {
+                open.tail = units;
+                open.tailPos = _pos + pos;
+            }
+            else if (units >= static_cast<size_t>(_minimumLength))
+            {
+                StringHit hit;
+                hit.pos = _pos + pos;
+                hit.len = static_cast<quint32>(stop - pos);
+                hit.encoding = encoding;
+                chunk.hits.push_back(hit);
+            }
+            pos = findBit(bits, stop, end, true);
+        }
+    }
+
+    std::shared_ptr<StringsResults> _results;
+    size_t _index;
+    size_t _pos, _len;
+    QHexEditData::Snapshot _snapshot;
+    int _encodings;
+    int _minimumLength;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// StringsEngine implementation:
+StringsEngine::StringsEngine(QObject * parent) :
+    QObject(parent),
+    _data(nullptr),
+    _minimumLength(4),
+    _encodings(Ascii | Utf16Le),
+    _results(std::make_shared<StringsResults>()),
+    _running(false),
+    _nextChunk(0),
+    _chunks(0),
+    _stitched(0),
+    _inFlight(0),
+    _progress(0)
+{
+    memset(_open, 0, sizeof(_open));
+    _feedTimer.setSingleShot(true);
+    connect(&_feedTimer, SIGNAL(timeout()), this, SLOT(feed()));
+}
+
+StringsEngine::~StringsEngine()
+{ }
+
+void StringsEngine::setData(QHexEditData * data)
+{
+    cancel();
+    _data = data;
+}
+
+void StringsEngine::setMinimumLength(int length)
+{
+    _minimumLength = std::max(1, length);
+}
+
+int StringsEngine::minimumLength() const
+{
+    return _minimumLength;
+}
+
+void StringsEngine::setEncodings(int encodings)
+{
+    _encodings = encodings;
+}
+
+int StringsEngine::encodings() const
+{
+    return _encodings;
+}
+
+bool StringsEngine::isRunning() const
+{
+    return _running;
+}
+
+size_t StringsEngine::count() const
+{
+    return _hits.size();
+}
+
+const StringHit & StringsEngine::hit(size_t index) const
+{
+    return _hits[index];
+}
+
+QString StringsEngine::text(size_t index, int maxLength) const
+{
+    const StringHit & hit = _hits[index];
+    const size_t unit = hit.encoding == Utf16Le ? 2 : 1;
+    const size_t len = std::min<size_t>(hit.len, maxLength * unit);
+    const QByteArray bytes = _snapshot->range(hit.pos, len);
+    if (unit == 1) {
+        return QString::fromLatin1(bytes);
+    }
+
+    // the high bytes are zero
+    QString text(bytes.size() / 2, QChar());
+    for (int i = 0; i < text.size(); i++) {
+        text[i] = QChar::fromLatin1(bytes[2 * i]);
+    }
+    return text;
+}
+
+size_t StringsEngine::findHit(size_t pos) const
+{
+    // the last hit starting at or before pos
+    const auto it = std::upper_bound(_hits.begin(), _hits.end(), pos, [](size_t pos, const StringHit & hit)
+    {
+        return pos < hit.pos;
+    });
+    if (it == _hits.begin() || (it - 1)->pos + (it - 1)->len <= pos) {
+        return _hits.size();
+    }
+    return it - 1 - _hits.begin();
+}
+
+void StringsEngine::classify(const uchar * data, size_t len, quint64 * printable, quint64 * zeros)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        setBits(printable, i, printableBytes(x));
+        setBits(zeros, i, _mm_cmpeq_epi8(x, zero));
+    }
+#endif
+    for (; i < len; i++)
+    {
+        const uchar c = data[i];
+        if (isPrintable(c)) {
+            printable[i >> 6] |= quint64(1) << (i & 63);
+        }
+        if (c == 0) {
+            zeros[i >> 6] |= quint64(1) << (i & 63);
+        }
+    }
+}
+
+void StringsEngine::start()
+{
+    cancel();
+    if (!_data) {
+        return;
+    }
+
+    _running = true;
+    _snapshot = _data->snapshot();
+    _chunks = (_snapshot->size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    emit started();
+    feed();
+}
+
+void StringsEngine::cancel()
+{
+    // results of running tasks are dropped with the old queue
+    _results = std::make_shared<StringsResults>();
+    _feedTimer.stop();
+    _running = false;
+    _nextChunk = 0;
+    _chunks = 0;
+    _stitched = 0;
+    _inFlight = 0;
+    _progress = 0;
+    memset(_open, 0, sizeof(_open));
+    _hits.clear();
+    _snapshot.reset();
+}
+
+void StringsEngine::feed()
+{
+    size_t first = _hits.size();
+    stitch(first);
+    if (first < _hits.size()) {
+        emit hitsChanged(first);
+    }
+
+    const int maxInFlight = 2 * std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    const size_t size = _snapshot ? _snapshot->size() : 0;
+    while (_snapshot && _nextChunk < _chunks && _inFlight < maxInFlight)
+    {
+        const size_t pos = _nextChunk * CHUNK_SIZE;
+        const size_t len = std::min(CHUNK_SIZE, size - pos);
+        QThreadPool::globalInstance()->start(new StringsTask(_results, _nextChunk, pos, len, _snapshot,
+                                                             _encodings, _minimumLength));
+        _nextChunk++;
+        _inFlight++;
+    }
+
+    const int percent = _chunks > 0 ? static_cast<int>(100 * _stitched / _chunks) : 100;
+    if (percent != _progress)
+    {
+        _progress = percent;
+        emit progress(_progress);
+    }
+
+    if (_stitched == _chunks)
+    {
+        _running = false;
+        emit finished();
+        return;
+    }
+
+    // go on immediately if there is room for more work, otherwise wait a bit
+    _feedTimer.start(_nextChunk < _chunks && _inFlight < maxInFlight ? 0 : POLL_INTERVAL);
+}
+
+void StringsEngine::stitch(size_t & first)
+{
+    StringsResults::Chunk chunk;
+    while (_stitched < _chunks && _results->take(_stitched, chunk))
+    {
+        _inFlight--;
+        _stitched++;
+
+        std::vector<StringHit> hits;
+        for (int stream = 0; stream < STREAMS; stream++)
+        {
+            const StringsResults::Open & open = chunk.streams[stream];
+            if (open.full)
+            {
+                if (_open[stream].units == 0) {
+                    _open[stream].pos = open.tailPos;
+                }
+                _open[stream].units += open.head;
+                continue;
+            }
+
+            if (open.head > 0)
+            {
+                // the run continues the open one of the previous chunk
+                if (_open[stream].units == 0) {
+                    _open[stream].pos = chunk.pos + (stream == 2 ? 1 : 0);
+                }
+                _open[stream].units += open.head;
+            }
+            close(stream, hits);
+
+            if (open.tail > 0)
+            {
+                _open[stream].pos = open.tailPos;
+                _open[stream].units = open.tail;
+            }
+        }
+
+        if (_stitched == _chunks)
+        {
+            for (int stream = 0; stream < STREAMS; stream++) {
+                close(stream, hits);
+            }
+        }
+
+        // the stitched runs may start before hits of the previous chunk
+        hits.insert(hits.end(), chunk.hits.begin(), chunk.hits.end());
+        std::sort(hits.begin(), hits.end(), [](const StringHit & a, const StringHit & b)
+        {
+            return a.pos < b.pos;
+        });
+        if (hits.empty()) {
+            continue;
+        }
+
+        const size_t old = _hits.size();
+        _hits.insert(_hits.end(), hits.begin(), hits.end());
+        const auto middle = _hits.begin() + old;
+        const auto from = std::upper_bound(_hits.begin(), middle, hits.front(), [](const StringHit & a, const StringHit & b)
+        {
+            return a.pos < b.pos;
+        });
+        std::inplace_merge(from, middle, _hits.end(), [](const StringHit & a, const StringHit & b)
+        {
+            return a.pos < b.pos;
+        });
+        first = std::min(first, static_cast<size_t>(from - _hits.begin()));
+    }
+}
+
+void StringsEngine::close(int stream, std::vector<StringHit> & hits)
+{
+    OpenRun & open = _open[stream];
+    if (open.units >= static_cast<size_t>(_minimumLength))
+    {
+        StringHit hit;
+        hit.pos = open.pos;
+        hit.len = static_cast<quint32>(open.units * (stream == 0 ? 1 : 2));
+        hit.encoding = stream == 0 ? Ascii : Utf16Le;
+        hits.push_back(hit);
+    }
+    open.units = 0;
+}
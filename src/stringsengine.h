@@ -0,0 +1,116 @@
+#ifndef STRINGSENGINE_H
+#define STRINGSENGINE_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+#include <memory>
+#include <vector>
+
+#include "qhexeditdata.h"
+
+class StringsResults;
+
+/*! StringHit is one printable string found in the data. */
+struct StringHit
+{
+    size_t pos;
+    quint32 len;                        // in bytes
+    quint32 encoding;                   // StringsEngine::Encoding
+};
+
+/*! StringsEngine extracts printable strings from QHexEditData, like the
+strings tool: runs of at least minimumLength() printable ASCII characters
+(0x20 - 0x7e and tab), in UTF-16LE each followed by a zero byte.
+
+The data is cut into chunks, which are scanned by tasks of the global
+QThreadPool. A task classifies 16 bytes at once with SSE2 into bitmaps of
+printable and zero bytes and walks the runs a word of the bitmap at a time.
+Runs touching the border of a chunk are handed back open and stitched with
+the neighbouring chunks in order, so strings crossing a border are found as
+one. A scan reads a snapshot of the data taken by start(), so the tasks read
+their chunks themselves and edits during the scan don't mix versions.
+
+The hits are sorted by position. Only their position and length are stored,
+text() reads a hit back from the snapshot, so millions of hits stay cheap.
+*/
+class StringsEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Encoding
+    {
+        Ascii = 0x1,
+        Utf16Le = 0x2
+    };
+
+    explicit StringsEngine(QObject * parent = 0);
+    ~StringsEngine();
+
+    // the data has to outlive the engine or be reset
+    void setData(QHexEditData * data);
+
+    void setMinimumLength(int length);  // in characters
+    int minimumLength() const;
+    void setEncodings(int encodings);
+    int encodings() const;
+
+    bool isRunning() const;
+    size_t count() const;
+    const StringHit & hit(size_t index) const;
+    // the text of a hit, cut after maxLength characters
+    QString text(size_t index, int maxLength = 256) const;
+    // index of the hit containing pos or count()
+    size_t findHit(size_t pos) const;
+
+    // sets the bits of the printable and the zero bytes in the bitmaps
+    static void classify(const uchar * data, size_t len, quint64 * printable, quint64 * zeros);
+
+public slots:
+    void start();
+    void cancel();
+
+signals:
+    void started();
+    // hits [first, count()) are new or have moved
+    void hitsChanged(size_t first);
+    void progress(int percent);
+    void finished();
+
+private slots:
+    void feed();
+
+private:
+    StringsEngine(const StringsEngine & other) = delete;
+    StringsEngine & operator=(const StringsEngine & other) = delete;
+
+    struct OpenRun                      // a run reaching the end of the stitched chunks
+    {
+        size_t pos;
+        size_t units;
+    };
+
+    void stitch(size_t & first);
+    void close(int stream, std::vector<StringHit> & hits);
+
+    QHexEditData * _data;
+    QHexEditData::Snapshot _snapshot;   // the scanned version
+    int _minimumLength;
+    int _encodings;
+    std::shared_ptr<StringsResults> _results;
+    bool _running;
+    size_t _nextChunk, _chunks;         // next to read and all
+    size_t _stitched;                   // chunks stitched so far
+    int _inFlight;
+    OpenRun _open[3];                   // ASCII, UTF-16 at even and at odd positions
+    std::vector<StringHit> _hits;
+    int _progress;
+
+    QTimer _feedTimer;
+};
+
+/** \endcond docNever */
+
+#endif // STRINGSENGINE_H
@@ -0,0 +1,203 @@
+#include <QAbstractListModel>
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+#include <algorithm>
+#include <climits>
+
+#include "stringspanel.h"
+
+const int RESCAN_DELAY = 1000;          // ms after the last edit
+
+////////////////////////////////////////////////////////////////////////////////
+// StringsModel implementation:
+/** \cond docNever */
+/*! StringsModel shows the hits of a StringsEngine. It only counts rows, the
+text of a row is read when the view asks for it.
+*/
+class StringsModel : public QAbstractListModel
+{
+public:
+    explicit StringsModel(const StringsEngine & engine, QObject * parent = 0) :
+        QAbstractListModel(parent),
+        _engine(engine),
+        _rows(0)
+    { }
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const
+    {
+        return parent.isValid() ? 0 : _rows;
+    }
+
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const
+    {
+        const size_t row = index.row();
+        if (!index.isValid() || row >= _engine.count()) {
+            return QVariant();
+        }
+
+        const StringHit & hit = _engine.hit(row);
+        switch (role)
+        {
+            case Qt::DisplayRole:
+                return QString("%1  %2  %3")
+                        .arg(hit.pos, 8, 16, QChar('0'))
+                        .arg(hit.encoding == StringsEngine::Utf16Le ? 'U' : 'A')
+                        .arg(_engine.text(row));
+            case Qt::ToolTipRole:
+                return QString("%1 bytes at %2").arg(hit.len).arg(hit.pos, 0, 16);
+            default:
+                return QVariant();
+        }
+    }
+
+    void reset()
+    {
+        beginResetModel();
+        _rows = 0;
+        endResetModel();
+    }
+
+    // rows from first have changed, new ones are appended
+    void update(size_t first)
+    {
+        const int rows = static_cast<int>(std::min<size_t>(_engine.count(), INT_MAX));
+        if (rows > _rows)
+        {
+            beginInsertRows(QModelIndex(), _rows, rows - 1);
+            const int old = _rows;
+            _rows = rows;
+            endInsertRows();
+            if (static_cast<int>(first) < old) {
+                emit dataChanged(index(first), index(old - 1));
+            }
+        }
+    }
+
+private:
+    const StringsEngine & _engine;
+    int _rows;
+};
+/** \endcond docNever */
+
+////////////////////////////////////////////////////////////////////////////////
+// StringsPanel implementation:
+StringsPanel::StringsPanel(QWidget * parent) :
+    QWidget(parent)
+{
+    _model = new StringsModel(_engine, this);
+
+    _list = new QListView;
+    _list->setModel(_model);
+    _list->setUniformItemSizes(true);
+    _list->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    _list->setSelectionMode(QAbstractItemView::SingleSelection);
+    connect(_list, SIGNAL(activated(QModelIndex)), this, SLOT(activated(QModelIndex)));
+    connect(_list, SIGNAL(clicked(QModelIndex)), this, SLOT(activated(QModelIndex)));
+
+    _minimumLength = new QSpinBox;
+    _minimumLength->setRange(1, 256);
+    _minimumLength->setValue(_engine.minimumLength());
+    _minimumLength->setToolTip(tr("Minimum length"));
+    connect(_minimumLength, SIGNAL(valueChanged(int)), this, SLOT(settingsChanged()));
+
+    _encodings = new QComboBox;
+    _encodings->addItem(tr("ASCII and UTF-16LE"), StringsEngine::Ascii | StringsEngine::Utf16Le);
+    _encodings->addItem(tr("ASCII"), StringsEngine::Ascii);
+    _encodings->addItem(tr("UTF-16LE"), StringsEngine::Utf16Le);
+    connect(_encodings, SIGNAL(currentIndexChanged(int)), this, SLOT(settingsChanged()));
+
+    _status = new QLabel;
+
+    QHBoxLayout * settings = new QHBoxLayout;
+    settings->addWidget(_minimumLength);
+    settings->addWidget(_encodings, 1);
+    QVBoxLayout * layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(settings);
+    layout->addWidget(_list);
+    layout->addWidget(_status);
+
+    connect(&_engine, SIGNAL(hitsChanged(size_t)), this, SLOT(hitsChanged(size_t)));
+    connect(&_engine, SIGNAL(progress(int)), this, SLOT(progress(int)));
+    connect(&_engine, SIGNAL(finished()), this, SLOT(finished()));
+
+    _rescanTimer.setSingleShot(true);
+    _rescanTimer.setInterval(RESCAN_DELAY);
+    connect(&_rescanTimer, SIGNAL(timeout()), this, SLOT(rescan()));
+}
+
+StringsPanel::~StringsPanel()
+{ }
+
+void StringsPanel::setData(QHexEditData * data)
+{
+    _engine.setData(data);
+    rescan();
+}
+
+StringsEngine & StringsPanel::engine()
+{
+    return _engine;
+}
+
+void StringsPanel::rescan()
+{
+    _rescanTimer.stop();
+    _model->reset();
+    _status->setText(tr("Scanning..."));
+    _engine.start();
+}
+
+void StringsPanel::setCursorAddress(int address)
+{
+    const size_t pos = static_cast<size_t>(std::max(address, 0));
+    const size_t row = _engine.findHit(pos);
+    if (row < static_cast<size_t>(_model->rowCount()))
+    {
+        const QModelIndex index = _model->index(row);
+        _list->setCurrentIndex(index);
+        _list->scrollTo(index);
+    }
+    else
+    {
+        _list->clearSelection();
+    }
+}
+
+void StringsPanel::dataChanged()
+{
+    _rescanTimer.start();
+}
+
+void StringsPanel::activated(const QModelIndex & index)
+{
+    if (index.isValid() && static_cast<size_t>(index.row()) < _engine.count()) {
+        emit addressClicked(_engine.hit(index.row()).pos);
+    }
+}
+
+void StringsPanel::finished()
+{
+    _status->setText(tr("%1 strings").arg(_engine.count()));
+}
+
+void StringsPanel::hitsChanged(size_t first)
+{
+    _model->update(first);
+}
+
+void StringsPanel::progress(int percent)
+{
+    if (_engine.isRunning()) {
+        _status->setText(tr("Scanning... %1%").arg(percent));
+    }
+}
+
+void StringsPanel::settingsChanged()
+{
+    _engine.setMinimumLength(_minimumLength->value());
+    _engine.setEncodings(_encodings->currentData().toInt());
+    rescan();
+}
@@ -0,0 +1,68 @@
+#ifndef STRINGSPANEL_H
+#define STRINGSPANEL_H
+
+#include <QComboBox>
+#include <QLabel>
+#include <QListView>
+#include <QSpinBox>
+#include <QWidget>
+
+#include "stringsengine.h"
+
+class StringsModel;
+
+/*! StringsPanel lists the printable strings of a QHexEditData, which are
+found by a StringsEngine in the background. The list is virtual, only the
+visible rows are read from the data, so it scrolls smoothly through millions
+of strings.
+
+Clicking a string emits its address (connect it to QHexEdit::gotoAddress()),
+setCursorAddress() selects the string under the cursor of the editor. The
+data is scanned again shortly after it was changed and when the minimum
+length or the encodings are changed.
+*/
+class StringsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit StringsPanel(QWidget * parent = 0);
+    ~StringsPanel();
+
+    /*! Sets the data to scan, which has to outlive the panel or be reset. */
+    void setData(QHexEditData * data);
+
+    /*! Returns the engine, which holds the found strings. */
+    StringsEngine & engine();
+
+public slots:
+    /*! Scans the data again. */
+    void rescan();
+
+    /*! Selects the string, which contains address. */
+    void setCursorAddress(int address);
+
+    /*! Schedules a scan, call it when the data was changed. */
+    void dataChanged();
+
+signals:
+    void addressClicked(size_t address);
+
+private slots:
+    void activated(const QModelIndex & index);
+    void finished();
+    void hitsChanged(size_t first);
+    void progress(int percent);
+    void settingsChanged();
+
+private:
+    StringsEngine _engine;
+    StringsModel * _model;
+    QListView * _list;
+    QSpinBox * _minimumLength;
+    QComboBox * _encodings;
+    QLabel * _status;
+    QTimer _rescanTimer;                    // collects edits before scanning
+};
+
+#endif // STRINGSPANEL_H
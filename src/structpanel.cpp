@@ -0,0 +1,224 @@
+#include <QAbstractItemModel>
+#include <QFile>
+#include <QFileInfo>
+#include <QFontDatabase>
+#include <QHeaderView>
+#include <QVBoxLayout>
+
+#include "structpanel.h"
+
+const int EVALUATE_DELAY = 500;         // ms after the last edit
+
+////////////////////////////////////////////////////////////////////////////////
+// StructModel implementation:
+/** \cond docNever */
+/*! StructModel shows the nodes of a StructTree. An index points to its node,
+the nodes are made when the view asks for the rows of an expanded item.
+*/
+class StructModel : public QAbstractItemModel
+{
+public:
+    enum Column
+    {
+        NameColumn,
+        OffsetColumn,
+        TypeColumn,
+        ValueColumn,
+        Columns
+    };
+
+    explicit StructModel(StructTree & tree, QObject * parent = 0) :
+        QAbstractItemModel(parent),
+        _tree(tree)
+    { }
+
+    QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const
+    {
+        StructNode * node = nodeOf(parent);
+        StructNode * child = node && column >= 0 && column < Columns ? node->child(row) : nullptr;
+        return child ? createIndex(row, column, child) : QModelIndex();
+    }
+
+    QModelIndex parent(const QModelIndex & index) const
+    {
+        StructNode * node = index.isValid() ? nodeOf(index)->parent() : nullptr;
+        if (!node || node == _tree.root()) {
+            return QModelIndex();
+        }
+        return createIndex(node->row(), 0, node);
+    }
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const
+    {
+        StructNode * node = nodeOf(parent);
+        return (node && parent.column() <= 0) ? node->childCount() : 0;
+    }
+
+    int columnCount(const QModelIndex & = QModelIndex()) const
+    {
+        return Columns;
+    }
+
+    bool hasChildren(const QModelIndex & parent = QModelIndex()) const
+    {
+        StructNode * node = nodeOf(parent);
+        return node && parent.column() <= 0 && node->hasChildren();
+    }
+
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const
+    {
+        if (!index.isValid()) {
+            return QVariant();
+        }
+
+        StructNode * node = nodeOf(index);
+        if (role == Qt::DecorationRole && index.column() == NameColumn && node->kind() != StructNode::Structure) {
+            return node->color();
+        }
+        if (role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (index.column())
+        {
+            case NameColumn:
+                return node->name();
+            case OffsetColumn:
+                return QString("%1").arg(node->pos(), 8, 16, QChar('0'));
+            case TypeColumn:
+                return node->typeName();
+            case ValueColumn:
+                return node->valueText();
+            default:
+                return QVariant();
+        }
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const
+    {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (section)
+        {
+            case NameColumn:    return QObject::tr("Name");
+            case OffsetColumn:  return QObject::tr("Offset");
+            case TypeColumn:    return QObject::tr("Type");
+            case ValueColumn:   return QObject::tr("Value");
+            default:            return QVariant();
+        }
+    }
+
+    StructNode * nodeOf(const QModelIndex & index) const
+    {
+        return index.isValid() ? static_cast<StructNode *>(index.internalPointer()) : _tree.root();
+    }
+
+    // the nodes are dropped, the view forgets its indexes
+    void reset()
+    {
+        beginResetModel();
+        _tree.reset();
+        endResetModel();
+    }
+
+    void setSource(QHexEditData * data)
+    {
+        beginResetModel();
+        _tree.setData(data);
+        endResetModel();
+    }
+
+    void setTemplate(const StructTemplate & structTemplate)
+    {
+        beginResetModel();
+        _tree.setTemplate(structTemplate);
+        endResetModel();
+    }
+
+private:
+    StructTree & _tree;
+};
+/** \endcond docNever */
+
+////////////////////////////////////////////////////////////////////////////////
+// StructPanel implementation:
+StructPanel::StructPanel(QWidget * parent) :
+    QWidget(parent)
+{
+    _model = new StructModel(_tree, this);
+
+    _view = new QTreeView;
+    _view->setModel(_model);
+    _view->setUniformRowHeights(true);
+    _view->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    _view->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    connect(_view, SIGNAL(activated(QModelIndex)), this, SLOT(activated(QModelIndex)));
+    connect(_view, SIGNAL(clicked(QModelIndex)), this, SLOT(activated(QModelIndex)));
+
+    _status = new QLabel(tr("No template"));
+
+    QVBoxLayout * layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(_view);
+    layout->addWidget(_status);
+
+    _evaluateTimer.setSingleShot(true);
+    _evaluateTimer.setInterval(EVALUATE_DELAY);
+    connect(&_evaluateTimer, SIGNAL(timeout()), this, SLOT(reevaluate()));
+}
+
+StructPanel::~StructPanel()
+{ }
+
+void StructPanel::setData(QHexEditData * data)
+{
+    _evaluateTimer.stop();
+    _model->setSource(data);
+    emit highlightingChanged();
+}
+
+bool StructPanel::loadTemplate(const QString & fileName, QString * errorString)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        if (errorString) {
+            *errorString = file.errorString();
+        }
+        return false;
+    }
+
+    StructTemplate structTemplate;
+    if (!structTemplate.load(file, errorString)) {
+        return false;
+    }
+    _evaluateTimer.stop();
+    _model->setTemplate(structTemplate);
+    _status->setText(QFileInfo(fileName).fileName());
+    emit highlightingChanged();
+    return true;
+}
+
+QHexEditHighlighter * StructPanel::highlighter()
+{
+    return &_tree;
+}
+
+void StructPanel::reevaluate()
+{
+    _evaluateTimer.stop();
+    _model->reset();
+    emit highlightingChanged();
+}
+
+void StructPanel::dataChanged()
+{
+    _evaluateTimer.start();
+}
+
+void StructPanel::activated(const QModelIndex & index)
+{
+    if (index.isValid()) {
+        emit addressClicked(_model->nodeOf(index)->pos());
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef STRUCTPANEL_H
+#define STRUCTPANEL_H
+
+#include <QLabel>
+#include <QTimer>
+#include <QTreeView>
+#include <QWidget>
+
+#include "structtemplate.h"
+
+class StructModel;
+
+/*! StructPanel shows the structures of a template (see StructTemplate) in a
+tree of fields with their offset, type and value. Its highlighter() colours
+the same fields in QHexEdit, register it with QHexEdit::addHighlighter() and
+connect highlightingChanged() to QHexEdit::updateHighlighting().
+
+The structures are evaluated lazily: the tree only asks for the rows of the
+expanded items, the highlighter only for the structures in view. So a
+template of millions of records costs nothing until they are shown.
+
+Clicking a field emits its address (connect it to QHexEdit::gotoAddress()).
+The template is applied again shortly after the data was changed.
+*/
+class StructPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit StructPanel(QWidget * parent = 0);
+    ~StructPanel();
+
+    /*! Sets the data to show, which has to outlive the panel or be reset. */
+    void setData(QHexEditData * data);
+
+    /*! Loads a template file and applies it to the data.
+    \return false, if the file can't be read or isn't a valid template
+    */
+    bool loadTemplate(const QString & fileName, QString * errorString = nullptr);
+
+    /*! Returns the highlighter, which colours the fields. */
+    QHexEditHighlighter * highlighter();
+
+public slots:
+    /*! Applies the template again. */
+    void reevaluate();
+
+    /*! Schedules reevaluate(), call it when the data was changed. */
+    void dataChanged();
+
+signals:
+    void addressClicked(size_t address);
+    void highlightingChanged();
+
+private slots:
+    void activated(const QModelIndex & index);
+
+private:
+    StructTree _tree;
+    StructModel * _model;
+    QTreeView * _view;
+    QLabel * _status;
+    QTimer _evaluateTimer;                  // collects edits before evaluating
+};
+
+#endif // STRUCTPANEL_H
@@ -0,0 +1,1146 @@
+#include "structtemplate.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+const int MAX_DEPTH = 64;               // of nested structs, for recursive templates
+const int MAX_TEXT = 64;                // chars shown of a char array
+
+enum Op
+{
+    Number,
+    Name,
+    Or,
+    And,
+    BitOr,
+    BitXor,
+    BitAnd,
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    ShiftLeft,
+    ShiftRight,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo,
+    Negate,
+    Not,
+    Complement
+};
+
+struct BinaryOp
+{
+    const char * text;
+    int level;                          // 1 binds the weakest
+    Op op;
+};
+
+// operators of two chars first, so "<<" isn't taken for "<"
+static const BinaryOp BINARY_OPS[] =
+{
+    {"||", 1, Or}, {"&&", 2, And}, {"==", 6, Equal}, {"!=", 6, NotEqual},
+    {"<=", 7, LessEqual}, {">=", 7, GreaterEqual}, {"<<", 8, ShiftLeft}, {">>", 8, ShiftRight},
+    {"|", 3, BitOr}, {"^", 4, BitXor}, {"&", 5, BitAnd}, {"<", 7, Less}, {">", 7, Greater},
+    {"+", 9, Add}, {"-", 9, Subtract}, {"*", 10, Multiply}, {"/", 10, Divide}, {"%", 10, Modulo}
+};
+const int MAX_LEVEL = 10;
+
+struct TypeName
+{
+    const char * name;
+    StructTemplate::Type type;
+    int size;
+};
+
+static const TypeName TYPE_NAMES[] =
+{
+    {"i8", StructTemplate::Int8, 1}, {"u8", StructTemplate::UInt8, 1},
+    {"i16", StructTemplate::Int16, 2}, {"u16", StructTemplate::UInt16, 2},
+    {"i32", StructTemplate::Int32, 4}, {"u32", StructTemplate::UInt32, 4},
+    {"i64", StructTemplate::Int64, 8}, {"u64", StructTemplate::UInt64, 8},
+    {"f32", StructTemplate::Float32, 4}, {"f64", StructTemplate::Float64, 8},
+    {"char", StructTemplate::Char, 1}
+};
+
+// light colours for the fields without one, by their index in the struct
+static const QRgb PALETTE[] =
+{
+    0xffd6d6, 0xd6ecff, 0xdcf5d0, 0xfff0c4, 0xe8dcff, 0xffdcf0, 0xd0f5ef, 0xf5e3d0
+};
+
+static qint64 toInteger(double value)
+{
+    if (!(std::fabs(value) < 9.2e18)) {
+        return 0;
+    }
+    return static_cast<qint64>(value);
+}
+
+static QColor paletteColor(int index)
+{
+    return QColor(PALETTE[index % (sizeof(PALETTE) / sizeof(PALETTE[0]))]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TemplateExpression implementation:
+/** \cond docNever */
+/*! Parser builds the terms of an expression by precedence climbing, the
+operands of a term are added in front of it.
+*/
+class TemplateExpression::Parser
+{
+public:
+    Parser(const QString & text, std::vector<Term> & terms) :
+        _text(text),
+        _terms(terms),
+        _pos(0)
+    { }
+
+    bool parse(QString & error)
+    {
+        if (parseLevel(1) < 0) {
+            error = _error;
+            return false;
+        }
+        skipBlanks();
+        if (_pos < _text.size()) {
+            error = QObject::tr("unexpected \"%1\"").arg(_text.mid(_pos));
+            return false;
+        }
+        return true;
+    }
+
+private:
+    void skipBlanks()
+    {
+        while (_pos < _text.size() && _text[_pos].isSpace()) {
+            _pos++;
+        }
+    }
+
+    int add(int op, qint64 value, int left, int right, const QStringList & path = QStringList())
+    {
+        Term term = {op, value, path, left, right};
+        _terms.push_back(term);
+        return static_cast<int>(_terms.size()) - 1;
+    }
+
+    int fail(const QString & error)
+    {
+        if (_error.isEmpty()) {
+            _error = error;
+        }
+        return -1;
+    }
+
+    int parseLevel(int level)
+    {
+        if (level > MAX_LEVEL) {
+            return parseUnary();
+        }
+        int left = parseLevel(level + 1);
+        while (left >= 0)
+        {
+            skipBlanks();
+            const BinaryOp * found = nullptr;
+            for (const BinaryOp & op : BINARY_OPS)
+            {
+                if (_text.midRef(_pos).startsWith(QLatin1String(op.text))) {
+                    found = &op;
+                    break;
+                }
+            }
+            if (!found || found->level != level) {
+                break;
+            }
+            _pos += static_cast<int>(std::strlen(found->text));
+            const int right = parseLevel(level + 1);
+            if (right < 0) {
+                return -1;
+            }
+            left = add(found->op, 0, left, right);
+        }
+        return left;
+    }
+
+    int parseUnary()
+    {
+        skipBlanks();
+        if (_pos >= _text.size()) {
+            return fail(QObject::tr("operand missing"));
+        }
+
+        const QChar ch = _text[_pos];
+        if (ch == '-' || ch == '!' || ch == '~')
+        {
+            _pos++;
+            const int operand = parseUnary();
+            if (operand < 0) {
+                return -1;
+            }
+            return add(ch == '-' ? Negate : (ch == '!' ? Not : Complement), 0, operand, -1);
+        }
+        if (ch == '+')
+        {
+            _pos++;
+            return parseUnary();
+        }
+        if (ch == '(')
+        {
+            _pos++;
+            const int inner = parseLevel(1);
+            skipBlanks();
+            if (inner < 0 || _pos >= _text.size() || _text[_pos] != ')') {
+                return fail(QObject::tr("\")\" missing"));
+            }
+            _pos++;
+            return inner;
+        }
+        if (ch.isDigit())
+        {
+            const int start = _pos;
+            while (_pos < _text.size() && (_text[_pos].isLetterOrNumber())) {
+                _pos++;
+            }
+            const QString digits = _text.mid(start, _pos - start);
+            bool ok;
+            quint64 value;
+            if (digits.startsWith("0x", Qt::CaseInsensitive)) {
+                value = digits.mid(2).toULongLong(&ok, 16);
+            } else {
+                value = digits.toULongLong(&ok, 10);
+            }
+            if (!ok) {
+                return fail(QObject::tr("bad number \"%1\"").arg(digits));
+            }
+            return add(Number, static_cast<qint64>(value), -1, -1);
+        }
+        if (ch.isLetter() || ch == '_')
+        {
+            QStringList path;
+            for (;;)
+            {
+                const int start = _pos;
+                while (_pos < _text.size() && (_text[_pos].isLetterOrNumber() || _text[_pos] == '_')) {
+                    _pos++;
+                }
+                if (start == _pos) {
+                    return fail(QObject::tr("name missing after \".\""));
+                }
+                path.append(_text.mid(start, _pos - start));
+                if (_pos >= _text.size() || _text[_pos] != '.') {
+                    break;
+                }
+                _pos++;
+            }
+            return add(Name, 0, -1, -1, path);
+        }
+        return fail(QObject::tr("unexpected \"%1\"").arg(_text.mid(_pos)));
+    }
+
+    const QString & _text;
+    std::vector<Term> & _terms;
+    int _pos;
+    QString _error;
+};
+
+/*! ConstantScope knows no names, it evaluates the constant expressions of a
+template while it is loaded.
+*/
+class ConstantScope : public TemplateExpression::Scope
+{
+public:
+    bool lookup(const QStringList &, qint64 &) const
+    {
+        return false;
+    }
+};
+
+/*! NodeScope resolves the names of the expressions of a struct: the first
+part of a name is a member of the struct or of an enclosing one, in front of
+the field which is evaluated, the other parts are members of that member.
+*/
+class NodeScope : public TemplateExpression::Scope
+{
+public:
+    explicit NodeScope(StructNode * node) :
+        _node(node)
+    { }
+
+    bool lookup(const QStringList & path, qint64 & value) const
+    {
+        if (path.size() == 1 && path.first() == QLatin1String("_index"))
+        {
+            for (const StructNode * node = _node; node; node = node->_parent)
+            {
+                if (node->_index >= 0) {
+                    value = node->_index;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // all members of the evaluated struct are in front of the field,
+        // of the enclosing ones those in front of the path to it
+        StructNode * found = nullptr;
+        int limit = INT_MAX;
+        for (StructNode * node = _node; node && !found; node = node->_parent)
+        {
+            if (node->_kind == StructNode::Structure)
+            {
+                const int members = std::min(static_cast<int>(node->_members.size()), limit);
+                for (int idx = members - 1; idx >= 0; idx--)
+                {
+                    if (node->_members[idx]->name() == path.first()) {
+                        found = node->_members[idx].get();
+                        break;
+                    }
+                }
+            }
+            limit = node->_index >= 0 ? INT_MAX : node->_row;
+        }
+        for (int idx = 1; found && idx < path.size(); idx++) {
+            found = found->member(path[idx]);
+        }
+        if (!found) {
+            return false;
+        }
+        value = found->value();
+        return true;
+    }
+
+private:
+    StructNode * _node;
+};
+/** \endcond docNever */
+
+TemplateExpression::TemplateExpression()
+{ }
+
+bool TemplateExpression::parse(const QString & text, QString * errorString)
+{
+    _terms.clear();
+    QString error;
+    Parser parser(text, _terms);
+    if (!parser.parse(error))
+    {
+        _terms.clear();
+        if (errorString) {
+            *errorString = error;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool TemplateExpression::isNull() const
+{
+    return _terms.empty();
+}
+
+bool TemplateExpression::isConstant() const
+{
+    for (const Term & term : _terms)
+    {
+        if (term.op == Name) {
+            return false;
+        }
+    }
+    return true;
+}
+
+qint64 TemplateExpression::evaluate(const Scope & scope) const
+{
+    if (_terms.empty()) {
+        return 0;
+    }
+    return evaluate(static_cast<int>(_terms.size()) - 1, scope);
+}
+
+qint64 TemplateExpression::evaluate(int index, const Scope & scope) const
+{
+    const Term & term = _terms[index];
+    switch (term.op)
+    {
+    case Number:
+        return term.value;
+    case Name:
+    {
+        qint64 value = 0;
+        scope.lookup(term.path, value);
+        return value;
+    }
+    case Negate:
+        return static_cast<qint64>(0 - static_cast<quint64>(evaluate(term.left, scope)));
+    case Not:
+        return evaluate(term.left, scope) == 0;
+    case Complement:
+        return ~evaluate(term.left, scope);
+    case Or:
+        return evaluate(term.left, scope) != 0 || evaluate(term.right, scope) != 0;
+    case And:
+        return evaluate(term.left, scope) != 0 && evaluate(term.right, scope) != 0;
+    default:
+        break;
+    }
+
+    // the arithmetic wraps around like unsigned numbers
+    const qint64 a = evaluate(term.left, scope);
+    const qint64 b = evaluate(term.right, scope);
+    const quint64 ua = static_cast<quint64>(a);
+    const quint64 ub = static_cast<quint64>(b);
+    switch (term.op)
+    {
+    case BitOr:         return a | b;
+    case BitXor:        return a ^ b;
+    case BitAnd:        return a & b;
+    case Equal:         return a == b;
+    case NotEqual:      return a != b;
+    case Less:          return a < b;
+    case LessEqual:     return a <= b;
+    case Greater:       return a > b;
+    case GreaterEqual:  return a >= b;
+    case ShiftLeft:     return static_cast<qint64>(ua << (b & 63));
+    case ShiftRight:    return a >> (b & 63);
+    case Add:           return static_cast<qint64>(ua + ub);
+    case Subtract:      return static_cast<qint64>(ua - ub);
+    case Multiply:      return static_cast<qint64>(ua * ub);
+    case Divide:        return b == 0 ? 0 : (b == -1 ? static_cast<qint64>(0 - ua) : a / b);
+    case Modulo:        return (b == 0 || b == -1) ? 0 : a % b;
+    default:            return 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// StructTemplate implementation:
+
+StructTemplate::StructTemplate() :
+    _root(-1)
+{ }
+
+bool StructTemplate::load(QIODevice & device, QString * errorString)
+{
+    _definitions.clear();
+    _root = -1;
+
+    QString error;
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(device.readAll(), &parseError);
+    const QJsonObject object = document.object();
+    const QJsonObject structs = object.value("structs").toObject();
+    if (document.isNull()) {
+        error = parseError.errorString();
+    } else if (structs.isEmpty()) {
+        error = QObject::tr("The template has no structs");
+    }
+
+    // the names first, fields refer to structs defined behind them
+    for (QJsonObject::const_iterator it = structs.begin(); it != structs.end() && error.isEmpty(); ++it)
+    {
+        Definition definition;
+        definition.name = it.key();
+        definition.staticSize = -1;
+        definition.placed = false;
+        _definitions.push_back(definition);
+    }
+
+    const bool bigEndian = object.value("endian").toString() == QLatin1String("big");
+    for (size_t idx = 0; idx < _definitions.size() && error.isEmpty(); idx++)
+    {
+        Definition & definition = _definitions[idx];
+        const QJsonValue fields = structs.value(definition.name);
+        if (!fields.isArray())
+        {
+            error = QObject::tr("%1: no array of fields").arg(definition.name);
+            break;
+        }
+        for (const QJsonValue & value : fields.toArray())
+        {
+            Field field;
+            field.index = static_cast<int>(definition.fields.size());
+            if (!parseField(value.toObject(), definition.name, bigEndian, field, error)) {
+                break;
+            }
+            definition.fields.push_back(field);
+        }
+    }
+
+    if (error.isEmpty())
+    {
+        const QString root = object.value("root").toString();
+        for (size_t idx = 0; idx < _definitions.size(); idx++)
+        {
+            if (_definitions[idx].name == root || (root.isEmpty() && _definitions.size() == 1)) {
+                _root = static_cast<int>(idx);
+            }
+        }
+        if (_root < 0) {
+            error = QObject::tr("The root struct \"%1\" isn't defined").arg(root);
+        }
+    }
+
+    if (!error.isEmpty())
+    {
+        _definitions.clear();
+        _root = -1;
+        if (errorString) {
+            *errorString = error;
+        }
+        return false;
+    }
+
+    std::vector<int> state(_definitions.size(), 0);
+    for (size_t idx = 0; idx < _definitions.size(); idx++) {
+        computeSize(static_cast<int>(idx), state);
+    }
+    return true;
+}
+
+bool StructTemplate::parseField(const QJsonObject & object, const QString & context, bool bigEndian, Field & field, QString & error)
+{
+    field.name = object.value("name").toString();
+    const QString where = QString("%1.%2").arg(context, field.name);
+    if (field.name.isEmpty())
+    {
+        error = QObject::tr("%1: field without a name").arg(context);
+        return false;
+    }
+
+    const QString type = object.value("type").toString();
+    field.type = Struct;
+    field.definition = -1;
+    field.size = 0;
+    for (const TypeName & name : TYPE_NAMES)
+    {
+        if (type == QLatin1String(name.name)) {
+            field.type = name.type;
+            field.size = name.size;
+        }
+    }
+    for (size_t idx = 0; field.type == Struct && idx < _definitions.size(); idx++)
+    {
+        if (_definitions[idx].name == type) {
+            field.definition = static_cast<int>(idx);
+        }
+    }
+    if (field.type == Struct && field.definition < 0)
+    {
+        error = QObject::tr("%1: unknown type \"%2\"").arg(where, type);
+        return false;
+    }
+
+    field.bigEndian = bigEndian;
+    if (object.contains("endian")) {
+        field.bigEndian = object.value("endian").toString() == QLatin1String("big");
+    }
+    if (object.contains("color")) {
+        field.color = QColor(object.value("color").toString());
+    }
+
+    // numbers and booleans are taken as expressions, too
+    const char * keys[] = {"count", "if", "at"};
+    TemplateExpression * expressions[] = {&field.count, &field.condition, &field.at};
+    for (int idx = 0; idx < 3; idx++)
+    {
+        const QJsonValue value = object.value(keys[idx]);
+        QString text;
+        if (value.isString()) {
+            text = value.toString();
+        } else if (value.isDouble()) {
+            text = QString::number(static_cast<qint64>(value.toDouble()));
+        } else if (value.isBool()) {
+            text = value.toBool() ? "1" : "0";
+        } else if (!value.isUndefined()) {
+            error = QObject::tr("%1: bad \"%2\"").arg(where, keys[idx]);
+            return false;
+        }
+        QString expressionError;
+        if (!text.isEmpty() && !expressions[idx]->parse(text, &expressionError))
+        {
+            error = QObject::tr("%1: %2").arg(where, expressionError);
+            return false;
+        }
+    }
+    field.isArray = !field.count.isNull();
+    return true;
+}
+
+qint64 StructTemplate::computeSize(int index, std::vector<int> & state)
+{
+    // state: 0 not visited, 1 in progress (a recursive struct), 2 done
+    Definition & definition = _definitions[index];
+    if (state[index] == 2) {
+        return definition.staticSize;
+    }
+    if (state[index] == 1) {
+        return -1;
+    }
+    state[index] = 1;
+
+    qint64 size = 0;
+    for (const Field & field : definition.fields)
+    {
+        qint64 fieldSize = field.size;
+        if (field.type == Struct)
+        {
+            fieldSize = computeSize(field.definition, state);
+            definition.placed |= _definitions[field.definition].placed;
+        }
+        if (!field.at.isNull())
+        {
+            definition.placed = true;
+            continue;
+        }
+        if (fieldSize >= 0 && field.isArray) {
+            fieldSize = field.count.isConstant() ? fieldSize * std::max<qint64>(field.count.evaluate(ConstantScope()), 0) : -1;
+        }
+        if (fieldSize < 0 || !field.condition.isNull() || size < 0) {
+            size = -1;
+        } else {
+            size += fieldSize;
+        }
+    }
+
+    definition.staticSize = size;
+    state[index] = 2;
+    return size;
+}
+
+bool StructTemplate::isNull() const
+{
+    return _root < 0;
+}
+
+int StructTemplate::root() const
+{
+    return _root;
+}
+
+const StructTemplate::Definition & StructTemplate::definition(int index) const
+{
+    return _definitions[index];
+}
+
+QString StructTemplate::typeName(const Field & field) const
+{
+    if (field.type == Struct) {
+        return _definitions[field.definition].name;
+    }
+    for (const TypeName & name : TYPE_NAMES)
+    {
+        if (name.type == field.type) {
+            return QLatin1String(name.name);
+        }
+    }
+    return QString();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// StructNode implementation:
+
+StructNode::StructNode(const StructTree & tree, StructNode * parent, const StructTemplate::Field * field, size_t pos, qint64 index, int row) :
+    _tree(tree),
+    _parent(parent),
+    _field(field),
+    _pos(pos),
+    _index(index),
+    _row(row),
+    _depth(parent ? parent->_depth + 1 : 0),
+    _count(0),
+    _evaluated(false),
+    _sizeKnown(false),
+    _size(0)
+{
+    if (!field) {
+        _kind = Structure;
+    } else if (index < 0 && field->isArray) {
+        _kind = Array;
+    } else if (field->type == StructTemplate::Struct) {
+        _kind = Structure;
+    } else {
+        _kind = Value;
+    }
+
+    if (_kind == Array)
+    {
+        // there are no more elements than bytes left
+        const size_t dataSize = _tree.data() ? _tree.data()->size() : 0;
+        const quint64 available = pos < dataSize ? dataSize - pos : 0;
+        const qint64 elements = field->count.evaluate(NodeScope(parent));
+        const qint64 size = elementSize();
+        _count = static_cast<quint64>(std::max<qint64>(elements, 0));
+        _count = std::min<quint64>(_count, size > 0 ? available / size : available);
+        _count = std::min<quint64>(_count, INT_MAX);
+    }
+}
+
+StructNode::Kind StructNode::kind() const
+{
+    return _kind;
+}
+
+QString StructNode::name() const
+{
+    if (!_field) {
+        return _tree.structTemplate().definition(definition()).name;
+    }
+    if (_index >= 0) {
+        return QString("[%1]").arg(_index);
+    }
+    return _field->name;
+}
+
+QString StructNode::typeName() const
+{
+    if (!_field) {
+        return name();
+    }
+    const QString type = _tree.structTemplate().typeName(*_field);
+    if (_kind == Array) {
+        return QString("%1[%2]").arg(type).arg(_count);
+    }
+    return type;
+}
+
+QString StructNode::valueText()
+{
+    if (_kind == Array && _field->type == StructTemplate::Char)
+    {
+        // the text up to the first null
+        const QByteArray bytes = _count > 0 ? _tree.data()->range(_pos, std::min<quint64>(_count, MAX_TEXT)) : QByteArray();
+        const int end = bytes.indexOf('\0');
+        QString text;
+        for (int idx = 0; idx < (end < 0 ? bytes.size() : end); idx++) {
+            text += (bytes[idx] >= 0x20 && bytes[idx] < 0x7f) ? QLatin1Char(bytes[idx]) : QLatin1Char('.');
+        }
+        return QString("\"%1\"%2").arg(text, (end < 0 && _count > MAX_TEXT) ? "..." : "");
+    }
+    quint64 raw;
+    if (_kind != Value || !read(raw)) {
+        return QString();
+    }
+
+    switch (_field->type)
+    {
+    case StructTemplate::Float32:
+    {
+        const quint32 bits = static_cast<quint32>(raw);
+        float number;
+        std::memcpy(&number, &bits, sizeof(number));
+        return QString::number(number, 'g', 7);
+    }
+    case StructTemplate::Float64:
+    {
+        double number;
+        std::memcpy(&number, &raw, sizeof(number));
+        return QString::number(number, 'g', 15);
+    }
+    case StructTemplate::Char:
+    {
+        const char ch = static_cast<char>(raw);
+        if (ch >= 0x20 && ch < 0x7f) {
+            return QString("'%1'").arg(QLatin1Char(ch));
+        }
+        return QString("0x%1").arg(raw, 2, 16, QChar('0'));
+    }
+    default:
+    {
+        const qint64 number = value();
+        const bool isSigned = _field->type == StructTemplate::Int8 || _field->type == StructTemplate::Int16 ||
+                              _field->type == StructTemplate::Int32 || _field->type == StructTemplate::Int64;
+        return QString("%1 (0x%2)")
+                .arg(isSigned ? QString::number(number) : QString::number(raw))
+                .arg(raw, 2 * _field->size, 16, QChar('0'));
+    }
+    }
+}
+
+QColor StructNode::color() const
+{
+    // of the nearest field with a colour, else from the palette
+    for (const StructNode * node = this; node && node->_field; node = node->_parent)
+    {
+        if (node->_field->color.isValid()) {
+            return node->_field->color;
+        }
+    }
+    return _field ? paletteColor(_field->index) : QColor();
+}
+
+size_t StructNode::pos() const
+{
+    return _pos;
+}
+
+size_t StructNode::size()
+{
+    if (_sizeKnown) {
+        return _size;
+    }
+
+    switch (_kind)
+    {
+    case Value:
+        _size = _field->size;
+        break;
+    case Array:
+    {
+        const qint64 size = elementSize();
+        _size = size >= 0 ? _count * size : elementPos(_count) - _pos;
+        break;
+    }
+    case Structure:
+    {
+        const qint64 size = _tree.structTemplate().definition(definition()).staticSize;
+        if (size >= 0)
+        {
+            _size = size;
+            break;
+        }
+        // the end of the last member, which isn't placed
+        evaluate();
+        _size = 0;
+        for (auto it = _members.rbegin(); it != _members.rend(); ++it)
+        {
+            if ((*it)->_field->at.isNull())
+            {
+                _size = (*it)->_pos + (*it)->size() - _pos;
+                break;
+            }
+        }
+        break;
+    }
+    }
+    _sizeKnown = true;
+    return _size;
+}
+
+qint64 StructNode::value()
+{
+    if (_kind == Array) {
+        return static_cast<qint64>(_count);
+    }
+    quint64 raw;
+    if (_kind != Value || !read(raw)) {
+        return 0;
+    }
+
+    // floats are truncated
+    switch (_field->type)
+    {
+    case StructTemplate::Int8:      return static_cast<qint8>(raw);
+    case StructTemplate::Int16:     return static_cast<qint16>(raw);
+    case StructTemplate::Int32:     return static_cast<qint32>(raw);
+    case StructTemplate::Float32:
+    {
+        const quint32 bits = static_cast<quint32>(raw);
+        float number;
+        std::memcpy(&number, &bits, sizeof(number));
+        return toInteger(number);
+    }
+    case StructTemplate::Float64:
+    {
+        double number;
+        std::memcpy(&number, &raw, sizeof(number));
+        return toInteger(number);
+    }
+    default:                        return static_cast<qint64>(raw);
+    }
+}
+
+StructNode * StructNode::parent() const
+{
+    return _parent;
+}
+
+int StructNode::row() const
+{
+    return _row;
+}
+
+bool StructNode::hasChildren() const
+{
+    switch (_kind)
+    {
+    case Structure:
+        return _depth <= MAX_DEPTH && !_tree.structTemplate().definition(definition()).fields.empty();
+    case Array:
+        return _field->type != StructTemplate::Char && _count > 0;
+    default:
+        return false;
+    }
+}
+
+int StructNode::childCount()
+{
+    switch (_kind)
+    {
+    case Structure:
+        evaluate();
+        return static_cast<int>(_members.size());
+    case Array:
+        return _field->type == StructTemplate::Char ? 0 : static_cast<int>(_count);
+    default:
+        return 0;
+    }
+}
+
+StructNode * StructNode::child(int row)
+{
+    if (row < 0 || row >= childCount()) {
+        return nullptr;
+    }
+    if (_kind == Structure) {
+        return _members[row].get();
+    }
+
+    std::unique_ptr<StructNode> & element = _elements[row];
+    if (!element) {
+        element = makeElement(row, elementPos(row));
+    }
+    return element.get();
+}
+
+int StructNode::definition() const
+{
+    if (!_field) {
+        return _tree.structTemplate().root();
+    }
+    return _field->type == StructTemplate::Struct ? _field->definition : -1;
+}
+
+qint64 StructNode::elementSize() const
+{
+    if (_field->type == StructTemplate::Struct) {
+        return _tree.structTemplate().definition(_field->definition).staticSize;
+    }
+    return _field->size;
+}
+
+size_t StructNode::elementPos(quint64 index)
+{
+    const qint64 size = elementSize();
+    if (size >= 0) {
+        return _pos + index * size;
+    }
+
+    // each element is evaluated once to find the next one
+    if (_offsets.empty()) {
+        _offsets.push_back(_pos);
+    }
+    while (_offsets.size() <= index)
+    {
+        const quint64 last = _offsets.size() - 1;
+        auto cached = _elements.find(last);
+        const size_t elementSize = cached != _elements.end() && cached->second ?
+                    cached->second->size() : makeElement(last, _offsets.back())->size();
+        _offsets.push_back(_offsets.back() + elementSize);
+    }
+    return _offsets[index];
+}
+
+std::unique_ptr<StructNode> StructNode::makeElement(quint64 index, size_t pos)
+{
+    return std::unique_ptr<StructNode>(new StructNode(_tree, this, _field, pos, index, static_cast<int>(index)));
+}
+
+StructNode * StructNode::member(const QString & name)
+{
+    if (_kind != Structure) {
+        return nullptr;
+    }
+    evaluate();
+    for (const std::unique_ptr<StructNode> & node : _members)
+    {
+        if (node->_field->name == name) {
+            return node.get();
+        }
+    }
+    return nullptr;
+}
+
+void StructNode::evaluate()
+{
+    if (_evaluated || _kind != Structure) {
+        return;
+    }
+    _evaluated = true;
+    if (_depth > MAX_DEPTH) {
+        return;
+    }
+
+    // a field follows the end of the last one, which isn't placed. Its size
+    // is only asked for then, an array at the end isn't walked.
+    const StructTemplate::Definition & definition = _tree.structTemplate().definition(this->definition());
+    NodeScope scope(this);
+    StructNode * previous = nullptr;
+    for (const StructTemplate::Field & field : definition.fields)
+    {
+        if (!field.condition.isNull() && field.condition.evaluate(scope) == 0) {
+            continue;
+        }
+        const bool placed = !field.at.isNull();
+        size_t pos = _pos;
+        if (placed) {
+            pos = static_cast<size_t>(std::max<qint64>(field.at.evaluate(scope), 0));
+        } else if (previous) {
+            pos = previous->_pos + previous->size();
+        }
+        _members.push_back(std::unique_ptr<StructNode>(new StructNode(_tree, this, &field, pos, -1, static_cast<int>(_members.size()))));
+        if (!placed) {
+            previous = _members.back().get();
+        }
+    }
+}
+
+bool StructNode::read(quint64 & raw)
+{
+    const QHexEditData * data = _tree.data();
+    const size_t size = _field->size;
+    if (!data || _kind != Value || _pos >= data->size() || data->size() - _pos < size) {
+        return false;
+    }
+    const QByteArray bytes = data->range(_pos, size);
+    if (static_cast<size_t>(bytes.size()) != size) {
+        return false;
+    }
+    raw = 0;
+    for (size_t idx = 0; idx < size; idx++) {
+        raw |= quint64(static_cast<uchar>(bytes[int(idx)])) << (8 * (_field->bigEndian ? size - 1 - idx : idx));
+    }
+    return true;
+}
+
+void StructNode::paint(size_t begin, size_t end, QColor * colors, QColor color)
+{
+    if (_field && _field->color.isValid()) {
+        color = _field->color;
+    }
+
+    const StructTemplate & structTemplate = _tree.structTemplate();
+    if (_kind == Structure)
+    {
+        const StructTemplate::Definition & definition = structTemplate.definition(this->definition());
+        if (!definition.placed && (_pos >= end || (definition.staticSize >= 0 && _pos + definition.staticSize <= begin))) {
+            return;
+        }
+        evaluate();
+        for (const std::unique_ptr<StructNode> & member : _members) {
+            member->paint(begin, end, colors, color);
+        }
+        return;
+    }
+
+    if (_kind == Value || definition() < 0)
+    {
+        // values and arrays of them have one colour
+        const size_t from = std::max(_pos, begin);
+        const size_t to = std::min(_pos + size(), end);
+        if (from < to) {
+            std::fill(colors + (from - begin), colors + (to - begin), color.isValid() ? color : paletteColor(_field->index));
+        }
+        return;
+    }
+
+    // the elements in view, found by their index or by walking the array
+    if (_count == 0 || _pos >= end) {
+        return;
+    }
+    const qint64 size = elementSize();
+    quint64 first = 0;
+    if (size == 0) {
+        return;
+    }
+    if (size > 0) {
+        first = begin > _pos ? (begin - _pos) / size : 0;
+    }
+    else if (begin > _pos)
+    {
+        elementPos(0);
+        while (_offsets.size() <= _count && _offsets.back() <= begin) {
+            elementPos(_offsets.size());
+        }
+        first = std::upper_bound(_offsets.begin(), _offsets.end(), begin) - _offsets.begin() - 1;
+    }
+
+    for (quint64 idx = first; idx < _count; idx++)
+    {
+        const size_t pos = elementPos(idx);
+        if (pos >= end) {
+            break;
+        }
+        auto cached = _elements.find(idx);
+        if (cached != _elements.end() && cached->second) {
+            cached->second->paint(begin, end, colors, color);
+        } else {
+            makeElement(idx, pos)->paint(begin, end, colors, color);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// StructTree implementation:
+
+StructTree::StructTree() :
+    _data(nullptr)
+{ }
+
+StructTree::~StructTree()
+{ }
+
+void StructTree::setTemplate(const StructTemplate & structTemplate)
+{
+    _template = structTemplate;
+    reset();
+}
+
+const StructTemplate & StructTree::structTemplate() const
+{
+    return _template;
+}
+
+void StructTree::setData(QHexEditData * data)
+{
+    _data = data;
+    reset();
+}
+
+QHexEditData * StructTree::data() const
+{
+    return _data;
+}
+
+void StructTree::reset()
+{
+    _root.reset();
+}
+
+StructNode * StructTree::root() const
+{
+    if (_template.isNull()) {
+        return nullptr;
+    }
+    if (!_root) {
+        _root.reset(new StructNode(*this, nullptr, nullptr, 0, -1, 0));
+    }
+    return _root.get();
+}
+
+void StructTree::highlight(size_t begin, size_t end, QColor * colors) const
+{
+    StructNode * node = root();
+    if (node && _data && begin < end) {
+        node->paint(begin, end, colors, QColor());
+    }
+}
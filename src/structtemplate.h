@@ -0,0 +1,251 @@
+#ifndef STRUCTTEMPLATE_H
+#define STRUCTTEMPLATE_H
+
+#include <QColor>
+#include <QIODevice>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "qhexeditdata.h"
+#include "qhexedithighlighter.h"
+
+/** \cond docNever */
+
+/*! TemplateExpression is an integer expression of a structure template, like
+"count * 2" or "header.type == 2 && flags & 0x10". It knows the operators of
+C (but ?:), decimal and hex numbers and names, which are resolved by a Scope
+when the expression is evaluated. Evaluating never fails, unknown names and
+divisions by zero are 0.
+*/
+class TemplateExpression
+{
+public:
+    class Scope
+    {
+    public:
+        virtual ~Scope() { }
+
+        // the value of a name like "header.count", false if it is unknown
+        virtual bool lookup(const QStringList & path, qint64 & value) const = 0;
+    };
+
+    TemplateExpression();
+
+    bool parse(const QString & text, QString * errorString);
+    bool isNull() const;
+    bool isConstant() const;            // a number without names
+    qint64 evaluate(const Scope & scope) const;
+
+private:
+    class Parser;
+    friend class Parser;
+
+    struct Term
+    {
+        int op;                         // 0: number, 1: name, else the operator
+        qint64 value;
+        QStringList path;
+        int left, right;                // index of the operands
+    };
+
+    qint64 evaluate(int term, const Scope & scope) const;
+
+    std::vector<Term> _terms;           // the last one is the root
+};
+
+/*! StructTemplate holds the definitions of a template file, a JSON object:
+
+\code
+{
+    "endian": "little",
+    "root": "Elf",
+    "structs": {
+        "Elf": [
+            {"name": "ident", "type": "char", "count": 16},
+            {"name": "type", "type": "u16"},
+            {"name": "phoff", "type": "u64", "color": "#ffd0d0"},
+            {"name": "phnum", "type": "u16"},
+            {"name": "phdrs", "type": "Phdr", "count": "phnum", "at": "phoff"},
+            {"name": "entry", "type": "u32", "if": "type == 2", "endian": "big"}
+        ],
+        "Phdr": [ ... ]
+    }
+}
+\endcode
+
+The types are i8, u8, i16, u16, i32, u32, i64, u64, f32, f64, char and the
+names of the structs. "count" makes a field an array, "if" leaves it out if
+it is 0, "at" places it at an absolute position instead of behind the field
+in front of it (the fields behind it continue where they were). Their values
+are expressions of the fields before them, of the same struct and of the
+enclosing ones, "_index" is the index of the element of the nearest array.
+*/
+class StructTemplate
+{
+public:
+    enum Type
+    {
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Int64,
+        UInt64,
+        Float32,
+        Float64,
+        Char,
+        Struct
+    };
+
+    struct Field
+    {
+        QString name;
+        Type type;
+        int definition;                 // of a Struct
+        int size;                       // of a value, 0 for a Struct
+        int index;                      // in the struct
+        bool bigEndian;
+        bool isArray;
+        TemplateExpression count;
+        TemplateExpression condition;
+        TemplateExpression at;
+        QColor color;                   // invalid: from the enclosing field or the palette
+    };
+
+    struct Definition
+    {
+        QString name;
+        std::vector<Field> fields;
+        qint64 staticSize;              // -1 if the size depends on the data
+        bool placed;                    // it or a nested struct has fields with "at"
+    };
+
+    StructTemplate();
+
+    bool load(QIODevice & device, QString * errorString = nullptr);
+    bool isNull() const;
+
+    int root() const;
+    const Definition & definition(int index) const;
+    QString typeName(const Field & field) const;
+
+private:
+    bool parseField(const QJsonObject & object, const QString & context, bool bigEndian, Field & field, QString & error);
+    qint64 computeSize(int index, std::vector<int> & state);
+
+    std::vector<Definition> _definitions;
+    int _root;
+};
+
+class StructTree;
+
+/*! StructNode is an evaluated part of the data: a value, an array or a
+struct. The members of a struct are evaluated when they are asked for the
+first time, the elements of an array one by one, so only the parts which are
+shown cost time and memory.
+*/
+class StructNode
+{
+public:
+    enum Kind
+    {
+        Value,
+        Array,
+        Structure
+    };
+
+    StructNode(const StructTree & tree, StructNode * parent, const StructTemplate::Field * field, size_t pos, qint64 index, int row);
+
+    Kind kind() const;
+    QString name() const;
+    QString typeName() const;
+    QString valueText();
+    QColor color() const;
+
+    size_t pos() const;
+    size_t size();                      // evaluates the members of a struct
+    qint64 value();                     // of a Value, the count of an Array
+
+    StructNode * parent() const;
+    int row() const;
+    bool hasChildren() const;
+    int childCount();
+    StructNode * child(int row);
+
+private:
+    friend class StructTree;
+    friend class NodeScope;
+
+    int definition() const;             // of a Structure or the elements of an Array
+    qint64 elementSize() const;         // -1 if it depends on the data
+    size_t elementPos(quint64 index);
+    std::unique_ptr<StructNode> makeElement(quint64 index, size_t pos);
+    StructNode * member(const QString & name);
+    void evaluate();
+    bool read(quint64 & raw);           // the bytes of a Value in the order of the host
+    void paint(size_t begin, size_t end, QColor * colors, QColor color);
+
+    const StructTree & _tree;
+    StructNode * _parent;
+    const StructTemplate::Field * _field;   // null for the root
+    Kind _kind;
+    size_t _pos;
+    qint64 _index;                      // of an element, else -1
+    int _row;
+    int _depth;
+    quint64 _count;                     // elements of an Array
+    bool _evaluated;
+    bool _sizeKnown;
+    size_t _size;
+    std::vector<std::unique_ptr<StructNode>> _members;
+    std::map<quint64, std::unique_ptr<StructNode>> _elements;
+    std::vector<size_t> _offsets;       // of the elements walked so far, if their size varies
+};
+
+/*! StructTree applies a StructTemplate to a QHexEditData, the root struct
+starts at the first byte. It is a QHexEditHighlighter, which colours the
+fields of the structures in view.
+
+Nothing is evaluated up front. Painting visits only the structures, which
+intersect the painted lines: the elements of arrays with a fixed element size
+are found by their index, arrays of elements whose size depends on the data
+are walked once up to the view and their offsets are kept. Nodes asked for by
+root() (e.g. by the expanded items of a tree view) are kept until reset().
+*/
+class StructTree : public QHexEditHighlighter
+{
+public:
+    StructTree();
+    ~StructTree();
+
+    void setTemplate(const StructTemplate & structTemplate);
+    const StructTemplate & structTemplate() const;
+
+    // data has to outlive the tree or be reset
+    void setData(QHexEditData * data);
+    QHexEditData * data() const;
+
+    // drops the evaluated nodes, e.g. after the data was changed
+    void reset();
+
+    // null without a template
+    StructNode * root() const;
+
+    void highlight(size_t begin, size_t end, QColor * colors) const;
+
+private:
+    StructTemplate _template;
+    QHexEditData * _data;
+    mutable std::unique_ptr<StructNode> _root;
+};
+
+/** \endcond docNever */
+
+#endif // STRUCTTEMPLATE_H
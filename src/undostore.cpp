@@ -0,0 +1,181 @@
+#include "undostore.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// UndoPayload implementation:
+UndoPayload::UndoPayload(UndoStore & store, const QByteArray & data) :
+    _store(store),
+    _data(data),
+    _fileOffset(-1),
+    _length(data.length())
+{
+    _store.attach(this);
+}
+
+UndoPayload::~UndoPayload()
+{
+    _store.detach(this);
+}
+
+bool UndoPayload::data(QByteArray & data) const
+{
+    if (_fileOffset < 0)
+    {
+        data = _data;
+        return true;
+    }
+    return _store.load(this, data);
+}
+
+void UndoPayload::setData(const QByteArray & data)
+{
+    _store.detach(this);
+    _data = data;
+    _fileOffset = -1;
+    _length = data.length();
+    _store.attach(this);
+}
+
+int UndoPayload::length() const
+{
+    return _length;
+}
+
+bool UndoPayload::isSpilled() const
+{
+    return _fileOffset >= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UndoStore implementation:
+UndoStore::UndoStore(size_t memoryLimit) :
+    _memoryLimit(memoryLimit),
+    _memoryUsage(0),
+    _spilledBytes(0),
+    _payloads(0),
+    _journalFailed(false),
+    _loadFailed(false)
+{ }
+
+UndoStore::~UndoStore()
+{
+    // all payloads belong to commands, which have to be deleted before the store
+    Q_ASSERT(_payloads == 0);
+}
+
+size_t UndoStore::memoryUsage() const
+{
+    return _memoryUsage;
+}
+
+size_t UndoStore::spilledBytes() const
+{
+    return _spilledBytes;
+}
+
+size_t UndoStore::memoryLimit() const
+{
+    return _memoryLimit;
+}
+
+void UndoStore::setMemoryLimit(size_t limit)
+{
+    _memoryLimit = limit;
+    enforceLimit();
+}
+
+bool UndoStore::takeLoadFailed()
+{
+    const bool failed = _loadFailed;
+    _loadFailed = false;
+    return failed;
+}
+
+void UndoStore::attach(UndoPayload * payload)
+{
+    _payloads++;
+    _memoryUsage += payload->_length;
+    payload->_residentPos = _resident.insert(_resident.end(), payload);
+    enforceLimit();
+}
+
+void UndoStore::detach(UndoPayload * payload)
+{
+    _payloads--;
+    if (payload->_fileOffset < 0) {
+        _memoryUsage -= payload->_length;
+        _resident.erase(payload->_residentPos);
+    } else {
+        _spilledBytes -= payload->_length;
+    }
+
+    // the journal is only appended, so its space is reclaimed when it is unused
+    if (_payloads == 0 && _journal && _journal->size() > 0) {
+        _journal->resize(0);
+        _spilledBytes = 0;
+    }
+}
+
+bool UndoStore::load(const UndoPayload * payload, QByteArray & data) const
+{
+    Q_ASSERT(_journal);
+    data = QByteArray();
+    if (!_journal->seek(payload->_fileOffset)) {
+        qWarning("UndoStore: cannot seek in undo journal");
+        _loadFailed = true;
+        return false;
+    }
+    data = _journal->read(payload->_length);
+    if (data.length() != payload->_length)
+    {
+        qWarning("UndoStore: cannot read undo journal");
+        data = QByteArray();
+        _loadFailed = true;
+        return false;
+    }
+    return true;
+}
+
+void UndoStore::enforceLimit()
+{
+    while (_memoryUsage > _memoryLimit && !_resident.empty())
+    {
+        if (!spill(_resident.front())) {
+            break;
+        }
+    }
+}
+
+bool UndoStore::spill(UndoPayload * payload)
+{
+    if (_journalFailed) {
+        return false;
+    }
+
+    if (!_journal)
+    {
+        _journal.reset(new QTemporaryFile(QDir::tempPath() + "/qhexedit-undo-XXXXXX"));
+        if (!_journal->open())
+        {
+            qWarning("UndoStore: cannot create undo journal, undo history stays in memory");
+            _journal.reset();
+            _journalFailed = true;
+            return false;
+        }
+    }
+
+    const qint64 offset = _journal->size();
+    if (!_journal->seek(offset) ||
+        _journal->write(payload->_data) != payload->_length)
+    {
+        qWarning("UndoStore: cannot write undo journal, undo history stays in memory");
+        _journalFailed = true;
+        return false;
+    }
+
+    _resident.erase(payload->_residentPos);
+    _memoryUsage -= payload->_length;
+    _spilledBytes += payload->_length;
+    payload->_fileOffset = offset;
+    payload->_data = QByteArray();
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef UNDOSTORE_H
+#define UNDOSTORE_H
+
+/** \cond docNever */
+
+#include <QtCore>
+
+#include <list>
+#include <memory>
+
+class UndoStore;
+
+/*! UndoPayload holds a byte array which is needed by an undo command to undo
+or redo its action (e.g. the overwritten bytes of a replace). The payload is
+registered at an UndoStore, which accounts its size. When the store runs over
+its memory budget, the payload is written to the journal file of the store and
+its memory is released. data() transparently reads spilled payloads back, it
+fails if the journal can't be read completely, which the store reports by
+takeLoadFailed().
+*/
+class UndoPayload
+{
+public:
+    explicit UndoPayload(UndoStore & store, const QByteArray & data = QByteArray());
+    ~UndoPayload();
+
+    // false if a spilled payload can't be read back, data is empty then
+    bool data(QByteArray & data) const;
+    void setData(const QByteArray & data);
+
+    int length() const;
+    bool isSpilled() const;
+
+private:
+    UndoPayload(const UndoPayload & other) = delete;
+    UndoPayload & operator=(const UndoPayload & other) = delete;
+
+    friend class UndoStore;
+
+    UndoStore & _store;
+    QByteArray _data;                   // resident bytes (empty when spilled)
+    qint64 _fileOffset;                 // position inside the journal, -1 if resident
+    int _length;
+    std::list<UndoPayload *>::iterator _residentPos;
+};
+
+/*! UndoStore enforces a memory budget for the payloads of all undo commands of
+one QUndoStack. The payloads are kept in the order of their registration, so
+the oldest payloads (the ones furthest away from the current undo index) are
+spilled first. Spilled payloads go to a temporary journal file, which is
+truncated when the last payload is released.
+
+If the journal file can't be created, payloads stay in memory and the budget
+is exceeded (a warning is printed once). Undo history is never dropped
+silently, because QUndoStack doesn't support removing single commands.
+*/
+class UndoStore
+{
+public:
+    static const size_t DefaultMemoryLimit = 64 * 1024 * 1024;
+
+    explicit UndoStore(size_t memoryLimit = DefaultMemoryLimit);
+    ~UndoStore();
+
+    // resident bytes of all payloads
+    size_t memoryUsage() const;
+    // bytes of all payloads, which are stored in the journal file
+    size_t spilledBytes() const;
+
+    size_t memoryLimit() const;
+    void setMemoryLimit(size_t limit);
+
+    // true once after a spilled payload couldn't be read back, the commands
+    // have refused to act then and the history no longer fits the data
+    bool takeLoadFailed();
+
+private:
+    UndoStore(const UndoStore & other) = delete;
+    UndoStore & operator=(const UndoStore & other) = delete;
+
+    friend class UndoPayload;
+
+    void attach(UndoPayload * payload);
+    void detach(UndoPayload * payload);
+    bool load(const UndoPayload * payload, QByteArray & data) const;
+    void enforceLimit();
+    bool spill(UndoPayload * payload);
+
+    std::list<UndoPayload *> _resident;     // oldest first
+    std::unique_ptr<QTemporaryFile> _journal;
+    size_t _memoryLimit;
+    size_t _memoryUsage;
+    size_t _spilledBytes;
+    int _payloads;
+    bool _journalFailed;
+    mutable bool _loadFailed;
+};
+
+/** \endcond docNever */
+
+#endif // UNDOSTORE_H
@@ -0,0 +1,228 @@
+#include "valuedecoder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+struct TypeInfo
+{
+    int size;                           // bytes
+    int width;                          // chars of the widest value
+};
+
+// by Type, floats are shown with the digits they can hold (%.7g and %.15g)
+static const TypeInfo TYPES[] =
+{
+    {0, 0},
+    {1, 4}, {1, 3},
+    {2, 6}, {2, 5},
+    {4, 11}, {4, 10},
+    {8, 20}, {8, 20},
+    {4, 13}, {8, 22}
+};
+
+// reverses the bytes of count values of size bytes in place
+static void swapBytes(uchar * data, size_t count, int size)
+{
+    const size_t bytes = count * size;
+    size_t pos = 0;
+#ifdef __SSE2__
+    for (; pos + 16 <= bytes; pos += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+        // reverse the 16 bit words of a value, then the bytes of every word
+        if (size == 4)
+        {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        else if (size == 8)
+        {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + pos), v);
+    }
+#endif
+    for (; pos < bytes; pos += size) {
+        std::reverse(data + pos, data + pos + size);
+    }
+}
+
+// writes the digits in front of end, returns the first one
+static char * writeDecimal(char * end, quint64 value, bool negative)
+{
+    do
+    {
+        *--end = char('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    if (negative) {
+        *--end = '-';
+    }
+    return end;
+}
+
+template <typename T>
+static T load(const uchar * value)
+{
+    T result;
+    std::memcpy(&result, value, sizeof(T));
+    return result;
+}
+
+template <typename T>
+static void writeSigned(char * end, const uchar * value)
+{
+    const qint64 v = load<T>(value);
+    writeDecimal(end, v < 0 ? 0 - quint64(v) : quint64(v), v < 0);
+}
+
+static void writeFloat(char * end, double value, int digits, int width)
+{
+    char buffer[32];
+    const int len = std::min(std::snprintf(buffer, sizeof(buffer), "%.*g", digits, value), width);
+    if (len > 0) {
+        std::memcpy(end - len, buffer, len);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ValueDecoder implementation:
+
+ValueDecoder::ValueDecoder() :
+    _type(None),
+    _bigEndian(false),
+    _stride(0)
+{ }
+
+void ValueDecoder::setType(Type type)
+{
+    _type = (type >= None && type <= Float64) ? type : None;
+}
+
+void ValueDecoder::setBigEndian(bool bigEndian)
+{
+    _bigEndian = bigEndian;
+}
+
+void ValueDecoder::setStride(int stride)
+{
+    _stride = std::max(stride, 0);
+}
+
+ValueDecoder::Type ValueDecoder::type() const
+{
+    return _type;
+}
+
+bool ValueDecoder::bigEndian() const
+{
+    return _bigEndian;
+}
+
+int ValueDecoder::stride() const
+{
+    return _stride;
+}
+
+int ValueDecoder::step() const
+{
+    return _stride > 0 ? _stride : std::max(valueSize(), 1);
+}
+
+int ValueDecoder::valueSize() const
+{
+    return TYPES[_type].size;
+}
+
+int ValueDecoder::cellChars() const
+{
+    return TYPES[_type].width + 1;
+}
+
+int ValueDecoder::valuesPerLine(int bytesPerLine) const
+{
+    if (_type == None) {
+        return 0;
+    }
+    return (bytesPerLine + step() - 1) / step();
+}
+
+int ValueDecoder::lineChars(int bytesPerLine) const
+{
+    return valuesPerLine(bytesPerLine) * cellChars();
+}
+
+void ValueDecoder::decode(const uchar * src, size_t size, size_t lines, int bytesPerLine, std::vector<char> & text)
+{
+    const int perLine = valuesPerLine(bytesPerLine);
+    const int chars = lineChars(bytesPerLine);
+    text.assign(lines * chars, ' ');
+    if (perLine == 0) {
+        return;
+    }
+
+    // the positions grow with the index, so the values in src are a prefix
+    const size_t valueBytes = valueSize();
+    const size_t stride = step();
+    size_t count = 0;
+    _packed.resize(lines * perLine * valueBytes);
+    if (stride == valueBytes && perLine * stride == size_t(bytesPerLine))
+    {
+        count = std::min(lines * perLine, size / valueBytes);
+        std::memcpy(_packed.data(), src, count * valueBytes);
+    }
+    else
+    {
+        for (size_t line = 0; line < lines; line++)
+        {
+            for (int idx = 0; idx < perLine; idx++)
+            {
+                const size_t pos = line * bytesPerLine + idx * stride;
+                if (pos + valueBytes > size) {
+                    break;
+                }
+                std::memcpy(_packed.data() + count * valueBytes, src + pos, valueBytes);
+                count++;
+            }
+            if (count < (line + 1) * perLine) {
+                break;
+            }
+        }
+    }
+
+    if (valueBytes > 1 && _bigEndian != (Q_BYTE_ORDER == Q_BIG_ENDIAN)) {
+        swapBytes(_packed.data(), count, int(valueBytes));
+    }
+
+    const int cell = cellChars();
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        char * cellEnd = text.data() + (idx / perLine) * chars + (idx % perLine + 1) * cell;
+        format(_packed.data() + idx * valueBytes, cellEnd);
+    }
+}
+
+void ValueDecoder::format(const uchar * value, char * cellEnd) const
+{
+    switch (_type)
+    {
+    case Int8:      writeSigned<qint8>(cellEnd, value); break;
+    case UInt8:     writeDecimal(cellEnd, *value, false); break;
+    case Int16:     writeSigned<qint16>(cellEnd, value); break;
+    case UInt16:    writeDecimal(cellEnd, load<quint16>(value), false); break;
+    case Int32:     writeSigned<qint32>(cellEnd, value); break;
+    case UInt32:    writeDecimal(cellEnd, load<quint32>(value), false); break;
+    case Int64:     writeSigned<qint64>(cellEnd, value); break;
+    case UInt64:    writeDecimal(cellEnd, load<quint64>(value), false); break;
+    case Float32:   writeFloat(cellEnd, load<float>(value), 7, TYPES[_type].width); break;
+    case Float64:   writeFloat(cellEnd, load<double>(value), 15, TYPES[_type].width); break;
+    case None:      break;
+    }
+}
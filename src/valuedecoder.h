@@ -0,0 +1,72 @@
+#ifndef VALUEDECODER_H
+#define VALUEDECODER_H
+
+/** \cond docNever */
+
+#include <QtGlobal>
+
+#include <vector>
+
+/*! ValueDecoder turns the bytes of the visible lines into the text of the
+inspector column: the values of one type (int8 .. int64, float32/64) at every
+stride bytes of a line, in little or big endian.
+
+The whole window is decoded at once, as the widget paints it. The values are
+gathered into a packed buffer (one copy if they are contiguous), their bytes
+are swapped in place, 16 bytes at once with SSE2, and they are written as
+text of fixed width without any allocation per value. So a line costs one
+drawText() and no access to the data per value.
+*/
+class ValueDecoder
+{
+public:
+    enum Type
+    {
+        None,
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Int64,
+        UInt64,
+        Float32,
+        Float64
+    };
+
+    static const int MAX_SIZE = 8;      // bytes of the largest type
+
+    ValueDecoder();
+
+    void setType(Type type);
+    void setBigEndian(bool bigEndian);
+    void setStride(int stride);         // 0: the size of the type
+
+    Type type() const;
+    bool bigEndian() const;
+    int stride() const;                 // as set, may be 0
+    int step() const;                   // bytes from one value to the next
+
+    int valueSize() const;              // bytes of a value, 0 for None
+    int cellChars() const;              // chars of a value and the blank in front of it
+    int valuesPerLine(int bytesPerLine) const;
+    int lineChars(int bytesPerLine) const;
+
+    // decodes the values of lines lines of bytesPerLine bytes each into
+    // text, lineChars() per line. src holds size bytes, values which don't
+    // fit into them are left blank.
+    void decode(const uchar * src, size_t size, size_t lines, int bytesPerLine, std::vector<char> & text);
+
+private:
+    void format(const uchar * value, char * cellEnd) const;
+
+    Type _type;
+    bool _bigEndian;
+    int _stride;
+    std::vector<uchar> _packed;         // the values of the window, one after another
+};
+
+/** \endcond docNever */
+
+#endif // VALUEDECODER_H
@@ -0,0 +1,68 @@
+#include <QtTest>
+
+#include <memory>
+
+#include "../../src/qhexeditdata.h"
+#include "../../src/hashengine.h"
+
+/*! TestHashEngine checks the digests of HashEngine against the reference
+values of the algorithms, including the ones of the empty input.
+*/
+class TestHashEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void digests_data();
+    void digests();
+};
+
+void TestHashEngine::digests_data()
+{
+    QTest::addColumn<int>("pos");
+    QTest::addColumn<int>("len");
+    QTest::addColumn<QByteArray>("crc32");
+    QTest::addColumn<QByteArray>("sha1");
+    QTest::addColumn<QByteArray>("sha256");
+    QTest::addColumn<QByteArray>("xxh64");
+
+    const QByteArray emptyCrc32("00000000");
+    const QByteArray emptySha1("da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    const QByteArray emptySha256("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    const QByteArray emptyXxh64("ef46db3751d8e999");
+
+    QTest::newRow("abc") << 0 << 3 << QByteArray("352441c2")
+                         << QByteArray("a9993e364706816aba3e25717850c26c9cd0d89d")
+                         << QByteArray("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad")
+                         << QByteArray("44bc2cf5ad770999");
+    QTest::newRow("empty at start") << 0 << 0 << emptyCrc32 << emptySha1 << emptySha256 << emptyXxh64;
+    QTest::newRow("empty inside") << 1 << 0 << emptyCrc32 << emptySha1 << emptySha256 << emptyXxh64;
+    QTest::newRow("empty at end") << 3 << 0 << emptyCrc32 << emptySha1 << emptySha256 << emptyXxh64;
+}
+
+void TestHashEngine::digests()
+{
+    QFETCH(int, pos);
+    QFETCH(int, len);
+    QFETCH(QByteArray, crc32);
+    QFETCH(QByteArray, sha1);
+    QFETCH(QByteArray, sha256);
+    QFETCH(QByteArray, xxh64);
+
+    std::unique_ptr<QHexEditData> data = QHexEditData::fromByteArray(QByteArray("abc"));
+    HashEngine engine;
+    engine.setData(data.get());
+    engine.request(pos, len, HashEngine::AllAlgorithms);
+    QTRY_VERIFY(engine.isReady());
+
+    QCOMPARE(engine.resultPos(), size_t(pos));
+    QCOMPARE(engine.resultLength(), size_t(len));
+    QCOMPARE(engine.result(HashEngine::Crc32).toHex(), crc32);
+    QCOMPARE(engine.result(HashEngine::Sha1).toHex(), sha1);
+    QCOMPARE(engine.result(HashEngine::Sha256).toHex(), sha256);
+    QCOMPARE(engine.result(HashEngine::Xxh64).toHex(), xxh64);
+}
+
+QTEST_GUILESS_MAIN(TestHashEngine)
+
+#include "tst_hashengine.moc"
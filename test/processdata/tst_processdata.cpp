@@ -0,0 +1,182 @@
+#include <QtTest>
+
+#include <memory>
+
+#ifdef Q_OS_LINUX
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "../../src/qhexeditdata.h"
+#include "../../src/qhexeditdocument.h"
+
+const int PART_SIZE = 64;
+
+// the child is forked after the buffer is filled, so it has the same bytes at
+// the same address. Every test uses its own part of it.
+static char BUFFER[4 * PART_SIZE];
+
+enum Part
+{
+    ReadPart,
+    WritePart,
+    InsertPart,
+    RemovePart
+};
+
+/*! TestProcessData checks the process memory backend against a child
+process, which waits until the tests are done: reading, writing, and that
+the document turns inserts into replaces and drops removes, because the
+memory of a process can't grow or shrink.
+*/
+class TestProcessData : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void read();
+    void write();
+    void insertReplaces();
+    void removeIsDropped();
+
+private:
+    std::unique_ptr<QHexEditData> openChild();
+    size_t positionOf(const QHexEditData & data, const void * address);
+    QByteArray part(Part part) const;
+
+    qint64 _child = -1;
+    int _pipe = -1;                     // the child exits, when it is closed
+};
+
+void TestProcessData::initTestCase()
+{
+#ifdef Q_OS_LINUX
+    for (int idx = 0; idx < int(sizeof(BUFFER)); idx++) {
+        BUFFER[idx] = char(idx * 7 + 3);
+    }
+
+    int fds[2];
+    QVERIFY(pipe(fds) == 0);
+    const pid_t pid = fork();
+    QVERIFY(pid >= 0);
+    if (pid == 0)
+    {
+        close(fds[1]);
+        char c;
+        while (::read(fds[0], &c, 1) > 0) { }
+        _exit(0);
+    }
+    close(fds[0]);
+    _pipe = fds[1];
+    _child = pid;
+#else
+    QSKIP("The memory of other processes can only be read on Linux");
+#endif
+}
+
+void TestProcessData::cleanupTestCase()
+{
+#ifdef Q_OS_LINUX
+    if (_child > 0)
+    {
+        close(_pipe);
+        waitpid(pid_t(_child), nullptr, 0);
+    }
+#endif
+}
+
+void TestProcessData::read()
+{
+    std::unique_ptr<QHexEditData> data = openChild();
+    QVERIFY(data);
+    QVERIFY(data->fixedSize());
+    QVERIFY(!data->canInsert());
+
+    const size_t pos = positionOf(*data, BUFFER + ReadPart * PART_SIZE);
+    QVERIFY(pos < data->size());
+    QCOMPARE(data->range(pos, PART_SIZE), part(ReadPart));
+}
+
+void TestProcessData::write()
+{
+    std::unique_ptr<QHexEditData> data = openChild();
+    QVERIFY(data);
+    const size_t pos = positionOf(*data, BUFFER + WritePart * PART_SIZE);
+    QVERIFY(pos < data->size());
+
+    data->replace(pos, QByteArray("written"));
+    QCOMPARE(openChild()->range(pos, 7), QByteArray("written"));
+    QCOMPARE(openChild()->range(pos + 7, PART_SIZE - 7), part(WritePart).mid(7));
+}
+
+void TestProcessData::insertReplaces()
+{
+    std::unique_ptr<QHexEditData> data = openChild();
+    QVERIFY(data);
+    const size_t pos = positionOf(*data, BUFFER + InsertPart * PART_SIZE);
+    QVERIFY(pos < data->size());
+
+    QHexEditDocument document(std::move(data));
+    const size_t size = document.data().size();
+    document.applyArray(ArrayCommand::insert, pos, QByteArray("ab"), 2);
+    document.applyChar(CharCommand::insert, pos + 2, 'c');
+    QCOMPARE(document.data().size(), size);
+    QCOMPARE(openChild()->range(pos, PART_SIZE), QByteArray("abc") + part(InsertPart).mid(3));
+
+    // undo restores the replaced bytes
+    while (document.undoStack()->canUndo()) {
+        document.undo();
+    }
+    QCOMPARE(openChild()->range(pos, PART_SIZE), part(InsertPart));
+}
+
+void TestProcessData::removeIsDropped()
+{
+    std::unique_ptr<QHexEditData> data = openChild();
+    QVERIFY(data);
+    const size_t pos = positionOf(*data, BUFFER + RemovePart * PART_SIZE);
+    QVERIFY(pos < data->size());
+
+    QHexEditDocument document(std::move(data));
+    const size_t size = document.data().size();
+    document.applyArray(ArrayCommand::remove, pos, QByteArray(), 4);
+    document.applyChar(CharCommand::remove, pos, 0);
+    QCOMPARE(document.data().size(), size);
+    QCOMPARE(document.undoStack()->count(), 0);
+    QCOMPARE(openChild()->range(pos, PART_SIZE), part(RemovePart));
+}
+
+std::unique_ptr<QHexEditData> TestProcessData::openChild()
+{
+    return QHexEditData::fromProcess(_child);
+}
+
+// the position of an address of the child in the data, or size()
+size_t TestProcessData::positionOf(const QHexEditData & data, const void * address)
+{
+    const quint64 target = quint64(quintptr(address));
+    for (size_t pos = data.nextData(0); pos < data.size(); )
+    {
+        const size_t end = data.nextHole(pos);
+        const quint64 begin = data.address(pos);
+        if (target >= begin && target < begin + (end - pos)) {
+            return pos + size_t(target - begin);
+        }
+        pos = data.nextData(end);
+    }
+    return data.size();
+}
+
+QByteArray TestProcessData::part(Part part) const
+{
+    return QByteArray(BUFFER + part * PART_SIZE, PART_SIZE);
+}
+
+QTEST_GUILESS_MAIN(TestProcessData)
+
+#include "tst_processdata.moc"